@@ -29,6 +29,7 @@
  * The InputConsumer is used by the application to receive events from the input dispatcher.
  */
 
+#include <string.h>
 #include <string>
 #include <unordered_map>
 
@@ -39,6 +40,7 @@
 #include <binder/IBinder.h>
 #include <binder/Parcelable.h>
 #include <input/Input.h>
+#include <input/TouchPredictor.h>
 #include <sys/stat.h>
 #include <ui/Transform.h>
 #include <utils/BitSet.h>
@@ -83,6 +85,9 @@ struct InputMessage {
     // as the underlying data. This is not guaranteed by C++, but it simplifies the conversions.
     static_assert(sizeof(std::array<uint8_t, 32>) == 32);
 
+    // For historical motion samples, rely on PointerProperties being as big as a time.
+    static_assert(sizeof(PointerProperties) == sizeof(nsecs_t));
+
     // For bool values, rely on the fact that they take up exactly one byte. This is not guaranteed
     // by C++ and is implementation-dependent, but it simplifies the conversions.
     static_assert(sizeof(bool) == 1);
@@ -139,12 +144,18 @@ struct InputMessage {
             int32_t displayWidth;
             int32_t displayHeight;
             uint32_t pointerCount;
-            uint32_t empty3;
+            uint32_t historySize;
             /**
              * The "pointers" field must be the last field of the struct InputMessage.
              * When we send the struct InputMessage across the socket, we are not
-             * writing the entire "pointers" array, but only the pointerCount portion
-             * of it as an optimization. Adding a field after "pointers" would break this.
+             * writing the entire "pointers" array, but only the portion of it that is
+             * used as an optimization. Adding a field after "pointers" would break this.
+             *
+             * The first pointerCount pointers are the sample at eventTime. They are
+             * followed by historySize older samples of the same pointers, oldest first,
+             * with pointerCount pointers each. The properties of a historical sample are
+             * those of the first one, so the properties of its first pointer hold the
+             * time of the sample instead (see getHistoricalEventTime).
              */
             struct Pointer {
                 PointerProperties properties;
@@ -157,9 +168,24 @@ struct InputMessage {
                 return pointers[index].properties.id;
             }
 
+            // The pointers of historical sample h, with h = 0 being the oldest.
+            inline const Pointer* getHistoricalPointers(size_t h) const {
+                return &pointers[pointerCount * (h + 1)];
+            }
+
+            inline nsecs_t getHistoricalEventTime(size_t h) const {
+                nsecs_t time;
+                memcpy(&time, &getHistoricalPointers(h)->properties, sizeof(time));
+                return time;
+            }
+
+            inline void setHistoricalEventTime(size_t h, nsecs_t time) {
+                memcpy(&pointers[pointerCount * (h + 1)].properties, &time, sizeof(time));
+            }
+
             inline size_t size() const {
                 return sizeof(Motion) - sizeof(Pointer) * MAX_POINTERS
-                        + sizeof(Pointer) * pointerCount;
+                        + sizeof(Pointer) * pointerCount * (size_t(historySize) + 1);
             }
         } motion;
 
@@ -270,6 +296,28 @@ public:
      */
     status_t receiveMessage(InputMessage* msg);
 
+    /* Send several messages to the other endpoint, in order, using as few system calls as
+     * possible.  The messages are still received one at a time.
+     *
+     * If the channel becomes full, the first *outSent messages have been sent and none of the
+     * others have.  Try again with the rest as for sendMessage.
+     *
+     * Return OK if all of the messages were sent.
+     * Otherwise, return the error as for sendMessage for the first message that was not sent.
+     */
+    status_t sendMessages(const InputMessage* msgs, size_t count, size_t* outSent);
+
+    /* Receive the messages present, up to 'capacity' of them, using as few system calls as
+     * possible.  The number received is returned in *outReceived.
+     *
+     * Return OK if at least one message was received.
+     * Return BAD_VALUE if a message was invalid.  It is dropped, and the valid messages that were
+     * received with it, before and after it, are still returned in *outReceived and should be
+     * handled first.
+     * Otherwise, return the error as for receiveMessage.
+     */
+    status_t receiveMessages(InputMessage* msgs, size_t capacity, size_t* outReceived);
+
     /* Return a new object that has a duplicate of this channel's fd. */
     std::unique_ptr<InputChannel> dup() const;
 
@@ -312,6 +360,9 @@ private:
     android::base::unique_fd mFd;
 
     sp<IBinder> mToken;
+
+    // The sanitized copies of the messages passed to sendMessages, kept to avoid reallocating them.
+    std::vector<InputMessage> mSanitizedMessages;
 };
 
 /*
@@ -342,11 +393,16 @@ public:
                              int32_t repeatCount, nsecs_t downTime, nsecs_t eventTime);
 
     /* Publishes a motion event to the input channel.
+     *
+     * The event may carry historySize older samples of the same pointers, oldest first, which
+     * are sent in the same message: historicalEventTimes has historySize entries and
+     * historicalCoords has pointerCount entries for each of them.
      *
      * Returns OK on success.
      * Returns WOULD_BLOCK if the channel is full.
      * Returns DEAD_OBJECT if the channel's peer has been closed.
-     * Returns BAD_VALUE if seq is 0 or if pointerCount is less than 1 or greater than MAX_POINTERS.
+     * Returns BAD_VALUE if seq is 0, if pointerCount is less than 1 or greater than MAX_POINTERS,
+     * or if the history does not fit in a message (see getMaxMotionHistorySize).
      * Other errors probably indicate that the channel is broken.
      */
     status_t publishMotionEvent(uint32_t seq, int32_t eventId, int32_t deviceId, int32_t source,
@@ -358,7 +414,14 @@ public:
                                 float yCursorPosition, int32_t displayWidth, int32_t displayHeight,
                                 nsecs_t downTime, nsecs_t eventTime, uint32_t pointerCount,
                                 const PointerProperties* pointerProperties,
-                                const PointerCoords* pointerCoords);
+                                const PointerCoords* pointerCoords, size_t historySize = 0,
+                                const nsecs_t* historicalEventTimes = nullptr,
+                                const PointerCoords* historicalCoords = nullptr);
+
+    /* Returns the largest number of historical samples that publishMotionEvent can send along
+     * with a sample of pointerCount pointers.
+     */
+    static size_t getMaxMotionHistorySize(uint32_t pointerCount);
 
     /* Publishes a focus event to the input channel.
      *
@@ -387,6 +450,21 @@ public:
      */
     status_t publishDragEvent(uint32_t seq, int32_t eventId, float x, float y, bool isExiting);
 
+    /* Makes the events published from now on wait to be sent together by endBatch, using as few
+     * system calls as possible.  In the meantime, the publish calls only return an error if the
+     * event is invalid.
+     */
+    void beginBatch();
+
+    /* Sends the events published since beginBatch, in order.  Events published after this are
+     * sent right away again.  *outSent is the number that were sent.
+     *
+     * Returns OK if all of them were sent.
+     * Otherwise, returns the error that publishing the first event that was not sent would have
+     * returned.  That event and the ones after it were not sent.
+     */
+    status_t endBatch(size_t* outSent);
+
     struct Finished {
         uint32_t seq;
         bool handled;
@@ -421,8 +499,31 @@ public:
      */
     android::base::Result<ConsumerResponse> receiveConsumerResponse();
 
+    /* Receive all of the signals present from the consumer, using as few system calls as
+     * possible, and append them to outResponses in the order they were sent.
+     *
+     * Returned error codes:
+     *         WOULD_BLOCK once there are no more signals present.
+     *         Otherwise, the error that receiveConsumerResponse would have returned.  The
+     *         signals received before it are still appended to outResponses.
+     */
+    status_t receiveConsumerResponses(std::vector<ConsumerResponse>* outResponses);
+
 private:
     std::shared_ptr<InputChannel> mChannel;
+
+    // Whether a batch was begun, and the messages published since then. The buffer is kept to
+    // avoid reallocating it for each batch.
+    bool mBatching;
+    std::vector<InputMessage> mBatchMessages;
+
+    // The buffer receiveConsumerResponses receives into, kept to avoid reallocating it.
+    std::vector<InputMessage> mReceivedResponses;
+
+    // Sends msg, or adds it to the batch.
+    status_t publishMessage(const InputMessage& msg);
+
+    android::base::Result<ConsumerResponse> toConsumerResponse(const InputMessage& msg) const;
 };
 
 /*
@@ -487,6 +588,9 @@ public:
      * the deferred event despite the fact that the input channel's file descriptor
      * is not readable.
      *
+     * Messages which were received from the input channel together with the last one
+     * consumed are also reported as a deferred event, as are errors found with them.
+     *
      * One option is simply to call consume() in a loop until it returns WOULD_BLOCK.
      * This guarantees that all deferred events will be processed.
      *
@@ -510,12 +614,34 @@ public:
      */
     int32_t getPendingBatchSource() const;
 
+    /* Sets how touches are resampled when the consumer has no sample after the time of the
+     * frame yet, for a channel that prefers predicting further ahead to delaying its touches.
+     *
+     * The factory makes a predictor for each touch gesture, which is fed with all the samples
+     * received and predicts the positions at the time of the frame minus resampleLatency, at
+     * most maxPrediction after the last sample.  An empty factory restores the default, which
+     * extrapolates linearly from the last two samples.
+     *
+     * Has no effect if touch resampling is disabled.  Touches that are in progress when this is
+     * called are extrapolated linearly until they end.
+     */
+    void setTouchPredictor(TouchPredictorFactory factory, nsecs_t resampleLatency,
+                           nsecs_t maxPrediction);
+
     std::string dump() const;
 
 private:
     // True if touch resampling is enabled.
     const bool mResampleTouch;
 
+    // Makes the predictor of each touch gesture, or empty to extrapolate linearly.
+    TouchPredictorFactory mTouchPredictorFactory;
+    // The latency added during resampling, and how far a predictor may predict.
+    nsecs_t mResampleLatency;
+    nsecs_t mMaxPrediction;
+    // The positions passed to the predictors, kept to avoid reallocating them for each sample.
+    std::vector<VelocityTracker::Position> mPredictorPositions;
+
     std::shared_ptr<InputChannel> mChannel;
 
     // The current input message.
@@ -525,6 +651,17 @@ private:
     // call to consume and that still needs to be handled.
     bool mMsgDeferred;
 
+    // Messages already received from the channel together, which still need to be handled,
+    // in order, from mReceivedMessages[mReceivedIndex] to mReceivedMessages[mReceivedCount].
+    std::vector<InputMessage> mReceivedMessages;
+    size_t mReceivedIndex;
+    size_t mReceivedCount;
+    // The error found when the received messages were received, to be returned after them.
+    status_t mReceiveError;
+
+    // The finished signals for a chain of batched samples, built here to send them together.
+    std::vector<InputMessage> mFinishedMessages;
+
     // Batched motion events per device and source.
     struct Batch {
         std::vector<InputMessage> samples;
@@ -549,6 +686,20 @@ private:
             }
         }
 
+        // Historical sample h of msg, see InputMessage::Body::Motion::pointers.
+        void initializeFromHistoricalSample(const InputMessage& msg, size_t h) {
+            eventTime = msg.body.motion.getHistoricalEventTime(h);
+            const InputMessage::Body::Motion::Pointer* samplePointers =
+                    msg.body.motion.getHistoricalPointers(h);
+            idBits.clear();
+            for (uint32_t i = 0; i < msg.body.motion.pointerCount; i++) {
+                uint32_t id = msg.body.motion.pointers[i].properties.id;
+                idBits.markBit(id);
+                idToIndex[id] = i;
+                pointers[i].copyFrom(samplePointers[i].coords);
+            }
+        }
+
         void initializeFrom(const History& other) {
             eventTime = other.eventTime;
             idBits = other.idBits; // temporary copy
@@ -576,6 +727,8 @@ private:
         size_t historySize;
         History history[2];
         History lastResample;
+        // Fed with all the samples of the gesture, if a predictor factory is set.
+        std::unique_ptr<TouchPredictor> predictor;
 
         void initialize(int32_t deviceId, int32_t source) {
             this->deviceId = deviceId;
@@ -641,6 +794,7 @@ private:
             Batch& batch, size_t count, uint32_t* outSeq, InputEvent** outEvent);
 
     void updateTouchState(InputMessage& msg);
+    void addTouchPredictorMovement(TouchState& touchState, const History& history);
     void resampleTouchState(nsecs_t frameTime, MotionEvent* event,
             const InputMessage *next);
 
@@ -650,6 +804,8 @@ private:
     nsecs_t getConsumeTime(uint32_t seq) const;
     void popConsumeTime(uint32_t seq);
     status_t sendUnchainedFinishedSignal(uint32_t seq, bool handled);
+    void initializeFinishedMessage(InputMessage* msg, uint32_t seq, bool handled) const;
+    status_t receiveNextMessage(InputMessage* msg);
 
     static void rewriteMessage(TouchState& state, InputMessage& msg);
     static void initializeKeyEvent(KeyEvent* event, const InputMessage* msg);
@@ -658,6 +814,9 @@ private:
     static void initializeCaptureEvent(CaptureEvent* event, const InputMessage* msg);
     static void initializeDragEvent(DragEvent* event, const InputMessage* msg);
     static void addSample(MotionEvent* event, const InputMessage* msg);
+    // Adds the samples of msg from historical sample firstHistoricalSample on, then its latest.
+    static void addSamples(MotionEvent* event, const InputMessage* msg,
+                           size_t firstHistoricalSample);
     static bool canAddSample(const Batch& batch, const InputMessage* msg);
     static ssize_t findSampleNoLaterThan(const Batch& batch, nsecs_t time);
     static bool shouldResampleTool(int32_t toolType);
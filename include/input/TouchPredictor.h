@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <input/VelocityTracker.h>
+#include <utils/BitSet.h>
+#include <utils/Timers.h>
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace android {
+
+/*
+ * Predicts where the pointers of a touch gesture will be, from the samples received so far.
+ *
+ * InputConsumer uses a predictor, if one is set, to resample touches at the time of a frame when
+ * it has not received any sample after that time yet.
+ */
+class TouchPredictor {
+public:
+    virtual ~TouchPredictor() {}
+
+    // Forgets all the samples, when a new gesture starts.
+    virtual void clear() = 0;
+
+    // Forgets the samples of specific pointers, which may be reusing the id of a pointer that
+    // went up earlier.
+    virtual void clearPointers(BitSet32 idBits) = 0;
+
+    // Adds a sample of a set of pointers. As for VelocityTracker::addMovement, the positions are
+    // in order of increasing pointer id.
+    virtual void addMovement(nsecs_t eventTime, BitSet32 idBits,
+                             const std::vector<VelocityTracker::Position>& positions) = 0;
+
+    // Predicts the position of a pointer at 'time', which is no earlier than its last sample.
+    // Returns false if there is not enough data to predict.
+    virtual bool predict(uint32_t id, nsecs_t time,
+                         VelocityTracker::Position* outPosition) const = 0;
+};
+
+// Makes a predictor for each touch gesture that needs one.
+using TouchPredictorFactory = std::function<std::unique_ptr<TouchPredictor>()>;
+
+/*
+ * Predicts by evaluating the polynomial that a VelocityTracker strategy fits to the recent
+ * samples of each pointer, such as a quadratic fit with LSQ2 or the IIR filter of INT2.
+ */
+class VelocityTrackerTouchPredictor : public TouchPredictor {
+public:
+    explicit VelocityTrackerTouchPredictor(VelocityTracker::Strategy strategy);
+    ~VelocityTrackerTouchPredictor() override;
+
+    void clear() override;
+    void clearPointers(BitSet32 idBits) override;
+    void addMovement(nsecs_t eventTime, BitSet32 idBits,
+                     const std::vector<VelocityTracker::Position>& positions) override;
+    bool predict(uint32_t id, nsecs_t time, VelocityTracker::Position* outPosition) const override;
+
+private:
+    VelocityTracker mVelocityTracker;
+};
+
+} // namespace android
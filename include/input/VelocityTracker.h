@@ -212,6 +212,64 @@ private:
 };
 
 
+/*
+ * Velocity tracker algorithm based on unweighted, quadratic least-squares regression.
+ * Fits the same samples as LeastSquaresVelocityTrackerStrategy with degree 2 and no weighting,
+ * but keeps running sums of the normal equations for each pointer as samples are added and
+ * aged out, so that getEstimator does not need to revisit the history.
+ */
+class IncrementalLeastSquaresVelocityTrackerStrategy : public VelocityTrackerStrategy {
+public:
+    IncrementalLeastSquaresVelocityTrackerStrategy();
+    ~IncrementalLeastSquaresVelocityTrackerStrategy() override;
+
+    void clear() override;
+    void clearPointers(BitSet32 idBits) override;
+    void addMovement(nsecs_t eventTime, BitSet32 idBits,
+                     const std::vector<VelocityTracker::Position>& positions) override;
+    bool getEstimator(uint32_t id, VelocityTracker::Estimator* outEstimator) const override;
+
+private:
+    // Sample horizon, as in LeastSquaresVelocityTrackerStrategy.
+    static constexpr nsecs_t HORIZON = 100 * 1000000; // 100 ms
+
+    // Number of samples to keep, as in LeastSquaresVelocityTrackerStrategy.
+    static constexpr uint32_t HISTORY_SIZE = 20;
+
+    struct Movement {
+        nsecs_t eventTime;
+        BitSet32 idBits;
+        VelocityTracker::Position positions[MAX_POINTERS];
+
+        inline const VelocityTracker::Position& getPosition(uint32_t id) const {
+            return positions[idBits.getIndexOfBit(id)];
+        }
+    };
+
+    // Sums over the samples of a pointer within the horizon, which are its last sampleCount
+    // movements. Times are in seconds relative to baseTime, which is moved up to the oldest
+    // sample from time to time so that the powers of time stay small.
+    struct Sums {
+        uint32_t sampleCount;
+        nsecs_t baseTime;
+        double t, t2, t3, t4;
+        double x, tx, t2x;
+        double y, ty, t2y;
+    };
+
+    // Adds (sign 1) or removes (sign -1) the sample of pointer id in movement to or from sums.
+    void accumulate(Sums& sums, const Movement& movement, uint32_t id, double sign) const;
+    void rebase(Sums& sums, uint32_t id) const;
+    uint32_t getOldestIndex(const Sums& sums) const;
+
+    uint32_t mIndex;
+    Movement mMovements[HISTORY_SIZE];
+    // The pointers that have at least one sample within the horizon.
+    BitSet32 mPointerIdBits;
+    Sums mSums[MAX_POINTER_ID + 1];
+};
+
+
 /*
  * Velocity tracker algorithm that uses an IIR filter.
  */
@@ -0,0 +1,161 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define LOG_TAG "CallStats"
+
+#include "CallStats.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <string_view>
+
+namespace android {
+
+using CallStats = ProcessState::CallStats;
+
+struct CallStatsTable::Entry {
+    Entry(const char16_t* descriptor, size_t descriptorLen, uint32_t code, bool incoming,
+          size_t hash)
+          : descriptor(descriptor, descriptorLen), code(code), incoming(incoming), hash(hash) {
+        count.store(0, std::memory_order_relaxed);
+        totalLatencyNs.store(0, std::memory_order_relaxed);
+        for (size_t i = 0; i < CallStats::kHistogramBuckets; i++) {
+            latencyHistogram[i].store(0, std::memory_order_relaxed);
+            sizeHistogram[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    const String16 descriptor;
+    const uint32_t code;
+    const bool incoming;
+    const size_t hash;
+
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> totalLatencyNs;
+    std::atomic<uint64_t> latencyHistogram[CallStats::kHistogramBuckets];
+    std::atomic<uint64_t> sizeHistogram[CallStats::kHistogramBuckets];
+};
+
+static size_t bucketFor(uint64_t value) {
+    if (value == 0) return 0;
+    const size_t bucket = 64 - __builtin_clzll(value);
+    return std::min(bucket, CallStats::kHistogramBuckets - 1);
+}
+
+// Only one thread writes to each table, so this doesn't need an atomic
+// read-modify-write, only for readers on other threads to see either value.
+static void add(std::atomic<uint64_t>* counter, uint64_t value) {
+    counter->store(counter->load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+static size_t hashKey(const char16_t* descriptor, size_t descriptorLen, uint32_t code,
+                      bool incoming) {
+    size_t hash = std::hash<std::u16string_view>{}(std::u16string_view(descriptor, descriptorLen));
+    return hash ^ (static_cast<size_t>(code) * 2 + incoming) * 0x9e3779b9;
+}
+
+CallStatsTable::CallStatsTable() : mNumEntries(0), mDropped(0) {
+    for (auto& entry : mEntries) entry.store(nullptr, std::memory_order_relaxed);
+}
+
+CallStatsTable::~CallStatsTable() {
+    for (auto& entry : mEntries) delete entry.load(std::memory_order_relaxed);
+}
+
+CallStatsTable::Entry* CallStatsTable::findOrInsert(const char16_t* descriptor,
+                                                    size_t descriptorLen, uint32_t code,
+                                                    bool incoming) {
+    const size_t hash = hashKey(descriptor, descriptorLen, code, incoming);
+    for (size_t i = 0; i < kMaxEntries; i++) {
+        std::atomic<Entry*>& slot = mEntries[(hash + i) % kMaxEntries];
+        // only this thread inserts, so there's no need to synchronize with it
+        Entry* entry = slot.load(std::memory_order_relaxed);
+        if (entry == nullptr) {
+            // keep some room, so that a missing key doesn't have to scan the whole table
+            if (mNumEntries >= kMaxEntries * 3 / 4) return nullptr;
+            entry = new Entry(descriptor, descriptorLen, code, incoming, hash);
+            slot.store(entry, std::memory_order_release);
+            mNumEntries++;
+            return entry;
+        }
+        if (entry->hash == hash && entry->code == code && entry->incoming == incoming &&
+            entry->descriptor.size() == descriptorLen &&
+            memcmp(entry->descriptor.string(), descriptor, descriptorLen * sizeof(char16_t)) ==
+                    0) {
+            return entry;
+        }
+    }
+    return nullptr;
+}
+
+void CallStatsTable::record(const char16_t* descriptor, size_t descriptorLen, uint32_t code,
+                            bool incoming, uint64_t latencyNs, size_t dataSize) {
+    Entry* entry = findOrInsert(descriptor, descriptorLen, code, incoming);
+    if (entry == nullptr) {
+        add(&mDropped, 1);
+        return;
+    }
+    add(&entry->count, 1);
+    add(&entry->totalLatencyNs, latencyNs);
+    add(&entry->latencyHistogram[bucketFor(latencyNs / 1000)], 1);
+    add(&entry->sizeHistogram[bucketFor(dataSize)], 1);
+}
+
+void CallStatsTable::addTo(CallStatsTable* other) const {
+    for (const auto& slot : mEntries) {
+        const Entry* entry = slot.load(std::memory_order_acquire);
+        if (entry == nullptr) continue;
+        Entry* otherEntry = other->findOrInsert(entry->descriptor.string(),
+                                                entry->descriptor.size(), entry->code,
+                                                entry->incoming);
+        if (otherEntry == nullptr) {
+            add(&other->mDropped, entry->count.load(std::memory_order_relaxed));
+            continue;
+        }
+        add(&otherEntry->count, entry->count.load(std::memory_order_relaxed));
+        add(&otherEntry->totalLatencyNs, entry->totalLatencyNs.load(std::memory_order_relaxed));
+        for (size_t i = 0; i < CallStats::kHistogramBuckets; i++) {
+            add(&otherEntry->latencyHistogram[i],
+                entry->latencyHistogram[i].load(std::memory_order_relaxed));
+            add(&otherEntry->sizeHistogram[i],
+                entry->sizeHistogram[i].load(std::memory_order_relaxed));
+        }
+    }
+    add(&other->mDropped, mDropped.load(std::memory_order_relaxed));
+}
+
+void CallStatsTable::collect(Map* stats) const {
+    for (const auto& slot : mEntries) {
+        const Entry* entry = slot.load(std::memory_order_acquire);
+        if (entry == nullptr) continue;
+        CallStats& out = (*stats)[Key(entry->descriptor, entry->code, entry->incoming)];
+        out.descriptor = entry->descriptor;
+        out.code = entry->code;
+        out.incoming = entry->incoming;
+        out.count += entry->count.load(std::memory_order_relaxed);
+        out.totalLatencyNs += entry->totalLatencyNs.load(std::memory_order_relaxed);
+        for (size_t i = 0; i < CallStats::kHistogramBuckets; i++) {
+            out.latencyHistogram[i] += entry->latencyHistogram[i].load(std::memory_order_relaxed);
+            out.sizeHistogram[i] += entry->sizeHistogram[i].load(std::memory_order_relaxed);
+        }
+    }
+}
+
+uint64_t CallStatsTable::dropped() const {
+    return mDropped.load(std::memory_order_relaxed);
+}
+
+} // namespace android
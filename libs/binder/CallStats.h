@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <binder/ProcessState.h>
+
+#include <atomic>
+#include <map>
+#include <tuple>
+
+namespace android {
+
+/**
+ * Latency and data size histograms of the binder transactions made or served
+ * by one thread, by interface descriptor and transaction code. See
+ * ProcessState::setCallStatsEnabled.
+ *
+ * Only one thread at a time may record into a table, so recording doesn't take
+ * any locks, but a table may be read from any thread at the same time.
+ */
+class CallStatsTable {
+public:
+    CallStatsTable();
+    ~CallStatsTable();
+
+    // (descriptor, code, incoming)
+    using Key = std::tuple<String16, uint32_t, bool>;
+    using Map = std::map<Key, ProcessState::CallStats>;
+
+    /**
+     * 'descriptor' is the interface token at the start of the transaction,
+     * or empty if it didn't have one.
+     */
+    void record(const char16_t* descriptor, size_t descriptorLen, uint32_t code, bool incoming,
+                uint64_t latencyNs, size_t dataSize);
+
+    /**
+     * Adds everything recorded in this table to 'other', which must only be
+     * recorded into by the calling thread.
+     */
+    void addTo(CallStatsTable* other) const;
+
+    /**
+     * Adds everything recorded in this table to 'stats'.
+     */
+    void collect(Map* stats) const;
+
+    /**
+     * Transactions which weren't recorded because the table was full.
+     */
+    uint64_t dropped() const;
+
+private:
+    struct Entry;
+
+    Entry* findOrInsert(const char16_t* descriptor, size_t descriptorLen, uint32_t code,
+                        bool incoming);
+
+    static constexpr size_t kMaxEntries = 512;
+
+    // open addressing, entries are never removed, or changed once inserted
+    // other than their counts.
+    std::atomic<Entry*> mEntries[kMaxEntries];
+    size_t mNumEntries;
+    std::atomic<uint64_t> mDropped;
+};
+
+} // namespace android
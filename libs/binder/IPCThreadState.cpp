@@ -27,6 +27,7 @@
 #include <utils/CallStack.h>
 #include <utils/Log.h>
 #include <utils/SystemClock.h>
+#include <utils/Timers.h>
 #include <utils/threads.h>
 
 #include <atomic>
@@ -40,6 +41,7 @@
 #include <sys/resource.h>
 #include <unistd.h>
 
+#include "CallStats.h"
 #include "Static.h"
 #include "binder_module.h"
 
@@ -699,6 +701,9 @@ status_t IPCThreadState::transact(int32_t handle,
             << indent << data << dedent << endl;
     }
 
+    const bool callStatsEnabled = mProcess->isCallStatsEnabled();
+    const nsecs_t startTime = callStatsEnabled ? systemTime(SYSTEM_TIME_MONOTONIC) : 0;
+
     LOG_ONEWAY(">>>> SEND from pid %d uid %d %s", getpid(), getuid(),
         (flags & TF_ONE_WAY) == 0 ? "READ REPLY" : "ONE WAY");
     err = writeTransactionData(BC_TRANSACTION, flags, handle, code, data, nullptr);
@@ -751,6 +756,8 @@ status_t IPCThreadState::transact(int32_t handle,
         err = waitForResponse(nullptr, nullptr);
     }
 
+    if (callStatsEnabled) recordCallStats(data, code, false /*incoming*/, startTime);
+
     return err;
 }
 
@@ -851,7 +858,8 @@ IPCThreadState::IPCThreadState()
         mIsFlushing(false),
         mStrictModePolicy(0),
         mLastTransactionBinderFlags(0),
-        mCallRestriction(mProcess->mCallRestriction) {
+        mCallRestriction(mProcess->mCallRestriction),
+        mCallStats(nullptr) {
     pthread_setspecific(gTLS, this);
     clearCaller();
     mIn.setDataCapacity(256);
@@ -860,6 +868,18 @@ IPCThreadState::IPCThreadState()
 
 IPCThreadState::~IPCThreadState()
 {
+    if (mCallStats != nullptr) mProcess->removeCallStatsTable(mCallStats);
+}
+
+void IPCThreadState::recordCallStats(const Parcel& data, uint32_t code, bool incoming,
+                                     nsecs_t startTime) {
+    const nsecs_t latency = systemTime(SYSTEM_TIME_MONOTONIC) - startTime;
+    if (mCallStats == nullptr) mCallStats = mProcess->addCallStatsTable();
+
+    size_t descriptorLen = 0;
+    const char16_t* descriptor = data.peekInterfaceToken(&descriptorLen);
+    mCallStats->record(descriptor != nullptr ? descriptor : u"", descriptorLen, code, incoming,
+                       latency, data.dataSize());
 }
 
 status_t IPCThreadState::sendReply(const Parcel& reply, uint32_t flags)
@@ -1249,6 +1269,9 @@ status_t IPCThreadState::executeCommand(int32_t cmd)
             // ALOGI(">>>> TRANSACT from pid %d sid %s uid %d\n", mCallingPid,
             //    (mCallingSid ? mCallingSid : "<N/A>"), mCallingUid);
 
+            const bool callStatsEnabled = mProcess->isCallStatsEnabled();
+            const nsecs_t startTime = callStatsEnabled ? systemTime(SYSTEM_TIME_MONOTONIC) : 0;
+
             Parcel reply;
             status_t error;
             IF_LOG_TRANSACTIONS() {
@@ -1308,6 +1331,10 @@ status_t IPCThreadState::executeCommand(int32_t cmd)
                 LOG_ONEWAY("NOT sending reply to %d!", mCallingPid);
             }
 
+            if (callStatsEnabled) {
+                recordCallStats(buffer, tr.code, true /*incoming*/, startTime);
+            }
+
             mServingStackPointer = origServingStackPointer;
             mCallingPid = origPid;
             mCallingSid = origSid;
@@ -31,6 +31,8 @@
 #include <sys/resource.h>
 #include <unistd.h>
 
+#include <cstddef>
+
 #include <binder/Binder.h>
 #include <binder/BpBinder.h>
 #include <binder/IPCThreadState.h>
@@ -655,6 +657,26 @@ bool Parcel::enforceInterface(const String16& interface,
     return enforceInterface(interface.string(), interface.size(), threadState);
 }
 
+const char16_t* Parcel::peekInterfaceToken(size_t* outLen) const {
+    // StrictModePolicy, WorkSource, vendor header, then the descriptor as a String16
+    constexpr size_t kLengthOffset = 3 * sizeof(int32_t);
+    constexpr size_t kDescriptorOffset = kLengthOffset + sizeof(int32_t);
+    if (isForRpc() || mDataSize < kDescriptorOffset) return nullptr;
+
+    int32_t header;
+    memcpy(&header, mData + 2 * sizeof(int32_t), sizeof(header));
+    if (header != kHeader) return nullptr;
+    int32_t len;
+    memcpy(&len, mData + kLengthOffset, sizeof(len));
+    if (len < 0 || static_cast<size_t>(len) >= (mDataSize - kDescriptorOffset) / sizeof(char16_t)) {
+        return nullptr;
+    }
+    const char16_t* descriptor = reinterpret_cast<const char16_t*>(mData + kDescriptorOffset);
+    if (descriptor[len] != u'\0') return nullptr;
+    *outLen = len;
+    return descriptor;
+}
+
 bool Parcel::enforceInterface(const char16_t* interface,
                               size_t len,
                               IPCThreadState* threadState) const
@@ -823,8 +845,20 @@ restart_write:
 }
 
 status_t Parcel::writeUtf8AsUtf16(const std::string& str) {
+    const size_t strLen = str.length();
+    if (asciiPrefixLength(str.data(), strLen) == strLen) {
+        // The UTF-16 length is known without decoding, so widen straight into the parcel.
+        if (strLen > std::numeric_limits<int32_t>::max()) return BAD_VALUE;
+        status_t err = writeInt32(strLen);
+        if (err) return err;
+        char16_t* dst = reinterpret_cast<char16_t*>(writeInplace((strLen + 1) * sizeof(char16_t)));
+        if (!dst) return NO_MEMORY;
+        widenAscii(str.data(), strLen, dst);
+        dst[strLen] = u'\0';
+        return NO_ERROR;
+    }
+
     const uint8_t* strData = (uint8_t*)str.data();
-    const size_t strLen= str.length();
     const ssize_t utf16Len = utf8_to_utf16_length(strData, strLen);
     if (utf16Len < 0 || utf16Len > std::numeric_limits<int32_t>::max()) {
         return BAD_VALUE;
@@ -1673,6 +1707,13 @@ status_t Parcel::readUtf8FromUtf16(std::string* str) const {
        return NO_ERROR;
     }
 
+    // Each UTF-16 character takes at least one byte in UTF-8, so this is enough for the
+    // common case of an ASCII string, which is narrowed without decoding.
+    str->resize(utf16Size);
+    if (narrowAsciiPrefix(src, utf16Size, &((*str)[0])) == utf16Size) {
+        return NO_ERROR;
+    }
+
     // Allow for closing '\0'
     ssize_t utf8Size = utf16_to_utf8_length(src, utf16Size) + 1;
     if (utf8Size < 1) {
@@ -2217,6 +2258,112 @@ void Parcel::acquireObjects()
     }
 }
 
+// Parcels are usually created and destroyed on the same thread, once or twice
+// for each transaction, so rather than going back to malloc each time, a few
+// recently freed data buffers are kept for each thread. Each buffer is
+// preceded by its capacity, which is rounded up so that buffers can be reused
+// for parcels of similar size, and so that small parcels can grow in place.
+struct alignas(std::max_align_t) ParcelDataHeader {
+    size_t capacity;
+};
+
+static constexpr size_t kMaxCachedParcelData = 8;
+static constexpr size_t kMinParcelDataCapacity = 256;
+// large parcels are rare, so avoid holding onto them
+static constexpr size_t kMaxCachedParcelDataCapacity = 4 * 1024;
+// processes may have many binder threads, so keep what each one holds small
+static constexpr size_t kMaxCachedParcelDataBytes = 8 * 1024;
+
+// Trivially destructible, so that it can still be used by parcels which are
+// destroyed after thread_local destructors run (e.g. those in IPCThreadState).
+struct ParcelDataCache {
+    ParcelDataHeader* buffers[kMaxCachedParcelData];
+    size_t numBuffers;
+    size_t numBytes; // total capacity of buffers
+    bool exited;
+};
+static thread_local ParcelDataCache gParcelDataCache;
+
+struct ParcelDataCacheCleanup {
+    // the first use on each thread registers the destructor
+    void use() {}
+    ~ParcelDataCacheCleanup() {
+        ParcelDataCache& cache = gParcelDataCache;
+        for (size_t i = 0; i < cache.numBuffers; i++) free(cache.buffers[i]);
+        cache.numBuffers = 0;
+        cache.numBytes = 0;
+        cache.exited = true;
+    }
+};
+static thread_local ParcelDataCacheCleanup gParcelDataCacheCleanup;
+
+static uint8_t* allocParcelData(size_t size) {
+    ParcelDataCache& cache = gParcelDataCache;
+    for (size_t i = 0; i < cache.numBuffers; i++) {
+        if (cache.buffers[i]->capacity >= size) {
+            ParcelDataHeader* header = cache.buffers[i];
+            cache.buffers[i] = cache.buffers[--cache.numBuffers];
+            cache.numBytes -= header->capacity;
+            return reinterpret_cast<uint8_t*>(header + 1);
+        }
+    }
+
+    size_t capacity = size;
+    if (capacity <= kMaxCachedParcelDataCapacity) {
+        capacity = kMinParcelDataCapacity;
+        while (capacity < size) capacity *= 2;
+    }
+    auto header = static_cast<ParcelDataHeader*>(malloc(sizeof(ParcelDataHeader) + capacity));
+    if (header == nullptr) return nullptr;
+    header->capacity = capacity;
+    return reinterpret_cast<uint8_t*>(header + 1);
+}
+
+static size_t parcelDataCapacity(const uint8_t* data) {
+    return (reinterpret_cast<const ParcelDataHeader*>(data) - 1)->capacity;
+}
+
+static void freeParcelData(uint8_t* data) {
+    if (data == nullptr) return;
+    ParcelDataHeader* header = reinterpret_cast<ParcelDataHeader*>(data) - 1;
+
+    ParcelDataCache& cache = gParcelDataCache;
+    if (!cache.exited && cache.numBuffers < kMaxCachedParcelData &&
+        header->capacity <= kMaxCachedParcelDataCapacity &&
+        cache.numBytes + header->capacity <= kMaxCachedParcelDataBytes) {
+        gParcelDataCacheCleanup.use();
+        cache.buffers[cache.numBuffers++] = header;
+        cache.numBytes += header->capacity;
+    } else {
+        free(header);
+    }
+}
+
+// Like realloc, but a buffer which is already big enough is kept as is. If
+// 'zero' is set, the data is always moved to a new buffer, and the old one is
+// zeroed before it is freed.
+static uint8_t* reallocZeroFree(uint8_t* data, size_t oldCapacity, size_t newCapacity, bool zero) {
+    if (newCapacity == 0 && !zero) {
+        freeParcelData(data);
+        return nullptr;
+    }
+    if (!zero && data != nullptr && parcelDataCapacity(data) >= newCapacity) {
+        return data;
+    }
+
+    uint8_t* newData = allocParcelData(newCapacity);
+    if (!newData) {
+        return nullptr;
+    }
+
+    if (data != nullptr) {
+        memcpy(newData, data, std::min(oldCapacity, newCapacity));
+        if (zero) zeroMemory(data, oldCapacity);
+        freeParcelData(data);
+    }
+    return newData;
+}
+
 void Parcel::freeData()
 {
     freeDataNoInit();
@@ -2239,7 +2386,7 @@ void Parcel::freeDataNoInit()
             if (mDeallocZero) {
                 zeroMemory(mData, mDataSize);
             }
-            free(mData);
+            freeParcelData(mData);
         }
         if (mObjects) free(mObjects);
     }
@@ -2261,21 +2408,6 @@ status_t Parcel::growData(size_t len)
             : continueWrite(std::max(newSize, (size_t) 128));
 }
 
-static uint8_t* reallocZeroFree(uint8_t* data, size_t oldCapacity, size_t newCapacity, bool zero) {
-    if (!zero) {
-        return (uint8_t*)realloc(data, newCapacity);
-    }
-    uint8_t* newData = (uint8_t*)malloc(newCapacity);
-    if (!newData) {
-        return nullptr;
-    }
-
-    memcpy(newData, data, std::min(oldCapacity, newCapacity));
-    zeroMemory(data, oldCapacity);
-    free(data);
-    return newData;
-}
-
 status_t Parcel::restartWrite(size_t desired)
 {
     if (desired > INT32_MAX) {
@@ -2360,7 +2492,7 @@ status_t Parcel::continueWrite(size_t desired)
 
         // If there is a different owner, we need to take
         // posession.
-        uint8_t* data = (uint8_t*)malloc(desired);
+        uint8_t* data = allocParcelData(desired);
         if (!data) {
             mError = NO_MEMORY;
             return NO_MEMORY;
@@ -2370,7 +2502,7 @@ status_t Parcel::continueWrite(size_t desired)
         if (objectsSize) {
             objects = (binder_size_t*)calloc(objectsSize, sizeof(binder_size_t));
             if (!objects) {
-                free(data);
+                freeParcelData(data);
 
                 mError = NO_MEMORY;
                 return NO_MEMORY;
@@ -2438,7 +2570,8 @@ status_t Parcel::continueWrite(size_t desired)
             mObjectsSorted = false;
         }
 
-        // We own the data, so we can just do a realloc().
+        // We own the data, so we can just do a realloc(), which often
+        // doesn't even need to move it.
         if (desired > mDataCapacity) {
             uint8_t* data = reallocZeroFree(mData, mDataCapacity, desired, mDeallocZero);
             if (data) {
@@ -2465,7 +2598,7 @@ status_t Parcel::continueWrite(size_t desired)
 
     } else {
         // This is the first data.  Easy!
-        uint8_t* data = (uint8_t*)malloc(desired);
+        uint8_t* data = allocParcelData(desired);
         if (!data) {
             mError = NO_MEMORY;
             return NO_MEMORY;
@@ -27,11 +27,14 @@
 #include <utils/String8.h>
 #include <utils/threads.h>
 
+#include "CallStats.h"
 #include "Static.h"
 #include "binder_module.h"
 
+#include <algorithm>
 #include <errno.h>
 #include <fcntl.h>
+#include <inttypes.h>
 #include <mutex>
 #include <stdio.h>
 #include <stdlib.h>
@@ -234,6 +237,90 @@ void ProcessState::setCallRestriction(CallRestriction restriction) {
     mCallRestriction = restriction;
 }
 
+void ProcessState::setCallStatsEnabled(bool enabled) {
+    mCallStatsEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool ProcessState::isCallStatsEnabled() const {
+    return mCallStatsEnabled.load(std::memory_order_relaxed);
+}
+
+std::vector<ProcessState::CallStats> ProcessState::getCallStats() {
+    CallStatsTable::Map stats;
+    {
+        std::lock_guard<std::mutex> _l(mCallStatsLock);
+        mExitedCallStats->collect(&stats);
+        for (const CallStatsTable* table : mCallStatsTables) {
+            table->collect(&stats);
+        }
+    }
+
+    std::vector<CallStats> ret;
+    ret.reserve(stats.size());
+    for (auto& [key, value] : stats) {
+        ret.push_back(std::move(value));
+    }
+    return ret;
+}
+
+static void dumpHistogram(int fd, const char* name,
+                          const std::array<uint64_t, ProcessState::CallStats::kHistogramBuckets>&
+                                  histogram) {
+    dprintf(fd, "    %s:", name);
+    for (size_t i = 0; i < histogram.size(); i++) {
+        if (histogram[i] == 0) continue;
+        if (i == 0) {
+            dprintf(fd, " 0: %" PRIu64, histogram[i]);
+        } else if (i == histogram.size() - 1) {
+            dprintf(fd, " >=%" PRIu64 ": %" PRIu64, uint64_t(1) << (i - 1), histogram[i]);
+        } else {
+            dprintf(fd, " [%" PRIu64 ", %" PRIu64 "): %" PRIu64, uint64_t(1) << (i - 1),
+                    uint64_t(1) << i, histogram[i]);
+        }
+    }
+    dprintf(fd, "\n");
+}
+
+void ProcessState::dumpCallStats(int fd) {
+    uint64_t dropped;
+    {
+        std::lock_guard<std::mutex> _l(mCallStatsLock);
+        dropped = mExitedCallStats->dropped();
+        for (const CallStatsTable* table : mCallStatsTables) {
+            dropped += table->dropped();
+        }
+    }
+
+    dprintf(fd, "Binder call stats (%s, %" PRIu64 " transactions not recorded):\n",
+            isCallStatsEnabled() ? "enabled" : "disabled", dropped);
+    for (const CallStats& stats : getCallStats()) {
+        dprintf(fd, "  %s %s code %" PRIu32 ": %" PRIu64 " calls, mean %" PRIu64 "us\n",
+                stats.incoming ? "incoming" : "outgoing",
+                stats.descriptor.size() == 0 ? "(no interface token)"
+                                             : String8(stats.descriptor).c_str(),
+                stats.code, stats.count,
+                stats.count == 0 ? 0 : stats.totalLatencyNs / stats.count / 1000);
+        dumpHistogram(fd, "latency (us)", stats.latencyHistogram);
+        dumpHistogram(fd, "size (bytes)", stats.sizeHistogram);
+    }
+}
+
+CallStatsTable* ProcessState::addCallStatsTable() {
+    CallStatsTable* table = new CallStatsTable;
+    std::lock_guard<std::mutex> _l(mCallStatsLock);
+    mCallStatsTables.push_back(table);
+    return table;
+}
+
+void ProcessState::removeCallStatsTable(CallStatsTable* table) {
+    {
+        std::lock_guard<std::mutex> _l(mCallStatsLock);
+        table->addTo(mExitedCallStats.get());
+        mCallStatsTables.erase(std::find(mCallStatsTables.begin(), mCallStatsTables.end(), table));
+    }
+    delete table;
+}
+
 ProcessState::handle_entry* ProcessState::lookupHandleLocked(int32_t handle)
 {
     const size_t N=mHandleToObject.size();
@@ -422,6 +509,8 @@ ProcessState::ProcessState(const char *driver)
     , mThreadPoolStarted(false)
     , mThreadPoolSeq(1)
     , mCallRestriction(CallRestriction::NONE)
+    , mCallStatsEnabled(false)
+    , mExitedCallStats(std::make_unique<CallStatsTable>())
 {
     if (mDriverFD >= 0) {
         // mmap the binder, providing a chunk of virtual address space to receive transactions.
@@ -28,6 +28,7 @@
 #include <log/log.h>
 #include "RpcState.h"
 
+#include "RpcSharedMemory.h"
 #include "RpcSocketAddress.h"
 #include "RpcWireFormat.h"
 
@@ -171,17 +172,86 @@ size_t RpcServer::numUninitializedSessions() {
     return mConnectingThreads.size();
 }
 
+// Reads the session ID at the start of a connection. If the client sends
+// RPC_SESSION_ID_CONNECTION_HEADER instead, an RpcConnectionHeader follows it,
+// and any fds sent along with it are received into 'fds'.
+static bool recvConnectionHeader(const unique_fd& socket, RpcConnectionHeader* header,
+                                 bool* hasHeader, RpcSharedMemory::Fds* fds) {
+    int32_t id;
+    iovec iov{&id, sizeof(id)};
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * RpcSharedMemory::kNumFds)];
+    msghdr msg{
+            .msg_iov = &iov,
+            .msg_iovlen = 1,
+            .msg_control = control,
+            .msg_controllen = sizeof(control),
+    };
+
+    ssize_t recd = TEMP_FAILURE_RETRY(recvmsg(socket.get(), &msg, MSG_WAITALL | MSG_CMSG_CLOEXEC));
+
+    // take ownership of any fds first, so that they are closed on error
+    size_t numFds = 0;
+    for (cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) continue;
+        size_t n = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        for (size_t i = 0; i < n; i++) {
+            int rawFd;
+            memcpy(&rawFd, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(rawFd));
+            unique_fd fd(rawFd);
+            if (numFds < fds->size()) (*fds)[numFds] = std::move(fd);
+            numFds++;
+        }
+    }
+
+    if (recd != sizeof(id)) return false;
+
+    if (id != RPC_SESSION_ID_CONNECTION_HEADER) {
+        *header = {.sessionId = id, .options = 0};
+        *hasHeader = false;
+        return true;
+    }
+
+    if (sizeof(*header) !=
+        TEMP_FAILURE_RETRY(recv(socket.get(), header, sizeof(*header), MSG_WAITALL))) {
+        return false;
+    }
+    *hasHeader = true;
+
+    // only accept exactly the fds which RpcSharedMemory needs
+    if (numFds != fds->size()) {
+        for (unique_fd& fd : *fds) fd.reset();
+    }
+    return true;
+}
+
 void RpcServer::establishConnection(sp<RpcServer>&& server, base::unique_fd clientFd) {
     LOG_ALWAYS_FATAL_IF(this != server.get(), "Must pass same ownership object");
 
     // TODO(b/183988761): cannot trust this simple ID
     LOG_ALWAYS_FATAL_IF(!mAgreedExperimental, "no!");
     bool idValid = true;
-    int32_t id;
-    if (sizeof(id) != read(clientFd.get(), &id, sizeof(id))) {
-        ALOGE("Could not read ID from fd %d", clientFd.get());
+    RpcConnectionHeader header{};
+    bool hasHeader = false;
+    RpcSharedMemory::Fds fds;
+    if (!recvConnectionHeader(clientFd, &header, &hasHeader, &fds)) {
+        ALOGE("Could not read connection header from fd %d", clientFd.get());
         idValid = false;
     }
+    int32_t id = header.sessionId;
+
+    std::shared_ptr<RpcSharedMemory> sharedMemory;
+    if (idValid && hasHeader) {
+        RpcConnectionResponse response{.options = 0};
+        if ((header.options & RPC_CONNECTION_OPTION_SHARED_MEMORY) && fds[0].ok()) {
+            sharedMemory = RpcSharedMemory::attach(std::move(fds));
+            if (sharedMemory != nullptr) response.options |= RPC_CONNECTION_OPTION_SHARED_MEMORY;
+        }
+        if (sizeof(response) !=
+            TEMP_FAILURE_RETRY(send(clientFd.get(), &response, sizeof(response), MSG_NOSIGNAL))) {
+            ALOGE("Could not write connection response to fd %d", clientFd.get());
+            idValid = false;
+        }
+    }
 
     std::thread thisThread;
     sp<RpcSession> session;
@@ -227,7 +297,7 @@ void RpcServer::establishConnection(sp<RpcServer>&& server, base::unique_fd clie
     // DO NOT ACCESS MEMBER VARIABLES BELOW
     //
 
-    session->join(std::move(clientFd));
+    session->join(std::move(clientFd), std::move(sharedMemory));
 }
 
 bool RpcServer::setupSocketServer(const RpcSocketAddress& addr) {
@@ -19,6 +19,7 @@
 #include <binder/RpcSession.h>
 
 #include <inttypes.h>
+#include <sys/socket.h>
 #include <unistd.h>
 
 #include <string_view>
@@ -28,6 +29,7 @@
 #include <binder/Stability.h>
 #include <utils/String8.h>
 
+#include "RpcSharedMemory.h"
 #include "RpcSocketAddress.h"
 #include "RpcState.h"
 #include "RpcWireFormat.h"
@@ -48,6 +50,37 @@ RpcSession::RpcSession() {
 RpcSession::~RpcSession() {
     LOG_RPC_DETAIL("RpcSession destroyed %p", this);
 
+    // Oneway transactions that are still held would otherwise be lost. The
+    // flushing thread can no longer promote this session, so send them here.
+    if (std::vector<uint8_t> batch = mState->takeOnewayBatch(); !batch.empty()) {
+        std::lock_guard<std::mutex> _l(mMutex);
+        if (mClientConnections.empty()) {
+            ALOGW("Dropping %zu bytes of oneway transactions, session has no connection",
+                  batch.size());
+        } else {
+            status_t status = mState->sendOnewayBatch(mClientConnections.front()->fd, batch);
+            ALOGW_IF(status != OK, "Failed to flush oneway batch: %s",
+                     statusToString(status).c_str());
+        }
+    }
+
+    // let the other side know now, rather than when it notices the sockets closing
+    mState->shutdownSharedMemory();
+
+    {
+        std::lock_guard<std::mutex> _l(mOnewayFlusher->mutex);
+        mOnewayFlusher->stop = true;
+    }
+    mOnewayFlusher->cv.notify_all();
+    if (mOnewayFlushThread.joinable()) {
+        // the flushing thread may have held the last reference
+        if (mOnewayFlushThread.get_id() == std::this_thread::get_id()) {
+            mOnewayFlushThread.detach();
+        } else {
+            mOnewayFlushThread.join();
+        }
+    }
+
     std::lock_guard<std::mutex> _l(mMutex);
     LOG_ALWAYS_FATAL_IF(mServerConnections.size() != 0,
                         "Should not be able to destroy a session with servers in use.");
@@ -57,6 +90,28 @@ sp<RpcSession> RpcSession::make() {
     return sp<RpcSession>::make();
 }
 
+void RpcSession::setMultiplexed(bool multiplexed) {
+    std::lock_guard<std::mutex> _l(mMutex);
+    LOG_ALWAYS_FATAL_IF(mClientConnections.size() != 0,
+                        "Must set multiplexing before setting up the session");
+    mMultiplexed = multiplexed;
+}
+
+void RpcSession::setOnewayBatching(size_t maxBytes, std::chrono::nanoseconds window) {
+    std::lock_guard<std::mutex> _l(mMutex);
+    LOG_ALWAYS_FATAL_IF(mClientConnections.size() != 0,
+                        "Must set oneway batching before setting up the session");
+    mOnewayBatchBytes = maxBytes;
+    mOnewayBatchWindow = window;
+}
+
+void RpcSession::setSharedMemoryTransport(size_t ringSize) {
+    std::lock_guard<std::mutex> _l(mMutex);
+    LOG_ALWAYS_FATAL_IF(mClientConnections.size() != 0,
+                        "Must set shared memory transport before setting up the session");
+    mSharedMemoryRingSize = ringSize;
+}
+
 bool RpcSession::setupUnixDomainClient(const char* path) {
     return setupSocketClient(UnixSocketAddress(path));
 }
@@ -100,6 +155,14 @@ status_t RpcSession::getRemoteMaxThreads(size_t* maxThreads) {
 
 status_t RpcSession::transact(const RpcAddress& address, uint32_t code, const Parcel& data,
                               Parcel* reply, uint32_t flags) {
+    if (mOnewayBatchBytes != 0) {
+        if (flags & IBinder::FLAG_ONEWAY) {
+            return batchOnewayTransaction(address, code, data, flags);
+        }
+        // keep oneway transactions before synchronous transactions made after them
+        if (status_t status = flushOnewayBatch(); status != OK) return status;
+    }
+
     ExclusiveConnection connection(sp<RpcSession>::fromExisting(this),
                                    (flags & IBinder::FLAG_ONEWAY) ? ConnectionUse::CLIENT_ASYNC
                                                                   : ConnectionUse::CLIENT);
@@ -108,11 +171,86 @@ status_t RpcSession::transact(const RpcAddress& address, uint32_t code, const Pa
 }
 
 status_t RpcSession::sendDecStrong(const RpcAddress& address) {
+    // held oneway transactions may target this binder, so the other side must
+    // get them before it may drop the binder
+    if (mOnewayBatchBytes != 0) {
+        if (status_t status = flushOnewayBatch(); status != OK) return status;
+    }
+
     ExclusiveConnection connection(sp<RpcSession>::fromExisting(this),
                                    ConnectionUse::CLIENT_REFCOUNT);
     return state()->sendDecStrong(connection.fd(), address);
 }
 
+status_t RpcSession::batchOnewayTransaction(const RpcAddress& address, uint32_t code,
+                                            const Parcel& data, uint32_t flags) {
+    bool batched = false;
+    std::vector<uint8_t> toSend;
+    status_t status = state()->batchOnewayTransaction(address, code, data, flags,
+                                                      mOnewayBatchBytes, &batched, &toSend);
+    if (!toSend.empty()) {
+        if (status_t sendStatus = sendOnewayBatch(toSend); sendStatus != OK) return sendStatus;
+    }
+    if (status != OK) return status;
+
+    if (!batched) {
+        ExclusiveConnection connection(sp<RpcSession>::fromExisting(this),
+                                       ConnectionUse::CLIENT_ASYNC);
+        return state()->transact(connection.fd(), address, code, data,
+                                 sp<RpcSession>::fromExisting(this), nullptr, flags);
+    }
+
+    scheduleOnewayFlush();
+    return OK;
+}
+
+status_t RpcSession::flushOnewayBatch() {
+    return sendOnewayBatch(state()->takeOnewayBatch());
+}
+
+status_t RpcSession::sendOnewayBatch(const std::vector<uint8_t>& batch) {
+    if (batch.empty()) return OK;
+    ExclusiveConnection connection(sp<RpcSession>::fromExisting(this),
+                                   ConnectionUse::CLIENT_ASYNC);
+    return state()->sendOnewayBatch(connection.fd(), batch);
+}
+
+void RpcSession::scheduleOnewayFlush() {
+    std::lock_guard<std::mutex> _l(mOnewayFlusher->mutex);
+    if (mOnewayFlusher->deadline) return; // already going to flush everything
+
+    mOnewayFlusher->deadline = std::chrono::steady_clock::now() + mOnewayBatchWindow;
+    if (!mOnewayFlushThread.joinable()) {
+        mOnewayFlushThread = std::thread(&RpcSession::onewayFlushLoop, mOnewayFlusher,
+                                         wp<RpcSession>::fromExisting(this));
+    }
+    mOnewayFlusher->cv.notify_one();
+}
+
+void RpcSession::onewayFlushLoop(std::shared_ptr<OnewayFlusher> flusher, wp<RpcSession> weak) {
+    std::unique_lock<std::mutex> _l(flusher->mutex);
+    while (!flusher->stop) {
+        if (!flusher->deadline) {
+            flusher->cv.wait(_l);
+            continue;
+        }
+        if (std::chrono::steady_clock::now() < *flusher->deadline) {
+            flusher->cv.wait_until(_l, *flusher->deadline);
+            continue;
+        }
+        flusher->deadline.reset();
+        _l.unlock();
+
+        if (sp<RpcSession> session = weak.promote(); session != nullptr) {
+            status_t status = session->flushOnewayBatch();
+            ALOGW_IF(status != OK, "Failed to flush oneway batch: %s",
+                     statusToString(status).c_str());
+        }
+
+        _l.lock();
+    }
+}
+
 status_t RpcSession::readId() {
     {
         std::lock_guard<std::mutex> _l(mMutex);
@@ -140,7 +278,11 @@ void RpcSession::preJoin(std::thread thread) {
     }
 }
 
-void RpcSession::join(unique_fd client) {
+void RpcSession::join(unique_fd client, std::shared_ptr<RpcSharedMemory> sharedMemory) {
+    if (sharedMemory != nullptr) {
+        state()->addSharedMemory(client, std::move(sharedMemory));
+    }
+
     // must be registered to allow arbitrary client code executing commands to
     // be able to do nested calls (we can't only read from it)
     sp<RpcConnection> connection = assignServerToThisThread(std::move(client));
@@ -155,6 +297,13 @@ void RpcSession::join(unique_fd client) {
         }
     }
 
+    if (state()->isMultiplexed()) {
+        state()->shutdownMultiplexWorkers();
+    }
+
+    // before the fd is closed (and maybe reused)
+    state()->removeSharedMemory(connection->fd);
+
     LOG_ALWAYS_FATAL_IF(!removeServerConnection(connection),
                         "bad state: connection object guaranteed to be in list");
 
@@ -213,6 +362,12 @@ bool RpcSession::setupSocketClient(const RpcSocketAddress& addr) {
         return false;
     }
 
+    if (mMultiplexed) {
+        // the one connection we have is shared between all callers
+        mState->enableMultiplexing();
+        return true;
+    }
+
     // we've already setup one client
     for (size_t i = 0; i + 1 < numThreadsAvailable; i++) {
         // TODO(b/185167543): shutdown existing connections?
@@ -222,6 +377,38 @@ bool RpcSession::setupSocketClient(const RpcSocketAddress& addr) {
     return true;
 }
 
+// Sends RPC_SESSION_ID_CONNECTION_HEADER followed by 'header', along with
+// 'fds' (if they are set).
+static bool sendConnectionHeader(const unique_fd& socket, const RpcConnectionHeader& header,
+                                 const RpcSharedMemory::Fds& fds) {
+    int32_t marker = RPC_SESSION_ID_CONNECTION_HEADER;
+    iovec iovs[]{
+            {&marker, sizeof(marker)},
+            {const_cast<RpcConnectionHeader*>(&header), sizeof(header)},
+    };
+    msghdr msg{
+            .msg_iov = iovs,
+            .msg_iovlen = std::size(iovs),
+    };
+
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * RpcSharedMemory::kNumFds)];
+    if (fds[0].ok()) {
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+        for (size_t i = 0; i < fds.size(); i++) {
+            int rawFd = fds[i].get();
+            memcpy(CMSG_DATA(cmsg) + i * sizeof(int), &rawFd, sizeof(rawFd));
+        }
+    }
+
+    return sizeof(marker) + sizeof(header) ==
+            TEMP_FAILURE_RETRY(sendmsg(socket.get(), &msg, MSG_NOSIGNAL));
+}
+
 bool RpcSession::setupOneSocketClient(const RpcSocketAddress& addr, int32_t id) {
     for (size_t tries = 0; tries < 5; tries++) {
         if (tries > 0) usleep(10000);
@@ -246,11 +433,52 @@ bool RpcSession::setupOneSocketClient(const RpcSocketAddress& addr, int32_t id)
             return false;
         }
 
-        if (sizeof(id) != TEMP_FAILURE_RETRY(write(serverFd.get(), &id, sizeof(id)))) {
-            int savedErrno = errno;
-            ALOGE("Could not write id to socket at %s: %s", addr.toString().c_str(),
-                  strerror(savedErrno));
-            return false;
+        // fds can only be sent over unix domain sockets
+        RpcSharedMemory::Fds fds;
+        std::shared_ptr<RpcSharedMemory> sharedMemory;
+        if (mSharedMemoryRingSize != 0 && addr.addr()->sa_family == AF_UNIX) {
+            sharedMemory = RpcSharedMemory::make(mSharedMemoryRingSize, &fds);
+        }
+
+        if (sharedMemory == nullptr) {
+            // the original preamble, which every server understands
+            if (sizeof(id) != TEMP_FAILURE_RETRY(write(serverFd.get(), &id, sizeof(id)))) {
+                int savedErrno = errno;
+                ALOGE("Could not write id to socket at %s: %s", addr.toString().c_str(),
+                      strerror(savedErrno));
+                return false;
+            }
+        } else {
+            RpcConnectionHeader header{.sessionId = id,
+                                       .options = RPC_CONNECTION_OPTION_SHARED_MEMORY};
+            if (!sendConnectionHeader(serverFd, header, fds)) {
+                int savedErrno = errno;
+                ALOGE("Could not write connection header to socket at %s: %s",
+                      addr.toString().c_str(), strerror(savedErrno));
+                return false;
+            }
+
+            // A server which doesn't know about RpcConnectionHeader takes the
+            // marker for an unknown session ID and hangs up, so connect again
+            // without it, and don't ask on later connections either.
+            RpcConnectionResponse response;
+            if (sizeof(response) !=
+                TEMP_FAILURE_RETRY(recv(serverFd.get(), &response, sizeof(response),
+                                        MSG_WAITALL | MSG_NOSIGNAL))) {
+                int savedErrno = errno;
+                ALOGW("Could not read connection response from socket at %s (%s), retrying "
+                      "without shared memory",
+                      addr.toString().c_str(), strerror(savedErrno));
+                mSharedMemoryRingSize = 0;
+                continue;
+            }
+
+            if (response.options & RPC_CONNECTION_OPTION_SHARED_MEMORY) {
+                mState->addSharedMemory(serverFd, std::move(sharedMemory));
+            } else {
+                ALOGW("Server at %s did not accept shared memory, using the socket instead",
+                      addr.toString().c_str());
+            }
         }
 
         LOG_RPC_DETAIL("Socket at %s client with fd %d", addr.toString().c_str(), serverFd.get());
@@ -304,6 +532,19 @@ RpcSession::ExclusiveConnection::ExclusiveConnection(const sp<RpcSession>& sessi
     pid_t tid = gettid();
     std::unique_lock<std::mutex> _l(mSession->mMutex);
 
+    // A multiplexed session has a single connection, and RpcState sorts out
+    // which commands belong to which thread.
+    if (mSession->mState->isMultiplexed()) {
+        LOG_ALWAYS_FATAL_IF(mSession->mClientConnections.size() == 0 &&
+                                    mSession->mServerConnections.size() == 0,
+                            "Multiplexed session has no connection left.");
+        mConnection = mSession->mClientConnections.size() != 0
+                ? mSession->mClientConnections.front()
+                : mSession->mServerConnections.front();
+        mReentrant = true; // never exclusively owned
+        return;
+    }
+
     mSession->mWaitingThreads++;
     while (true) {
         sp<RpcConnection> exclusive;
@@ -0,0 +1,399 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "RpcSharedMemory"
+
+#include "RpcSharedMemory.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <iterator>
+#include <new>
+
+#include <log/log.h>
+
+// The glibc host sysroot predates memfd_create and file sealing, so the system
+// call is made directly, and whatever its headers lack is defined here.
+#ifndef __NR_memfd_create
+#if defined(__x86_64__)
+#define __NR_memfd_create 319
+#elif defined(__i386__)
+#define __NR_memfd_create 356
+#endif
+#endif
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#endif
+#ifndef MFD_ALLOW_SEALING
+#define MFD_ALLOW_SEALING 0x0002U
+#endif
+#ifndef F_ADD_SEALS
+#define F_ADD_SEALS (1024 + 9)
+#define F_GET_SEALS (1024 + 10)
+#endif
+#ifndef F_SEAL_SEAL
+#define F_SEAL_SEAL 0x0001
+#define F_SEAL_SHRINK 0x0002
+#define F_SEAL_GROW 0x0004
+#endif
+
+namespace android {
+
+using base::unique_fd;
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free,
+              "atomics in shared memory must not need a lock");
+
+constexpr uint32_t kSharedMemoryMagic = 0x52504353; // 'RPCS'
+constexpr uint32_t kMinRingSize = 4096;
+constexpr uint32_t kMaxRingSize = 16 * 1024 * 1024;
+
+// Where each fd is in RpcSharedMemory::Fds.
+constexpr size_t kMemfdIndex = 0;
+constexpr size_t dataEventIndex(size_t ring) {
+    return 1 + 2 * ring;
+}
+constexpr size_t spaceEventIndex(size_t ring) {
+    return 2 + 2 * ring;
+}
+
+// Positions are running byte counts, which wrap at 2^32. The ring size is a
+// power of two, so a position maps to an offset in the ring by masking it.
+struct RpcSharedMemory::Ring {
+    // written by the side sending into this ring
+    alignas(64) std::atomic<uint32_t> head;
+    std::atomic<uint32_t> readerWaiting;
+
+    // written by the side receiving from this ring
+    alignas(64) std::atomic<uint32_t> tail;
+    std::atomic<uint32_t> writerWaiting;
+};
+
+struct RpcSharedMemory::Header {
+    uint32_t magic;
+    uint32_t ringSize;
+    std::atomic<uint32_t> closed;
+
+    // [0] is from client to server, [1] is from server to client
+    Ring rings[2];
+};
+
+static void signalEvent(const unique_fd& event) {
+    uint64_t one = 1;
+    // this only fails if the counter is about to overflow, so it is signaled
+    (void)TEMP_FAILURE_RETRY(write(event.get(), &one, sizeof(one)));
+}
+
+// The eventfds come from the other side, so make sure that they are eventfds,
+// and that signaling them can't block this side.
+static bool isNonBlockingEventFd(const unique_fd& fd) {
+    char path[32];
+    snprintf(path, sizeof(path), "/proc/self/fd/%d", fd.get());
+    char target[32];
+    ssize_t len = readlink(path, target, sizeof(target) - 1);
+    if (len < 0) return false;
+    target[len] = '\0';
+    if (strcmp(target, "anon_inode:[eventfd]") != 0) return false;
+
+    int flags = fcntl(fd.get(), F_GETFL);
+    if (flags == -1) return false;
+    return (flags & O_NONBLOCK) != 0 || fcntl(fd.get(), F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+static void copyIn(uint8_t* ring, uint32_t ringSize, uint32_t pos, const uint8_t* src, size_t n) {
+    size_t offset = pos & (ringSize - 1);
+    size_t first = std::min<size_t>(n, ringSize - offset);
+    memcpy(ring + offset, src, first);
+    memcpy(ring, src + first, n - first);
+}
+
+static void copyOut(uint8_t* dst, const uint8_t* ring, uint32_t ringSize, uint32_t pos, size_t n) {
+    size_t offset = pos & (ringSize - 1);
+    size_t first = std::min<size_t>(n, ringSize - offset);
+    memcpy(dst, ring + offset, first);
+    memcpy(dst + first, ring, n - first);
+}
+
+size_t RpcSharedMemory::headerSize() {
+    size_t pageSize = getpagesize();
+    return (sizeof(Header) + pageSize - 1) / pageSize * pageSize;
+}
+
+size_t RpcSharedMemory::mappingSizeFor(uint32_t ringSize) {
+    return headerSize() + 2 * static_cast<size_t>(ringSize);
+}
+
+std::unique_ptr<RpcSharedMemory> RpcSharedMemory::make(size_t ringSize, Fds* outFds) {
+    if (ringSize > kMaxRingSize) {
+        ALOGE("Shared memory ring size %zu is too big, max is %u", ringSize, kMaxRingSize);
+        return nullptr;
+    }
+    uint32_t size = kMinRingSize;
+    while (size < ringSize) size <<= 1;
+
+    unique_fd fd(static_cast<int>(
+            syscall(__NR_memfd_create, "rpc_shared_memory", MFD_CLOEXEC | MFD_ALLOW_SEALING)));
+    if (fd == -1) {
+        ALOGE("Could not create memfd: %s", strerror(errno));
+        return nullptr;
+    }
+
+    size_t mappingSize = mappingSizeFor(size);
+    if (0 != TEMP_FAILURE_RETRY(ftruncate(fd.get(), mappingSize))) {
+        ALOGE("Could not size memfd to %zu bytes: %s", mappingSize, strerror(errno));
+        return nullptr;
+    }
+    // the server maps the whole file, so it must not be able to shrink
+    if (0 != fcntl(fd.get(), F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL)) {
+        ALOGE("Could not seal memfd: %s", strerror(errno));
+        return nullptr;
+    }
+
+    Fds events;
+    for (size_t i = kMemfdIndex + 1; i < kNumFds; i++) {
+        events[i].reset(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK));
+        if (!events[i].ok()) {
+            ALOGE("Could not create eventfd: %s", strerror(errno));
+            return nullptr;
+        }
+        (*outFds)[i].reset(fcntl(events[i].get(), F_DUPFD_CLOEXEC, 0));
+        if (!(*outFds)[i].ok()) {
+            ALOGE("Could not duplicate eventfd: %s", strerror(errno));
+            return nullptr;
+        }
+    }
+
+    void* mapping = mmap(nullptr, mappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd.get(), 0);
+    if (mapping == MAP_FAILED) {
+        ALOGE("Could not map memfd: %s", strerror(errno));
+        return nullptr;
+    }
+
+    Header* header = new (mapping) Header{};
+    header->magic = kSharedMemoryMagic;
+    header->ringSize = size;
+
+    (*outFds)[kMemfdIndex] = std::move(fd);
+    return std::unique_ptr<RpcSharedMemory>(new RpcSharedMemory(mapping, mappingSize, size,
+                                                                true /*isClient*/,
+                                                                std::move(events)));
+}
+
+std::unique_ptr<RpcSharedMemory> RpcSharedMemory::attach(Fds fds) {
+    const unique_fd& fd = fds[kMemfdIndex];
+    int seals = fcntl(fd.get(), F_GET_SEALS);
+    if (seals == -1 || (seals & (F_SEAL_SHRINK | F_SEAL_SEAL)) != (F_SEAL_SHRINK | F_SEAL_SEAL)) {
+        ALOGE("Shared memory from client is not sealed (seals %d)", seals);
+        return nullptr;
+    }
+
+    for (size_t i = kMemfdIndex + 1; i < kNumFds; i++) {
+        if (!isNonBlockingEventFd(fds[i])) {
+            ALOGE("Shared memory from client came with a bad eventfd");
+            return nullptr;
+        }
+    }
+
+    struct stat st;
+    if (0 != fstat(fd.get(), &st)) {
+        ALOGE("Could not stat shared memory from client: %s", strerror(errno));
+        return nullptr;
+    }
+    size_t mappingSize = st.st_size;
+    if (mappingSize < mappingSizeFor(kMinRingSize) || mappingSize > mappingSizeFor(kMaxRingSize)) {
+        ALOGE("Shared memory from client has bad size %zu", mappingSize);
+        return nullptr;
+    }
+
+    void* mapping = mmap(nullptr, mappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd.get(), 0);
+    if (mapping == MAP_FAILED) {
+        ALOGE("Could not map shared memory from client: %s", strerror(errno));
+        return nullptr;
+    }
+
+    const Header* header = reinterpret_cast<const Header*>(mapping);
+    uint32_t magic = header->magic;
+    uint32_t ringSize = header->ringSize;
+    if (magic != kSharedMemoryMagic || ringSize < kMinRingSize || ringSize > kMaxRingSize ||
+        (ringSize & (ringSize - 1)) != 0 || mappingSizeFor(ringSize) != mappingSize) {
+        ALOGE("Shared memory from client has bad header (magic %x, ring size %u, size %zu)",
+              magic, ringSize, mappingSize);
+        munmap(mapping, mappingSize);
+        return nullptr;
+    }
+
+    // the mapping keeps the memory alive
+    fds[kMemfdIndex].reset();
+    return std::unique_ptr<RpcSharedMemory>(new RpcSharedMemory(mapping, mappingSize, ringSize,
+                                                                false /*isClient*/,
+                                                                std::move(fds)));
+}
+
+RpcSharedMemory::RpcSharedMemory(void* mapping, size_t mappingSize, uint32_t ringSize,
+                                 bool isClient, Fds events)
+      : mMapping(mapping),
+        mMappingSize(mappingSize),
+        mRingSize(ringSize),
+        mHeader(reinterpret_cast<Header*>(mapping)),
+        mEvents(std::move(events)) {
+    uint8_t* data = static_cast<uint8_t*>(mapping) + headerSize();
+    uint8_t* clientToServer = data;
+    uint8_t* serverToClient = data + ringSize;
+
+    size_t sendRing = isClient ? 0 : 1;
+    size_t recvRing = isClient ? 1 : 0;
+
+    mSendRing = &mHeader->rings[sendRing];
+    mSendData = isClient ? clientToServer : serverToClient;
+    mSendDataEvent = &mEvents[dataEventIndex(sendRing)];
+    mSendSpaceEvent = &mEvents[spaceEventIndex(sendRing)];
+    mRecvRing = &mHeader->rings[recvRing];
+    mRecvData = isClient ? serverToClient : clientToServer;
+    mRecvDataEvent = &mEvents[dataEventIndex(recvRing)];
+    mRecvSpaceEvent = &mEvents[spaceEventIndex(recvRing)];
+}
+
+RpcSharedMemory::~RpcSharedMemory() {
+    munmap(mMapping, mMappingSize);
+}
+
+bool RpcSharedMemory::isClosed() {
+    return mHeader->closed.load() != 0;
+}
+
+template <typename Ready>
+bool RpcSharedMemory::waitFor(const unique_fd& socket, const unique_fd& event,
+                              std::atomic<uint32_t>* waiting, const Ready& ready) {
+    while (true) {
+        if (ready()) return true;
+        if (isClosed()) return false;
+
+        // The other side checks 'waiting' after it moves. Either it sees this
+        // store and signals 'event', or it has already moved and 'ready' sees
+        // it.
+        waiting->store(1);
+        if (ready()) return true;
+
+        // Nothing is written to the socket after the shared memory is set up,
+        // so any event on it means the other side closed it.
+        pollfd pfds[]{
+                {.fd = socket.get(), .events = POLLIN | POLLRDHUP, .revents = 0},
+                {.fd = event.get(), .events = POLLIN, .revents = 0},
+        };
+        if (TEMP_FAILURE_RETRY(poll(pfds, std::size(pfds), -1)) == -1) {
+            ALOGE("Could not wait on shared memory: %s", strerror(errno));
+            return false;
+        }
+        if (pfds[0].revents != 0) return false;
+        if (pfds[1].revents & ~POLLIN) return false;
+
+        // reset the eventfd, an extra signal only costs another check
+        uint64_t count;
+        (void)TEMP_FAILURE_RETRY(read(event.get(), &count, sizeof(count)));
+    }
+}
+
+bool RpcSharedMemory::send(const unique_fd& socket, const iovec* iovs, size_t niovs) {
+    if (isClosed()) return false;
+
+    uint32_t head = mSendRing->head.load(std::memory_order_relaxed);
+
+    size_t i = 0;
+    size_t offset = 0; // into iovs[i]
+    while (i < niovs) {
+        uint32_t used = 0;
+        if (!waitFor(socket, *mSendSpaceEvent, &mSendRing->writerWaiting, [&] {
+                used = head - mSendRing->tail.load();
+                return used != mRingSize;
+            })) {
+            return false;
+        }
+        if (used > mRingSize) {
+            ALOGE("Shared memory ring is corrupt (%u of %u bytes used)", used, mRingSize);
+            shutdown();
+            return false;
+        }
+
+        // copy as much as fits before waking the other side
+        size_t space = mRingSize - used;
+        while (space > 0 && i < niovs) {
+            size_t n = std::min(space, iovs[i].iov_len - offset);
+            const uint8_t* src = static_cast<const uint8_t*>(iovs[i].iov_base) + offset;
+            copyIn(mSendData, mRingSize, head, src, n);
+            head += n;
+            space -= n;
+            offset += n;
+            if (offset == iovs[i].iov_len) {
+                i++;
+                offset = 0;
+            }
+        }
+
+        mSendRing->head.store(head);
+        if (mSendRing->readerWaiting.exchange(0)) signalEvent(*mSendDataEvent);
+    }
+
+    return true;
+}
+
+bool RpcSharedMemory::recv(const unique_fd& socket, void* data, size_t size) {
+    uint8_t* dst = static_cast<uint8_t*>(data);
+    uint32_t tail = mRecvRing->tail.load(std::memory_order_relaxed);
+
+    while (size > 0) {
+        uint32_t used = 0;
+        if (!waitFor(socket, *mRecvDataEvent, &mRecvRing->readerWaiting, [&] {
+                used = mRecvRing->head.load() - tail;
+                return used != 0;
+            })) {
+            return false;
+        }
+        if (used > mRingSize) {
+            ALOGE("Shared memory ring is corrupt (%u of %u bytes used)", used, mRingSize);
+            shutdown();
+            return false;
+        }
+
+        size_t n = std::min<size_t>(size, used);
+        copyOut(dst, mRecvData, mRingSize, tail, n);
+        tail += n;
+        dst += n;
+        size -= n;
+
+        mRecvRing->tail.store(tail);
+        if (mRecvRing->writerWaiting.exchange(0)) signalEvent(*mRecvSpaceEvent);
+    }
+
+    return true;
+}
+
+void RpcSharedMemory::shutdown() {
+    mHeader->closed.store(1);
+    for (size_t i = kMemfdIndex + 1; i < kNumFds; i++) {
+        signalEvent(mEvents[i]);
+    }
+}
+
+} // namespace android
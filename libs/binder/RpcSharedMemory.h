@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <android-base/unique_fd.h>
+#include <sys/uio.h>
+
+#include <array>
+#include <atomic>
+#include <memory>
+
+namespace android {
+
+/**
+ * A pair of ring buffers in a memfd, shared by the two ends of a single
+ * connection of an RpcSession over a unix domain socket (see
+ * RpcSession::setSharedMemoryTransport). Once this is set up, everything which
+ * would have been written to the socket is copied through one ring, and
+ * everything which would have been read from it comes from the other. The
+ * socket stays open only so that each side can tell if the other goes away.
+ *
+ * A thread waiting for data or for space in a ring blocks in poll() on the
+ * socket and on an eventfd, which the other side only signals when it sees
+ * that a thread is waiting. An idle connection doesn't wake up.
+ *
+ * Like the socket it replaces, each direction supports a single writer and a
+ * single reader at a time.
+ *
+ * The other side can write to the shared memory at any time, so nothing read
+ * from it is trusted to stay within bounds.
+ */
+class RpcSharedMemory {
+public:
+    /**
+     * The memfd holding the rings, followed by an eventfd signaled when there
+     * is new data and one signaled when there is new space, for each ring.
+     */
+    static constexpr size_t kNumFds = 5;
+    using Fds = std::array<base::unique_fd, kNumFds>;
+
+    /**
+     * For the client. Creates a new memfd with rings of (at least) ringSize
+     * bytes, and the eventfds, which must all be sent to the server in
+     * 'outFds'.
+     */
+    static std::unique_ptr<RpcSharedMemory> make(size_t ringSize, Fds* outFds);
+
+    /**
+     * For the server. Maps a memfd created by the client with make, and takes
+     * the eventfds that came with it.
+     */
+    static std::unique_ptr<RpcSharedMemory> attach(Fds fds);
+
+    ~RpcSharedMemory();
+
+    /**
+     * Equivalent to sending all of the buffers over 'socket', or receiving
+     * exactly 'size' bytes from it. These fail if either side has called
+     * shutdown or if 'socket' is closed by the other side.
+     */
+    [[nodiscard]] bool send(const base::unique_fd& socket, const iovec* iovs, size_t niovs);
+    [[nodiscard]] bool recv(const base::unique_fd& socket, void* data, size_t size);
+
+    /**
+     * Wakes up any thread waiting on either side, and makes all later calls to
+     * send or recv fail.
+     */
+    void shutdown();
+
+private:
+    struct Ring;
+    struct Header;
+
+    RpcSharedMemory(void* mapping, size_t mappingSize, uint32_t ringSize, bool isClient,
+                    Fds events);
+
+    template <typename Ready>
+    bool waitFor(const base::unique_fd& socket, const base::unique_fd& event,
+                 std::atomic<uint32_t>* waiting, const Ready& ready);
+    bool isClosed();
+
+    static size_t headerSize();
+    static size_t mappingSizeFor(uint32_t ringSize);
+
+    void* mMapping;
+    size_t mMappingSize;
+    uint32_t mRingSize; // read once, the copy in shared memory can't be trusted
+    Header* mHeader;
+
+    // the eventfds from Fds, the memfd itself isn't kept
+    Fds mEvents;
+
+    Ring* mSendRing;
+    uint8_t* mSendData;
+    const base::unique_fd* mSendDataEvent;  // signaled by this side
+    const base::unique_fd* mSendSpaceEvent; // waited on by this side
+    Ring* mRecvRing;
+    uint8_t* mRecvData;
+    const base::unique_fd* mRecvDataEvent;  // waited on by this side
+    const base::unique_fd* mRecvSpaceEvent; // signaled by this side
+};
+
+} // namespace android
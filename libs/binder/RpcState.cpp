@@ -22,9 +22,15 @@
 #include <binder/RpcServer.h>
 
 #include "Debug.h"
+#include "RpcSharedMemory.h"
 #include "RpcWireFormat.h"
 
 #include <inttypes.h>
+#include <sys/socket.h>
+
+#include <functional>
+#include <iterator>
+#include <string_view>
 
 namespace android {
 
@@ -56,45 +62,78 @@ status_t RpcState::onBinderLeaving(const sp<RpcSession>& session, const sp<IBind
         return INVALID_OPERATION;
     }
 
-    std::lock_guard<std::mutex> _l(mNodeMutex);
+    if (isRpc) {
+        // proxies always know their address, and they can only exist while we
+        // know about them
+        const RpcAddress& address = binder->remoteBinder()->getPrivateAccessorForId().rpcAddress();
+        NodeShard& shard = shardFor(address);
+        std::lock_guard<std::mutex> _l(shard.mutex);
+        if (mTerminated) return DEAD_OBJECT; // avoid fatal only, otherwise races
 
-    // TODO(b/182939933): maybe move address out of BpBinder, and keep binder->address map
-    // in RpcState
-    for (auto& [addr, node] : mNodeForAddress) {
-        if (binder == node.binder) {
-            if (isRpc) {
-                const RpcAddress& actualAddr =
-                        binder->remoteBinder()->getPrivateAccessorForId().rpcAddress();
-                // TODO(b/182939933): this is only checking integrity of data structure
-                // a different data structure doesn't need this
-                LOG_ALWAYS_FATAL_IF(addr < actualAddr, "Address mismatch");
-                LOG_ALWAYS_FATAL_IF(actualAddr < addr, "Address mismatch");
-            }
-            node.timesSent++;
-            node.sentRef = binder; // might already be set
-            *outAddress = addr;
+        auto it = shard.nodes.find(address);
+        LOG_ALWAYS_FATAL_IF(it == shard.nodes.end(),
+                            "RPC binder must have known address at this point");
+        LOG_ALWAYS_FATAL_IF(it->second.binder.unsafe_get() != binder.get(), "Address mismatch");
+
+        it->second.timesSent++;
+        it->second.sentRef = binder; // might already be set
+        *outAddress = address;
+        return OK;
+    }
+
+    // Held while creating a new address, so that the same binder doesn't end
+    // up with two addresses if it is sent on two threads at once.
+    LocalBinderShard& localShard = localShardFor(binder.get());
+    std::lock_guard<std::mutex> _l(localShard.mutex);
+
+    if (auto it = localShard.addresses.find(binder.get()); it != localShard.addresses.end()) {
+        NodeShard& shard = shardFor(it->second);
+        std::lock_guard<std::mutex> _ln(shard.mutex);
+        if (mTerminated) return DEAD_OBJECT; // avoid fatal only, otherwise races
+
+        // The entry is keyed by the binder's address in memory, so it may also
+        // be left over from a binder that was destroyed while the other side
+        // still had a reference to it, and whose memory was reused for this
+        // one. Only use it if the node is really for this binder.
+        auto nodeIt = shard.nodes.find(it->second);
+        if (nodeIt != shard.nodes.end() && nodeIt->second.binder.unsafe_get() == binder.get()) {
+            nodeIt->second.timesSent++;
+            nodeIt->second.sentRef = binder; // might already be set
+            *outAddress = it->second;
             return OK;
         }
+
+        // otherwise, the node was dropped, or it belongs to another binder, so
+        // this binder gets a new address below
+        localShard.addresses.erase(it);
     }
-    LOG_ALWAYS_FATAL_IF(isRpc, "RPC binder must have known address at this point");
 
-    auto&& [it, inserted] = mNodeForAddress.insert({RpcAddress::unique(),
+    RpcAddress address = RpcAddress::unique();
+    {
+        NodeShard& shard = shardFor(address);
+        std::lock_guard<std::mutex> _ln(shard.mutex);
+        if (mTerminated) return DEAD_OBJECT; // avoid fatal only, otherwise races
+
+        auto&& [it, inserted] = shard.nodes.insert({address,
                                                     BinderNode{
                                                             .binder = binder,
                                                             .timesSent = 1,
                                                             .sentRef = binder,
                                                     }});
-    // TODO(b/182939933): better organization could avoid needing this log
-    LOG_ALWAYS_FATAL_IF(!inserted);
+        // TODO(b/182939933): better organization could avoid needing this log
+        LOG_ALWAYS_FATAL_IF(!inserted);
+    }
+    localShard.addresses.insert_or_assign(binder.get(), address);
 
-    *outAddress = it->first;
+    *outAddress = address;
     return OK;
 }
 
 sp<IBinder> RpcState::onBinderEntering(const sp<RpcSession>& session, const RpcAddress& address) {
-    std::unique_lock<std::mutex> _l(mNodeMutex);
+    NodeShard& shard = shardFor(address);
+    std::unique_lock<std::mutex> _l(shard.mutex);
 
-    if (auto it = mNodeForAddress.find(address); it != mNodeForAddress.end()) {
+    if (auto it = shard.nodes.find(address); it != shard.nodes.end()) {
         sp<IBinder> binder = it->second.binder.promote();
 
         // implicitly have strong RPC refcount, since we received this binder
@@ -110,7 +149,7 @@ sp<IBinder> RpcState::onBinderEntering(const sp<RpcSession>& session, const RpcA
         return binder;
     }
 
-    auto&& [it, inserted] = mNodeForAddress.insert({address, BinderNode{}});
+    auto&& [it, inserted] = shard.nodes.insert({address, BinderNode{}});
     LOG_ALWAYS_FATAL_IF(!inserted, "Failed to insert binder when creating proxy");
 
     // Currently, all binders are assumed to be part of the same session (no
@@ -121,40 +160,123 @@ sp<IBinder> RpcState::onBinderEntering(const sp<RpcSession>& session, const RpcA
     return binder;
 }
 
+void RpcState::addSharedMemory(const base::unique_fd& fd,
+                               std::shared_ptr<RpcSharedMemory> sharedMemory) {
+    std::lock_guard<std::mutex> _l(mSharedMemoryMutex);
+    mSharedMemory[fd.get()] = std::move(sharedMemory);
+    mHasSharedMemory = true;
+}
+
+void RpcState::removeSharedMemory(const base::unique_fd& fd) {
+    std::shared_ptr<RpcSharedMemory> sharedMemory;
+    {
+        std::lock_guard<std::mutex> _l(mSharedMemoryMutex);
+        auto it = mSharedMemory.find(fd.get());
+        if (it == mSharedMemory.end()) return;
+        sharedMemory = std::move(it->second);
+        mSharedMemory.erase(it);
+    }
+    sharedMemory->shutdown();
+}
+
+void RpcState::shutdownSharedMemory() {
+    // entries are kept, so that any later command fails instead of going to the socket
+    std::lock_guard<std::mutex> _l(mSharedMemoryMutex);
+    for (auto& [fd, sharedMemory] : mSharedMemory) {
+        (void)fd;
+        sharedMemory->shutdown();
+    }
+}
+
+std::shared_ptr<RpcSharedMemory> RpcState::sharedMemoryFor(const base::unique_fd& fd) {
+    if (!mHasSharedMemory) return nullptr;
+
+    std::lock_guard<std::mutex> _l(mSharedMemoryMutex);
+    auto it = mSharedMemory.find(fd.get());
+    return it == mSharedMemory.end() ? nullptr : it->second;
+}
+
 size_t RpcState::countBinders() {
-    std::lock_guard<std::mutex> _l(mNodeMutex);
-    return mNodeForAddress.size();
+    size_t count = 0;
+    for (NodeShard& shard : mNodeShards) {
+        std::lock_guard<std::mutex> _l(shard.mutex);
+        count += shard.nodes.size();
+    }
+    return count;
 }
 
 void RpcState::dump() {
-    std::lock_guard<std::mutex> _l(mNodeMutex);
     ALOGE("DUMP OF RpcState %p", this);
-    ALOGE("DUMP OF RpcState (%zu nodes)", mNodeForAddress.size());
-    for (const auto& [address, node] : mNodeForAddress) {
-        sp<IBinder> binder = node.binder.promote();
-
-        const char* desc;
-        if (binder) {
-            if (binder->remoteBinder()) {
-                if (binder->remoteBinder()->isRpcBinder()) {
-                    desc = "(rpc binder proxy)";
+    ALOGE("DUMP OF RpcState (%zu nodes)", countBinders());
+    for (NodeShard& shard : mNodeShards) {
+        std::lock_guard<std::mutex> _l(shard.mutex);
+        for (const auto& [address, node] : shard.nodes) {
+            sp<IBinder> binder = node.binder.promote();
+
+            const char* desc;
+            if (binder) {
+                if (binder->remoteBinder()) {
+                    if (binder->remoteBinder()->isRpcBinder()) {
+                        desc = "(rpc binder proxy)";
+                    } else {
+                        desc = "(binder proxy)";
+                    }
                 } else {
-                    desc = "(binder proxy)";
+                    desc = "(local binder)";
                 }
             } else {
-                desc = "(local binder)";
+                desc = "(null)";
             }
-        } else {
-            desc = "(null)";
-        }
 
-        ALOGE("- BINDER NODE: %p times sent:%zu times recd: %zu a:%s type:%s",
-              node.binder.unsafe_get(), node.timesSent, node.timesRecd, address.toString().c_str(),
-              desc);
+            ALOGE("- BINDER NODE: %p times sent:%zu times recd: %zu a:%s type:%s",
+                  node.binder.unsafe_get(), node.timesSent, node.timesRecd,
+                  address.toString().c_str(), desc);
+        }
     }
     ALOGE("END DUMP OF RpcState");
 }
 
+size_t RpcState::AddressHash::operator()(const RpcAddress& address) const {
+    const RpcWireAddress& raw = address.viewRawEmbedded();
+    return std::hash<std::string_view>()(
+            std::string_view(reinterpret_cast<const char*>(raw.address), sizeof(raw.address)));
+}
+
+bool RpcState::AddressEqual::operator()(const RpcAddress& lhs, const RpcAddress& rhs) const {
+    return memcmp(&lhs.viewRawEmbedded(), &rhs.viewRawEmbedded(), sizeof(RpcWireAddress)) == 0;
+}
+
+RpcState::NodeShard& RpcState::shardFor(const RpcAddress& address) {
+    // top bits, since the map in each shard buckets by the low bits
+    size_t hash = AddressHash()(address);
+    return mNodeShards[(hash >> (sizeof(size_t) * 8 - 8)) % kNumShards];
+}
+
+RpcState::LocalBinderShard& RpcState::localShardFor(const IBinder* binder) {
+    return mLocalBinderShards[std::hash<const IBinder*>()(binder) % kNumShards];
+}
+
+void RpcState::eraseNodeLocked(NodeShard& shard, NodeMap::iterator it,
+                               std::optional<LocalBinderEntry>* dropped) {
+    *dropped = LocalBinderEntry{
+            .binder = it->second.binder.unsafe_get(),
+            .address = it->first,
+    };
+    shard.nodes.erase(it);
+}
+
+void RpcState::forgetLocalBinder(const std::optional<LocalBinderEntry>& dropped) {
+    if (!dropped) return;
+
+    LocalBinderShard& localShard = localShardFor(dropped->binder);
+    std::lock_guard<std::mutex> _l(localShard.mutex);
+    auto it = localShard.addresses.find(dropped->binder);
+    // may have already been given a new address
+    if (it != localShard.addresses.end() && AddressEqual()(it->second, dropped->address)) {
+        localShard.addresses.erase(it);
+    }
+}
+
 void RpcState::terminate() {
     if (SHOULD_LOG_RPC_DETAIL) {
         ALOGE("RpcState::terminate()");
@@ -163,13 +285,16 @@ void RpcState::terminate() {
 
     // if the destructor of a binder object makes another RPC call, then calling
     // decStrong could deadlock. So, we must hold onto these binders until
-    // mNodeMutex is no longer taken.
+    // no shard mutex is taken.
     std::vector<sp<IBinder>> tempHoldBinder;
 
-    {
-        std::lock_guard<std::mutex> _l(mNodeMutex);
-        mTerminated = true;
-        for (auto& [address, node] : mNodeForAddress) {
+    // set before clearing any shard, so that anything that finds a shard
+    // cleared also knows why
+    mTerminated = true;
+
+    for (NodeShard& shard : mNodeShards) {
+        std::lock_guard<std::mutex> _l(shard.mutex);
+        for (auto& [address, node] : shard.nodes) {
             sp<IBinder> binder = node.binder.promote();
             LOG_ALWAYS_FATAL_IF(binder == nullptr, "Binder %p expected to be owned.", binder.get());
 
@@ -178,33 +303,145 @@ void RpcState::terminate() {
             }
         }
 
-        mNodeForAddress.clear();
+        shard.nodes.clear();
+    }
+
+    for (LocalBinderShard& localShard : mLocalBinderShards) {
+        std::lock_guard<std::mutex> _l(localShard.mutex);
+        localShard.addresses.clear();
+    }
+
+    {
+        std::lock_guard<std::mutex> _l(mMultiplexMutex);
+        mMultiplexTerminated = true;
+        mMultiplexReplies.clear();
+        mMultiplexAbandonedRequests.clear();
+    }
+    mMultiplexCv.notify_all();
+}
+
+void RpcState::enableMultiplexing() {
+    mMultiplexed = true;
+}
+
+void RpcState::shutdownMultiplexWorkers() {
+    std::vector<std::thread> workers;
+    {
+        std::lock_guard<std::mutex> _l(mMultiplexMutex);
+        mMultiplexTerminated = true;
+        mMultiplexTodo.clear();
+        workers = std::move(mMultiplexWorkers);
+    }
+    mMultiplexCv.notify_all();
+
+    for (auto& worker : workers) worker.join();
+}
+
+std::unique_lock<std::mutex> RpcState::lockForSend() {
+    if (!isMultiplexed()) return std::unique_lock<std::mutex>();
+    return std::unique_lock<std::mutex>(mMultiplexWriteMutex);
+}
+
+// The maximum size for regular binder is 1MB for all concurrent
+// transactions. A very small proportion of transactions are even
+// larger than a page, but we need to avoid allocating too much
+// data on behalf of an arbitrary client, or we could risk being in
+// a position where a single additional allocation could run out of
+// memory.
+//
+// Note, this limit may not reflect the total amount of data allocated for a
+// transaction (in some cases, additional fixed size amounts are added),
+// though for rough consistency, we should avoid cases where this data type
+// is used for multiple dynamic allocations for a single transaction.
+constexpr size_t kMaxTransactionAllocation = 100 * 1000;
+
+// Almost every transaction needs one buffer on each side for the command
+// body, so a few of these are kept around on each thread rather than going
+// back to malloc each time. Each buffer is preceded by its capacity.
+struct alignas(std::max_align_t) CommandBufferHeader {
+    size_t capacity;
+};
+
+static constexpr size_t kMaxCachedCommandBuffers = 4;
+static constexpr size_t kCommandBufferCapacityGranularity = 512;
+// large commands are rare, so avoid holding onto them
+static constexpr size_t kMaxCachedCommandBufferCapacity = 16 * 1024;
+
+// Trivially destructible, so that it can still be used by commands which are
+// freed after thread_local destructors run (e.g. reply parcels).
+struct CommandBufferCache {
+    CommandBufferHeader* buffers[kMaxCachedCommandBuffers];
+    size_t numBuffers;
+    bool exited;
+};
+static thread_local CommandBufferCache gCommandBufferCache;
+
+struct CommandBufferCacheCleanup {
+    // the first use on each thread registers the destructor
+    void use() {}
+    ~CommandBufferCacheCleanup() {
+        CommandBufferCache& cache = gCommandBufferCache;
+        for (size_t i = 0; i < cache.numBuffers; i++) free(cache.buffers[i]);
+        cache.numBuffers = 0;
+        cache.exited = true;
+    }
+};
+static thread_local CommandBufferCacheCleanup gCommandBufferCacheCleanup;
+
+static uint8_t* takeCommandData(size_t size) {
+    CommandBufferCache& cache = gCommandBufferCache;
+    for (size_t i = 0; i < cache.numBuffers; i++) {
+        if (cache.buffers[i]->capacity >= size) {
+            CommandBufferHeader* header = cache.buffers[i];
+            cache.buffers[i] = cache.buffers[--cache.numBuffers];
+            return reinterpret_cast<uint8_t*>(header + 1);
+        }
+    }
+
+    // round up, so that buffers can be reused for commands of similar size
+    size_t capacity = (size + kCommandBufferCapacityGranularity - 1) &
+            ~(kCommandBufferCapacityGranularity - 1);
+    auto header =
+            static_cast<CommandBufferHeader*>(malloc(sizeof(CommandBufferHeader) + capacity));
+    if (header == nullptr) return nullptr;
+    header->capacity = capacity;
+    return reinterpret_cast<uint8_t*>(header + 1);
+}
+
+static void recycleCommandData(uint8_t* data) {
+    if (data == nullptr) return;
+    CommandBufferHeader* header = reinterpret_cast<CommandBufferHeader*>(data) - 1;
+
+    CommandBufferCache& cache = gCommandBufferCache;
+    if (!cache.exited && cache.numBuffers < kMaxCachedCommandBuffers &&
+        header->capacity <= kMaxCachedCommandBufferCapacity) {
+        gCommandBufferCacheCleanup.use();
+        cache.buffers[cache.numBuffers++] = header;
+    } else {
+        free(header);
     }
 }
 
 RpcState::CommandData::CommandData(size_t size) : mSize(size) {
-    // The maximum size for regular binder is 1MB for all concurrent
-    // transactions. A very small proportion of transactions are even
-    // larger than a page, but we need to avoid allocating too much
-    // data on behalf of an arbitrary client, or we could risk being in
-    // a position where a single additional allocation could run out of
-    // memory.
-    //
-    // Note, this limit may not reflect the total amount of data allocated for a
-    // transaction (in some cases, additional fixed size amounts are added),
-    // though for rough consistency, we should avoid cases where this data type
-    // is used for multiple dynamic allocations for a single transaction.
-    constexpr size_t kMaxTransactionAllocation = 100 * 1000;
     if (size == 0) return;
     if (size > kMaxTransactionAllocation) {
         ALOGW("Transaction requested too much data allocation %zu", size);
         return;
     }
-    mData.reset(new (std::nothrow) uint8_t[size]);
+    mData.reset(takeCommandData(size));
+}
+
+void RpcState::CommandData::Recycler::operator()(uint8_t* data) const {
+    recycleCommandData(data);
 }
 
-bool RpcState::rpcSend(const base::unique_fd& fd, const char* what, const void* data, size_t size) {
-    LOG_RPC_DETAIL("Sending %s on fd %d: %s", what, fd.get(), hexString(data, size).c_str());
+bool RpcState::rpcSend(const base::unique_fd& fd, const char* what, iovec* iovs, size_t niovs) {
+    size_t size = 0;
+    for (size_t i = 0; i < niovs; i++) {
+        LOG_RPC_DETAIL("Sending %s on fd %d: %s", what, fd.get(),
+                       hexString(iovs[i].iov_base, iovs[i].iov_len).c_str());
+        size += iovs[i].iov_len;
+    }
 
     if (size > std::numeric_limits<ssize_t>::max()) {
         ALOGE("Cannot send %s at size %zu (too big)", what, size);
@@ -212,14 +449,45 @@ bool RpcState::rpcSend(const base::unique_fd& fd, const char* what, const void*
         return false;
     }
 
-    ssize_t sent = TEMP_FAILURE_RETRY(send(fd.get(), data, size, MSG_NOSIGNAL));
+    if (std::shared_ptr<RpcSharedMemory> sharedMemory = sharedMemoryFor(fd);
+        sharedMemory != nullptr) {
+        if (!sharedMemory->send(fd, iovs, niovs)) {
+            ALOGE("Failed to send %s (%zu bytes) through shared memory for fd %d", what, size,
+                  fd.get());
+            terminate();
+            return false;
+        }
+        return true;
+    }
 
-    if (sent < 0 || sent != static_cast<ssize_t>(size)) {
-        ALOGE("Failed to send %s (sent %zd of %zu bytes) on fd %d, error: %s", what, sent, size,
-              fd.get(), strerror(errno));
+    size_t sentTotal = 0;
+    while (sentTotal < size) {
+        msghdr msg{
+                .msg_iov = iovs,
+                .msg_iovlen = niovs,
+        };
+        ssize_t sent = TEMP_FAILURE_RETRY(sendmsg(fd.get(), &msg, MSG_NOSIGNAL));
 
-        terminate();
-        return false;
+        if (sent <= 0) {
+            ALOGE("Failed to send %s (sent %zu of %zu bytes) on fd %d, error: %s", what,
+                  sentTotal, size, fd.get(), strerror(errno));
+
+            terminate();
+            return false;
+        }
+        sentTotal += sent;
+
+        // a partial send can stop anywhere, so skip whatever was written
+        size_t skip = sent;
+        while (niovs > 0 && skip >= iovs->iov_len) {
+            skip -= iovs->iov_len;
+            iovs++;
+            niovs--;
+        }
+        if (skip > 0) {
+            iovs->iov_base = static_cast<uint8_t*>(iovs->iov_base) + skip;
+            iovs->iov_len -= skip;
+        }
     }
 
     return true;
@@ -232,6 +500,18 @@ bool RpcState::rpcRec(const base::unique_fd& fd, const char* what, void* data, s
         return false;
     }
 
+    if (std::shared_ptr<RpcSharedMemory> sharedMemory = sharedMemoryFor(fd);
+        sharedMemory != nullptr) {
+        if (!sharedMemory->recv(fd, data, size)) {
+            // usually, the other side has just gone away
+            LOG_RPC_DETAIL("Failed to read %s through shared memory for fd %d", what, fd.get());
+            terminate();
+            return false;
+        }
+        LOG_RPC_DETAIL("Received %s on fd %d: %s", what, fd.get(), hexString(data, size).c_str());
+        return true;
+    }
+
     ssize_t recd = TEMP_FAILURE_RETRY(recv(fd.get(), data, size, MSG_WAITALL | MSG_NOSIGNAL));
 
     if (recd < 0 || recd != static_cast<ssize_t>(size)) {
@@ -317,16 +597,76 @@ status_t RpcState::transact(const base::unique_fd& fd, const RpcAddress& address
                             const Parcel& data, const sp<RpcSession>& session, Parcel* reply,
                             uint32_t flags) {
     uint64_t asyncNumber = 0;
+    uint32_t requestId = RPC_REQUEST_ID_NONE;
 
+    if (isMultiplexed()) {
+        std::lock_guard<std::mutex> _l(mMultiplexMutex);
+        if (mMultiplexTerminated) return DEAD_OBJECT;
+        if (++mNextRequestId == RPC_REQUEST_ID_NONE) ++mNextRequestId;
+        requestId = mNextRequestId;
+    }
+
+    if (status_t status = prepareTransaction(address, data, flags, &asyncNumber); status != OK) {
+        return status;
+    }
+
+    RpcWireTransaction transaction{
+            .address = address.viewRawEmbedded(),
+            .code = code,
+            .flags = flags,
+            .asyncNumber = asyncNumber,
+    };
+
+    size_t bodySize = sizeof(RpcWireTransaction) + data.dataSize();
+    if (bodySize > kMaxTransactionAllocation) {
+        // the other side could not allocate this
+        ALOGW("Transaction requested too much data allocation %zu", bodySize);
+        return NO_MEMORY;
+    }
+
+    RpcWireHeader command{
+            .command = RPC_COMMAND_TRANSACT,
+            .bodySize = static_cast<uint32_t>(bodySize),
+            .requestId = requestId,
+    };
+
+    iovec iovs[]{
+            {&command, sizeof(command)},
+            {&transaction, sizeof(transaction)},
+            {const_cast<uint8_t*>(data.data()), data.dataSize()},
+    };
+
+    {
+        auto _w = lockForSend();
+        if (!rpcSend(fd, "transaction", iovs, std::size(iovs))) {
+            return DEAD_OBJECT;
+        }
+    }
+
+    if (flags & IBinder::FLAG_ONEWAY) {
+        return OK; // do not wait for result
+    }
+
+    LOG_ALWAYS_FATAL_IF(reply == nullptr, "Reply parcel must be used for synchronous transaction.");
+
+    if (requestId != RPC_REQUEST_ID_NONE) {
+        return waitForMultiplexedReply(fd, session, requestId, reply);
+    }
+    return waitForReply(fd, session, reply);
+}
+
+status_t RpcState::prepareTransaction(const RpcAddress& address, const Parcel& data,
+                                      uint32_t flags, uint64_t* asyncNumber) {
     if (!address.isZero()) {
-        std::lock_guard<std::mutex> _l(mNodeMutex);
+        NodeShard& shard = shardFor(address);
+        std::lock_guard<std::mutex> _l(shard.mutex);
         if (mTerminated) return DEAD_OBJECT; // avoid fatal only, otherwise races
-        auto it = mNodeForAddress.find(address);
-        LOG_ALWAYS_FATAL_IF(it == mNodeForAddress.end(), "Sending transact on unknown address %s",
+        auto it = shard.nodes.find(address);
+        LOG_ALWAYS_FATAL_IF(it == shard.nodes.end(), "Sending transact on unknown address %s",
                             address.toString().c_str());
 
         if (flags & IBinder::FLAG_ONEWAY) {
-            asyncNumber = it->second.asyncNumber++;
+            *asyncNumber = it->second.asyncNumber++;
         }
     }
 
@@ -340,6 +680,41 @@ status_t RpcState::transact(const base::unique_fd& fd, const RpcAddress& address
         return BAD_TYPE;
     }
 
+    return OK;
+}
+
+status_t RpcState::batchOnewayTransaction(const RpcAddress& address, uint32_t code,
+                                          const Parcel& data, uint32_t flags, size_t maxBatchSize,
+                                          bool* batched, std::vector<uint8_t>* toSend) {
+    LOG_ALWAYS_FATAL_IF(!(flags & IBinder::FLAG_ONEWAY), "Only oneway transactions are batched");
+
+    maxBatchSize = std::min(maxBatchSize, kMaxTransactionAllocation);
+    size_t itemSize = sizeof(RpcWireHeader) + sizeof(RpcWireTransaction) + data.dataSize();
+
+    std::lock_guard<std::mutex> _l(mOnewayBatchMutex);
+
+    if (mOnewayBatch.size() + itemSize > maxBatchSize) {
+        *toSend = std::move(mOnewayBatch);
+        mOnewayBatch.clear();
+    }
+
+    if (itemSize > maxBatchSize) {
+        *batched = false;
+        return OK;
+    }
+
+    // the asyncNumber is assigned here, but transactions may still be sent out
+    // of order, e.g. if another thread is sending an older batch. The other
+    // side queues them up in the order of asyncNumber anyway.
+    uint64_t asyncNumber = 0;
+    if (status_t status = prepareTransaction(address, data, flags, &asyncNumber); status != OK) {
+        return status;
+    }
+
+    RpcWireHeader command{
+            .command = RPC_COMMAND_TRANSACT,
+            .bodySize = static_cast<uint32_t>(itemSize - sizeof(RpcWireHeader)),
+    };
     RpcWireTransaction transaction{
             .address = address.viewRawEmbedded(),
             .code = code,
@@ -347,44 +722,53 @@ status_t RpcState::transact(const base::unique_fd& fd, const RpcAddress& address
             .asyncNumber = asyncNumber,
     };
 
-    CommandData transactionData(sizeof(RpcWireTransaction) + data.dataSize());
-    if (!transactionData.valid()) {
-        return NO_MEMORY;
+    size_t offset = mOnewayBatch.size();
+    mOnewayBatch.resize(offset + itemSize);
+    memcpy(mOnewayBatch.data() + offset, &command, sizeof(command));
+    offset += sizeof(command);
+    memcpy(mOnewayBatch.data() + offset, &transaction, sizeof(transaction));
+    offset += sizeof(transaction);
+    memcpy(mOnewayBatch.data() + offset, data.data(), data.dataSize());
+
+    *batched = true;
+    if (mOnewayBatch.size() == maxBatchSize && toSend->empty()) {
+        *toSend = std::move(mOnewayBatch);
+        mOnewayBatch.clear();
     }
+    return OK;
+}
 
-    memcpy(transactionData.data() + 0, &transaction, sizeof(RpcWireTransaction));
-    memcpy(transactionData.data() + sizeof(RpcWireTransaction), data.data(), data.dataSize());
+std::vector<uint8_t> RpcState::takeOnewayBatch() {
+    std::lock_guard<std::mutex> _l(mOnewayBatchMutex);
+    std::vector<uint8_t> batch = std::move(mOnewayBatch);
+    mOnewayBatch.clear();
+    return batch;
+}
 
-    if (transactionData.size() > std::numeric_limits<uint32_t>::max()) {
-        ALOGE("Transaction size too big %zu", transactionData.size());
-        return BAD_VALUE;
-    }
+status_t RpcState::sendOnewayBatch(const base::unique_fd& fd, const std::vector<uint8_t>& batch) {
+    if (batch.empty()) return OK;
 
     RpcWireHeader command{
-            .command = RPC_COMMAND_TRANSACT,
-            .bodySize = static_cast<uint32_t>(transactionData.size()),
+            .command = RPC_COMMAND_TRANSACT_BATCH,
+            .bodySize = static_cast<uint32_t>(batch.size()),
     };
 
-    if (!rpcSend(fd, "transact header", &command, sizeof(command))) {
-        return DEAD_OBJECT;
-    }
-    if (!rpcSend(fd, "command body", transactionData.data(), transactionData.size())) {
-        return DEAD_OBJECT;
-    }
+    iovec iovs[]{
+            {&command, sizeof(command)},
+            {const_cast<uint8_t*>(batch.data()), batch.size()},
+    };
 
-    if (flags & IBinder::FLAG_ONEWAY) {
-        return OK; // do not wait for result
+    auto _w = lockForSend();
+    if (!rpcSend(fd, "transaction batch", iovs, std::size(iovs))) {
+        return DEAD_OBJECT;
     }
-
-    LOG_ALWAYS_FATAL_IF(reply == nullptr, "Reply parcel must be used for synchronous transaction.");
-
-    return waitForReply(fd, session, reply);
+    return OK;
 }
 
 static void cleanup_reply_data(Parcel* p, const uint8_t* data, size_t dataSize,
                                const binder_size_t* objects, size_t objectsCount) {
     (void)p;
-    delete[] const_cast<uint8_t*>(data - offsetof(RpcWireReply, data));
+    recycleCommandData(const_cast<uint8_t*>(data - offsetof(RpcWireReply, data)));
     (void)dataSize;
     LOG_ALWAYS_FATAL_IF(objects != nullptr);
     LOG_ALWAYS_FATAL_IF(objectsCount, 0);
@@ -413,18 +797,147 @@ status_t RpcState::waitForReply(const base::unique_fd& fd, const sp<RpcSession>&
         return DEAD_OBJECT;
     }
 
-    if (command.bodySize < sizeof(RpcWireReply)) {
-        ALOGE("Expecting %zu but got %" PRId32 " bytes for RpcWireReply. Terminating!",
-              sizeof(RpcWireReply), command.bodySize);
+    return processReply(session, std::move(data), reply);
+}
+
+status_t RpcState::waitForMultiplexedReply(const base::unique_fd& fd,
+                                           const sp<RpcSession>& session, uint32_t requestId,
+                                           Parcel* reply) {
+    // On the server, the thread joined to the session is always reading, and
+    // it hands the replies to nested calls over to the workers waiting here.
+    const bool hasDedicatedReader = session->server().unsafe_get() != nullptr;
+
+    std::unique_lock<std::mutex> _l(mMultiplexMutex);
+    while (true) {
+        if (auto it = mMultiplexReplies.find(requestId); it != mMultiplexReplies.end()) {
+            CommandData data = std::move(it->second);
+            mMultiplexReplies.erase(it);
+            _l.unlock();
+            return processReply(session, std::move(data), reply);
+        }
+
+        if (mMultiplexTerminated) return DEAD_OBJECT;
+
+        if (hasDedicatedReader || mMultiplexReaderActive) {
+            // another thread is reading, and it will wake us up when it
+            // stashes our reply or when it stops reading
+            mMultiplexCv.wait(_l);
+            continue;
+        }
+
+        // become the reader until our own reply arrives
+        mMultiplexReaderActive = true;
+        _l.unlock();
+
+        status_t status = OK;
+        std::optional<CommandData> replyData;
+        std::optional<CommandData> transactionData;
+        RpcWireHeader command;
+        if (!rpcRec(fd, "command header", &command, sizeof(command))) {
+            status = DEAD_OBJECT;
+        } else if (command.command == RPC_COMMAND_REPLY) {
+            replyData.emplace(command.bodySize);
+            if (!replyData->valid()) {
+                // the rest of this command can't be skipped, and the
+                // connection is shared, so it can't be recovered
+                terminate();
+                status = NO_MEMORY;
+            } else if (!rpcRec(fd, "reply body", replyData->data(), command.bodySize)) {
+                status = DEAD_OBJECT;
+            }
+        } else if (command.command == RPC_COMMAND_TRANSACT &&
+                   command.requestId != RPC_REQUEST_ID_NONE) {
+            // A nested call from the server. It is executed below, once
+            // another thread can take over reading, so that it may make
+            // calls of its own.
+            transactionData.emplace(command.bodySize);
+            if (!transactionData->valid()) {
+                terminate();
+                status = NO_MEMORY;
+            } else if (!rpcRec(fd, "transaction body", transactionData->data(),
+                               command.bodySize)) {
+                status = DEAD_OBJECT;
+            }
+        } else {
+            status = processServerCommand(fd, session, command);
+        }
+
+        _l.lock();
+        mMultiplexReaderActive = false;
+        // wake a waiting thread to take over reading, or to take its reply
+        mMultiplexCv.notify_all();
+
+        if (status == OK && transactionData) {
+            _l.unlock();
+            status = processTransactInternal(fd, session, std::move(*transactionData),
+                                             command.requestId);
+            _l.lock();
+        }
+
+        if (status != OK) {
+            abandonMultiplexedReplyLocked(requestId);
+            return status;
+        }
+
+        if (replyData) {
+            if (command.requestId == requestId) {
+                _l.unlock();
+                return processReply(session, std::move(*replyData), reply);
+            }
+            stashMultiplexedReplyLocked(command.requestId, std::move(*replyData));
+        }
+    }
+}
+
+status_t RpcState::processMultiplexedReply(const base::unique_fd& fd,
+                                           const RpcWireHeader& command) {
+    LOG_ALWAYS_FATAL_IF(command.command != RPC_COMMAND_REPLY, "command: %d", command.command);
+
+    CommandData replyData(command.bodySize);
+    if (!replyData.valid()) {
+        terminate();
+        return NO_MEMORY;
+    }
+    if (!rpcRec(fd, "reply body", replyData.data(), replyData.size())) {
+        return DEAD_OBJECT;
+    }
+
+    {
+        std::lock_guard<std::mutex> _l(mMultiplexMutex);
+        stashMultiplexedReplyLocked(command.requestId, std::move(replyData));
+    }
+    mMultiplexCv.notify_all();
+    return OK;
+}
+
+void RpcState::stashMultiplexedReplyLocked(uint32_t requestId, CommandData data) {
+    if (mMultiplexAbandonedRequests.erase(requestId) != 0) {
+        LOG_RPC_DETAIL("Dropping reply to abandoned request %" PRIu32, requestId);
+        return;
+    }
+    mMultiplexReplies.emplace(requestId, std::move(data));
+}
+
+void RpcState::abandonMultiplexedReplyLocked(uint32_t requestId) {
+    if (mMultiplexTerminated) return; // everything is dropped already
+    if (mMultiplexReplies.erase(requestId) == 0) {
+        mMultiplexAbandonedRequests.insert(requestId);
+    }
+}
+
+status_t RpcState::processReply(const sp<RpcSession>& session, CommandData data, Parcel* reply) {
+    if (data.size() < sizeof(RpcWireReply)) {
+        ALOGE("Expecting %zu but got %zu bytes for RpcWireReply. Terminating!",
+              sizeof(RpcWireReply), data.size());
         terminate();
         return BAD_VALUE;
     }
     RpcWireReply* rpcReply = reinterpret_cast<RpcWireReply*>(data.data());
     if (rpcReply->status != OK) return rpcReply->status;
 
+    size_t dataSize = data.size() - offsetof(RpcWireReply, data);
     data.release();
-    reply->ipcSetDataReference(rpcReply->data, command.bodySize - offsetof(RpcWireReply, data),
-                               nullptr, 0, cleanup_reply_data);
+    reply->ipcSetDataReference(rpcReply->data, dataSize, nullptr, 0, cleanup_reply_data);
 
     reply->markForRpc(session);
 
@@ -432,28 +945,34 @@ status_t RpcState::waitForReply(const base::unique_fd& fd, const sp<RpcSession>&
 }
 
 status_t RpcState::sendDecStrong(const base::unique_fd& fd, const RpcAddress& addr) {
+    std::optional<LocalBinderEntry> dropped;
     {
-        std::lock_guard<std::mutex> _l(mNodeMutex);
+        NodeShard& shard = shardFor(addr);
+        std::lock_guard<std::mutex> _l(shard.mutex);
         if (mTerminated) return DEAD_OBJECT; // avoid fatal only, otherwise races
-        auto it = mNodeForAddress.find(addr);
-        LOG_ALWAYS_FATAL_IF(it == mNodeForAddress.end(), "Sending dec strong on unknown address %s",
+        auto it = shard.nodes.find(addr);
+        LOG_ALWAYS_FATAL_IF(it == shard.nodes.end(), "Sending dec strong on unknown address %s",
                             addr.toString().c_str());
         LOG_ALWAYS_FATAL_IF(it->second.timesRecd <= 0, "Bad dec strong %s",
                             addr.toString().c_str());
 
         it->second.timesRecd--;
         if (it->second.timesRecd == 0 && it->second.timesSent == 0) {
-            mNodeForAddress.erase(it);
+            eraseNodeLocked(shard, it, &dropped);
         }
     }
+    forgetLocalBinder(dropped);
 
     RpcWireHeader cmd = {
             .command = RPC_COMMAND_DEC_STRONG,
             .bodySize = sizeof(RpcWireAddress),
     };
-    if (!rpcSend(fd, "dec ref header", &cmd, sizeof(cmd))) return DEAD_OBJECT;
-    if (!rpcSend(fd, "dec ref body", &addr.viewRawEmbedded(), sizeof(RpcWireAddress)))
-        return DEAD_OBJECT;
+    iovec iovs[]{
+            {&cmd, sizeof(cmd)},
+            {const_cast<RpcWireAddress*>(&addr.viewRawEmbedded()), sizeof(RpcWireAddress)},
+    };
+    auto _w = lockForSend();
+    if (!rpcSend(fd, "dec ref", iovs, std::size(iovs))) return DEAD_OBJECT;
     return OK;
 }
 
@@ -473,8 +992,17 @@ status_t RpcState::processServerCommand(const base::unique_fd& fd, const sp<RpcS
     switch (command.command) {
         case RPC_COMMAND_TRANSACT:
             return processTransact(fd, session, command);
+        case RPC_COMMAND_TRANSACT_BATCH:
+            return processTransactBatch(fd, session, command);
         case RPC_COMMAND_DEC_STRONG:
             return processDecStrong(fd, command);
+        case RPC_COMMAND_REPLY:
+            // only the server reads replies here, for nested calls made by
+            // the workers of a multiplexed session
+            if (isMultiplexed() && command.requestId != RPC_REQUEST_ID_NONE) {
+                return processMultiplexedReply(fd, command);
+            }
+            break;
     }
 
     // We should always know the version of the opposing side, and since the
@@ -498,7 +1026,123 @@ status_t RpcState::processTransact(const base::unique_fd& fd, const sp<RpcSessio
         return DEAD_OBJECT;
     }
 
-    return processTransactInternal(fd, session, std::move(transactionData));
+    if (command.requestId != RPC_REQUEST_ID_NONE) {
+        return enqueueMultiplexedTransact(fd, session, std::move(transactionData),
+                                          command.requestId);
+    }
+
+    return processTransactInternal(fd, session, std::move(transactionData), RPC_REQUEST_ID_NONE);
+}
+
+status_t RpcState::processTransactBatch(const base::unique_fd& fd, const sp<RpcSession>& session,
+                                        const RpcWireHeader& command) {
+    LOG_ALWAYS_FATAL_IF(command.command != RPC_COMMAND_TRANSACT_BATCH, "command: %d",
+                        command.command);
+
+    CommandData batchData(command.bodySize);
+    if (!batchData.valid()) {
+        return NO_MEMORY;
+    }
+    if (!rpcRec(fd, "transaction batch", batchData.data(), batchData.size())) {
+        return DEAD_OBJECT;
+    }
+
+    size_t offset = 0;
+    while (offset < batchData.size()) {
+        if (batchData.size() - offset < sizeof(RpcWireHeader)) {
+            ALOGE("Truncated header in transaction batch. Terminating!");
+            terminate();
+            return BAD_VALUE;
+        }
+        RpcWireHeader header;
+        memcpy(&header, batchData.data() + offset, sizeof(header));
+        offset += sizeof(header);
+
+        if (header.command != RPC_COMMAND_TRANSACT || header.bodySize > batchData.size() - offset ||
+            header.bodySize < sizeof(RpcWireTransaction)) {
+            ALOGE("Invalid command %" PRIu32 " of size %" PRIu32
+                  " in transaction batch. Terminating!",
+                  header.command, header.bodySize);
+            terminate();
+            return BAD_VALUE;
+        }
+
+        // Each transaction needs its own data, since it may be queued up
+        // until the transactions before it on the same binder are done.
+        CommandData transactionData(header.bodySize);
+        if (!transactionData.valid()) {
+            return NO_MEMORY;
+        }
+        memcpy(transactionData.data(), batchData.data() + offset, header.bodySize);
+        offset += header.bodySize;
+
+        if (!(reinterpret_cast<RpcWireTransaction*>(transactionData.data())->flags &
+              IBinder::FLAG_ONEWAY)) {
+            ALOGE("Synchronous transaction in transaction batch. Terminating!");
+            terminate();
+            return BAD_VALUE;
+        }
+
+        status_t status = processTransactInternal(fd, session, std::move(transactionData),
+                                                  RPC_REQUEST_ID_NONE);
+        if (status != OK) return status;
+    }
+
+    return OK;
+}
+
+status_t RpcState::enqueueMultiplexedTransact(const base::unique_fd& fd,
+                                              const sp<RpcSession>& session,
+                                              CommandData transactionData, uint32_t requestId) {
+    enableMultiplexing();
+
+    std::lock_guard<std::mutex> _l(mMultiplexMutex);
+    if (mMultiplexTerminated) return DEAD_OBJECT;
+
+    mMultiplexTodo.push_back(MultiplexTodo{
+            .data = std::move(transactionData),
+            .requestId = requestId,
+    });
+
+    if (mMultiplexIdleWorkers < mMultiplexTodo.size()) {
+        size_t maxWorkers = 1;
+        if (sp<RpcServer> server = session->server().promote(); server != nullptr) {
+            maxWorkers = server->getMaxThreads();
+        }
+        if (mMultiplexWorkers.size() < maxWorkers) {
+            // counted as idle until it takes its first transaction
+            mMultiplexIdleWorkers++;
+            mMultiplexWorkers.push_back(
+                    std::thread(&RpcState::multiplexWorkerLoop, this, std::cref(fd), session));
+        }
+    }
+
+    mMultiplexCv.notify_one();
+    return OK;
+}
+
+void RpcState::multiplexWorkerLoop(const base::unique_fd& fd, sp<RpcSession> session) {
+    std::unique_lock<std::mutex> _l(mMultiplexMutex);
+    while (true) {
+        mMultiplexCv.wait(_l, [&] { return mMultiplexTerminated || !mMultiplexTodo.empty(); });
+        if (mMultiplexTerminated) break;
+
+        MultiplexTodo todo = std::move(mMultiplexTodo.front());
+        mMultiplexTodo.pop_front();
+        mMultiplexIdleWorkers--;
+        _l.unlock();
+
+        status_t status =
+                processTransactInternal(fd, session, std::move(todo.data), todo.requestId);
+        if (status != OK) {
+            LOG_RPC_DETAIL("Multiplexed transaction %" PRIu32 " failed: %s", todo.requestId,
+                           statusToString(status).c_str());
+        }
+
+        _l.lock();
+        mMultiplexIdleWorkers++;
+    }
+    mMultiplexIdleWorkers--;
 }
 
 static void do_nothing_to_transact_data(Parcel* p, const uint8_t* data, size_t dataSize,
@@ -511,7 +1155,7 @@ static void do_nothing_to_transact_data(Parcel* p, const uint8_t* data, size_t d
 }
 
 status_t RpcState::processTransactInternal(const base::unique_fd& fd, const sp<RpcSession>& session,
-                                           CommandData transactionData) {
+                                           CommandData transactionData, uint32_t requestId) {
     if (transactionData.size() < sizeof(RpcWireTransaction)) {
         ALOGE("Expecting %zu but got %zu bytes for RpcWireTransaction. Terminating!",
               sizeof(RpcWireTransaction), transactionData.size());
@@ -520,17 +1164,18 @@ status_t RpcState::processTransactInternal(const base::unique_fd& fd, const sp<R
     }
     RpcWireTransaction* transaction = reinterpret_cast<RpcWireTransaction*>(transactionData.data());
 
-    // TODO(b/182939933): heap allocation just for lookup in mNodeForAddress,
+    // TODO(b/182939933): heap allocation just for lookup in the node table,
     // maybe add an RpcAddress 'view' if the type remains 'heavy'
     auto addr = RpcAddress::fromRawEmbedded(&transaction->address);
 
     status_t replyStatus = OK;
     sp<IBinder> target;
     if (!addr.isZero()) {
-        std::lock_guard<std::mutex> _l(mNodeMutex);
+        NodeShard& shard = shardFor(addr);
+        std::unique_lock<std::mutex> _l(shard.mutex);
 
-        auto it = mNodeForAddress.find(addr);
-        if (it == mNodeForAddress.end()) {
+        auto it = shard.nodes.find(addr);
+        if (it == shard.nodes.end()) {
             ALOGE("Unknown binder address %s.", addr.toString().c_str());
             replyStatus = BAD_VALUE;
         } else {
@@ -544,11 +1189,13 @@ status_t RpcState::processTransactInternal(const base::unique_fd& fd, const sp<R
                 // session.
                 ALOGE("While transacting, binder has been deleted at address %s. Terminating!",
                       addr.toString().c_str());
+                _l.unlock();
                 terminate();
                 replyStatus = BAD_VALUE;
             } else if (target->localBinder() == nullptr) {
                 ALOGE("Transactions can only go to local binders, not address %s. Terminating!",
                       addr.toString().c_str());
+                _l.unlock();
                 terminate();
                 replyStatus = BAD_VALUE;
             } else if (transaction->flags & IBinder::FLAG_ONEWAY) {
@@ -640,10 +1287,11 @@ status_t RpcState::processTransactInternal(const base::unique_fd& fd, const sp<R
         // downside: asynchronous transactions may drown out synchronous
         // transactions.
         {
-            std::unique_lock<std::mutex> _l(mNodeMutex);
-            auto it = mNodeForAddress.find(addr);
+            NodeShard& shard = shardFor(addr);
+            std::unique_lock<std::mutex> _l(shard.mutex);
+            auto it = shard.nodes.find(addr);
             // last refcount dropped after this transaction happened
-            if (it == mNodeForAddress.end()) return OK;
+            if (it == shard.nodes.end()) return OK;
 
             // note - only updated now, instead of later, so that other threads
             // will queue any later transactions
@@ -665,7 +1313,8 @@ status_t RpcState::processTransactInternal(const base::unique_fd& fd, const sp<R
                         const_cast<BinderNode::AsyncTodo&>(it->second.asyncTodo.top()).data);
                 it->second.asyncTodo.pop();
                 _l.unlock();
-                return processTransactInternal(fd, session, std::move(data));
+                return processTransactInternal(fd, session, std::move(data),
+                                               RPC_REQUEST_ID_NONE);
             }
         }
         return OK;
@@ -675,28 +1324,27 @@ status_t RpcState::processTransactInternal(const base::unique_fd& fd, const sp<R
             .status = replyStatus,
     };
 
-    CommandData replyData(sizeof(RpcWireReply) + reply.dataSize());
-    if (!replyData.valid()) {
+    size_t replySize = sizeof(RpcWireReply) + reply.dataSize();
+    if (replySize > kMaxTransactionAllocation) {
+        // the other side could not allocate this
+        ALOGW("Reply requested too much data allocation %zu", replySize);
         return NO_MEMORY;
     }
-    memcpy(replyData.data() + 0, &rpcReply, sizeof(RpcWireReply));
-    memcpy(replyData.data() + sizeof(RpcWireReply), reply.data(), reply.dataSize());
-
-    if (replyData.size() > std::numeric_limits<uint32_t>::max()) {
-        ALOGE("Reply size too big %zu", transactionData.size());
-        terminate();
-        return BAD_VALUE;
-    }
 
     RpcWireHeader cmdReply{
             .command = RPC_COMMAND_REPLY,
-            .bodySize = static_cast<uint32_t>(replyData.size()),
+            .bodySize = static_cast<uint32_t>(replySize),
+            .requestId = requestId,
     };
 
-    if (!rpcSend(fd, "reply header", &cmdReply, sizeof(RpcWireHeader))) {
-        return DEAD_OBJECT;
-    }
-    if (!rpcSend(fd, "reply body", replyData.data(), replyData.size())) {
+    iovec iovs[]{
+            {&cmdReply, sizeof(cmdReply)},
+            {&rpcReply, sizeof(rpcReply)},
+            {const_cast<uint8_t*>(reply.data()), reply.dataSize()},
+    };
+
+    auto _w = lockForSend();
+    if (!rpcSend(fd, "reply", iovs, std::size(iovs))) {
         return DEAD_OBJECT;
     }
     return OK;
@@ -723,9 +1371,10 @@ status_t RpcState::processDecStrong(const base::unique_fd& fd, const RpcWireHead
 
     // TODO(b/182939933): heap allocation just for lookup
     auto addr = RpcAddress::fromRawEmbedded(address);
-    std::unique_lock<std::mutex> _l(mNodeMutex);
-    auto it = mNodeForAddress.find(addr);
-    if (it == mNodeForAddress.end()) {
+    NodeShard& shard = shardFor(addr);
+    std::unique_lock<std::mutex> _l(shard.mutex);
+    auto it = shard.nodes.find(addr);
+    if (it == shard.nodes.end()) {
         ALOGE("Unknown binder address %s for dec strong.", addr.toString().c_str());
         return OK;
     }
@@ -734,6 +1383,7 @@ status_t RpcState::processDecStrong(const base::unique_fd& fd, const RpcWireHead
     if (target == nullptr) {
         ALOGE("While requesting dec strong, binder has been deleted at address %s. Terminating!",
               addr.toString().c_str());
+        _l.unlock();
         terminate();
         return BAD_VALUE;
     }
@@ -747,6 +1397,7 @@ status_t RpcState::processDecStrong(const base::unique_fd& fd, const RpcWireHead
                         addr.toString().c_str());
 
     sp<IBinder> tempHold;
+    std::optional<LocalBinderEntry> dropped;
 
     it->second.timesSent--;
     if (it->second.timesSent == 0) {
@@ -754,11 +1405,12 @@ status_t RpcState::processDecStrong(const base::unique_fd& fd, const RpcWireHead
         it->second.sentRef = nullptr;
 
         if (it->second.timesRecd == 0) {
-            mNodeForAddress.erase(it);
+            eraseNodeLocked(shard, it, &dropped);
         }
     }
 
     _l.unlock();
+    forgetLocalBinder(dropped);
     tempHold = nullptr; // destructor may make binder calls on this session
 
     return OK;
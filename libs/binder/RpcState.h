@@ -19,13 +19,24 @@
 #include <binder/IBinder.h>
 #include <binder/Parcel.h>
 #include <binder/RpcSession.h>
+#include <sys/uio.h>
 
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <map>
+#include <memory>
 #include <optional>
 #include <queue>
+#include <set>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 namespace android {
 
+class RpcSharedMemory;
 struct RpcWireHeader;
 
 /**
@@ -62,6 +73,23 @@ public:
                                     uint32_t code, const Parcel& data,
                                     const sp<RpcSession>& session, Parcel* reply, uint32_t flags);
     [[nodiscard]] status_t sendDecStrong(const base::unique_fd& fd, const RpcAddress& address);
+
+    /**
+     * Instead of sending a oneway transaction, add it to a batch to be sent
+     * later with sendOnewayBatch. If the transaction is bigger than
+     * maxBatchSize, it isn't batched, and it should be sent directly.
+     *
+     * If a batch is ready to be sent (it is full, or the transaction does
+     * not fit in it), it is moved to toSend. This should be sent before this
+     * transaction if it is not batched.
+     */
+    [[nodiscard]] status_t batchOnewayTransaction(const RpcAddress& address, uint32_t code,
+                                                  const Parcel& data, uint32_t flags,
+                                                  size_t maxBatchSize, bool* batched,
+                                                  std::vector<uint8_t>* toSend);
+    std::vector<uint8_t> takeOnewayBatch();
+    [[nodiscard]] status_t sendOnewayBatch(const base::unique_fd& fd,
+                                           const std::vector<uint8_t>& batch);
     [[nodiscard]] status_t getAndExecuteCommand(const base::unique_fd& fd,
                                                 const sp<RpcSession>& session);
 
@@ -79,6 +107,37 @@ public:
      */
     sp<IBinder> onBinderEntering(const sp<RpcSession>& session, const RpcAddress& address);
 
+    /**
+     * Multiplexed sessions share a single connection between any number of
+     * concurrent callers. Each transaction carries a request ID, and the reply
+     * is routed back to the thread waiting on that ID. On the client, this is
+     * enabled by RpcSession once the connection is set up. On the server, it is
+     * enabled when the first multiplexed transaction is received, and those
+     * transactions are executed on up to RpcServer::getMaxThreads() workers.
+     */
+    void enableMultiplexing();
+    bool isMultiplexed() const { return mMultiplexed; }
+
+    /**
+     * Must be called by the thread reading commands from a multiplexed server
+     * connection, after it stops reading. Waits for all workers to finish.
+     */
+    void shutdownMultiplexWorkers();
+
+    /**
+     * Commands for a connection set up with shared memory (see
+     * RpcSession::setSharedMemoryTransport) go through it instead of through
+     * the connection's fd. This must be added before the fd is used, and
+     * removed before it is closed.
+     */
+    void addSharedMemory(const base::unique_fd& fd, std::shared_ptr<RpcSharedMemory> sharedMemory);
+    void removeSharedMemory(const base::unique_fd& fd);
+    /**
+     * Shuts down shared memory for all connections, so that the other side
+     * finds out right away instead of waiting to notice the socket closing.
+     */
+    void shutdownSharedMemory();
+
     size_t countBinders();
     void dump();
 
@@ -102,36 +161,73 @@ private:
     void terminate();
 
     // Alternative to std::vector<uint8_t> that doesn't abort on allocation failure and caps
-    // large allocations to avoid being requested from allocating too much data.
+    // large allocations to avoid being requested from allocating too much data. The memory
+    // is recycled for later commands on the thread which frees it.
     struct CommandData {
         explicit CommandData(size_t size);
+        CommandData(CommandData&&) = default;
+        CommandData& operator=(CommandData&&) = default;
         bool valid() { return mSize == 0 || mData != nullptr; }
         size_t size() { return mSize; }
         uint8_t* data() { return mData.get(); }
+        // must be given back to recycleCommandData
         uint8_t* release() { return mData.release(); }
 
     private:
-        std::unique_ptr<uint8_t[]> mData;
+        struct Recycler {
+            void operator()(uint8_t* data) const;
+        };
+        std::unique_ptr<uint8_t, Recycler> mData;
         size_t mSize;
     };
 
-    [[nodiscard]] bool rpcSend(const base::unique_fd& fd, const char* what, const void* data,
-                               size_t size);
+    // Sends all of the buffers, in order, without copying them together first.
+    [[nodiscard]] bool rpcSend(const base::unique_fd& fd, const char* what, iovec* iovs,
+                               size_t niovs);
     [[nodiscard]] bool rpcRec(const base::unique_fd& fd, const char* what, void* data, size_t size);
+    std::shared_ptr<RpcSharedMemory> sharedMemoryFor(const base::unique_fd& fd);
 
     [[nodiscard]] status_t waitForReply(const base::unique_fd& fd, const sp<RpcSession>& session,
                                         Parcel* reply);
+    [[nodiscard]] status_t waitForMultiplexedReply(const base::unique_fd& fd,
+                                                   const sp<RpcSession>& session,
+                                                   uint32_t requestId, Parcel* reply);
+    [[nodiscard]] status_t processReply(const sp<RpcSession>& session, CommandData data,
+                                        Parcel* reply);
     [[nodiscard]] status_t processServerCommand(const base::unique_fd& fd,
                                                 const sp<RpcSession>& session,
                                                 const RpcWireHeader& command);
     [[nodiscard]] status_t processTransact(const base::unique_fd& fd, const sp<RpcSession>& session,
                                            const RpcWireHeader& command);
+    [[nodiscard]] status_t processTransactBatch(const base::unique_fd& fd,
+                                                const sp<RpcSession>& session,
+                                                const RpcWireHeader& command);
     [[nodiscard]] status_t processTransactInternal(const base::unique_fd& fd,
                                                    const sp<RpcSession>& session,
-                                                   CommandData transactionData);
+                                                   CommandData transactionData,
+                                                   uint32_t requestId);
+    [[nodiscard]] status_t enqueueMultiplexedTransact(const base::unique_fd& fd,
+                                                      const sp<RpcSession>& session,
+                                                      CommandData transactionData,
+                                                      uint32_t requestId);
+    void multiplexWorkerLoop(const base::unique_fd& fd, sp<RpcSession> session);
+    [[nodiscard]] status_t processMultiplexedReply(const base::unique_fd& fd,
+                                                   const RpcWireHeader& command);
+    // Keeps a reply for the thread waiting on it, unless that thread gave up.
+    void stashMultiplexedReplyLocked(uint32_t requestId, CommandData data);
+    // Called when a thread stops waiting for its reply before it arrives.
+    void abandonMultiplexedReplyLocked(uint32_t requestId);
+
+    // Locks mMultiplexWriteMutex if this is a multiplexed session, so that
+    // a header and its body are never interleaved with another command.
+    std::unique_lock<std::mutex> lockForSend();
     [[nodiscard]] status_t processDecStrong(const base::unique_fd& fd,
                                             const RpcWireHeader& command);
 
+    // checks common to all outgoing transactions, and assigns asyncNumber
+    [[nodiscard]] status_t prepareTransaction(const RpcAddress& address, const Parcel& data,
+                                              uint32_t flags, uint64_t* asyncNumber);
+
     struct BinderNode {
         // Two cases:
         // A - local binder we are serving
@@ -179,10 +275,85 @@ private:
         // (no additional data specific to remote binders)
     };
 
-    std::mutex mNodeMutex;
-    bool mTerminated = false;
-    // binders known by both sides of a session
-    std::map<RpcAddress, BinderNode> mNodeForAddress;
+    struct AddressHash {
+        size_t operator()(const RpcAddress& address) const;
+    };
+    struct AddressEqual {
+        bool operator()(const RpcAddress& lhs, const RpcAddress& rhs) const;
+    };
+    using NodeMap = std::unordered_map<RpcAddress, BinderNode, AddressHash, AddressEqual>;
+
+    // Binders known by both sides of a session, split up by address so that
+    // transactions on different binders rarely contend on the same lock.
+    struct NodeShard {
+        std::mutex mutex;
+        NodeMap nodes;
+    };
+
+    // Addresses of local binders we have sent, split up by binder, so that a
+    // binder which is sent again gets the same address. This is only a cache
+    // of the nodes in NodeShard. If both are needed, this lock is taken first.
+    struct LocalBinderShard {
+        std::mutex mutex;
+        std::unordered_map<const IBinder*, RpcAddress> addresses;
+    };
+
+    struct LocalBinderEntry {
+        const IBinder* binder;
+        RpcAddress address;
+    };
+
+    NodeShard& shardFor(const RpcAddress& address);
+    LocalBinderShard& localShardFor(const IBinder* binder);
+    // Since the locks can't be taken in order here, the entry for the dropped
+    // node must be cleaned up with forgetLocalBinder after shard.mutex is
+    // released.
+    void eraseNodeLocked(NodeShard& shard, NodeMap::iterator it,
+                         std::optional<LocalBinderEntry>* dropped);
+    void forgetLocalBinder(const std::optional<LocalBinderEntry>& dropped);
+
+    static constexpr size_t kNumShards = 16;
+    std::array<NodeShard, kNumShards> mNodeShards;
+    std::array<LocalBinderShard, kNumShards> mLocalBinderShards;
+    std::atomic<bool> mTerminated = false;
+
+    std::mutex mOnewayBatchMutex;
+    // oneway transactions which haven't been sent yet, in the format of the
+    // body of RPC_COMMAND_TRANSACT_BATCH
+    std::vector<uint8_t> mOnewayBatch;
+
+    // only so that sessions without shared memory don't take the lock
+    std::atomic<bool> mHasSharedMemory = false;
+    std::mutex mSharedMemoryMutex; // for below
+    std::unordered_map<int, std::shared_ptr<RpcSharedMemory>> mSharedMemory; // by fd
+
+    std::atomic<bool> mMultiplexed = false;
+
+    // held while writing a command to a multiplexed connection
+    std::mutex mMultiplexWriteMutex;
+
+    std::mutex mMultiplexMutex; // for below
+    std::condition_variable mMultiplexCv;
+    bool mMultiplexTerminated = false;
+
+    // Replies are stashed here for the threads waiting on them. On the client,
+    // a waiting thread becomes the reader of the connection until its own
+    // reply arrives. On the server, the thread joined to the session reads
+    // the replies to nested calls made by the workers.
+    uint32_t mNextRequestId = 0;
+    bool mMultiplexReaderActive = false;
+    std::map<uint32_t, CommandData> mMultiplexReplies;
+    // requests whose waiting thread returned an error before the reply came
+    std::set<uint32_t> mMultiplexAbandonedRequests;
+
+    // SERVER - transactions read from the connection, waiting for a worker
+    struct MultiplexTodo {
+        CommandData data;
+        uint32_t requestId;
+    };
+    std::deque<MultiplexTodo> mMultiplexTodo;
+    size_t mMultiplexIdleWorkers = 0;
+    std::vector<std::thread> mMultiplexWorkers;
 };
 
 } // namespace android
@@ -37,6 +37,13 @@ enum : uint32_t {
      * want to create a 'Parcel' object for every decref)
      */
     RPC_COMMAND_DEC_STRONG,
+    /**
+     * follows is a series of |RpcWireHeader|RpcWireTransaction|, each of which
+     * is an RPC_COMMAND_TRANSACT for a oneway transaction (see
+     * RpcSession::setOnewayBatching). These are processed in order, as if
+     * they were sent separately.
+     */
+    RPC_COMMAND_TRANSACT_BATCH,
 };
 
 /**
@@ -51,7 +58,43 @@ enum : uint32_t {
     RPC_SPECIAL_TRANSACT_GET_SESSION_ID = 2,
 };
 
+/**
+ * Each connection starts with the client sending an int32_t session ID, or
+ * RPC_SESSION_ID_NEW. A client that wants any RPC_CONNECTION_OPTION_* sends
+ * RPC_SESSION_ID_CONNECTION_HEADER in its place, followed by an
+ * RpcConnectionHeader. A server which doesn't understand this treats it as an
+ * unknown session and closes the connection, so the client can connect again
+ * without options.
+ */
 constexpr int32_t RPC_SESSION_ID_NEW = -1;
+constexpr int32_t RPC_SESSION_ID_CONNECTION_HEADER = -2;
+
+enum : uint32_t {
+    /**
+     * The client sends the RpcSharedMemory::Fds along with the
+     * RpcConnectionHeader, and wants to use them instead of the socket (see
+     * RpcSession::setSharedMemoryTransport).
+     */
+    RPC_CONNECTION_OPTION_SHARED_MEMORY = 0x1,
+};
+
+/**
+ * Sent by the client after RPC_SESSION_ID_CONNECTION_HEADER.
+ */
+struct RpcConnectionHeader {
+    int32_t sessionId; // or RPC_SESSION_ID_NEW
+    uint32_t options;  // RPC_CONNECTION_OPTION_*
+};
+
+/**
+ * Sent by the server in response to an RpcConnectionHeader which asks for any
+ * options, with the subset of those options which the server accepts.
+ */
+struct RpcConnectionResponse {
+    uint32_t options;
+};
+
+constexpr uint32_t RPC_REQUEST_ID_NONE = 0;
 
 // serialization is like:
 // |RpcWireHeader|struct desginated by 'command'| (over and over again)
@@ -60,7 +103,16 @@ struct RpcWireHeader {
     uint32_t command; // RPC_COMMAND_*
     uint32_t bodySize;
 
-    uint32_t reserved[2];
+    /**
+     * Zero, unless this command is part of a multiplexed session (see
+     * RpcSession::setMultiplexed). Then, RPC_COMMAND_TRANSACT carries an ID
+     * chosen by the side sending it, and the RPC_COMMAND_REPLY for it
+     * carries the same ID, so that many transactions may be in flight on a
+     * single connection at once.
+     */
+    uint32_t requestId;
+
+    uint32_t reserved[1];
 };
 
 struct RpcWireAddress {
@@ -18,10 +18,91 @@
 
 #include <string.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
 namespace android {
 
 void zeroMemory(uint8_t* data, size_t size) {
     memset(data, 0, size);
 }
 
+size_t asciiPrefixLength(const char* str, size_t len) {
+    size_t i = 0;
+#if defined(__SSE2__)
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(str + i));
+        int nonAscii = _mm_movemask_epi8(v);
+        if (nonAscii != 0) return i + __builtin_ctz(nonAscii);
+    }
+#elif defined(__aarch64__)
+    for (; i + 16 <= len; i += 16) {
+        uint8x16_t v = vld1q_u8(reinterpret_cast<const uint8_t*>(str + i));
+        if (vmaxvq_u8(v) >= 0x80) break; // find which one below
+    }
+#else
+    for (; i + 8 <= len; i += 8) {
+        uint64_t v;
+        memcpy(&v, str + i, sizeof(v));
+        if (v & 0x8080808080808080ULL) break; // find which one below
+    }
+#endif
+    for (; i < len; i++) {
+        if (static_cast<uint8_t>(str[i]) >= 0x80) return i;
+    }
+    return len;
+}
+
+void widenAscii(const char* src, size_t len, char16_t* dst) {
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_unpacklo_epi8(v, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 8), _mm_unpackhi_epi8(v, zero));
+    }
+#elif defined(__aarch64__)
+    for (; i + 16 <= len; i += 16) {
+        uint8x16_t v = vld1q_u8(reinterpret_cast<const uint8_t*>(src + i));
+        vst1q_u16(reinterpret_cast<uint16_t*>(dst + i), vmovl_u8(vget_low_u8(v)));
+        vst1q_u16(reinterpret_cast<uint16_t*>(dst + i + 8), vmovl_u8(vget_high_u8(v)));
+    }
+#endif
+    for (; i < len; i++) {
+        dst[i] = static_cast<uint8_t>(src[i]);
+    }
+}
+
+size_t narrowAsciiPrefix(const char16_t* src, size_t len, char* dst) {
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128i nonAsciiBits = _mm_set1_epi16(static_cast<int16_t>(0xff80));
+    for (; i + 16 <= len; i += 16) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 8));
+        __m128i nonAscii = _mm_and_si128(_mm_or_si128(a, b), nonAsciiBits);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi16(nonAscii, _mm_setzero_si128())) != 0xffff) {
+            break; // find which one below
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(a, b));
+    }
+#elif defined(__aarch64__)
+    for (; i + 16 <= len; i += 16) {
+        uint16x8_t a = vld1q_u16(reinterpret_cast<const uint16_t*>(src + i));
+        uint16x8_t b = vld1q_u16(reinterpret_cast<const uint16_t*>(src + i + 8));
+        if (vmaxvq_u16(vorrq_u16(a, b)) >= 0x80) break; // find which one below
+        vst1q_u8(reinterpret_cast<uint8_t*>(dst + i), vcombine_u8(vmovn_u16(a), vmovn_u16(b)));
+    }
+#endif
+    for (; i < len; i++) {
+        if (src[i] >= 0x80) return i;
+        dst[i] = static_cast<char>(src[i]);
+    }
+    return len;
+}
+
 }   // namespace android
@@ -22,4 +22,18 @@ namespace android {
 // avoid optimizations
 void zeroMemory(uint8_t* data, size_t size);
 
+// Fast paths for converting strings which are entirely 7-bit ASCII, which most
+// strings in parcels are (interface descriptors, service and package names).
+// These use SSE2 or NEON where available.
+
+// Returns the length of the longest prefix of 'str' which is ASCII.
+size_t asciiPrefixLength(const char* str, size_t len);
+
+// Widens 'len' ASCII characters from 'src' into 'dst'.
+void widenAscii(const char* src, size_t len, char16_t* dst);
+
+// Narrows the longest prefix of 'src' which is ASCII into 'dst', which has room
+// for 'len' characters, and returns the length of that prefix.
+size_t narrowAsciiPrefix(const char16_t* src, size_t len, char* dst);
+
 }   // namespace android
@@ -19,6 +19,7 @@
 #include <utils/Errors.h>
 #include <binder/Parcel.h>
 #include <binder/ProcessState.h>
+#include <utils/Timers.h>
 #include <utils/Vector.h>
 
 #if defined(_WIN32)
@@ -28,6 +29,8 @@ typedef  int  uid_t;
 // ---------------------------------------------------------------------------
 namespace android {
 
+class CallStatsTable;
+
 class IPCThreadState
 {
 public:
@@ -189,6 +192,8 @@ private:
             void                processPostWriteDerefs();
 
             void                clearCaller();
+            void                recordCallStats(const Parcel& data, uint32_t code, bool incoming,
+                                                nsecs_t startTime);
 
     static  void                threadDestructor(void *st);
     static  void                freeBuffer(Parcel* parcel,
@@ -217,6 +222,8 @@ private:
             int32_t             mStrictModePolicy;
             int32_t             mLastTransactionBinderFlags;
             CallRestriction     mCallRestriction;
+            // Created once ProcessState::setCallStatsEnabled is first seen.
+            CallStatsTable*     mCallStats;
 };
 
 } // namespace android
@@ -16,6 +16,8 @@
 
 #pragma once
 
+#include <algorithm>
+#include <array>
 #include <map> // for legacy reasons
 #include <string>
 #include <type_traits>
@@ -555,6 +557,9 @@ private:
     status_t            validateReadData(size_t len) const;
 
     void                updateWorkSourceRequestHeaderPosition() const;
+    // The interface descriptor written by writeInterfaceToken at the start
+    // of the parcel, if there is one, regardless of the data position.
+    const char16_t*     peekInterfaceToken(size_t* outLen) const;
 
     status_t            finishFlattenBinder(const sp<IBinder>& binder);
     status_t            finishUnflattenBinder(const sp<IBinder>& binder, sp<IBinder>* out) const;
@@ -658,6 +663,10 @@ private:
     //
     // 3.1) Arrays accessed by the std::vector type.  This is the default for AIDL.
     //
+    // 3.2) Arrays accessed by the std::array type.  These are written exactly as a
+    // std::vector of the same size would be, and reading fails with BAD_VALUE if the
+    // size written does not match.
+    //
     // 4) Nullables
     // std::optional, std::unique_ptr, std::shared_ptr are all parceled identically
     // (i.e. result in identical byte layout).
@@ -774,7 +783,19 @@ private:
             || std::is_same_v<T, uint64_t>
             || std::is_same_v<T, int64_t>
             || std::is_same_v<T, double>
-            || (std::is_enum_v<T> && (sizeof(T) == 1 || sizeof(T) == 4)); // size check not type
+            // size check not type; enums are written as their underlying type, and
+            // those of size 2 are widened.
+            || (std::is_enum_v<T> && (sizeof(T) == 1 || sizeof(T) == 4 || sizeof(T) == 8));
+
+    // std::array<T, N> cannot be detected with is_specialization_v, as N is not a type.
+    template <typename T>
+    struct is_std_array : std::false_type {};
+
+    template <typename T, size_t N>
+    struct is_std_array<std::array<T, N>> : std::true_type {};
+
+    template <typename T>
+    static inline constexpr bool is_std_array_v = is_std_array<T>::value;
 
     // allowed "nullable" types
     // These are nonintrusive containers std::optional, std::unique_ptr, std::shared_ptr.
@@ -883,6 +904,7 @@ private:
     status_t writeData(const CT& c) {
         using T = first_template_type_t<CT>;  // The T in CT == C<T, ...>
         if constexpr (is_specialization_v<T, std::vector>
+                || is_std_array_v<T>
                 || std::is_same_v<T, String16>
                 || std::is_same_v<T, std::string>) {
             if (!c) return writeData(static_cast<int32_t>(kNullVectorSize));
@@ -894,25 +916,31 @@ private:
         return writeData(*c);
     }
 
+    // std::vector and std::array have the same wire format, the size as an int32 followed
+    // by the elements.
     template <typename CT,
-            typename std::enable_if_t<is_specialization_v<CT, std::vector>, bool> = true>
+            typename std::enable_if_t<is_specialization_v<CT, std::vector>
+                    || is_std_array_v<CT>, bool> = true>
     status_t writeData(const CT& c) {
-        using T = first_template_type_t<CT>;  // The T in CT == C<T, ...>
+        using T = typename CT::value_type;
         if (c.size() >  std::numeric_limits<int32_t>::max()) return BAD_VALUE;
         const auto size = static_cast<int32_t>(c.size());
-        writeData(size);
+        status_t status = writeData(size);
+        if (status != OK) return status;
         if constexpr (is_pointer_equivalent_array_v<T>) {
-            constexpr size_t limit = std::numeric_limits<size_t>::max() / sizeof(T);
+            constexpr size_t limit = std::numeric_limits<int32_t>::max() / sizeof(T);
             if (c.size() > limit) return BAD_VALUE;
             // is_pointer_equivalent types do not have gaps which could leak info,
             // which is only a concern when writing through binder.
-
-            // TODO: Padding of the write is suboptimal when the length of the
-            // data is not a multiple of 4.  Consider improving the write() method.
+            // The wire format of these is their memory layout, so the whole array
+            // is copied at once, and only the end is padded.
             return write(c.data(), c.size() * sizeof(T));
         } else if constexpr (std::is_same_v<T, bool>
                 || std::is_same_v<T, char16_t>) {
-            // reserve data space to write to
+            constexpr size_t limit = std::numeric_limits<int32_t>::max() / sizeof(int32_t);
+            if (c.size() > limit) return BAD_VALUE;
+            // Each element is widened to an int32, so reserve data space for all of
+            // them and write in place, rather than growing the parcel for each one.
             auto data = reinterpret_cast<int32_t*>(writeInplace(c.size() * sizeof(int32_t)));
             if (data == nullptr) return BAD_VALUE;
             for (const auto t: c) {
@@ -1020,6 +1048,7 @@ private:
         status_t status = readData(&peek);
         if (status != OK) return status;
         if constexpr (is_specialization_v<T, std::vector>
+                || is_std_array_v<T>
                 || std::is_same_v<T, String16>
                 || std::is_same_v<T, std::string>) {
             if (peek == kNullVectorSize) {
@@ -1045,7 +1074,7 @@ private:
         // rewind data ptr to reread (this is pretty quick), otherwise we could
         // pass an optional argument to readData to indicate a peeked value.
         setDataPosition(startPos);
-        if constexpr (is_specialization_v<T, std::vector>) {
+        if constexpr (is_specialization_v<T, std::vector> || is_std_array_v<T>) {
             return readData(&**c, READ_FLAG_SP_NULLABLE);  // nullable sp<> allowed now
         } else {
             return readData(&**c);
@@ -1075,16 +1104,14 @@ private:
             auto data = reinterpret_cast<const T*>(
                     readInplace(static_cast<size_t>(size) * sizeof(T)));
             if (data == nullptr) return BAD_VALUE;
-            c->insert(c->begin(), data, data + size); // insert should do a reserve().
+            c->assign(data, data + size); // one allocation and copy, reuses capacity.
         } else if constexpr (std::is_same_v<T, bool>
                 || std::is_same_v<T, char16_t>) {
-            c->reserve(size); // avoids default initialization
             auto data = reinterpret_cast<const int32_t*>(
                     readInplace(static_cast<size_t>(size) * sizeof(int32_t)));
             if (data == nullptr) return BAD_VALUE;
-            for (int32_t i = 0; i < size; ++i) {
-                c->emplace_back(static_cast<T>(*data++));
-            }
+            // narrows each int32, with a single allocation.
+            c->assign(data, data + size);
         } else if constexpr (is_specialization_v<T, sp>) {
             c->resize(size); // calls ctor
             if (readFlags & READ_FLAG_SP_NULLABLE) {
@@ -1108,6 +1135,43 @@ private:
         return OK;
     }
 
+    // std::array special case, the size on the wire must match.
+    template <typename CT,
+            typename std::enable_if_t<is_std_array_v<CT>, bool> = true>
+    status_t readData(CT* c, ReadFlags readFlags = READ_FLAG_NONE) const {
+        using T = typename CT::value_type;
+        int32_t size;
+        status_t status = readInt32(&size);
+        if (status != OK) return status;
+        if (size < 0) return UNEXPECTED_NULL;
+        if (static_cast<size_t>(size) != c->size()) return BAD_VALUE;
+        if constexpr (is_pointer_equivalent_array_v<T>) {
+            auto data = reinterpret_cast<const T*>(readInplace(c->size() * sizeof(T)));
+            if (data == nullptr) return BAD_VALUE;
+            std::copy(data, data + c->size(), c->begin());
+        } else if constexpr (std::is_same_v<T, bool>
+                || std::is_same_v<T, char16_t>) {
+            auto data = reinterpret_cast<const int32_t*>(
+                    readInplace(c->size() * sizeof(int32_t)));
+            if (data == nullptr) return BAD_VALUE;
+            for (auto &t : *c) {
+                t = static_cast<T>(*data++);
+            }
+        } else if constexpr (is_specialization_v<T, sp>) {
+            for (auto &t : *c) {
+                status = (readFlags & READ_FLAG_SP_NULLABLE) ? readNullableStrongBinder(&t)
+                                                             : readStrongBinder(&t);
+                if (status != OK) return status;
+            }
+        } else /* constexpr */ {
+            for (auto &t : *c) {
+                status = readData(&t);
+                if (status != OK) return status;
+            }
+        }
+        return OK;
+    }
+
     //-----------------------------------------------------------------------------
     private:
 
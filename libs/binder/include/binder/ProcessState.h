@@ -25,9 +25,16 @@
 
 #include <pthread.h>
 
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
 // ---------------------------------------------------------------------------
 namespace android {
 
+class CallStatsTable;
 class IPCThreadState;
 
 class ProcessState : public virtual RefBase
@@ -85,6 +92,43 @@ public:
             // before any threads are spawned.
             void setCallRestriction(CallRestriction restriction);
 
+            /**
+             * Latency and data size of the binder transactions for one
+             * transaction code of one interface, see getCallStats.
+             */
+            struct CallStats {
+                // Bucket 0 counts values of 0, and bucket i counts values in
+                // [2^(i-1), 2^i), except for the last bucket, which also counts
+                // everything larger.
+                static constexpr size_t kHistogramBuckets = 24;
+
+                // Empty if the transaction didn't start with an interface token.
+                String16 descriptor;
+                uint32_t code = 0;
+                // Whether the transactions were served by this process, rather
+                // than made by it.
+                bool incoming = false;
+                uint64_t count = 0;
+                uint64_t totalLatencyNs = 0;
+                // Latency in microseconds. For outgoing oneway transactions,
+                // this only covers sending them.
+                std::array<uint64_t, kHistogramBuckets> latencyHistogram = {};
+                // Size of the transaction data in bytes, not including the reply.
+                std::array<uint64_t, kHistogramBuckets> sizeHistogram = {};
+            };
+
+            // Starts or stops recording CallStats for each binder transaction
+            // made or served by this process. This is off by default, as it
+            // adds a little to the cost of every transaction. Stopping keeps
+            // what has been recorded so far.
+            void                setCallStatsEnabled(bool enabled);
+            bool                isCallStatsEnabled() const;
+            // Everything recorded since call stats were first enabled, across
+            // all threads, sorted by descriptor and code.
+            std::vector<CallStats> getCallStats();
+            // Writes getCallStats() to 'fd' as text, for dumpsys.
+            void                dumpCallStats(int fd);
+
 private:
     static  sp<ProcessState>    init(const char *defaultDriver, bool requireDefault);
 
@@ -105,6 +149,11 @@ private:
 
             handle_entry*       lookupHandleLocked(int32_t handle);
 
+            // Called by IPCThreadState on the thread which will record into
+            // the table, and when that thread exits.
+            CallStatsTable*     addCallStatsTable();
+            void                removeCallStatsTable(CallStatsTable* table);
+
             String8             mDriverName;
             int                 mDriverFD;
             void*               mVMStart;
@@ -130,6 +179,13 @@ private:
     volatile int32_t            mThreadPoolSeq;
 
             CallRestriction     mCallRestriction;
+
+            std::atomic_bool    mCallStatsEnabled;
+            std::mutex          mCallStatsLock; // protects below
+            // Those of threads which are still running.
+            std::vector<CallStatsTable*> mCallStatsTables;
+            // Everything recorded by threads which have exited.
+            std::unique_ptr<CallStatsTable> mExitedCallStats;
 };
     
 } // namespace android
@@ -21,7 +21,10 @@
 #include <utils/Errors.h>
 #include <utils/RefBase.h>
 
+#include <chrono>
+#include <condition_variable>
 #include <map>
+#include <memory>
 #include <optional>
 #include <thread>
 #include <vector>
@@ -34,6 +37,7 @@ namespace android {
 
 class Parcel;
 class RpcServer;
+class RpcSharedMemory;
 class RpcSocketAddress;
 class RpcState;
 
@@ -46,6 +50,52 @@ class RpcSession final : public virtual RefBase {
 public:
     static sp<RpcSession> make();
 
+    /**
+     * Instead of opening one connection for each thread on the server, open a
+     * single connection, and send all transactions over it concurrently. Each
+     * transaction is tagged with a request ID so that replies can be routed
+     * back to the thread waiting on them. Up to RpcServer::getMaxThreads()
+     * transactions are executed at once by the server. Nested calls from the
+     * server back to the client are executed by the client thread that is
+     * reading the connection when they arrive.
+     *
+     * This must be called before setting up the session.
+     */
+    void setMultiplexed(bool multiplexed);
+
+    /**
+     * Instead of sending each oneway transaction as soon as it is made, hold
+     * up to maxBytes worth of them for up to 'window', and send them together
+     * in a single write. The server processes them in order, as if they were
+     * sent separately. Synchronous transactions, releasing a reference to a
+     * remote binder, and destroying the session first send any oneway
+     * transactions being held.
+     *
+     * Setting maxBytes to 0 disables batching (the default).
+     *
+     * This must be called before setting up the session.
+     */
+    void setOnewayBatching(size_t maxBytes, std::chrono::nanoseconds window);
+
+    /**
+     * When connecting over a unix domain socket, ask the server to move each
+     * connection onto a pair of ring buffers in shared memory (one each way)
+     * of at least ringSize bytes, so that commands are copied once through
+     * shared memory instead of through the socket. The socket is kept open so
+     * that each side can tell if the other goes away. If the server can't use
+     * the shared memory, the connection falls back to using the socket.
+     *
+     * Setting ringSize to 0 disables this (the default).
+     *
+     * This must be called before setting up the session.
+     */
+    void setSharedMemoryTransport(size_t ringSize);
+
+    /**
+     * Send any oneway transactions held because of setOnewayBatching now.
+     */
+    status_t flushOnewayBatch();
+
     /**
      * This should be called once per thread, matching 'join' in the remote
      * process.
@@ -117,7 +167,7 @@ private:
     // transfer ownership of thread
     void preJoin(std::thread thread);
     // join on thread passed to preJoin
-    void join(base::unique_fd client);
+    void join(base::unique_fd client, std::shared_ptr<RpcSharedMemory> sharedMemory);
     void terminateLocked();
 
     struct RpcConnection : public RefBase {
@@ -128,6 +178,21 @@ private:
         std::optional<pid_t> exclusiveTid;
     };
 
+    status_t batchOnewayTransaction(const RpcAddress& address, uint32_t code, const Parcel& data,
+                                    uint32_t flags);
+    status_t sendOnewayBatch(const std::vector<uint8_t>& batch);
+    void scheduleOnewayFlush();
+
+    // Shared with the thread which flushes oneway batches, so that it never
+    // touches the session itself unless it can promote it.
+    struct OnewayFlusher {
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::optional<std::chrono::steady_clock::time_point> deadline;
+        bool stop = false;
+    };
+    static void onewayFlushLoop(std::shared_ptr<OnewayFlusher> flusher, wp<RpcSession> session);
+
     bool setupSocketClient(const RpcSocketAddress& address);
     bool setupOneSocketClient(const RpcSocketAddress& address, int32_t sessionId);
     void addClientConnection(base::unique_fd fd);
@@ -184,6 +249,15 @@ private:
 
     std::unique_ptr<RpcState> mState;
 
+    bool mMultiplexed = false;
+
+    size_t mSharedMemoryRingSize = 0;
+
+    size_t mOnewayBatchBytes = 0;
+    std::chrono::nanoseconds mOnewayBatchWindow{0};
+    std::shared_ptr<OnewayFlusher> mOnewayFlusher = std::make_shared<OnewayFlusher>();
+    std::thread mOnewayFlushThread; // guarded by mOnewayFlusher->mutex
+
     std::mutex mMutex; // for all below
 
     std::condition_variable mAvailableConnectionCv; // for mWaitingThreads
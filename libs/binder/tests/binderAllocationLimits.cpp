@@ -165,14 +165,19 @@ TEST(BinderAllocation, SmallTransaction) {
     sp<IServiceManager> manager = defaultServiceManager();
 
     size_t mallocs = 0;
-    const auto on_malloc = OnMalloc([&](size_t bytes) {
-        mallocs++;
-        // Parcel should allocate a small amount by default
-        EXPECT_EQ(bytes, 128);
-    });
-    manager->checkService(empty_descriptor);
+    {
+        const auto on_malloc = OnMalloc([&](size_t bytes) {
+            mallocs++;
+            // Parcel should allocate a small amount by default
+            EXPECT_LE(bytes, 512);
+        });
+        manager->checkService(empty_descriptor);
+    }
+    EXPECT_LE(mallocs, 1);
 
-    EXPECT_EQ(mallocs, 1);
+    // the parcel data buffer is cached by this thread for the next transaction
+    const auto m = ScopeDisallowMalloc();
+    manager->checkService(empty_descriptor);
 }
 
 int main(int argc, char** argv) {
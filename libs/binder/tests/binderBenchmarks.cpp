@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "binderBenchmarks.h"
+
+// Usage: atest binderBenchmarks, or run it directly on a Linux host. It
+// doesn't need /dev/binder, calls go over the RPC transport.
+//
+// All of the benchmarks in binderParcelBenchmark and binderRpcBenchmark, in
+// one binary. Unless --benchmark_out is given, results are also written as
+// JSON to $TMPDIR/binderBenchmarks.json, so that runs can be compared, for
+// instance with tools/compare.py from Google benchmark.
+
+int main(int argc, char** argv) {
+    initParcelBenchmarks(argv);
+
+    std::vector<char*> args(argv, argv + argc);
+    std::string out = std::string("--benchmark_out=") + (getenv("TMPDIR") ?: "/tmp") +
+            "/binderBenchmarks.json";
+    std::string outFormat = "--benchmark_out_format=json";
+    bool hasOut = false;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--benchmark_out=", strlen("--benchmark_out=")) == 0) hasOut = true;
+    }
+    if (!hasOut) {
+        args.push_back(out.data());
+        args.push_back(outFormat.data());
+    }
+    int numArgs = args.size();
+    args.push_back(nullptr);
+
+    ::benchmark::Initialize(&numArgs, args.data());
+    if (::benchmark::ReportUnrecognizedArguments(numArgs, args.data())) return 1;
+
+    initRpcBenchmarks();
+
+    ::benchmark::RunSpecifiedBenchmarks();
+    return 0;
+}
@@ -0,0 +1,27 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+// binderParcelBenchmark and binderRpcBenchmark each build on their own, and
+// are also built together into binderBenchmarks, with BINDER_BENCHMARK_SUITE
+// defined. There, these are called instead of the main of each one.
+
+// Must be called before anything else in main, as it may re-exec the process.
+void initParcelBenchmarks(char** argv);
+
+// Starts an RPC server in this process, and connects the sessions used by the
+// RPC benchmarks to it.
+void initRpcBenchmarks();
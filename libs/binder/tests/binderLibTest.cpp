@@ -416,6 +416,35 @@ TEST_F(BinderLibTest, NopTransactionOneway) {
                 StatusEq(NO_ERROR));
 }
 
+TEST_F(BinderLibTest, CallStats) {
+    sp<ProcessState> process = ProcessState::self();
+    process->setCallStatsEnabled(true);
+
+    Parcel data, reply;
+    data.writeInterfaceToken(String16("binderLibTest.CallStats"));
+    data.writeInt32(1);
+    EXPECT_THAT(m_server->transact(BINDER_LIB_TEST_NOP_TRANSACTION, data, &reply),
+                StatusEq(NO_ERROR));
+    process->setCallStatsEnabled(false);
+    EXPECT_THAT(m_server->transact(BINDER_LIB_TEST_NOP_TRANSACTION, data, &reply),
+                StatusEq(NO_ERROR));
+
+    bool found = false;
+    for (const auto& stats : process->getCallStats()) {
+        if (stats.descriptor != String16("binderLibTest.CallStats")) continue;
+        EXPECT_EQ(static_cast<uint32_t>(BINDER_LIB_TEST_NOP_TRANSACTION), stats.code);
+        EXPECT_FALSE(stats.incoming);
+        EXPECT_EQ(1u, stats.count);
+        uint64_t latencyCount = 0, sizeCount = 0;
+        for (uint64_t count : stats.latencyHistogram) latencyCount += count;
+        for (uint64_t count : stats.sizeHistogram) sizeCount += count;
+        EXPECT_EQ(1u, latencyCount);
+        EXPECT_EQ(1u, sizeCount);
+        found = true;
+    }
+    EXPECT_TRUE(found);
+}
+
 TEST_F(BinderLibTest, NopTransactionClear) {
     Parcel data, reply;
     // make sure it accepts the transaction flag
@@ -17,6 +17,15 @@
 #include <binder/Parcel.h>
 #include <benchmark/benchmark.h>
 
+#include "binderBenchmarks.h"
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#ifdef __BIONIC__
+#include <malloc.h>
+#endif
+
 // Usage: atest binderParcelBenchmark
 
 // For static assert(false) we need a template version to avoid early failure.
@@ -36,6 +45,8 @@ void writeVector(android::Parcel &p, const V<T, Args...> &v) {
         p.writeInt32Vector(v);
     } else if constexpr (std::is_same_v<T, int64_t>) {
         p.writeInt64Vector(v);
+    } else if constexpr (std::is_same_v<T, float>) {
+        p.writeFloatVector(v);
     } else {
         static_assert(dependent_false_v<V<T>>);
     }
@@ -53,6 +64,8 @@ void readVector(android::Parcel &p, V<T, Args...> *v) {
         p.readInt32Vector(v);
     } else if constexpr (std::is_same_v<T, int64_t>) {
         p.readInt64Vector(v);
+    } else if constexpr (std::is_same_v<T, float>) {
+        p.readFloatVector(v);
     } else {
         static_assert(dependent_false_v<V<T>>);
     }
@@ -169,4 +182,248 @@ BENCHMARK(BM_CharVector)->Apply(VectorArgs);
 BENCHMARK(BM_Int32Vector)->Apply(VectorArgs);
 BENCHMARK(BM_Int64Vector)->Apply(VectorArgs);
 
-BENCHMARK_MAIN();
+// Args of 1K, 64K and 1M elements.
+static void LargeVectorArgs(benchmark::internal::Benchmark* b) {
+    for (int i : {10, 16, 20}) {
+        b->Args({1 << i});
+    }
+}
+
+/*
+  Like BM_ParcelVector, but reports throughput, which for the types which are
+  copied in bulk should approach that of memcpy.
+*/
+template <typename T>
+static void BM_ParcelVectorLarge(benchmark::State& state) {
+    BM_ParcelVector<T>(state);
+    state.SetBytesProcessed(state.iterations() * state.range(0) * sizeof(T));
+}
+
+static void BM_BoolVectorLarge(benchmark::State& state) {
+    BM_ParcelVectorLarge<bool>(state);
+}
+
+static void BM_Int32VectorLarge(benchmark::State& state) {
+    BM_ParcelVectorLarge<int32_t>(state);
+}
+
+static void BM_Int64VectorLarge(benchmark::State& state) {
+    BM_ParcelVectorLarge<int64_t>(state);
+}
+
+static void BM_FloatVectorLarge(benchmark::State& state) {
+    BM_ParcelVectorLarge<float>(state);
+}
+
+BENCHMARK(BM_BoolVectorLarge)->Apply(LargeVectorArgs);
+BENCHMARK(BM_Int32VectorLarge)->Apply(LargeVectorArgs);
+BENCHMARK(BM_Int64VectorLarge)->Apply(LargeVectorArgs);
+BENCHMARK(BM_FloatVectorLarge)->Apply(LargeVectorArgs);
+
+// Strings of a given length, either all ASCII or with one in every 8
+// characters taking more than one byte in UTF-8.
+enum StringContent : int64_t {
+    STRING_ASCII = 0,
+    STRING_MIXED = 1,
+};
+
+static std::string makeUtf8String(size_t length, StringContent content) {
+    std::string str;
+    for (size_t i = 0; i < length; i++) {
+        if (content == STRING_MIXED && i % 8 == 7) {
+            str += "\xc3\xa9"; // U+00E9
+        } else {
+            str += static_cast<char>('a' + i % 26);
+        }
+    }
+    return str;
+}
+
+static void StringArgs(benchmark::internal::Benchmark* b) {
+    b->ArgNames({"length", "mixed"});
+    for (int64_t length : {8, 64, 512, 4096}) {
+        b->Args({length, STRING_ASCII});
+        b->Args({length, STRING_MIXED});
+    }
+}
+
+/*
+  std::string written as UTF-16 and read back, as done for AIDL String
+  arguments in the C++ backend with @utf8InCpp.
+*/
+static void BM_Utf8AsUtf16(benchmark::State& state) {
+    const std::string str =
+            makeUtf8String(state.range(0), static_cast<StringContent>(state.range(1)));
+    std::string out;
+    android::Parcel p;
+    while (state.KeepRunning()) {
+        p.setDataPosition(0);
+        p.writeUtf8AsUtf16(str);
+
+        p.setDataPosition(0);
+        p.readUtf8FromUtf16(&out);
+
+        benchmark::DoNotOptimize(out.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(state.iterations() * str.size());
+}
+BENCHMARK(BM_Utf8AsUtf16)->Apply(StringArgs);
+
+static void BM_String16(benchmark::State& state) {
+    const android::String16 str(
+            makeUtf8String(state.range(0), static_cast<StringContent>(state.range(1))).c_str());
+    android::String16 out;
+    android::Parcel p;
+    while (state.KeepRunning()) {
+        p.setDataPosition(0);
+        p.writeString16(str);
+
+        p.setDataPosition(0);
+        p.readString16(&out);
+
+        benchmark::DoNotOptimize(out.string());
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(state.iterations() * str.size() * sizeof(char16_t));
+}
+BENCHMARK(BM_String16)->Apply(StringArgs);
+
+// Counts calls to malloc and realloc, to show how many allocations a parcel
+// needs. This is only available on bionic, with LIBC_HOOKS_ENABLE set.
+static size_t gMallocs = 0;
+#ifdef __BIONIC__
+static decltype(__malloc_hook) gOrigMallocHook;
+static decltype(__realloc_hook) gOrigReallocHook;
+
+static void* countingMallocHook(size_t bytes, const void* arg) {
+    gMallocs++;
+    return gOrigMallocHook(bytes, arg);
+}
+static void* countingReallocHook(void* ptr, size_t bytes, const void* arg) {
+    gMallocs++;
+    return gOrigReallocHook(ptr, bytes, arg);
+}
+#endif
+
+enum AidlPayload : int64_t {
+    AIDL_INTS = 0,       // foo(int, int, int)
+    AIDL_STRING = 1,     // foo(String)
+    AIDL_VECTOR = 2,     // foo(int[])
+    AIDL_MIXED = 3,      // foo(int, String, int[])
+    AIDL_PARCELABLE = 4, // foo(Parcelable { int; String; int[]; })
+};
+
+static void writeAidlPayload(android::Parcel& p, AidlPayload payload, const android::String16& str,
+                             const std::vector<int32_t>& v) {
+    // roughly what the interface token adds to each transaction
+    p.writeInt32(0);
+    p.writeInt32(0);
+    p.writeInt32(0);
+    p.writeString16(android::String16(u"android.os.IBenchmarkService"));
+
+    switch (payload) {
+        case AIDL_INTS:
+            p.writeInt32(1);
+            p.writeInt32(2);
+            p.writeInt32(3);
+            break;
+        case AIDL_STRING:
+            p.writeString16(str);
+            break;
+        case AIDL_VECTOR:
+            p.writeInt32Vector(v);
+            break;
+        case AIDL_MIXED:
+            p.writeInt32(1);
+            p.writeString16(str);
+            p.writeInt32Vector(v);
+            break;
+        case AIDL_PARCELABLE: {
+            // as generated for a structured parcelable: non-null, then its size
+            p.writeInt32(1);
+            const size_t start = p.dataPosition();
+            p.writeInt32(0);
+            p.writeInt32(1);
+            p.writeString16(str);
+            p.writeInt32Vector(v);
+            const size_t end = p.dataPosition();
+            p.setDataPosition(start);
+            p.writeInt32(end - start);
+            p.setDataPosition(end);
+        } break;
+    }
+}
+
+/*
+  A new parcel for each call, as when making or serving an AIDL transaction,
+  written and then read back. allocs_per_op is only reported on bionic.
+*/
+static void BM_ParcelAidl(benchmark::State& state) {
+    const AidlPayload payload = static_cast<AidlPayload>(state.range(0));
+    const android::String16 str(u"a typical string argument");
+    const std::vector<int32_t> v(8, 42);
+
+    size_t mallocsBefore = gMallocs;
+    while (state.KeepRunning()) {
+        android::Parcel p;
+        writeAidlPayload(p, payload, str, v);
+
+        p.setDataPosition(0);
+        int32_t i;
+        p.readInt32(&i);
+        p.readInt32(&i);
+        p.readInt32(&i);
+        benchmark::DoNotOptimize(p.readString16());
+        if (payload == AIDL_PARCELABLE) {
+            p.readInt32(&i); // non-null
+            p.readInt32(&i); // size
+        }
+        const bool mixed = payload == AIDL_MIXED || payload == AIDL_PARCELABLE;
+        if (payload == AIDL_INTS || mixed) p.readInt32(&i);
+        if (payload == AIDL_STRING || mixed) {
+            benchmark::DoNotOptimize(p.readString16());
+        }
+        if (payload == AIDL_VECTOR || mixed) {
+            std::vector<int32_t> out;
+            p.readInt32Vector(&out);
+            benchmark::DoNotOptimize(out.data());
+        }
+        benchmark::ClobberMemory();
+    }
+    state.counters["allocs_per_op"] =
+            benchmark::Counter(gMallocs - mallocsBefore, benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_ParcelAidl)
+        ->ArgName("payload")
+        ->Arg(AIDL_INTS)
+        ->Arg(AIDL_STRING)
+        ->Arg(AIDL_VECTOR)
+        ->Arg(AIDL_MIXED)
+        ->Arg(AIDL_PARCELABLE);
+
+void initParcelBenchmarks(char** argv) {
+#ifdef __BIONIC__
+    if (getenv("LIBC_HOOKS_ENABLE") == nullptr) {
+        if (0 == setenv("LIBC_HOOKS_ENABLE", "1", true /*overwrite*/)) execv(argv[0], argv);
+    } else {
+        gOrigMallocHook = __malloc_hook;
+        gOrigReallocHook = __realloc_hook;
+        __malloc_hook = countingMallocHook;
+        __realloc_hook = countingReallocHook;
+    }
+#else
+    (void)argv;
+#endif
+}
+
+#ifndef BINDER_BENCHMARK_SUITE
+int main(int argc, char** argv) {
+    initParcelBenchmarks(argv);
+
+    ::benchmark::Initialize(&argc, argv);
+    if (::benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+    ::benchmark::RunSpecifiedBenchmarks();
+    return 0;
+}
+#endif // BINDER_BENCHMARK_SUITE
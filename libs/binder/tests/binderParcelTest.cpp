@@ -18,6 +18,8 @@
 #include <binder/IPCThreadState.h>
 #include <gtest/gtest.h>
 
+#include <string.h>
+
 using android::IPCThreadState;
 using android::OK;
 using android::Parcel;
@@ -101,6 +103,31 @@ TEST(Parcel, Utf8AsUtf16Write) {
     });
 }
 
+// Strings which are ASCII have a fast path, so check lengths around the
+// vector widths it uses, with and without other characters in them.
+TEST(Parcel, Utf8Utf16RoundTrip) {
+    for (size_t len : {1, 7, 8, 15, 16, 17, 31, 32, 33, 100}) {
+        for (const char* insert : {"", "\xc3\xa9", "\xe2\x82\xac", "\xf0\x9f\x98\x80"}) {
+            for (size_t at : {size_t(0), len / 2, len}) {
+                std::string token(len, 'x');
+                token.insert(at, insert);
+
+                Parcel p;
+                ASSERT_EQ(OK, p.writeUtf8AsUtf16(token));
+                p.setDataPosition(0);
+                String16 s16;
+                ASSERT_EQ(OK, p.readString16(&s16));
+                EXPECT_EQ(String16(token.c_str()), s16) << token;
+
+                p.setDataPosition(0);
+                std::string s;
+                ASSERT_EQ(OK, p.readUtf8FromUtf16(&s));
+                EXPECT_EQ(token, s);
+            }
+        }
+    }
+}
+
 template <typename T>
 using readFunc = status_t (Parcel::*)(T* out) const;
 template <typename T>
@@ -146,3 +173,50 @@ TEST_READ_WRITE_INVERSE(char16_t, Char, {u'a', u'\0'});
 TEST_READ_WRITE_INVERSE(int8_t, Byte, {-1, 0, 1});
 TEST_READ_WRITE_INVERSE(String8, String8, {String8(), String8("a"), String8("asdf")});
 TEST_READ_WRITE_INVERSE(String16, String16, {String16(), String16("a"), String16("asdf")});
+
+// std::array is written the same way as std::vector, and only read back at the same size
+template <typename T, size_t N>
+void arrayMatchesVector(const std::array<T, N>& array) {
+    Parcel pa;
+    ASSERT_EQ(OK, pa.writeData(array));
+    Parcel pv;
+    ASSERT_EQ(OK, pv.writeData(std::vector<T>(array.begin(), array.end())));
+    ASSERT_EQ(pv.dataSize(), pa.dataSize());
+    EXPECT_EQ(0, memcmp(pv.data(), pa.data(), pa.dataSize()));
+
+    pa.setDataPosition(0);
+    std::array<T, N> out{};
+    EXPECT_EQ(OK, pa.readData(&out));
+    EXPECT_EQ(array, out);
+
+    pa.setDataPosition(0);
+    std::array<T, N + 1> wrongSize{};
+    EXPECT_EQ(android::BAD_VALUE, pa.readData(&wrongSize));
+}
+
+TEST(Parcel, ArrayMatchesVector) {
+    arrayMatchesVector(std::array<int32_t, 3>{-1, 0, 1});
+    arrayMatchesVector(std::array<int64_t, 2>{-1, 1LL << 40});
+    arrayMatchesVector(std::array<float, 2>{-1.0f, 3.14f});
+    arrayMatchesVector(std::array<uint8_t, 5>{1, 2, 3, 4, 5});
+    arrayMatchesVector(std::array<bool, 3>{true, false, true});
+    arrayMatchesVector(std::array<char16_t, 2>{u'a', u'\0'});
+}
+
+TEST(Parcel, InverseLargeVectors) {
+    std::vector<int64_t> int64s(1 << 16);
+    for (size_t i = 0; i < int64s.size(); i++) int64s[i] = static_cast<int64_t>(i) << 32;
+    std::vector<bool> bools(1 << 16);
+    for (size_t i = 0; i < bools.size(); i++) bools[i] = i % 3 == 0;
+
+    Parcel p;
+    ASSERT_EQ(OK, p.writeInt64Vector(int64s));
+    ASSERT_EQ(OK, p.writeBoolVector(bools));
+    p.setDataPosition(0);
+    std::vector<int64_t> int64sOut(1); // existing contents are replaced
+    std::vector<bool> boolsOut(1);
+    EXPECT_EQ(OK, p.readInt64Vector(&int64sOut));
+    EXPECT_EQ(OK, p.readBoolVector(&boolsOut));
+    EXPECT_EQ(int64s, int64sOut);
+    EXPECT_EQ(bools, boolsOut);
+}
@@ -21,11 +21,17 @@
 #include <binder/RpcServer.h>
 #include <binder/RpcSession.h>
 
+#include <algorithm>
+#include <chrono>
+#include <mutex>
 #include <thread>
+#include <vector>
 
 #include <sys/types.h>
 #include <unistd.h>
 
+#include "binderBenchmarks.h"
+
 using android::BBinder;
 using android::IBinder;
 using android::interface_cast;
@@ -44,9 +50,22 @@ class MyBinderRpcBenchmark : public BnBinderRpcBenchmark {
         *out = str;
         return Status::ok();
     }
+    Status sendString(const std::string& str) override {
+        (void)str;
+        return Status::ok();
+    }
 };
 
+// number of threads the server serves each session with
+constexpr size_t kServerThreads = 16;
+
 static sp<RpcSession> gSession = RpcSession::make();
+// same server, but all calls share a single connection
+static sp<RpcSession> gMultiplexedSession = RpcSession::make();
+// same server, but oneway calls are sent in batches
+static sp<RpcSession> gBatchedSession = RpcSession::make();
+// same server, but commands go through shared memory instead of the socket
+static sp<RpcSession> gSharedMemorySession = RpcSession::make();
 
 void BM_getRootObject(benchmark::State& state) {
     while (state.KeepRunning()) {
@@ -94,6 +113,52 @@ void BM_repeatString(benchmark::State& state) {
 }
 BENCHMARK(BM_repeatString);
 
+void BM_repeatStringSize(benchmark::State& state) {
+    sp<IBinder> binder = gSession->getRootObject();
+    CHECK(binder != nullptr);
+    sp<IBinderRpcBenchmark> iface = interface_cast<IBinderRpcBenchmark>(binder);
+    CHECK(iface != nullptr);
+
+    std::string str = std::string(state.range(0), 'a');
+
+    while (state.KeepRunning()) {
+        std::string out;
+        Status ret = iface->repeatString(str, &out);
+        CHECK(ret.isOk()) << ret;
+    }
+
+    // sent there and back as UTF-16
+    state.SetBytesProcessed(state.iterations() * str.size() * sizeof(char16_t) * 2);
+}
+// stays under the 100KB limit for a single RPC transaction
+BENCHMARK(BM_repeatStringSize)->RangeMultiplier(4)->Range(64, 32 * 1024);
+
+// Round trips from several threads at once, which share the session's
+// connections.
+void BM_repeatStringConcurrent(benchmark::State& state) {
+    sp<IBinder> binder = gSession->getRootObject();
+    CHECK(binder != nullptr);
+    sp<IBinderRpcBenchmark> iface = interface_cast<IBinderRpcBenchmark>(binder);
+    CHECK(iface != nullptr);
+
+    std::string str = std::string(state.range(0), 'a');
+
+    while (state.KeepRunning()) {
+        std::string out;
+        Status ret = iface->repeatString(str, &out);
+        CHECK(ret.isOk()) << ret;
+    }
+
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * str.size() * sizeof(char16_t) * 2);
+}
+BENCHMARK(BM_repeatStringConcurrent)
+        ->ArgName("size")
+        ->Arg(64)
+        ->Arg(4096)
+        ->ThreadRange(1, 16)
+        ->UseRealTime();
+
 void BM_repeatBinder(benchmark::State& state) {
     sp<IBinder> binder = gSession->getRootObject();
     CHECK(binder != nullptr);
@@ -111,10 +176,146 @@ void BM_repeatBinder(benchmark::State& state) {
 }
 BENCHMARK(BM_repeatBinder);
 
-int main(int argc, char** argv) {
-    ::benchmark::Initialize(&argc, argv);
-    if (::benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+// Many distinct binders crossing the session at once, from several threads.
+// Each thread also keeps a set of binders alive on its side, so the table of
+// known binders is large.
+void BM_repeatBinderConcurrent(benchmark::State& state) {
+    sp<IBinder> binder = gSession->getRootObject();
+    CHECK(binder != nullptr);
+    sp<IBinderRpcBenchmark> iface = interface_cast<IBinderRpcBenchmark>(binder);
+    CHECK(iface != nullptr);
+
+    constexpr size_t kNumBinders = 256;
+    std::vector<sp<IBinder>> binders;
+    for (size_t i = 0; i < kNumBinders; i++) {
+        binders.push_back(sp<BBinder>::make());
+    }
+
+    size_t i = 0;
+    while (state.KeepRunning()) {
+        sp<IBinder> out;
+        Status ret = iface->repeatBinder(binders[i++ % kNumBinders], &out);
+        CHECK(ret.isOk()) << ret;
+    }
+
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_repeatBinderConcurrent)->ThreadRange(1, 16)->UseRealTime();
+
+static int64_t percentile(std::vector<int64_t>* samples, size_t percent) {
+    if (samples->empty()) return 0;
+    size_t index = (samples->size() - 1) * percent / 100;
+    std::nth_element(samples->begin(), samples->begin() + index, samples->end());
+    return (*samples)[index];
+}
+
+static std::mutex gPingConcurrentMutex;
+static std::vector<int64_t> gPingConcurrentLatenciesNs;
+static int gPingConcurrentThreadsDone = 0;
+
+// Run with many concurrent callers to compare a session with a connection per
+// server thread (callers wait for a free connection) against a multiplexed
+// session (all callers share one connection).
+void BM_pingConcurrent(benchmark::State& state) {
+    sp<RpcSession> session = state.range(0) ? gMultiplexedSession : gSession;
+    sp<IBinder> binder = session->getRootObject();
+    CHECK(binder != nullptr);
+
+    std::vector<int64_t> latenciesNs;
+    while (state.KeepRunning()) {
+        auto start = std::chrono::steady_clock::now();
+        CHECK_EQ(OK, binder->pingBinder());
+        latenciesNs.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                      std::chrono::steady_clock::now() - start)
+                                      .count());
+    }
+
+    state.SetItemsProcessed(state.iterations());
+
+    // The p99 is taken over the samples of all threads together, by the last
+    // thread to finish. Counters are summed over threads, so the others leave
+    // it at zero.
+    std::lock_guard<std::mutex> _l(gPingConcurrentMutex);
+    gPingConcurrentLatenciesNs.insert(gPingConcurrentLatenciesNs.end(), latenciesNs.begin(),
+                                      latenciesNs.end());
+    if (++gPingConcurrentThreadsDone == state.threads) {
+        state.counters["p99_ns"] = percentile(&gPingConcurrentLatenciesNs, 99);
+        gPingConcurrentLatenciesNs.clear();
+        gPingConcurrentThreadsDone = 0;
+    }
+}
+BENCHMARK(BM_pingConcurrent)
+        ->ArgName("multiplexed")
+        ->Arg(0)
+        ->Arg(1)
+        ->Threads(1)
+        ->Threads(16)
+        ->Threads(128)
+        ->UseRealTime();
+
+// A flood of small oneway calls, like a chatty telemetry interface.
+void BM_onewayFlood(benchmark::State& state) {
+    sp<RpcSession> session = state.range(0) ? gBatchedSession : gSession;
+    sp<IBinder> binder = session->getRootObject();
+    CHECK(binder != nullptr);
+    sp<IBinderRpcBenchmark> iface = interface_cast<IBinderRpcBenchmark>(binder);
+    CHECK(iface != nullptr);
+
+    std::string str = "event";
+
+    while (state.KeepRunning()) {
+        Status ret = iface->sendString(str);
+        CHECK(ret.isOk()) << ret;
+    }
+
+    // wait for everything to be processed (also flushes any batch)
+    CHECK_EQ(OK, binder->pingBinder());
 
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_onewayFlood)->ArgName("batched")->Arg(0)->Arg(1);
+
+// Compares the unix domain socket with shared memory set up over it, for
+// latency (size 0 is a ping) and throughput.
+void BM_transport(benchmark::State& state) {
+    sp<RpcSession> session = state.range(0) ? gSharedMemorySession : gSession;
+    sp<IBinder> binder = session->getRootObject();
+    CHECK(binder != nullptr);
+    sp<IBinderRpcBenchmark> iface = interface_cast<IBinderRpcBenchmark>(binder);
+    CHECK(iface != nullptr);
+
+    std::string str = std::string(state.range(1), 'a');
+
+    std::vector<int64_t> latenciesNs;
+    while (state.KeepRunning()) {
+        auto start = std::chrono::steady_clock::now();
+        if (str.empty()) {
+            CHECK_EQ(OK, binder->pingBinder());
+        } else {
+            std::string out;
+            Status ret = iface->repeatString(str, &out);
+            CHECK(ret.isOk()) << ret;
+        }
+        latenciesNs.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                      std::chrono::steady_clock::now() - start)
+                                      .count());
+    }
+
+    // sent there and back as UTF-16
+    state.SetBytesProcessed(state.iterations() * str.size() * sizeof(char16_t) * 2);
+    state.counters["p50_ns"] = percentile(&latenciesNs, 50);
+    state.counters["p99_ns"] = percentile(&latenciesNs, 99);
+}
+static void transportArgs(benchmark::internal::Benchmark* b) {
+    for (int64_t sharedMemory : {0, 1}) {
+        for (int64_t size : {0, 64, 4096, 32 * 1024}) {
+            b->Args({sharedMemory, size});
+        }
+    }
+}
+BENCHMARK(BM_transport)->ArgNames({"shared_memory", "size"})->Apply(transportArgs);
+
+void initRpcBenchmarks() {
     std::string addr = std::string(getenv("TMPDIR") ?: "/tmp") + "/binderRpcBenchmark";
     (void)unlink(addr.c_str());
 
@@ -122,6 +323,7 @@ int main(int argc, char** argv) {
         sp<RpcServer> server = RpcServer::make();
         server->setRootObject(sp<MyBinderRpcBenchmark>::make());
         server->iUnderstandThisCodeIsExperimentalAndIWillNotUseItInProduction();
+        server->setMaxThreads(kServerThreads);
         CHECK(server->setupUnixDomainServer(addr.c_str()));
         server->join();
     }).detach();
@@ -133,6 +335,24 @@ int main(int argc, char** argv) {
     LOG(FATAL) << "Could not connect.";
 success:
 
+    gMultiplexedSession->setMultiplexed(true);
+    CHECK(gMultiplexedSession->setupUnixDomainClient(addr.c_str()));
+
+    gBatchedSession->setOnewayBatching(16 * 1024, std::chrono::milliseconds(1));
+    CHECK(gBatchedSession->setupUnixDomainClient(addr.c_str()));
+
+    gSharedMemorySession->setSharedMemoryTransport(256 * 1024);
+    CHECK(gSharedMemorySession->setupUnixDomainClient(addr.c_str()));
+}
+
+#ifndef BINDER_BENCHMARK_SUITE
+int main(int argc, char** argv) {
+    ::benchmark::Initialize(&argc, argv);
+    if (::benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+
+    initRpcBenchmarks();
+
     ::benchmark::RunSpecifiedBenchmarks();
     return 0;
 }
+#endif // BINDER_BENCHMARK_SUITE
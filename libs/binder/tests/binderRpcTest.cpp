@@ -73,18 +73,24 @@ using android::binder::Status;
 class MyBinderRpcSession : public BnBinderRpcSession {
 public:
     static std::atomic<int32_t> gNum;
+    static std::atomic<int32_t> gNumOneways;
 
     MyBinderRpcSession(const std::string& name) : mName(name) { gNum++; }
     Status getName(std::string* name) override {
         *name = mName;
         return Status::ok();
     }
+    Status countOneway() override {
+        gNumOneways++;
+        return Status::ok();
+    }
     ~MyBinderRpcSession() { gNum--; }
 
 private:
     std::string mName;
 };
 std::atomic<int32_t> MyBinderRpcSession::gNum;
+std::atomic<int32_t> MyBinderRpcSession::gNumOneways;
 
 class MyBinderRpcTest : public BnBinderRpcTest {
 public:
@@ -153,6 +159,10 @@ public:
         *out = MyBinderRpcSession::gNum;
         return Status::ok();
     }
+    Status getNumSessionOneways(int32_t* out) override {
+        *out = MyBinderRpcSession::gNumOneways;
+        return Status::ok();
+    }
 
     std::mutex blockMutex;
     Status lock() override {
@@ -301,6 +311,7 @@ struct BinderRpcTestProcessSession {
 
 enum class SocketType {
     UNIX,
+    UNIX_SHARED_MEMORY,
     VSOCK,
     INET,
 };
@@ -308,6 +319,8 @@ static inline std::string PrintSocketType(const testing::TestParamInfo<SocketTyp
     switch (info.param) {
         case SocketType::UNIX:
             return "unix_domain_socket";
+        case SocketType::UNIX_SHARED_MEMORY:
+            return "unix_domain_socket_shared_memory";
         case SocketType::VSOCK:
             return "vm_socket";
         case SocketType::INET:
@@ -323,7 +336,8 @@ public:
     // threads.
     ProcessSession createRpcTestSocketServerProcess(
             size_t numThreads, size_t numSessions,
-            const std::function<void(const sp<RpcServer>&)>& configure) {
+            const std::function<void(const sp<RpcServer>&)>& configure, bool multiplexed = false,
+            size_t onewayBatchBytes = 0) {
         CHECK_GE(numSessions, 1) << "Must have at least one session to a server";
 
         SocketType socketType = GetParam();
@@ -344,6 +358,7 @@ public:
 
                     switch (socketType) {
                         case SocketType::UNIX:
+                        case SocketType::UNIX_SHARED_MEMORY:
                             CHECK(server->setupUnixDomainServer(addr.c_str())) << addr;
                             break;
                         case SocketType::VSOCK:
@@ -375,10 +390,19 @@ public:
 
         for (size_t i = 0; i < numSessions; i++) {
             sp<RpcSession> session = RpcSession::make();
+            session->setMultiplexed(multiplexed);
+            if (onewayBatchBytes != 0) {
+                // long enough that only a synchronous call or a dropped reference sends the batch
+                session->setOnewayBatching(onewayBatchBytes, std::chrono::seconds(10));
+            }
             switch (socketType) {
                 case SocketType::UNIX:
                     if (session->setupUnixDomainClient(addr.c_str())) goto success;
                     break;
+                case SocketType::UNIX_SHARED_MEMORY:
+                    session->setSharedMemoryTransport(64 * 1024);
+                    if (session->setupUnixDomainClient(addr.c_str())) goto success;
+                    break;
                 case SocketType::VSOCK:
                     if (session->setupVsockClient(VMADDR_CID_LOCAL, vsockPort)) goto success;
                     break;
@@ -396,7 +420,9 @@ public:
     }
 
     BinderRpcTestProcessSession createRpcTestSocketServerProcess(size_t numThreads,
-                                                                 size_t numSessions = 1) {
+                                                                 size_t numSessions = 1,
+                                                                 bool multiplexed = false,
+                                                                 size_t onewayBatchBytes = 0) {
         BinderRpcTestProcessSession ret{
                 .proc = createRpcTestSocketServerProcess(numThreads, numSessions,
                                                          [&](const sp<RpcServer>& server) {
@@ -404,7 +430,8 @@ public:
                                                                      new MyBinderRpcTest;
                                                              server->setRootObject(service);
                                                              service->server = server;
-                                                         }),
+                                                         },
+                                                         multiplexed, onewayBatchBytes),
         };
 
         ret.rootBinder = ret.proc.sessions.at(0).root;
@@ -786,6 +813,64 @@ TEST_P(BinderRpc, ThreadPoolOverSaturated) {
     EXPECT_LE(epochMsAfter, epochMsBefore + 3 * kSleepMs);
 }
 
+TEST_P(BinderRpc, MultiplexedThreadPoolOverSaturated) {
+    constexpr size_t kNumThreads = 10;
+    constexpr size_t kNumCalls = kNumThreads + 3;
+    constexpr size_t kSleepMs = 500;
+
+    auto proc = createRpcTestSocketServerProcess(kNumThreads, 1 /*numSessions*/,
+                                                 true /*multiplexed*/);
+
+    size_t epochMsBefore = epochMillis();
+
+    std::vector<std::thread> ts;
+    for (size_t i = 0; i < kNumCalls; i++) {
+        ts.push_back(std::thread([&] { EXPECT_OK(proc.rootIface->sleepMs(kSleepMs)); }));
+    }
+
+    for (auto& t : ts) t.join();
+
+    size_t epochMsAfter = epochMillis();
+
+    EXPECT_GE(epochMsAfter, epochMsBefore + 2 * kSleepMs);
+
+    // Potential flake, but make sure calls are handled in parallel.
+    EXPECT_LE(epochMsAfter, epochMsBefore + 3 * kSleepMs);
+}
+
+TEST_P(BinderRpc, MultiplexedThreadingStressTest) {
+    constexpr size_t kNumClientThreads = 10;
+    constexpr size_t kNumServerThreads = 4;
+    constexpr size_t kNumCalls = 100;
+
+    auto proc = createRpcTestSocketServerProcess(kNumServerThreads, 1 /*numSessions*/,
+                                                 true /*multiplexed*/);
+
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < kNumClientThreads; i++) {
+        threads.push_back(std::thread([&] {
+            for (size_t j = 0; j < kNumCalls; j++) {
+                sp<IBinder> out;
+                EXPECT_OK(proc.rootIface->repeatBinder(proc.rootBinder, &out));
+                EXPECT_EQ(proc.rootBinder, out);
+            }
+        }));
+    }
+
+    for (auto& t : threads) t.join();
+}
+
+TEST_P(BinderRpc, MultiplexedNestedTransactions) {
+    // each nested call back into the server waits on a worker of its own
+    constexpr size_t kNumServerThreads = 10;
+
+    auto proc = createRpcTestSocketServerProcess(kNumServerThreads, 1 /*numSessions*/,
+                                                 true /*multiplexed*/);
+
+    auto nastyNester = sp<MyBinderRpcTest>::make();
+    EXPECT_OK(proc.rootIface->nestMe(nastyNester, 10));
+}
+
 TEST_P(BinderRpc, ThreadingStressTest) {
     constexpr size_t kNumClientThreads = 10;
     constexpr size_t kNumServerThreads = 10;
@@ -868,6 +953,52 @@ TEST_P(BinderRpc, OnewayCallQueueing) {
     EXPECT_GT(epochMsAfter, epochMsBefore + kSleepMs * kNumSleeps);
 }
 
+TEST_P(BinderRpc, OnewayBatchQueueing) {
+    constexpr size_t kNumSleeps = 10;
+    constexpr size_t kNumExtraServerThreads = 4;
+    constexpr size_t kSleepMs = 50;
+
+    // only the synchronous call below flushes the batch
+    auto proc = createRpcTestSocketServerProcess(1 + kNumExtraServerThreads, 1 /*numSessions*/,
+                                                 false /*multiplexed*/,
+                                                 4096 /*onewayBatchBytes*/);
+
+    EXPECT_OK(proc.rootIface->lock());
+
+    for (size_t i = 0; i < kNumSleeps; i++) {
+        // these should be batched, and then processed serially
+        proc.rootIface->sleepMsAsync(kSleepMs);
+    }
+    EXPECT_OK(proc.rootIface->unlockInMsAsync(kSleepMs));
+
+    size_t epochMsBefore = epochMillis();
+    EXPECT_OK(proc.rootIface->lockUnlock());
+    size_t epochMsAfter = epochMillis();
+
+    EXPECT_GT(epochMsAfter, epochMsBefore + kSleepMs * kNumSleeps);
+}
+
+TEST_P(BinderRpc, OnewayBatchIsSentBeforeLastRefIsDropped) {
+    constexpr int32_t kNumOneways = 10;
+
+    auto proc = createRpcTestSocketServerProcess(1, 1 /*numSessions*/, false /*multiplexed*/,
+                                                 4096 /*onewayBatchBytes*/);
+
+    sp<IBinderRpcSession> session;
+    EXPECT_OK(proc.rootIface->openSession("aoeu", &session));
+    for (int32_t i = 0; i < kNumOneways; i++) {
+        EXPECT_OK(session->countOneway());
+    }
+
+    // The batch is held until the window expires, so dropping the session
+    // must send it ahead of the dec-strong that releases the session object.
+    session = nullptr;
+
+    int32_t numOneways;
+    EXPECT_OK(proc.rootIface->getNumSessionOneways(&numOneways));
+    EXPECT_EQ(kNumOneways, numOneways);
+}
+
 TEST_P(BinderRpc, Die) {
     for (bool doDeathCleanup : {true, false}) {
         auto proc = createRpcTestSocketServerProcess(1);
@@ -934,6 +1065,7 @@ TEST_P(BinderRpc, Fds) {
 INSTANTIATE_TEST_CASE_P(PerSocket, BinderRpc,
                         ::testing::ValuesIn({
                                 SocketType::UNIX,
+                                SocketType::UNIX_SHARED_MEMORY,
 // TODO(b/185269356): working on host
 #ifdef __BIONIC__
                                 SocketType::VSOCK,
@@ -25,8 +25,11 @@ static constexpr bool DEBUG_TRANSPORT_ACTIONS = false;
 #include <math.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
+#include <algorithm>
+
 #include <android-base/stringprintf.h>
 #include <binder/Parcel.h>
 #include <cutils/properties.h>
@@ -46,6 +49,11 @@ namespace android {
 // behind processing touches.
 static const size_t SOCKET_BUFFER_SIZE = 32 * 1024;
 
+// Maximum number of messages sent or received with a single system call.  An InputMessage is a
+// few KB, so the messages are kept in buffers owned by the channel, publisher or consumer, which
+// are reused, rather than on the stack of the thread that sends or receives them.
+static const size_t MESSAGE_BATCH_SIZE = 8;
+
 // Nanoseconds per milliseconds.
 static const nsecs_t NANOS_PER_MS = 1000000;
 
@@ -105,10 +113,13 @@ bool InputMessage::isValid(size_t actualSize) const {
         case Type::KEY:
             return true;
         case Type::MOTION: {
-            const bool valid =
-                    body.motion.pointerCount > 0 && body.motion.pointerCount <= MAX_POINTERS;
+            const bool valid = body.motion.pointerCount > 0 &&
+                    body.motion.pointerCount <= MAX_POINTERS &&
+                    body.motion.historySize <=
+                            InputPublisher::getMaxMotionHistorySize(body.motion.pointerCount);
             if (!valid) {
-                ALOGE("Received invalid MOTION: pointerCount = %" PRIu32, body.motion.pointerCount);
+                ALOGE("Received invalid MOTION: pointerCount = %" PRIu32 ", historySize = %" PRIu32,
+                      body.motion.pointerCount, body.motion.historySize);
             }
             return valid;
         }
@@ -248,8 +259,12 @@ void InputMessage::getSanitizedCopy(InputMessage* msg) const {
             msg->body.motion.displayHeight = body.motion.displayHeight;
             // uint32_t pointerCount
             msg->body.motion.pointerCount = body.motion.pointerCount;
+            // uint32_t historySize
+            msg->body.motion.historySize = body.motion.historySize;
             //struct Pointer pointers[MAX_POINTERS]
-            for (size_t i = 0; i < body.motion.pointerCount; i++) {
+            const size_t pointerSlots =
+                    body.motion.pointerCount * (size_t(body.motion.historySize) + 1);
+            for (size_t i = 0; i < pointerSlots; i++) {
                 // PointerProperties properties
                 msg->body.motion.pointers[i].properties.id = body.motion.pointers[i].properties.id;
                 msg->body.motion.pointers[i].properties.toolType =
@@ -428,6 +443,150 @@ status_t InputChannel::receiveMessage(InputMessage* msg) {
     return OK;
 }
 
+status_t InputChannel::sendMessages(const InputMessage* msgs, size_t count, size_t* outSent) {
+    *outSent = 0;
+    if (mSanitizedMessages.empty()) {
+        mSanitizedMessages.resize(MESSAGE_BATCH_SIZE);
+    }
+    InputMessage* cleanMsgs = mSanitizedMessages.data();
+    struct iovec iovs[MESSAGE_BATCH_SIZE];
+    struct mmsghdr headers[MESSAGE_BATCH_SIZE];
+    while (*outSent < count) {
+        const size_t batchSize = std::min(count - *outSent, MESSAGE_BATCH_SIZE);
+        for (size_t i = 0; i < batchSize; i++) {
+            const InputMessage& msg = msgs[*outSent + i];
+            msg.getSanitizedCopy(&cleanMsgs[i]);
+            iovs[i].iov_base = &cleanMsgs[i];
+            iovs[i].iov_len = msg.size();
+            memset(&headers[i], 0, sizeof(headers[i]));
+            headers[i].msg_hdr.msg_iov = &iovs[i];
+            headers[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        int nSent;
+        do {
+            nSent = ::sendmmsg(getFd(), headers, batchSize, MSG_DONTWAIT | MSG_NOSIGNAL);
+        } while (nSent == -1 && errno == EINTR);
+
+        if (nSent < 0) {
+            int error = errno;
+#if DEBUG_CHANNEL_MESSAGES
+            ALOGD("channel '%s' ~ error sending message of type %d, %s", mName.c_str(),
+                  msgs[*outSent].header.type, strerror(error));
+#endif
+            if (error == EAGAIN || error == EWOULDBLOCK) {
+                return WOULD_BLOCK;
+            }
+            if (error == EPIPE || error == ENOTCONN || error == ECONNREFUSED ||
+                error == ECONNRESET) {
+                return DEAD_OBJECT;
+            }
+            return -error;
+        }
+
+        for (int i = 0; i < nSent; i++) {
+            if (headers[i].msg_len != iovs[i].iov_len) {
+#if DEBUG_CHANNEL_MESSAGES
+                ALOGD("channel '%s' ~ error sending message type %d, send was incomplete",
+                      mName.c_str(), msgs[*outSent].header.type);
+#endif
+                return DEAD_OBJECT;
+            }
+            *outSent += 1;
+        }
+#if DEBUG_CHANNEL_MESSAGES
+        ALOGD("channel '%s' ~ sent %d messages", mName.c_str(), nSent);
+#endif
+        // If fewer messages were sent than requested, the next one failed, and sending it again
+        // returns the reason.
+    }
+    return OK;
+}
+
+status_t InputChannel::receiveMessages(InputMessage* msgs, size_t capacity,
+                                       size_t* outReceived) {
+    *outReceived = 0;
+    struct iovec iovs[MESSAGE_BATCH_SIZE];
+    struct mmsghdr headers[MESSAGE_BATCH_SIZE];
+    while (*outReceived < capacity) {
+        const size_t batchSize = std::min(capacity - *outReceived, MESSAGE_BATCH_SIZE);
+        for (size_t i = 0; i < batchSize; i++) {
+            iovs[i].iov_base = &msgs[*outReceived + i];
+            iovs[i].iov_len = sizeof(InputMessage);
+            memset(&headers[i], 0, sizeof(headers[i]));
+            headers[i].msg_hdr.msg_iov = &iovs[i];
+            headers[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        int nReceived;
+        do {
+            nReceived = ::recvmmsg(getFd(), headers, batchSize, MSG_DONTWAIT, nullptr);
+        } while (nReceived == -1 && errno == EINTR);
+
+        if (nReceived < 0) {
+            int error = errno;
+            if (*outReceived > 0) {
+                // Let the caller handle the messages received so far, the next receive reports
+                // the error.
+                break;
+            }
+#if DEBUG_CHANNEL_MESSAGES
+            ALOGD("channel '%s' ~ receive messages failed, errno=%d", mName.c_str(), errno);
+#endif
+            if (error == EAGAIN || error == EWOULDBLOCK) {
+                return WOULD_BLOCK;
+            }
+            if (error == EPIPE || error == ENOTCONN || error == ECONNREFUSED) {
+                return DEAD_OBJECT;
+            }
+            return -error;
+        }
+
+        // The whole batch was already read from the socket, so an invalid message is skipped and
+        // the valid messages before and after it are returned along with the error.
+        const size_t batchStart = *outReceived;
+        bool hasInvalidMessage = false;
+        for (int i = 0; i < nReceived; i++) {
+            const size_t nRead = headers[i].msg_len;
+            if (nRead == 0) { // check for EOF
+                if (hasInvalidMessage) {
+                    return BAD_VALUE;
+                }
+                if (*outReceived > 0) {
+                    // As above, the next receive reports that the peer was closed.
+                    return OK;
+                }
+#if DEBUG_CHANNEL_MESSAGES
+                ALOGD("channel '%s' ~ receive message failed because peer was closed",
+                      mName.c_str());
+#endif
+                return DEAD_OBJECT;
+            }
+            if (!msgs[batchStart + i].isValid(nRead)) {
+                ALOGE("channel '%s' ~ received invalid message of size %zu", mName.c_str(),
+                      nRead);
+                hasInvalidMessage = true;
+                continue;
+            }
+            if (*outReceived != batchStart + i) {
+                msgs[*outReceived] = msgs[batchStart + i];
+            }
+            *outReceived += 1;
+        }
+#if DEBUG_CHANNEL_MESSAGES
+        ALOGD("channel '%s' ~ received %d messages", mName.c_str(), nReceived);
+#endif
+        if (hasInvalidMessage) {
+            return BAD_VALUE;
+        }
+        if (size_t(nReceived) < batchSize) {
+            // The channel is empty.
+            break;
+        }
+    }
+    return OK;
+}
+
 std::unique_ptr<InputChannel> InputChannel::dup() const {
     base::unique_fd newFd(dupFd());
     return InputChannel::create(getName(), std::move(newFd), getConnectionToken());
@@ -480,7 +639,8 @@ base::unique_fd InputChannel::dupFd() const {
 
 // --- InputPublisher ---
 
-InputPublisher::InputPublisher(const std::shared_ptr<InputChannel>& channel) : mChannel(channel) {}
+InputPublisher::InputPublisher(const std::shared_ptr<InputChannel>& channel)
+      : mChannel(channel), mBatching(false) {}
 
 InputPublisher::~InputPublisher() {
 }
@@ -525,7 +685,7 @@ status_t InputPublisher::publishKeyEvent(uint32_t seq, int32_t eventId, int32_t
     msg.body.key.repeatCount = repeatCount;
     msg.body.key.downTime = downTime;
     msg.body.key.eventTime = eventTime;
-    return mChannel->sendMessage(&msg);
+    return publishMessage(msg);
 }
 
 status_t InputPublisher::publishMotionEvent(
@@ -535,11 +695,13 @@ status_t InputPublisher::publishMotionEvent(
         MotionClassification classification, const ui::Transform& transform, float xPrecision,
         float yPrecision, float xCursorPosition, float yCursorPosition, int32_t displayWidth,
         int32_t displayHeight, nsecs_t downTime, nsecs_t eventTime, uint32_t pointerCount,
-        const PointerProperties* pointerProperties, const PointerCoords* pointerCoords) {
+        const PointerProperties* pointerProperties, const PointerCoords* pointerCoords,
+        size_t historySize, const nsecs_t* historicalEventTimes,
+        const PointerCoords* historicalCoords) {
     if (ATRACE_ENABLED()) {
         std::string message = StringPrintf(
-                "publishMotionEvent(inputChannel=%s, action=%" PRId32 ")",
-                mChannel->getName().c_str(), action);
+                "publishMotionEvent(inputChannel=%s, action=%" PRId32 ", historySize=%zu)",
+                mChannel->getName().c_str(), action, historySize);
         ATRACE_NAME(message.c_str());
     }
     if (DEBUG_TRANSPORT_ACTIONS) {
@@ -568,6 +730,13 @@ status_t InputPublisher::publishMotionEvent(
         return BAD_VALUE;
     }
 
+    if (historySize > getMaxMotionHistorySize(pointerCount)) {
+        ALOGE("channel '%s' publisher ~ %zu historical samples of %" PRIu32
+              " pointers do not fit in a message.",
+              mChannel->getName().c_str(), historySize, pointerCount);
+        return BAD_VALUE;
+    }
+
     InputMessage msg;
     msg.header.type = InputMessage::Type::MOTION;
     msg.header.seq = seq;
@@ -602,8 +771,23 @@ status_t InputPublisher::publishMotionEvent(
         msg.body.motion.pointers[i].properties.copyFrom(pointerProperties[i]);
         msg.body.motion.pointers[i].coords.copyFrom(pointerCoords[i]);
     }
+    msg.body.motion.historySize = historySize;
+    for (size_t h = 0; h < historySize; h++) {
+        msg.body.motion.setHistoricalEventTime(h, historicalEventTimes[h]);
+        for (uint32_t i = 0; i < pointerCount; i++) {
+            msg.body.motion.pointers[pointerCount * (h + 1) + i].coords.copyFrom(
+                    historicalCoords[pointerCount * h + i]);
+        }
+    }
 
-    return mChannel->sendMessage(&msg);
+    return publishMessage(msg);
+}
+
+size_t InputPublisher::getMaxMotionHistorySize(uint32_t pointerCount) {
+    if (pointerCount < 1 || pointerCount > MAX_POINTERS) {
+        return 0;
+    }
+    return MAX_POINTERS / pointerCount - 1;
 }
 
 status_t InputPublisher::publishFocusEvent(uint32_t seq, int32_t eventId, bool hasFocus,
@@ -622,7 +806,7 @@ status_t InputPublisher::publishFocusEvent(uint32_t seq, int32_t eventId, bool h
     msg.body.focus.eventId = eventId;
     msg.body.focus.hasFocus = hasFocus;
     msg.body.focus.inTouchMode = inTouchMode;
-    return mChannel->sendMessage(&msg);
+    return publishMessage(msg);
 }
 
 status_t InputPublisher::publishCaptureEvent(uint32_t seq, int32_t eventId,
@@ -639,7 +823,7 @@ status_t InputPublisher::publishCaptureEvent(uint32_t seq, int32_t eventId,
     msg.header.seq = seq;
     msg.body.capture.eventId = eventId;
     msg.body.capture.pointerCaptureEnabled = pointerCaptureEnabled;
-    return mChannel->sendMessage(&msg);
+    return publishMessage(msg);
 }
 
 status_t InputPublisher::publishDragEvent(uint32_t seq, int32_t eventId, float x, float y,
@@ -658,6 +842,33 @@ status_t InputPublisher::publishDragEvent(uint32_t seq, int32_t eventId, float x
     msg.body.drag.isExiting = isExiting;
     msg.body.drag.x = x;
     msg.body.drag.y = y;
+    return publishMessage(msg);
+}
+
+void InputPublisher::beginBatch() {
+    LOG_ALWAYS_FATAL_IF(mBatching, "channel '%s' publisher ~ already publishing a batch",
+                        mChannel->getName().c_str());
+    mBatching = true;
+}
+
+status_t InputPublisher::endBatch(size_t* outSent) {
+    LOG_ALWAYS_FATAL_IF(!mBatching, "channel '%s' publisher ~ not publishing a batch",
+                        mChannel->getName().c_str());
+    mBatching = false;
+    *outSent = 0;
+    if (mBatchMessages.empty()) {
+        return OK;
+    }
+    status_t status = mChannel->sendMessages(mBatchMessages.data(), mBatchMessages.size(), outSent);
+    mBatchMessages.clear();
+    return status;
+}
+
+status_t InputPublisher::publishMessage(const InputMessage& msg) {
+    if (mBatching) {
+        mBatchMessages.push_back(msg);
+        return OK;
+    }
     return mChannel->sendMessage(&msg);
 }
 
@@ -671,6 +882,37 @@ android::base::Result<InputPublisher::ConsumerResponse> InputPublisher::receiveC
     if (result) {
         return android::base::Error(result);
     }
+    return toConsumerResponse(msg);
+}
+
+status_t InputPublisher::receiveConsumerResponses(std::vector<ConsumerResponse>* outResponses) {
+    if (DEBUG_TRANSPORT_ACTIONS) {
+        ALOGD("channel '%s' publisher ~ %s", mChannel->getName().c_str(), __func__);
+    }
+
+    if (mReceivedResponses.empty()) {
+        mReceivedResponses.resize(MESSAGE_BATCH_SIZE);
+    }
+    for (;;) {
+        size_t count;
+        status_t result = mChannel->receiveMessages(mReceivedResponses.data(),
+                                                    mReceivedResponses.size(), &count);
+        for (size_t i = 0; i < count; i++) {
+            android::base::Result<ConsumerResponse> response =
+                    toConsumerResponse(mReceivedResponses[i]);
+            if (!response.ok()) {
+                return response.error().code();
+            }
+            outResponses->push_back(std::move(*response));
+        }
+        if (result) {
+            return result;
+        }
+    }
+}
+
+android::base::Result<InputPublisher::ConsumerResponse> InputPublisher::toConsumerResponse(
+        const InputMessage& msg) const {
     if (msg.header.type == InputMessage::Type::FINISHED) {
         return Finished{
                 .seq = msg.header.seq,
@@ -694,7 +936,14 @@ android::base::Result<InputPublisher::ConsumerResponse> InputPublisher::receiveC
 // --- InputConsumer ---
 
 InputConsumer::InputConsumer(const std::shared_ptr<InputChannel>& channel)
-      : mResampleTouch(isTouchResamplingEnabled()), mChannel(channel), mMsgDeferred(false) {}
+      : mResampleTouch(isTouchResamplingEnabled()),
+        mResampleLatency(RESAMPLE_LATENCY),
+        mMaxPrediction(RESAMPLE_MAX_PREDICTION),
+        mChannel(channel),
+        mMsgDeferred(false),
+        mReceivedIndex(0),
+        mReceivedCount(0),
+        mReceiveError(OK) {}
 
 InputConsumer::~InputConsumer() {
 }
@@ -703,6 +952,24 @@ bool InputConsumer::isTouchResamplingEnabled() {
     return property_get_bool(PROPERTY_RESAMPLING_ENABLED, true);
 }
 
+void InputConsumer::setTouchPredictor(TouchPredictorFactory factory, nsecs_t resampleLatency,
+                                      nsecs_t maxPrediction) {
+    if (factory) {
+        mTouchPredictorFactory = std::move(factory);
+        mResampleLatency = resampleLatency;
+        mMaxPrediction = maxPrediction;
+    } else {
+        mTouchPredictorFactory = nullptr;
+        mResampleLatency = RESAMPLE_LATENCY;
+        mMaxPrediction = RESAMPLE_MAX_PREDICTION;
+    }
+    // The predictors of the previous factory are not used again.  Touches that are in progress
+    // are extrapolated linearly until they end.
+    for (TouchState& touchState : mTouchStates) {
+        touchState.predictor.reset();
+    }
+}
+
 status_t InputConsumer::consume(InputEventFactoryInterface* factory, bool consumeBatches,
                                 nsecs_t frameTime, uint32_t* outSeq, InputEvent** outEvent) {
     if (DEBUG_TRANSPORT_ACTIONS) {
@@ -722,7 +989,7 @@ status_t InputConsumer::consume(InputEventFactoryInterface* factory, bool consum
             mMsgDeferred = false;
         } else {
             // Receive a fresh message.
-            status_t result = mChannel->receiveMessage(&mMsg);
+            status_t result = receiveNextMessage(&mMsg);
             if (result == OK) {
                 mConsumeTimes.emplace(mMsg.header.seq, systemTime(SYSTEM_TIME_MONOTONIC));
             }
@@ -881,7 +1148,7 @@ status_t InputConsumer::consumeBatch(InputEventFactoryInterface* factory,
 
         nsecs_t sampleTime = frameTime;
         if (mResampleTouch) {
-            sampleTime -= RESAMPLE_LATENCY;
+            sampleTime -= mResampleLatency;
         }
         ssize_t split = findSampleNoLaterThan(batch, sampleTime);
         if (split < 0) {
@@ -953,6 +1220,14 @@ void InputConsumer::updateTouchState(InputMessage& msg) {
         TouchState& touchState = mTouchStates[index];
         touchState.initialize(deviceId, source);
         touchState.addHistory(msg);
+        if (mTouchPredictorFactory) {
+            if (touchState.predictor) {
+                touchState.predictor->clear();
+            } else {
+                touchState.predictor = mTouchPredictorFactory();
+            }
+            addTouchPredictorMovement(touchState, *touchState.getHistory(0));
+        }
         break;
     }
 
@@ -960,7 +1235,16 @@ void InputConsumer::updateTouchState(InputMessage& msg) {
         ssize_t index = findTouchState(deviceId, source);
         if (index >= 0) {
             TouchState& touchState = mTouchStates[index];
+            if (touchState.predictor) {
+                // The samples coalesced into the message by the dispatcher come before it.
+                for (size_t h = 0; h < msg.body.motion.historySize; h++) {
+                    History history;
+                    history.initializeFromHistoricalSample(msg, h);
+                    addTouchPredictorMovement(touchState, history);
+                }
+            }
             touchState.addHistory(msg);
+            addTouchPredictorMovement(touchState, *touchState.getHistory(0));
             rewriteMessage(touchState, msg);
         }
         break;
@@ -971,6 +1255,15 @@ void InputConsumer::updateTouchState(InputMessage& msg) {
         if (index >= 0) {
             TouchState& touchState = mTouchStates[index];
             touchState.lastResample.idBits.clearBit(msg.body.motion.getActionId());
+            if (touchState.predictor) {
+                // The new pointer may reuse the id of one that went up earlier.
+                BitSet32 actionIdBits;
+                actionIdBits.markBit(msg.body.motion.getActionId());
+                touchState.predictor->clearPointers(actionIdBits);
+                History history;
+                history.initializeFrom(msg);
+                addTouchPredictorMovement(touchState, history);
+            }
             rewriteMessage(touchState, msg);
         }
         break;
@@ -1008,6 +1301,20 @@ void InputConsumer::updateTouchState(InputMessage& msg) {
     }
 }
 
+void InputConsumer::addTouchPredictorMovement(TouchState& touchState, const History& history) {
+    if (!touchState.predictor) {
+        return;
+    }
+
+    // The predictor takes the positions in order of increasing pointer id.
+    mPredictorPositions.clear();
+    for (BitSet32 idBits(history.idBits); !idBits.isEmpty();) {
+        const PointerCoords& coords = history.getPointerById(idBits.clearFirstMarkedBit());
+        mPredictorPositions.push_back({coords.getX(), coords.getY()});
+    }
+    touchState.predictor->addMovement(history.eventTime, history.idBits, mPredictorPositions);
+}
+
 /**
  * Replace the coordinates in msg with the coordinates in lastResample, if necessary.
  *
@@ -1080,9 +1387,10 @@ void InputConsumer::resampleTouchState(nsecs_t sampleTime, MotionEvent* event,
     }
 
     // Find the data to use for resampling.
-    const History* other;
+    const History* other = nullptr;
+    const TouchPredictor* predictor = nullptr;
     History future;
-    float alpha;
+    float alpha = 0;
     if (next) {
         // Interpolate between current sample and future sample.
         // So current->eventTime <= sampleTime <= future.eventTime.
@@ -1096,6 +1404,19 @@ void InputConsumer::resampleTouchState(nsecs_t sampleTime, MotionEvent* event,
             return;
         }
         alpha = float(sampleTime - current->eventTime) / delta;
+    } else if (touchState.predictor) {
+        // Predict future sample from all the samples received so far.
+        // So current->eventTime <= sampleTime.
+        nsecs_t maxPredict = current->eventTime + mMaxPrediction;
+        if (sampleTime > maxPredict) {
+#if DEBUG_RESAMPLING
+            ALOGD("Sample time is too far in the future, adjusting prediction "
+                    "from %" PRId64 " to %" PRId64 " ns.",
+                    sampleTime - current->eventTime, maxPredict - current->eventTime);
+#endif
+            sampleTime = maxPredict;
+        }
+        predictor = touchState.predictor.get();
     } else if (touchState.historySize >= 2) {
         // Extrapolate future sample using current sample and past sample.
         // So other->eventTime <= current->eventTime <= sampleTime.
@@ -1153,7 +1474,19 @@ void InputConsumer::resampleTouchState(nsecs_t sampleTime, MotionEvent* event,
         PointerCoords& resampledCoords = touchState.lastResample.pointers[i];
         const PointerCoords& currentCoords = current->getPointerById(id);
         resampledCoords.copyFrom(currentCoords);
-        if (other->idBits.hasBit(id)
+        VelocityTracker::Position predictedPosition;
+        if (predictor) {
+            if (shouldResampleTool(event->getToolType(i)) &&
+                predictor->predict(id, sampleTime, &predictedPosition)) {
+                resampledCoords.setAxisValue(AMOTION_EVENT_AXIS_X, predictedPosition.x);
+                resampledCoords.setAxisValue(AMOTION_EVENT_AXIS_Y, predictedPosition.y);
+            }
+#if DEBUG_RESAMPLING
+            ALOGD("[%d] - out (%0.3f, %0.3f), cur (%0.3f, %0.3f), predicted",
+                    id, resampledCoords.getX(), resampledCoords.getY(),
+                    currentCoords.getX(), currentCoords.getY());
+#endif
+        } else if (other->idBits.hasBit(id)
                 && shouldResampleTool(event->getToolType(i))) {
             const PointerCoords& otherCoords = other->getPointerById(id);
             resampledCoords.setAxisValue(AMOTION_EVENT_AXIS_X,
@@ -1211,12 +1544,38 @@ status_t InputConsumer::sendFinishedSignal(uint32_t seq, bool handled) {
                  mSeqChains.erase(mSeqChains.begin() + i);
              }
         }
-        status_t status = OK;
-        while (!status && chainIndex > 0) {
-            chainIndex--;
-            status = sendUnchainedFinishedSignal(chainSeqs[chainIndex], handled);
-        }
-        if (status) {
+        if (chainIndex) {
+            // Send the signals for the chain, then the one for the last message in the batch,
+            // with as few system calls as possible.
+            const size_t count = chainIndex + 1;
+            if (mFinishedMessages.empty()) {
+                mFinishedMessages.resize(MESSAGE_BATCH_SIZE);
+            }
+            InputMessage* msgs = mFinishedMessages.data();
+            size_t sent = 0;
+            status_t status = OK;
+            while (!status && sent < count) {
+                const size_t batchSize = std::min(count - sent, MESSAGE_BATCH_SIZE);
+                for (size_t i = 0; i < batchSize; i++) {
+                    const size_t position = sent + i;
+                    initializeFinishedMessage(&msgs[i],
+                                              position < chainIndex
+                                                      ? chainSeqs[chainIndex - 1 - position]
+                                                      : seq,
+                                              handled);
+                }
+                size_t batchSent;
+                status = mChannel->sendMessages(msgs, batchSize, &batchSent);
+                for (size_t i = 0; i < batchSent; i++) {
+                    popConsumeTime(msgs[i].header.seq);
+                }
+                sent += batchSent;
+            }
+            if (!status || sent >= chainIndex) {
+                return status;
+            }
+            chainIndex -= sent + 1;
+
             // An error occurred so at least one signal was not sent, reconstruct the chain.
             for (;;) {
                 SeqChain seqChain;
@@ -1265,12 +1624,17 @@ void InputConsumer::popConsumeTime(uint32_t seq) {
     mConsumeTimes.erase(seq);
 }
 
+void InputConsumer::initializeFinishedMessage(InputMessage* msg, uint32_t seq,
+                                              bool handled) const {
+    msg->header.type = InputMessage::Type::FINISHED;
+    msg->header.seq = seq;
+    msg->body.finished.handled = handled;
+    msg->body.finished.consumeTime = getConsumeTime(seq);
+}
+
 status_t InputConsumer::sendUnchainedFinishedSignal(uint32_t seq, bool handled) {
     InputMessage msg;
-    msg.header.type = InputMessage::Type::FINISHED;
-    msg.header.seq = seq;
-    msg.body.finished.handled = handled;
-    msg.body.finished.consumeTime = getConsumeTime(seq);
+    initializeFinishedMessage(&msg, seq, handled);
     status_t result = mChannel->sendMessage(&msg);
     if (result == OK) {
         // Remove the consume time if the socket write succeeded. We will not need to ack this
@@ -1281,8 +1645,33 @@ status_t InputConsumer::sendUnchainedFinishedSignal(uint32_t seq, bool handled)
     return result;
 }
 
+status_t InputConsumer::receiveNextMessage(InputMessage* msg) {
+    if (mReceivedIndex == mReceivedCount) {
+        if (mReceiveError) {
+            status_t result = mReceiveError;
+            mReceiveError = OK;
+            return result;
+        }
+        // Drain the channel, so that a burst of messages costs one system call.
+        if (mReceivedMessages.empty()) {
+            mReceivedMessages.resize(MESSAGE_BATCH_SIZE);
+        }
+        mReceivedIndex = 0;
+        status_t result = mChannel->receiveMessages(mReceivedMessages.data(),
+                                                    mReceivedMessages.size(), &mReceivedCount);
+        if (result) {
+            if (!mReceivedCount) {
+                return result;
+            }
+            mReceiveError = result;
+        }
+    }
+    *msg = mReceivedMessages[mReceivedIndex++];
+    return OK;
+}
+
 bool InputConsumer::hasDeferredEvent() const {
-    return mMsgDeferred;
+    return mMsgDeferred || mReceivedIndex < mReceivedCount || mReceiveError != OK;
 }
 
 bool InputConsumer::hasPendingBatch() const {
@@ -1346,10 +1735,16 @@ void InputConsumer::initializeMotionEvent(MotionEvent* event, const InputMessage
     uint32_t pointerCount = msg->body.motion.pointerCount;
     PointerProperties pointerProperties[pointerCount];
     PointerCoords pointerCoords[pointerCount];
+    // The event starts at the oldest sample in the message, and the others are added to it.
+    const bool hasHistory = msg->body.motion.historySize > 0;
+    const InputMessage::Body::Motion::Pointer* firstPointers =
+            hasHistory ? msg->body.motion.getHistoricalPointers(0) : msg->body.motion.pointers;
     for (uint32_t i = 0; i < pointerCount; i++) {
         pointerProperties[i].copyFrom(msg->body.motion.pointers[i].properties);
-        pointerCoords[i].copyFrom(msg->body.motion.pointers[i].coords);
+        pointerCoords[i].copyFrom(firstPointers[i].coords);
     }
+    const nsecs_t firstEventTime = hasHistory ? msg->body.motion.getHistoricalEventTime(0)
+                                              : msg->body.motion.eventTime;
 
     ui::Transform transform;
     transform.set({msg->body.motion.dsdx, msg->body.motion.dtdx, msg->body.motion.tx,
@@ -1362,18 +1757,34 @@ void InputConsumer::initializeMotionEvent(MotionEvent* event, const InputMessage
                       msg->body.motion.xPrecision, msg->body.motion.yPrecision,
                       msg->body.motion.xCursorPosition, msg->body.motion.yCursorPosition,
                       msg->body.motion.displayWidth, msg->body.motion.displayHeight,
-                      msg->body.motion.downTime, msg->body.motion.eventTime, pointerCount,
+                      msg->body.motion.downTime, firstEventTime, pointerCount,
                       pointerProperties, pointerCoords);
+    if (hasHistory) {
+        addSamples(event, msg, 1 /*firstHistoricalSample*/);
+    }
 }
 
 void InputConsumer::addSample(MotionEvent* event, const InputMessage* msg) {
+    event->setMetaState(event->getMetaState() | msg->body.motion.metaState);
+    addSamples(event, msg, 0 /*firstHistoricalSample*/);
+}
+
+void InputConsumer::addSamples(MotionEvent* event, const InputMessage* msg,
+                               size_t firstHistoricalSample) {
     uint32_t pointerCount = msg->body.motion.pointerCount;
     PointerCoords pointerCoords[pointerCount];
+    for (size_t h = firstHistoricalSample; h < msg->body.motion.historySize; h++) {
+        const InputMessage::Body::Motion::Pointer* pointers =
+                msg->body.motion.getHistoricalPointers(h);
+        for (uint32_t i = 0; i < pointerCount; i++) {
+            pointerCoords[i].copyFrom(pointers[i].coords);
+        }
+        event->addSample(msg->body.motion.getHistoricalEventTime(h), pointerCoords);
+    }
+
     for (uint32_t i = 0; i < pointerCount; i++) {
         pointerCoords[i].copyFrom(msg->body.motion.pointers[i].coords);
     }
-
-    event->setMetaState(event->getMetaState() | msg->body.motion.metaState);
     event->addSample(msg->body.motion.eventTime, pointerCoords);
 }
 
@@ -1405,11 +1816,14 @@ ssize_t InputConsumer::findSampleNoLaterThan(const Batch& batch, nsecs_t time) {
 std::string InputConsumer::dump() const {
     std::string out;
     out = out + "mResampleTouch = " + toString(mResampleTouch) + "\n";
+    out = out + "mTouchPredictor = " + toString(bool(mTouchPredictorFactory)) + "\n";
     out = out + "mChannel = " + mChannel->getName() + "\n";
     out = out + "mMsgDeferred: " + toString(mMsgDeferred) + "\n";
     if (mMsgDeferred) {
         out = out + "mMsg : " + NamedEnum::string(mMsg.header.type) + "\n";
     }
+    out += android::base::StringPrintf("Received messages pending: %zu\n",
+                                       mReceivedCount - mReceivedIndex);
     out += "Batches:\n";
     for (const Batch& batch : mBatches) {
         out += "    Batch:\n";
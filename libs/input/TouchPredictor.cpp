@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "TouchPredictor"
+
+#include <input/TouchPredictor.h>
+
+namespace android {
+
+// --- VelocityTrackerTouchPredictor ---
+
+VelocityTrackerTouchPredictor::VelocityTrackerTouchPredictor(VelocityTracker::Strategy strategy)
+      : mVelocityTracker(strategy) {}
+
+VelocityTrackerTouchPredictor::~VelocityTrackerTouchPredictor() {}
+
+void VelocityTrackerTouchPredictor::clear() {
+    mVelocityTracker.clear();
+}
+
+void VelocityTrackerTouchPredictor::clearPointers(BitSet32 idBits) {
+    mVelocityTracker.clearPointers(idBits);
+}
+
+void VelocityTrackerTouchPredictor::addMovement(
+        nsecs_t eventTime, BitSet32 idBits,
+        const std::vector<VelocityTracker::Position>& positions) {
+    mVelocityTracker.addMovement(eventTime, idBits, positions);
+}
+
+bool VelocityTrackerTouchPredictor::predict(uint32_t id, nsecs_t time,
+                                            VelocityTracker::Position* outPosition) const {
+    VelocityTracker::Estimator estimator;
+    if (!mVelocityTracker.getEstimator(id, &estimator) || estimator.degree < 1) {
+        return false;
+    }
+
+    // Evaluate the polynomials at 'time', relative to the time of the estimator, in seconds.
+    const float t = (time - estimator.time) * 0.000000001f;
+    float x = 0;
+    float y = 0;
+    for (uint32_t i = estimator.degree + 1; i != 0;) {
+        i--;
+        x = x * t + estimator.xCoeff[i];
+        y = y * t + estimator.yCoeff[i];
+    }
+    outPosition->x = x;
+    outPosition->y = y;
+    return true;
+}
+
+} // namespace android
@@ -139,7 +139,7 @@ std::unique_ptr<VelocityTrackerStrategy> VelocityTracker::createStrategy(
             return std::make_unique<LeastSquaresVelocityTrackerStrategy>(1);
 
         case VelocityTracker::Strategy::LSQ2:
-            return std::make_unique<LeastSquaresVelocityTrackerStrategy>(2);
+            return std::make_unique<IncrementalLeastSquaresVelocityTrackerStrategy>();
 
         case VelocityTracker::Strategy::LSQ3:
             return std::make_unique<LeastSquaresVelocityTrackerStrategy>(3);
@@ -743,6 +743,181 @@ float LeastSquaresVelocityTrackerStrategy::chooseWeight(uint32_t index) const {
 }
 
 
+// --- IncrementalLeastSquaresVelocityTrackerStrategy ---
+
+IncrementalLeastSquaresVelocityTrackerStrategy::IncrementalLeastSquaresVelocityTrackerStrategy() {
+    mIndex = 0;
+    mMovements[0].eventTime = 0;
+    mMovements[0].idBits.clear();
+    clear();
+}
+
+IncrementalLeastSquaresVelocityTrackerStrategy::~IncrementalLeastSquaresVelocityTrackerStrategy() {
+}
+
+void IncrementalLeastSquaresVelocityTrackerStrategy::clear() {
+    mPointerIdBits.clear();
+}
+
+void IncrementalLeastSquaresVelocityTrackerStrategy::clearPointers(BitSet32 idBits) {
+    mPointerIdBits.value &= ~idBits.value;
+}
+
+void IncrementalLeastSquaresVelocityTrackerStrategy::addMovement(
+        nsecs_t eventTime, BitSet32 idBits,
+        const std::vector<VelocityTracker::Position>& positions) {
+    if (mMovements[mIndex].eventTime == eventTime) {
+        // As in LeastSquaresVelocityTrackerStrategy, a movement with the same time as the newest
+        // one replaces it, so take the newest samples back out of the sums.
+        for (BitSet32 iterIdBits(mPointerIdBits); !iterIdBits.isEmpty();) {
+            uint32_t id = iterIdBits.clearFirstMarkedBit();
+            Sums& sums = mSums[id];
+            accumulate(sums, mMovements[mIndex], id, -1);
+            if (--sums.sampleCount == 0) {
+                mPointerIdBits.clearBit(id);
+            }
+        }
+    } else {
+        mIndex = (mIndex + 1) % HISTORY_SIZE;
+        // The movement about to be overwritten holds the oldest sample of the pointers that have
+        // a full history.
+        for (BitSet32 iterIdBits(mPointerIdBits); !iterIdBits.isEmpty();) {
+            uint32_t id = iterIdBits.clearFirstMarkedBit();
+            Sums& sums = mSums[id];
+            if (sums.sampleCount == HISTORY_SIZE) {
+                accumulate(sums, mMovements[mIndex], id, -1);
+                sums.sampleCount--;
+            }
+        }
+    }
+
+    Movement& movement = mMovements[mIndex];
+    movement.eventTime = eventTime;
+    movement.idBits = idBits;
+    uint32_t count = idBits.count();
+    for (uint32_t i = 0; i < count; i++) {
+        movement.positions[i] = positions[i];
+    }
+
+    // A pointer that is missing from a movement starts over when it comes back.
+    mPointerIdBits.value &= idBits.value;
+    for (BitSet32 iterIdBits(idBits); !iterIdBits.isEmpty();) {
+        uint32_t id = iterIdBits.clearFirstMarkedBit();
+        Sums& sums = mSums[id];
+        if (!mPointerIdBits.hasBit(id)) {
+            sums = {};
+            sums.baseTime = eventTime;
+            mPointerIdBits.markBit(id);
+        }
+        accumulate(sums, movement, id, 1);
+        sums.sampleCount++;
+
+        while (eventTime - mMovements[getOldestIndex(sums)].eventTime > HORIZON) {
+            accumulate(sums, mMovements[getOldestIndex(sums)], id, -1);
+            sums.sampleCount--;
+        }
+        if (eventTime - sums.baseTime > HORIZON) {
+            rebase(sums, id);
+        }
+    }
+}
+
+void IncrementalLeastSquaresVelocityTrackerStrategy::accumulate(Sums& sums,
+                                                                const Movement& movement,
+                                                                uint32_t id, double sign) const {
+    const VelocityTracker::Position& position = movement.getPosition(id);
+    const double t = (movement.eventTime - sums.baseTime) * 0.000000001;
+    const double t2 = t * t;
+    sums.t += sign * t;
+    sums.t2 += sign * t2;
+    sums.t3 += sign * t2 * t;
+    sums.t4 += sign * t2 * t2;
+    sums.x += sign * position.x;
+    sums.tx += sign * t * position.x;
+    sums.t2x += sign * t2 * position.x;
+    sums.y += sign * position.y;
+    sums.ty += sign * t * position.y;
+    sums.t2y += sign * t2 * position.y;
+}
+
+void IncrementalLeastSquaresVelocityTrackerStrategy::rebase(Sums& sums, uint32_t id) const {
+    const uint32_t sampleCount = sums.sampleCount;
+    const uint32_t oldestIndex = getOldestIndex(sums);
+    sums = {};
+    sums.sampleCount = sampleCount;
+    sums.baseTime = mMovements[oldestIndex].eventTime;
+    for (uint32_t i = 0; i < sampleCount; i++) {
+        accumulate(sums, mMovements[(oldestIndex + i) % HISTORY_SIZE], id, 1);
+    }
+}
+
+uint32_t IncrementalLeastSquaresVelocityTrackerStrategy::getOldestIndex(const Sums& sums) const {
+    return (mIndex + HISTORY_SIZE + 1 - sums.sampleCount) % HISTORY_SIZE;
+}
+
+bool IncrementalLeastSquaresVelocityTrackerStrategy::getEstimator(
+        uint32_t id, VelocityTracker::Estimator* outEstimator) const {
+    outEstimator->clear();
+    if (!mPointerIdBits.hasBit(id)) {
+        return false; // no data
+    }
+
+    const Sums& sums = mSums[id];
+    const Movement& newestMovement = mMovements[mIndex];
+    outEstimator->time = newestMovement.eventTime;
+    outEstimator->confidence = 1;
+
+    // The sums are relative to baseTime, while the coefficients are relative to the newest
+    // movement, so the fitted polynomials are shifted by this much.
+    const double n = sums.sampleCount;
+    const double shift = (newestMovement.eventTime - sums.baseTime) * 0.000000001;
+    const double stt = sums.t2 - sums.t * sums.t / n;
+    if (sums.sampleCount == 2) {
+        // A linear fit, as solveLeastSquares would do with two samples. The threshold matches
+        // its check for linearly dependent vectors.
+        if (stt >= 0.000001 * 0.000001) {
+            const double xSlope = (sums.tx - sums.t * sums.x / n) / stt;
+            const double ySlope = (sums.ty - sums.t * sums.y / n) / stt;
+            outEstimator->degree = 1;
+            outEstimator->xCoeff[0] = sums.x / n + xSlope * (shift - sums.t / n);
+            outEstimator->xCoeff[1] = xSlope;
+            outEstimator->yCoeff[0] = sums.y / n + ySlope * (shift - sums.t / n);
+            outEstimator->yCoeff[1] = ySlope;
+            return true;
+        }
+    } else if (sums.sampleCount >= 3) {
+        // Same solution as solveUnweightedLeastSquaresDeg2. Everything but the last two sums of
+        // each axis only depends on the sample times, so it is shared by both axes.
+        const double stt2 = sums.t3 - sums.t * sums.t2 / n;
+        const double st2t2 = sums.t4 - sums.t2 * sums.t2 / n;
+        const double denominator = stt * st2t2 - stt2 * stt2;
+        if (denominator != 0) {
+            auto solve = [&](double s, double ts, double t2s, float* outCoeff) {
+                const double sts = ts - sums.t * s / n;
+                const double st2s = t2s - sums.t2 * s / n;
+                const double a = (st2s * stt - sts * stt2) / denominator;
+                const double b = (sts * st2t2 - st2s * stt2) / denominator;
+                const double c = s / n - b * sums.t / n - a * sums.t2 / n;
+                outCoeff[0] = c + (b + a * shift) * shift;
+                outCoeff[1] = b + 2 * a * shift;
+                outCoeff[2] = a;
+            };
+            outEstimator->degree = 2;
+            solve(sums.x, sums.tx, sums.t2x, outEstimator->xCoeff);
+            solve(sums.y, sums.ty, sums.t2y, outEstimator->yCoeff);
+            return true;
+        }
+    }
+
+    // No velocity data available for this pointer, but we do have its current position.
+    const VelocityTracker::Position& position = newestMovement.getPosition(id);
+    outEstimator->xCoeff[0] = position.x;
+    outEstimator->yCoeff[0] = position.y;
+    outEstimator->degree = 0;
+    return true;
+}
+
+
 // --- IntegratingVelocityTrackerStrategy ---
 
 IntegratingVelocityTrackerStrategy::IntegratingVelocityTrackerStrategy(uint32_t degree) :
@@ -0,0 +1,142 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <attestation/HmacKeyManager.h>
+#include <input/InputTransport.h>
+
+namespace android {
+
+// InputChannel::sendMessages and receiveMessages handle up to this many messages with each
+// system call.
+static constexpr size_t MESSAGES_PER_SYSTEM_CALL = 8;
+
+static void makeMotionMessages(std::vector<InputMessage>& msgs) {
+    for (size_t i = 0; i < msgs.size(); i++) {
+        InputMessage& msg = msgs[i];
+        memset(&msg, 0, sizeof(InputMessage));
+        msg.header.type = InputMessage::Type::MOTION;
+        msg.header.seq = i + 1;
+        msg.body.motion.action = AMOTION_EVENT_ACTION_MOVE;
+        msg.body.motion.pointerCount = 2;
+        for (uint32_t p = 0; p < 2; p++) {
+            msg.body.motion.pointers[p].properties.id = p;
+            msg.body.motion.pointers[p].coords.setAxisValue(AMOTION_EVENT_AXIS_X, 100 + i);
+            msg.body.motion.pointers[p].coords.setAxisValue(AMOTION_EVENT_AXIS_Y, 200 + p);
+        }
+    }
+}
+
+static void setCounters(benchmark::State& state, size_t systemCallsPerBurst) {
+    const size_t burst = state.range(0);
+    state.SetItemsProcessed(state.iterations() * burst);
+    state.counters["syscalls_per_event"] = double(systemCallsPerBurst) / burst;
+}
+
+// Sends a burst of MOVE events, then receives them, one system call per message.
+static void BM_SendAndReceiveOneAtATime(benchmark::State& state) {
+    std::unique_ptr<InputChannel> serverChannel, clientChannel;
+    InputChannel::openInputChannelPair("benchmark", serverChannel, clientChannel);
+    std::vector<InputMessage> msgs(state.range(0));
+    makeMotionMessages(msgs);
+    InputMessage received;
+
+    for (auto _ : state) {
+        for (const InputMessage& msg : msgs) {
+            if (serverChannel->sendMessage(&msg) != OK) {
+                state.SkipWithError("sendMessage failed");
+                return;
+            }
+        }
+        for (size_t i = 0; i < msgs.size(); i++) {
+            if (clientChannel->receiveMessage(&received) != OK) {
+                state.SkipWithError("receiveMessage failed");
+                return;
+            }
+        }
+    }
+    setCounters(state, 2 * msgs.size());
+}
+BENCHMARK(BM_SendAndReceiveOneAtATime)->Arg(1)->Arg(4)->Arg(16);
+
+// The same burst, sent and received with the batched calls.
+static void BM_SendAndReceiveBatched(benchmark::State& state) {
+    std::unique_ptr<InputChannel> serverChannel, clientChannel;
+    InputChannel::openInputChannelPair("benchmark", serverChannel, clientChannel);
+    std::vector<InputMessage> msgs(state.range(0));
+    makeMotionMessages(msgs);
+    std::vector<InputMessage> received(msgs.size());
+
+    for (auto _ : state) {
+        size_t sent;
+        if (serverChannel->sendMessages(msgs.data(), msgs.size(), &sent) != OK) {
+            state.SkipWithError("sendMessages failed");
+            return;
+        }
+        // Asking for exactly as many as were sent avoids a last call to find the channel empty.
+        size_t receivedCount;
+        if (clientChannel->receiveMessages(received.data(), received.size(), &receivedCount) !=
+                    OK ||
+            receivedCount != msgs.size()) {
+            state.SkipWithError("receiveMessages failed");
+            return;
+        }
+    }
+    const size_t callsPerDirection =
+            (msgs.size() + MESSAGES_PER_SYSTEM_CALL - 1) / MESSAGES_PER_SYSTEM_CALL;
+    setCounters(state, 2 * callsPerDirection);
+}
+BENCHMARK(BM_SendAndReceiveBatched)->Arg(1)->Arg(4)->Arg(16);
+
+// A burst of key events through a publisher and consumer, with the finished signals read back
+// by the publisher all at once, as the dispatcher does.
+static void BM_PublishConsumeAndFinish(benchmark::State& state) {
+    std::unique_ptr<InputChannel> serverChannel, clientChannel;
+    InputChannel::openInputChannelPair("benchmark", serverChannel, clientChannel);
+    InputPublisher publisher(std::move(serverChannel));
+    InputConsumer consumer(std::move(clientChannel));
+    PreallocatedInputEventFactory eventFactory;
+    std::vector<InputPublisher::ConsumerResponse> responses;
+    const uint32_t burst = state.range(0);
+
+    for (auto _ : state) {
+        for (uint32_t seq = 1; seq <= burst; seq++) {
+            publisher.publishKeyEvent(seq, InputEvent::nextId(), 1 /*deviceId*/,
+                                      AINPUT_SOURCE_KEYBOARD, ADISPLAY_ID_DEFAULT, INVALID_HMAC,
+                                      AKEY_EVENT_ACTION_DOWN, 0 /*flags*/, AKEYCODE_ENTER,
+                                      13 /*scanCode*/, 0 /*metaState*/, 0 /*repeatCount*/,
+                                      0 /*downTime*/, 0 /*eventTime*/);
+        }
+        uint32_t seq;
+        InputEvent* event;
+        while (consumer.consume(&eventFactory, true /*consumeBatches*/, -1, &seq, &event) == OK) {
+            consumer.sendFinishedSignal(seq, true);
+        }
+        responses.clear();
+        publisher.receiveConsumerResponses(&responses);
+        if (responses.size() != burst) {
+            state.SkipWithError("not all finished signals were received");
+            return;
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * burst);
+}
+BENCHMARK(BM_PublishConsumeAndFinish)->Arg(1)->Arg(4)->Arg(16);
+
+} // namespace android
+
+BENCHMARK_MAIN();
@@ -15,6 +15,7 @@
  */
 
 #include <array>
+#include <vector>
 
 #include "TestHelpers.h"
 
@@ -195,6 +196,125 @@ TEST_F(InputChannelTest, SendAndReceive_MotionClassification) {
     }
 }
 
+TEST_F(InputChannelTest, SendAndReceiveMessages_PreservesOrderAndBoundaries) {
+    std::unique_ptr<InputChannel> serverChannel, clientChannel;
+    status_t result = InputChannel::openInputChannelPair("channel name",
+            serverChannel, clientChannel);
+    ASSERT_EQ(OK, result)
+            << "should have successfully opened a channel pair";
+
+    // More messages than are sent with one system call, of different sizes.
+    constexpr size_t count = 20;
+    std::vector<InputMessage> serverMsgs(count);
+    for (size_t i = 0; i < count; i++) {
+        InputMessage& msg = serverMsgs[i];
+        memset(&msg, 0, sizeof(InputMessage));
+        msg.header.seq = i + 1;
+        if (i % 2) {
+            msg.header.type = InputMessage::Type::MOTION;
+            msg.body.motion.pointerCount = 1 + i % MAX_POINTERS;
+        } else {
+            msg.header.type = InputMessage::Type::KEY;
+            msg.body.key.keyCode = i;
+        }
+    }
+    size_t sent;
+    EXPECT_EQ(OK, serverChannel->sendMessages(serverMsgs.data(), count, &sent))
+            << "server channel should be able to send messages to client channel";
+    EXPECT_EQ(count, sent);
+
+    // Receive them in two parts.
+    std::vector<InputMessage> clientMsgs(count);
+    size_t received;
+    ASSERT_EQ(OK, clientChannel->receiveMessages(clientMsgs.data(), 3, &received));
+    ASSERT_EQ(3u, received);
+    ASSERT_EQ(OK, clientChannel->receiveMessages(clientMsgs.data() + 3, count, &received));
+    ASSERT_EQ(count - 3, received);
+    for (size_t i = 0; i < count; i++) {
+        EXPECT_EQ(serverMsgs[i].header.type, clientMsgs[i].header.type);
+        EXPECT_EQ(serverMsgs[i].header.seq, clientMsgs[i].header.seq);
+        EXPECT_EQ(serverMsgs[i].size(), clientMsgs[i].size());
+    }
+
+    EXPECT_EQ(WOULD_BLOCK, clientChannel->receiveMessages(clientMsgs.data(), count, &received))
+            << "receiveMessages should have returned WOULD_BLOCK";
+    EXPECT_EQ(0u, received);
+
+    serverChannel.reset(); // close server channel
+    EXPECT_EQ(DEAD_OBJECT, clientChannel->receiveMessages(clientMsgs.data(), count, &received))
+            << "receiveMessages should have returned DEAD_OBJECT";
+    EXPECT_EQ(DEAD_OBJECT, clientChannel->sendMessages(clientMsgs.data(), count, &sent))
+            << "sendMessages should have returned DEAD_OBJECT";
+    EXPECT_EQ(0u, sent);
+}
+
+TEST_F(InputChannelTest, ReceiveMessages_WhenOneIsInvalid_ReturnsTheOthersWithTheError) {
+    std::unique_ptr<InputChannel> serverChannel, clientChannel;
+    status_t result = InputChannel::openInputChannelPair("channel name",
+            serverChannel, clientChannel);
+    ASSERT_EQ(OK, result)
+            << "should have successfully opened a channel pair";
+
+    constexpr size_t count = 5;
+    constexpr size_t invalidIndex = 2;
+    std::vector<InputMessage> serverMsgs(count);
+    for (size_t i = 0; i < count; i++) {
+        InputMessage& msg = serverMsgs[i];
+        memset(&msg, 0, sizeof(InputMessage));
+        msg.header.seq = i + 1;
+        msg.header.type = InputMessage::Type::MOTION;
+        // A motion message without pointers is rejected by the receiver.
+        msg.body.motion.pointerCount = i == invalidIndex ? 0 : 1;
+    }
+    size_t sent;
+    ASSERT_EQ(OK, serverChannel->sendMessages(serverMsgs.data(), count, &sent));
+    ASSERT_EQ(count, sent);
+
+    std::vector<InputMessage> clientMsgs(count);
+    size_t received;
+    EXPECT_EQ(BAD_VALUE, clientChannel->receiveMessages(clientMsgs.data(), count, &received))
+            << "receiveMessages should have reported the invalid message";
+    ASSERT_EQ(count - 1, received) << "the valid messages should not have been dropped";
+    EXPECT_EQ(1u, clientMsgs[0].header.seq);
+    EXPECT_EQ(2u, clientMsgs[1].header.seq);
+    EXPECT_EQ(4u, clientMsgs[2].header.seq);
+    EXPECT_EQ(5u, clientMsgs[3].header.seq);
+
+    EXPECT_EQ(WOULD_BLOCK, clientChannel->receiveMessages(clientMsgs.data(), count, &received))
+            << "receiveMessages should have returned WOULD_BLOCK";
+    EXPECT_EQ(0u, received);
+}
+
+TEST_F(InputChannelTest, SendMessages_WhenChannelFull_ReportsHowManyWereSent) {
+    std::unique_ptr<InputChannel> serverChannel, clientChannel;
+    status_t result = InputChannel::openInputChannelPair("channel name",
+            serverChannel, clientChannel);
+    ASSERT_EQ(OK, result)
+            << "should have successfully opened a channel pair";
+
+    // Far more than fit in the socket buffer.
+    constexpr size_t count = 1000;
+    std::vector<InputMessage> serverMsgs(count);
+    for (size_t i = 0; i < count; i++) {
+        memset(&serverMsgs[i], 0, sizeof(InputMessage));
+        serverMsgs[i].header.type = InputMessage::Type::MOTION;
+        serverMsgs[i].header.seq = i + 1;
+        serverMsgs[i].body.motion.pointerCount = MAX_POINTERS;
+    }
+    size_t sent;
+    EXPECT_EQ(WOULD_BLOCK, serverChannel->sendMessages(serverMsgs.data(), count, &sent));
+    ASSERT_GT(sent, 0u);
+    ASSERT_LT(sent, count);
+
+    InputMessage clientMsg;
+    for (size_t i = 0; i < sent; i++) {
+        ASSERT_EQ(OK, clientChannel->receiveMessage(&clientMsg));
+        EXPECT_EQ(serverMsgs[i].header.seq, clientMsg.header.seq);
+    }
+    EXPECT_EQ(WOULD_BLOCK, clientChannel->receiveMessage(&clientMsg))
+            << "only the messages reported as sent should have been received";
+}
+
 TEST_F(InputChannelTest, InputChannelParcelAndUnparcel) {
     std::unique_ptr<InputChannel> serverChannel, clientChannel;
 
@@ -426,6 +426,88 @@ TEST_F(InputPublisherAndConsumerTest, SendTimeline) {
     ASSERT_EQ(graphicsTimeline, timeline.graphicsTimeline);
 }
 
+TEST_F(InputPublisherAndConsumerTest, ConsumeAndReceiveManyEvents) {
+    // More events than are received with one system call.
+    constexpr uint32_t count = 20;
+    for (uint32_t seq = 1; seq <= count; seq++) {
+        ASSERT_EQ(OK,
+                  mPublisher->publishKeyEvent(seq, InputEvent::nextId(), 1 /*deviceId*/,
+                                              AINPUT_SOURCE_KEYBOARD, ADISPLAY_ID_DEFAULT,
+                                              INVALID_HMAC, AKEY_EVENT_ACTION_DOWN, 0 /*flags*/,
+                                              AKEYCODE_ENTER, 13 /*scanCode*/, 0 /*metaState*/,
+                                              0 /*repeatCount*/, 3 /*downTime*/,
+                                              4 /*eventTime*/));
+    }
+
+    for (uint32_t seq = 1; seq <= count; seq++) {
+        uint32_t consumeSeq;
+        InputEvent* event;
+        ASSERT_EQ(OK,
+                  mConsumer->consume(&mEventFactory, true /*consumeBatches*/, -1, &consumeSeq,
+                                     &event));
+        ASSERT_EQ(seq, consumeSeq) << "events should be consumed in the order they were sent";
+        if (seq == 1) {
+            // Some of the others were received from the channel along with the first one.
+            EXPECT_TRUE(mConsumer->hasDeferredEvent());
+        }
+        ASSERT_EQ(OK, mConsumer->sendFinishedSignal(consumeSeq, seq % 2));
+    }
+    uint32_t consumeSeq;
+    InputEvent* event;
+    ASSERT_EQ(WOULD_BLOCK,
+              mConsumer->consume(&mEventFactory, true /*consumeBatches*/, -1, &consumeSeq,
+                                 &event));
+
+    std::vector<InputPublisher::ConsumerResponse> responses;
+    ASSERT_EQ(WOULD_BLOCK, mPublisher->receiveConsumerResponses(&responses))
+            << "receiveConsumerResponses should return WOULD_BLOCK once all were received";
+    ASSERT_EQ(count, responses.size());
+    for (uint32_t i = 0; i < count; i++) {
+        ASSERT_TRUE(std::holds_alternative<InputPublisher::Finished>(responses[i]));
+        const InputPublisher::Finished& finish = std::get<InputPublisher::Finished>(responses[i]);
+        EXPECT_EQ(i + 1, finish.seq);
+        EXPECT_EQ((i + 1) % 2 != 0, finish.handled);
+    }
+}
+
+TEST_F(InputPublisherAndConsumerTest, PublishBatch_SendsEventsTogetherInOrder) {
+    constexpr uint32_t count = 20;
+    mPublisher->beginBatch();
+    for (uint32_t seq = 1; seq <= count; seq++) {
+        ASSERT_EQ(OK,
+                  mPublisher->publishFocusEvent(seq, InputEvent::nextId(), seq % 2 /*hasFocus*/,
+                                                false /*inTouchMode*/));
+    }
+    uint32_t consumeSeq;
+    InputEvent* event;
+    ASSERT_EQ(WOULD_BLOCK,
+              mConsumer->consume(&mEventFactory, true /*consumeBatches*/, -1, &consumeSeq,
+                                 &event))
+            << "events should not be sent before the batch ends";
+
+    size_t sent;
+    ASSERT_EQ(OK, mPublisher->endBatch(&sent));
+    ASSERT_EQ(count, sent);
+
+    for (uint32_t seq = 1; seq <= count; seq++) {
+        ASSERT_EQ(OK,
+                  mConsumer->consume(&mEventFactory, true /*consumeBatches*/, -1, &consumeSeq,
+                                     &event));
+        ASSERT_EQ(seq, consumeSeq) << "events should be consumed in the order they were sent";
+        ASSERT_EQ(AINPUT_EVENT_TYPE_FOCUS, event->getType());
+        EXPECT_EQ(seq % 2 != 0, static_cast<FocusEvent*>(event)->getHasFocus());
+    }
+
+    // Events published after the batch are sent right away.
+    ASSERT_EQ(OK,
+              mPublisher->publishFocusEvent(count + 1, InputEvent::nextId(), true /*hasFocus*/,
+                                            false /*inTouchMode*/));
+    ASSERT_EQ(OK,
+              mConsumer->consume(&mEventFactory, true /*consumeBatches*/, -1, &consumeSeq,
+                                 &event));
+    EXPECT_EQ(count + 1, consumeSeq);
+}
+
 TEST_F(InputPublisherAndConsumerTest, PublishKeyEvent_EndToEnd) {
     ASSERT_NO_FATAL_FAILURE(PublishAndConsumeKeyEvent());
 }
@@ -503,6 +585,97 @@ TEST_F(InputPublisherAndConsumerTest,
             << "publisher publishMotionEvent should return BAD_VALUE";
 }
 
+TEST_F(InputPublisherAndConsumerTest, PublishMotionEventWithHistory_EndToEnd) {
+    constexpr uint32_t pointerCount = 2;
+    const size_t historySize = InputPublisher::getMaxMotionHistorySize(pointerCount);
+    ASSERT_EQ(MAX_POINTERS / pointerCount - 1, historySize);
+
+    PointerProperties pointerProperties[pointerCount];
+    PointerCoords pointerCoords[pointerCount];
+    std::vector<nsecs_t> historicalEventTimes(historySize);
+    std::vector<PointerCoords> historicalCoords(historySize * pointerCount);
+    for (uint32_t i = 0; i < pointerCount; i++) {
+        pointerProperties[i].clear();
+        pointerProperties[i].id = i + 3;
+        pointerProperties[i].toolType = AMOTION_EVENT_TOOL_TYPE_FINGER;
+        pointerCoords[i].clear();
+        pointerCoords[i].setAxisValue(AMOTION_EVENT_AXIS_X, 100 * i + historySize);
+        pointerCoords[i].setAxisValue(AMOTION_EVENT_AXIS_Y, 200 * i + historySize);
+    }
+    for (size_t h = 0; h < historySize; h++) {
+        historicalEventTimes[h] = 10 + h;
+        for (uint32_t i = 0; i < pointerCount; i++) {
+            PointerCoords& coords = historicalCoords[h * pointerCount + i];
+            coords.clear();
+            coords.setAxisValue(AMOTION_EVENT_AXIS_X, 100 * i + h);
+            coords.setAxisValue(AMOTION_EVENT_AXIS_Y, 200 * i + h);
+        }
+    }
+
+    ui::Transform identityTransform;
+    const nsecs_t eventTime = 10 + historySize;
+    ASSERT_EQ(OK,
+              mPublisher->publishMotionEvent(1, InputEvent::nextId(), 1 /*deviceId*/,
+                                             AINPUT_SOURCE_TOUCHSCREEN, ADISPLAY_ID_DEFAULT,
+                                             INVALID_HMAC, AMOTION_EVENT_ACTION_MOVE, 0, 0, 0, 0,
+                                             0, MotionClassification::NONE, identityTransform, 0,
+                                             0, AMOTION_EVENT_INVALID_CURSOR_POSITION,
+                                             AMOTION_EVENT_INVALID_CURSOR_POSITION, 0, 0,
+                                             5 /*downTime*/, eventTime, pointerCount,
+                                             pointerProperties, pointerCoords, historySize,
+                                             historicalEventTimes.data(),
+                                             historicalCoords.data()));
+
+    uint32_t consumeSeq;
+    InputEvent* event;
+    ASSERT_EQ(OK,
+              mConsumer->consume(&mEventFactory, true /*consumeBatches*/, -1, &consumeSeq,
+                                 &event));
+    ASSERT_EQ(1U, consumeSeq);
+    ASSERT_EQ(AINPUT_EVENT_TYPE_MOTION, event->getType());
+    const MotionEvent& motionEvent = static_cast<const MotionEvent&>(*event);
+    ASSERT_EQ(pointerCount, motionEvent.getPointerCount());
+    ASSERT_EQ(historySize, motionEvent.getHistorySize());
+    EXPECT_EQ(eventTime, motionEvent.getEventTime());
+    for (uint32_t i = 0; i < pointerCount; i++) {
+        EXPECT_EQ(pointerProperties[i].id, motionEvent.getPointerId(i));
+        EXPECT_EQ(static_cast<float>(100 * i + historySize), motionEvent.getRawX(i));
+        EXPECT_EQ(static_cast<float>(200 * i + historySize), motionEvent.getRawY(i));
+    }
+    for (size_t h = 0; h < historySize; h++) {
+        EXPECT_EQ(historicalEventTimes[h], motionEvent.getHistoricalEventTime(h));
+        for (uint32_t i = 0; i < pointerCount; i++) {
+            EXPECT_EQ(static_cast<float>(100 * i + h), motionEvent.getHistoricalRawX(i, h));
+            EXPECT_EQ(static_cast<float>(200 * i + h), motionEvent.getHistoricalRawY(i, h));
+        }
+    }
+    ASSERT_EQ(OK, mConsumer->sendFinishedSignal(consumeSeq, true));
+}
+
+TEST_F(InputPublisherAndConsumerTest, PublishMotionEvent_WhenHistoryDoesNotFit_ReturnsError) {
+    constexpr uint32_t pointerCount = 2;
+    const size_t historySize = InputPublisher::getMaxMotionHistorySize(pointerCount) + 1;
+    PointerProperties pointerProperties[pointerCount];
+    PointerCoords pointerCoords[pointerCount];
+    for (uint32_t i = 0; i < pointerCount; i++) {
+        pointerProperties[i].clear();
+        pointerCoords[i].clear();
+    }
+    std::vector<nsecs_t> historicalEventTimes(historySize);
+    std::vector<PointerCoords> historicalCoords(historySize * pointerCount);
+
+    ui::Transform identityTransform;
+    status_t status =
+            mPublisher->publishMotionEvent(1, InputEvent::nextId(), 0, 0, 0, INVALID_HMAC, 0, 0, 0,
+                                           0, 0, 0, MotionClassification::NONE, identityTransform,
+                                           0, 0, AMOTION_EVENT_INVALID_CURSOR_POSITION,
+                                           AMOTION_EVENT_INVALID_CURSOR_POSITION, 0, 0, 0, 0,
+                                           pointerCount, pointerProperties, pointerCoords,
+                                           historySize, historicalEventTimes.data(),
+                                           historicalCoords.data());
+    ASSERT_EQ(BAD_VALUE, status) << "publisher publishMotionEvent should return BAD_VALUE";
+}
+
 TEST_F(InputPublisherAndConsumerTest, PublishMultipleEvents_EndToEnd) {
     ASSERT_NO_FATAL_FAILURE(PublishAndConsumeMotionEvent());
     ASSERT_NO_FATAL_FAILURE(PublishAndConsumeKeyEvent());
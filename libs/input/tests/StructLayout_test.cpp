@@ -77,7 +77,7 @@ void TestInputMessageAlignment() {
   CHECK_OFFSET(InputMessage::Body::Motion, displayWidth, 136);
   CHECK_OFFSET(InputMessage::Body::Motion, displayHeight, 140);
   CHECK_OFFSET(InputMessage::Body::Motion, pointerCount, 144);
-  CHECK_OFFSET(InputMessage::Body::Motion, empty3, 148);
+  CHECK_OFFSET(InputMessage::Body::Motion, historySize, 148);
   CHECK_OFFSET(InputMessage::Body::Motion, pointers, 152);
 
   CHECK_OFFSET(InputMessage::Body::Focus, eventId, 0);
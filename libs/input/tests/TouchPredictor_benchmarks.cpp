@@ -0,0 +1,323 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <random>
+#include <sstream>
+
+#include <input/TouchPredictor.h>
+
+// Replays touch strokes through a predictor, sample by sample, and compares each prediction to
+// where the finger really was.  The horizon argument is how far ahead of the last sample the
+// predictor is asked for, which is the latency that resampling with it saves.
+//
+// The strokes are synthetic, unless TOUCH_PREDICTOR_RECORDING names a file captured from a
+// touchscreen with "getevent -lt /dev/input/eventN".  The first finger of each gesture of such a
+// recording is replayed, and its later samples stand for where it really was, so the errors are
+// in the units of the touchscreen.
+
+namespace android {
+
+static constexpr nsecs_t NANOS_PER_MS = 1000000;
+
+// The time between two samples of a touchscreen sampled at 120Hz.
+static constexpr nsecs_t SAMPLE_INTERVAL = 8333333;
+
+// How much the sample times and positions reported by the touchscreen are off.
+static constexpr nsecs_t SAMPLE_TIME_JITTER = NANOS_PER_MS / 2;
+static constexpr float POSITION_NOISE = 0.5;
+
+// The number of samples of each synthetic stroke.
+static constexpr size_t STROKE_SAMPLE_COUNT = 60;
+
+static constexpr char RECORDING_PATH_VARIABLE[] = "TOUCH_PREDICTOR_RECORDING";
+
+// Where the finger really is at a time of a synthetic stroke.
+using Trajectory = VelocityTracker::Position (*)(nsecs_t time);
+
+static float seconds(nsecs_t time) {
+    return time * 0.000000001f;
+}
+
+// A fling, slowing down after the finger was released from a fast swipe.
+static VelocityTracker::Position fling(nsecs_t time) {
+    const float decay = 0.15f * (1 - std::exp(-seconds(time) / 0.15f));
+    return {200 + 3000 * decay, 1800 - 6000 * decay};
+}
+
+// A circle drawn at one turn per second.
+static VelocityTracker::Position circle(nsecs_t time) {
+    const float angle = 2 * float(M_PI) * seconds(time);
+    return {500 + 300 * std::cos(angle), 1000 + 300 * std::sin(angle)};
+}
+
+// A scroll back and forth, as when reading through a list.
+static VelocityTracker::Position scroll(nsecs_t time) {
+    return {540, 1000 + 600 * std::sin(float(M_PI) * seconds(time))};
+}
+
+struct Sample {
+    nsecs_t eventTime;
+    VelocityTracker::Position position;
+};
+
+struct Stroke {
+    // The samples reported by the touchscreen.
+    std::vector<Sample> samples;
+    // Where the finger really was at a time, or false if that is not known.
+    std::function<bool(nsecs_t time, VelocityTracker::Position* outPosition)> actual;
+};
+
+// Samples a trajectory the way a touchscreen reports it, with jittered times and noisy positions.
+static std::vector<Sample> record(Trajectory trajectory) {
+    std::mt19937 generator(STROKE_SAMPLE_COUNT);
+    std::uniform_int_distribution<nsecs_t> timeJitter(-SAMPLE_TIME_JITTER, SAMPLE_TIME_JITTER);
+    std::uniform_real_distribution<float> positionNoise(-POSITION_NOISE, POSITION_NOISE);
+
+    std::vector<Sample> samples;
+    for (size_t i = 0; i < STROKE_SAMPLE_COUNT; i++) {
+        const nsecs_t eventTime = i * SAMPLE_INTERVAL + (i ? timeJitter(generator) : 0);
+        VelocityTracker::Position position = trajectory(eventTime);
+        position.x += positionNoise(generator);
+        position.y += positionNoise(generator);
+        samples.push_back({eventTime, position});
+    }
+    return samples;
+}
+
+static Stroke syntheticStroke(Trajectory trajectory) {
+    return {record(trajectory), [trajectory](nsecs_t time, VelocityTracker::Position* outPosition) {
+                *outPosition = trajectory(time);
+                return true;
+            }};
+}
+
+// Interpolates between the samples of a recorded stroke, as the finger is only known to have been
+// where it was sampled.
+static bool interpolate(const std::vector<Sample>& samples, nsecs_t time,
+                        VelocityTracker::Position* outPosition) {
+    auto next = std::lower_bound(samples.begin(), samples.end(), time,
+                                 [](const Sample& sample, nsecs_t t) {
+                                     return sample.eventTime < t;
+                                 });
+    if (next == samples.end()) {
+        return false;
+    }
+    if (next == samples.begin() || next->eventTime == time) {
+        *outPosition = next->position;
+        return true;
+    }
+    const Sample& previous = *(next - 1);
+    const float alpha = float(time - previous.eventTime) / (next->eventTime - previous.eventTime);
+    outPosition->x = previous.position.x + alpha * (next->position.x - previous.position.x);
+    outPosition->y = previous.position.y + alpha * (next->position.y - previous.position.y);
+    return true;
+}
+
+static Stroke recordedStroke(std::vector<Sample> samples) {
+    return {samples, [samples](nsecs_t time, VelocityTracker::Position* outPosition) {
+                return interpolate(samples, time, outPosition);
+            }};
+}
+
+// Reads the strokes of the first finger from the output of "getevent -lt", which has a line such
+// as "[    4567.123456] EV_ABS       ABS_MT_POSITION_X    000001a4" for each event.
+static std::vector<Stroke> loadStrokes(const char* path) {
+    std::ifstream file(path);
+    if (!file) {
+        fprintf(stderr, "Could not read %s\n", path);
+        exit(1);
+    }
+
+    std::vector<Stroke> strokes;
+    std::vector<Sample> samples;
+    int32_t slot = 0;
+    bool down = false;
+    VelocityTracker::Position position = {0, 0};
+    auto finishStroke = [&] {
+        if (samples.size() >= 2) {
+            strokes.push_back(recordedStroke(std::move(samples)));
+        }
+        samples.clear();
+        down = false;
+    };
+
+    std::string line;
+    while (std::getline(file, line)) {
+        double seconds;
+        int timeLength;
+        if (sscanf(line.c_str(), " [ %lf ]%n", &seconds, &timeLength) != 1) {
+            continue;
+        }
+        // The device name is only printed when more than one device is read, so the event is
+        // taken from the end of the line.
+        std::istringstream tokens(line.substr(timeLength));
+        std::vector<std::string> fields{std::istream_iterator<std::string>(tokens), {}};
+        if (fields.size() < 3) {
+            continue;
+        }
+        const std::string& code = fields[fields.size() - 2];
+        const int32_t value = int32_t(strtoul(fields.back().c_str(), nullptr, 16));
+        const nsecs_t eventTime = nsecs_t(seconds * 1000000000);
+
+        if (code == "SYN_REPORT") {
+            if (down) {
+                samples.push_back({eventTime, position});
+            }
+        } else if (code == "ABS_MT_SLOT") {
+            slot = value;
+        } else if (slot != 0) {
+            continue;
+        } else if (code == "ABS_MT_TRACKING_ID") {
+            if (value < 0) {
+                finishStroke();
+            } else {
+                down = true;
+            }
+        } else if (code == "ABS_MT_POSITION_X") {
+            position.x = value;
+        } else if (code == "ABS_MT_POSITION_Y") {
+            position.y = value;
+        }
+    }
+    finishStroke();
+
+    if (strokes.empty()) {
+        fprintf(stderr, "%s has no touch strokes\n", path);
+        exit(1);
+    }
+    return strokes;
+}
+
+static std::vector<Stroke> loadOrSynthesizeStrokes() {
+    const char* path = getenv(RECORDING_PATH_VARIABLE);
+    if (path != nullptr) {
+        return loadStrokes(path);
+    }
+    return {syntheticStroke(fling), syntheticStroke(circle), syntheticStroke(scroll)};
+}
+
+// --- LinearTouchPredictor ---
+
+// Extrapolates from the last two samples, the way InputConsumer resamples by default.
+class LinearTouchPredictor : public TouchPredictor {
+public:
+    void clear() override { mSampleCount = 0; }
+
+    void clearPointers(BitSet32) override { mSampleCount = 0; }
+
+    void addMovement(nsecs_t eventTime, BitSet32,
+                     const std::vector<VelocityTracker::Position>& positions) override {
+        mSamples[0] = mSamples[1];
+        mSamples[1] = {eventTime, positions[0]};
+        mSampleCount = std::min(mSampleCount + 1, size_t(2));
+    }
+
+    bool predict(uint32_t, nsecs_t time, VelocityTracker::Position* outPosition) const override {
+        if (mSampleCount < 2) {
+            return false;
+        }
+        const float alpha = float(time - mSamples[1].eventTime) /
+                (mSamples[1].eventTime - mSamples[0].eventTime);
+        outPosition->x = mSamples[1].position.x +
+                alpha * (mSamples[1].position.x - mSamples[0].position.x);
+        outPosition->y = mSamples[1].position.y +
+                alpha * (mSamples[1].position.y - mSamples[0].position.y);
+        return true;
+    }
+
+private:
+    Sample mSamples[2];
+    size_t mSampleCount = 0;
+};
+
+static void BM_ReplayStrokes(benchmark::State& state, TouchPredictorFactory factory) {
+    const nsecs_t horizon = state.range(0) * NANOS_PER_MS;
+    static const std::vector<Stroke> strokes = loadOrSynthesizeStrokes();
+    std::unique_ptr<TouchPredictor> predictor = factory();
+
+    BitSet32 idBits;
+    idBits.markBit(0);
+    std::vector<VelocityTracker::Position> positions(1);
+    std::vector<float> errors;
+    size_t sampleCount = 0;
+    for (auto _ : state) {
+        errors.clear();
+        for (const Stroke& stroke : strokes) {
+            predictor->clear();
+            for (const Sample& sample : stroke.samples) {
+                positions[0] = sample.position;
+                predictor->addMovement(sample.eventTime, idBits, positions);
+                sampleCount++;
+
+                VelocityTracker::Position actual;
+                if (!stroke.actual(sample.eventTime + horizon, &actual)) {
+                    // The stroke ended before then.
+                    continue;
+                }
+                VelocityTracker::Position predicted;
+                if (!predictor->predict(0, sample.eventTime + horizon, &predicted)) {
+                    // Resampling would have kept the last sample.
+                    predicted = sample.position;
+                }
+                errors.push_back(std::hypot(predicted.x - actual.x, predicted.y - actual.y));
+            }
+        }
+    }
+    if (errors.empty()) {
+        state.SkipWithError("The strokes are shorter than the horizon");
+        return;
+    }
+
+    std::sort(errors.begin(), errors.end());
+    float errorSum = 0;
+    for (float error : errors) {
+        errorSum += error;
+    }
+    state.counters["latency_saved_ms"] = state.range(0);
+    state.counters["mean_error_px"] = errorSum / errors.size();
+    state.counters["p90_error_px"] = errors[errors.size() * 9 / 10];
+    state.counters["max_error_px"] = errors.back();
+    state.SetItemsProcessed(sampleCount);
+}
+
+static TouchPredictorFactory velocityTrackerPredictor(VelocityTracker::Strategy strategy) {
+    return [strategy] { return std::make_unique<VelocityTrackerTouchPredictor>(strategy); };
+}
+
+static void horizons(benchmark::internal::Benchmark* benchmark) {
+    benchmark->DenseRange(0, 16, 4);
+}
+
+BENCHMARK_CAPTURE(BM_ReplayStrokes, Linear, [] { return std::make_unique<LinearTouchPredictor>(); })
+        ->Apply(horizons);
+BENCHMARK_CAPTURE(BM_ReplayStrokes, Lsq2, velocityTrackerPredictor(VelocityTracker::Strategy::LSQ2))
+        ->Apply(horizons);
+BENCHMARK_CAPTURE(BM_ReplayStrokes, Wlsq2Recent,
+                  velocityTrackerPredictor(VelocityTracker::Strategy::WLSQ2_RECENT))
+        ->Apply(horizons);
+BENCHMARK_CAPTURE(BM_ReplayStrokes, Int2, velocityTrackerPredictor(VelocityTracker::Strategy::INT2))
+        ->Apply(horizons);
+
+} // namespace android
@@ -0,0 +1,230 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <attestation/HmacKeyManager.h>
+#include <gtest/gtest.h>
+#include <input/InputTransport.h>
+#include <input/TouchPredictor.h>
+
+namespace android {
+
+// The time between two samples of a touchscreen sampled at 120Hz, rounded to a millisecond.
+static constexpr nsecs_t SAMPLE_INTERVAL = 8 * 1000000;
+
+// The x velocity of the pointers, in pixels per second.
+static constexpr float X_VELOCITY = 1000;
+
+static BitSet32 pointerIdBits(uint32_t pointerCount) {
+    BitSet32 idBits;
+    for (uint32_t id = 0; id < pointerCount; id++) {
+        idBits.markBit(id);
+    }
+    return idBits;
+}
+
+// Moves the pointers along x at a constant velocity, for 'count' samples.
+static void addLinearMovements(TouchPredictor& predictor, uint32_t pointerCount, size_t count) {
+    std::vector<VelocityTracker::Position> positions(pointerCount);
+    for (size_t i = 0; i < count; i++) {
+        const nsecs_t eventTime = i * SAMPLE_INTERVAL;
+        for (uint32_t id = 0; id < pointerCount; id++) {
+            positions[id].x = 100 + X_VELOCITY * eventTime * 0.000000001f;
+            positions[id].y = 100 * (id + 1);
+        }
+        predictor.addMovement(eventTime, pointerIdBits(pointerCount), positions);
+    }
+}
+
+// --- VelocityTrackerTouchPredictorTest ---
+
+TEST(VelocityTrackerTouchPredictorTest, NoPredictionWithoutMovement) {
+    VelocityTrackerTouchPredictor predictor(VelocityTracker::Strategy::LSQ2);
+    VelocityTracker::Position position;
+    ASSERT_FALSE(predictor.predict(0, 0, &position));
+
+    addLinearMovements(predictor, 1, 1);
+    ASSERT_FALSE(predictor.predict(0, SAMPLE_INTERVAL, &position))
+            << "A single sample gives no velocity to predict with";
+}
+
+TEST(VelocityTrackerTouchPredictorTest, PredictsLinearMovement) {
+    VelocityTrackerTouchPredictor predictor(VelocityTracker::Strategy::LSQ2);
+    addLinearMovements(predictor, 2, 5);
+
+    // The last samples were at x = 132, 4 * SAMPLE_INTERVAL.
+    const nsecs_t predictionTime = 4 * SAMPLE_INTERVAL + SAMPLE_INTERVAL / 2;
+    for (uint32_t id = 0; id < 2; id++) {
+        VelocityTracker::Position position;
+        ASSERT_TRUE(predictor.predict(id, predictionTime, &position));
+        EXPECT_NEAR(136, position.x, 0.1);
+        EXPECT_NEAR(100 * (id + 1), position.y, 0.1);
+    }
+}
+
+TEST(VelocityTrackerTouchPredictorTest, ClearPointersForgetsTheirMovement) {
+    VelocityTrackerTouchPredictor predictor(VelocityTracker::Strategy::LSQ2);
+    addLinearMovements(predictor, 2, 5);
+
+    BitSet32 idBits;
+    idBits.markBit(1);
+    predictor.clearPointers(idBits);
+
+    VelocityTracker::Position position;
+    EXPECT_TRUE(predictor.predict(0, 5 * SAMPLE_INTERVAL, &position));
+    EXPECT_FALSE(predictor.predict(1, 5 * SAMPLE_INTERVAL, &position));
+
+    predictor.clear();
+    EXPECT_FALSE(predictor.predict(0, 5 * SAMPLE_INTERVAL, &position));
+}
+
+// --- InputConsumerTouchPredictionTest ---
+
+class InputConsumerTouchPredictionTest : public testing::Test {
+protected:
+    std::shared_ptr<InputChannel> mServerChannel, mClientChannel;
+    std::unique_ptr<InputPublisher> mPublisher;
+    std::unique_ptr<InputConsumer> mConsumer;
+    PreallocatedInputEventFactory mEventFactory;
+    uint32_t mSeq = 1;
+
+    void SetUp() override {
+        std::unique_ptr<InputChannel> serverChannel, clientChannel;
+        ASSERT_EQ(OK,
+                  InputChannel::openInputChannelPair("channel name", serverChannel,
+                                                     clientChannel));
+        mServerChannel = std::move(serverChannel);
+        mClientChannel = std::move(clientChannel);
+
+        mPublisher = std::make_unique<InputPublisher>(mServerChannel);
+        mConsumer = std::make_unique<InputConsumer>(mClientChannel);
+    }
+
+    void publishTouch(int32_t action, nsecs_t eventTime) {
+        PointerProperties pointerProperties;
+        pointerProperties.clear();
+        pointerProperties.toolType = AMOTION_EVENT_TOOL_TYPE_FINGER;
+        PointerCoords pointerCoords;
+        pointerCoords.clear();
+        pointerCoords.setAxisValue(AMOTION_EVENT_AXIS_X,
+                                   100 + X_VELOCITY * eventTime * 0.000000001f);
+        pointerCoords.setAxisValue(AMOTION_EVENT_AXIS_Y, 100);
+
+        ui::Transform identityTransform;
+        ASSERT_EQ(OK,
+                  mPublisher->publishMotionEvent(mSeq++, InputEvent::nextId(), 1 /*deviceId*/,
+                                                 AINPUT_SOURCE_TOUCHSCREEN, ADISPLAY_ID_DEFAULT,
+                                                 INVALID_HMAC, action, 0 /*actionButton*/,
+                                                 0 /*flags*/, 0 /*edgeFlags*/, AMETA_NONE,
+                                                 0 /*buttonState*/, MotionClassification::NONE,
+                                                 identityTransform, 0 /*xPrecision*/,
+                                                 0 /*yPrecision*/,
+                                                 AMOTION_EVENT_INVALID_CURSOR_POSITION,
+                                                 AMOTION_EVENT_INVALID_CURSOR_POSITION,
+                                                 1000 /*displayWidth*/, 2000 /*displayHeight*/,
+                                                 0 /*downTime*/, eventTime, 1 /*pointerCount*/,
+                                                 &pointerProperties, &pointerCoords));
+    }
+
+    // Publishes a down and two moves, and consumes them for a frame at 'frameTime'.
+    void publishAndConsumeGesture(nsecs_t frameTime, MotionEvent** outMotionEvent) {
+        publishTouch(AMOTION_EVENT_ACTION_DOWN, 0);
+        publishTouch(AMOTION_EVENT_ACTION_MOVE, SAMPLE_INTERVAL);
+        publishTouch(AMOTION_EVENT_ACTION_MOVE, 2 * SAMPLE_INTERVAL);
+
+        uint32_t seq;
+        InputEvent* event;
+        ASSERT_EQ(OK, mConsumer->consume(&mEventFactory, true /*consumeBatches*/, frameTime, &seq,
+                                         &event));
+        ASSERT_EQ(AMOTION_EVENT_ACTION_DOWN, static_cast<MotionEvent*>(event)->getAction());
+        ASSERT_EQ(OK, mConsumer->consume(&mEventFactory, true /*consumeBatches*/, frameTime, &seq,
+                                         &event));
+        *outMotionEvent = static_cast<MotionEvent*>(event);
+        ASSERT_EQ(AMOTION_EVENT_ACTION_MOVE, (*outMotionEvent)->getAction());
+    }
+};
+
+TEST_F(InputConsumerTouchPredictionTest, PredictsUpToMaxPrediction) {
+    mConsumer->setTouchPredictor(
+            [] {
+                return std::make_unique<VelocityTrackerTouchPredictor>(
+                        VelocityTracker::Strategy::LSQ2);
+            },
+            0 /*resampleLatency*/, SAMPLE_INTERVAL /*maxPrediction*/);
+
+    // Further than maxPrediction after the last sample.
+    MotionEvent* motionEvent;
+    ASSERT_NO_FATAL_FAILURE(publishAndConsumeGesture(4 * SAMPLE_INTERVAL, &motionEvent));
+    if (motionEvent->getHistorySize() == 1) {
+        GTEST_SKIP() << "Touch resampling is disabled";
+    }
+
+    // The two moves and the predicted sample.
+    ASSERT_EQ(2U, motionEvent->getHistorySize());
+    EXPECT_EQ(3 * SAMPLE_INTERVAL, motionEvent->getEventTime());
+    EXPECT_NEAR(124, motionEvent->getX(0), 0.1);
+    EXPECT_NEAR(100, motionEvent->getY(0), 0.1);
+}
+
+TEST_F(InputConsumerTouchPredictionTest, EmptyFactoryRestoresLinearExtrapolation) {
+    mConsumer->setTouchPredictor(
+            [] {
+                return std::make_unique<VelocityTrackerTouchPredictor>(
+                        VelocityTracker::Strategy::LSQ2);
+            },
+            0 /*resampleLatency*/, SAMPLE_INTERVAL /*maxPrediction*/);
+    mConsumer->setTouchPredictor(nullptr, 0, 0);
+
+    MotionEvent* motionEvent;
+    ASSERT_NO_FATAL_FAILURE(publishAndConsumeGesture(4 * SAMPLE_INTERVAL, &motionEvent));
+    if (motionEvent->getHistorySize() == 1) {
+        GTEST_SKIP() << "Touch resampling is disabled";
+    }
+
+    // Extrapolated by half of the time between the last two samples, after the default latency.
+    ASSERT_EQ(2U, motionEvent->getHistorySize());
+    EXPECT_EQ(2 * SAMPLE_INTERVAL + SAMPLE_INTERVAL / 2, motionEvent->getEventTime());
+    EXPECT_NEAR(120, motionEvent->getX(0), 0.1);
+}
+
+TEST_F(InputConsumerTouchPredictionTest, EmptyFactoryDuringGesture_StopsUsingThePredictor) {
+    mConsumer->setTouchPredictor(
+            [] {
+                return std::make_unique<VelocityTrackerTouchPredictor>(
+                        VelocityTracker::Strategy::LSQ2);
+            },
+            0 /*resampleLatency*/, SAMPLE_INTERVAL /*maxPrediction*/);
+    MotionEvent* motionEvent;
+    ASSERT_NO_FATAL_FAILURE(publishAndConsumeGesture(4 * SAMPLE_INTERVAL, &motionEvent));
+    if (motionEvent->getHistorySize() == 1) {
+        GTEST_SKIP() << "Touch resampling is disabled";
+    }
+
+    mConsumer->setTouchPredictor(nullptr, 0, 0);
+    publishTouch(AMOTION_EVENT_ACTION_MOVE, 3 * SAMPLE_INTERVAL);
+    uint32_t seq;
+    InputEvent* event;
+    ASSERT_EQ(OK,
+              mConsumer->consume(&mEventFactory, true /*consumeBatches*/, 5 * SAMPLE_INTERVAL,
+                                 &seq, &event));
+    ASSERT_EQ(AINPUT_EVENT_TYPE_MOTION, event->getType());
+    motionEvent = static_cast<MotionEvent*>(event);
+
+    // Extrapolated linearly, rather than predicted up to the previous maxPrediction.
+    ASSERT_EQ(1U, motionEvent->getHistorySize());
+    EXPECT_EQ(3 * SAMPLE_INTERVAL + SAMPLE_INTERVAL / 2, motionEvent->getEventTime());
+}
+
+} // namespace android
@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <input/VelocityTracker.h>
+
+namespace android {
+
+// The time between two movements, as reported by a touchscreen sampled at 240Hz.
+static constexpr nsecs_t MOVEMENT_INTERVAL = 4166667;
+
+// Adds one movement of all the pointers, then gets the velocity of each of them, the way an
+// application does on each ACTION_MOVE while a gesture is being tracked.
+template <typename Strategy>
+static void BM_AddMovementAndGetVelocity(benchmark::State& state, Strategy strategy) {
+    const uint32_t pointerCount = state.range(0);
+    BitSet32 idBits;
+    for (uint32_t id = 0; id < pointerCount; id++) {
+        idBits.markBit(id);
+    }
+    std::vector<VelocityTracker::Position> positions(pointerCount);
+
+    nsecs_t eventTime = 0;
+    for (auto _ : state) {
+        eventTime += MOVEMENT_INTERVAL;
+        for (uint32_t i = 0; i < pointerCount; i++) {
+            positions[i].x = 100 + i * 50 + (eventTime / 1000000) % 400;
+            positions[i].y = 1000 - i * 50 - (eventTime / 2000000) % 400;
+        }
+        strategy.addMovement(eventTime, idBits, positions);
+
+        for (uint32_t id = 0; id < pointerCount; id++) {
+            VelocityTracker::Estimator estimator;
+            strategy.getEstimator(id, &estimator);
+            benchmark::DoNotOptimize(estimator.xCoeff[1]);
+            benchmark::DoNotOptimize(estimator.yCoeff[1]);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * pointerCount);
+}
+
+// The unweighted quadratic fit, which refits the whole history on each getEstimator.
+BENCHMARK_CAPTURE(BM_AddMovementAndGetVelocity, LeastSquaresLsq2,
+                  LeastSquaresVelocityTrackerStrategy(2))
+        ->Arg(1)
+        ->Arg(10);
+
+// The same fit from running sums, which is what VelocityTracker uses for LSQ2.
+BENCHMARK_CAPTURE(BM_AddMovementAndGetVelocity, IncrementalLeastSquaresLsq2,
+                  IncrementalLeastSquaresVelocityTrackerStrategy())
+        ->Arg(1)
+        ->Arg(10);
+
+} // namespace android
@@ -19,6 +19,7 @@
 #include <array>
 #include <chrono>
 #include <math.h>
+#include <random>
 
 #include <android-base/stringprintf.h>
 #include <attestation/HmacKeyManager.h>
@@ -964,4 +965,134 @@ TEST_F(VelocityTrackerTest, LeastSquaresVelocityTrackerStrategyEstimator_Parabol
     computeAndCheckQuadraticEstimate(motions, std::array<float, 3>({0, 0E3, 1E6}));
 }
 
+/*
+ * ================== IncrementalLeastSquaresVelocityTrackerStrategy ===============================
+ * The incremental strategy should fit the same samples as the unweighted quadratic
+ * LeastSquaresVelocityTrackerStrategy, up to the difference between float and double arithmetic.
+ */
+static void checkSameEstimate(const VelocityTrackerStrategy& expectedStrategy,
+                              const VelocityTrackerStrategy& actualStrategy, uint32_t id) {
+    VelocityTracker::Estimator expected, actual;
+    bool expectedResult = expectedStrategy.getEstimator(id, &expected);
+    ASSERT_EQ(expectedResult, actualStrategy.getEstimator(id, &actual)) << "id=" << id;
+    if (!expectedResult) {
+        return;
+    }
+    ASSERT_EQ(expected.degree, actual.degree) << "id=" << id;
+    EXPECT_EQ(expected.time, actual.time);
+    // LeastSquaresVelocityTrackerStrategy fits in single precision, and loses up to a few units
+    // per second of velocity to rounding, and a lot more of the quadratic term.
+    const std::array<float, 3> absoluteTolerances = {0.1, 5, 500};
+    const std::array<float, 3> relativeTolerances = {0.01, 0.01, 0.1};
+    for (size_t i = 0; i <= expected.degree; i++) {
+        auto tolerance = [&](float coefficient) {
+            return std::max(absoluteTolerances[i], fabsf(coefficient) * relativeTolerances[i]);
+        };
+        EXPECT_NEAR(expected.xCoeff[i], actual.xCoeff[i], tolerance(expected.xCoeff[i]))
+                << "id=" << id << ", coefficient " << i;
+        EXPECT_NEAR(expected.yCoeff[i], actual.yCoeff[i], tolerance(expected.yCoeff[i]))
+                << "id=" << id << ", coefficient " << i;
+    }
+}
+
+class IncrementalLeastSquaresVelocityTrackerStrategyTest : public testing::Test {
+protected:
+    LeastSquaresVelocityTrackerStrategy mExpectedStrategy{2};
+    IncrementalLeastSquaresVelocityTrackerStrategy mStrategy;
+
+    void addMovementAndCheck(nsecs_t eventTime, BitSet32 idBits,
+                             const std::vector<VelocityTracker::Position>& positions) {
+        mExpectedStrategy.addMovement(eventTime, idBits, positions);
+        mStrategy.addMovement(eventTime, idBits, positions);
+        for (uint32_t id = 0; id <= MAX_POINTER_ID; id++) {
+            checkSameEstimate(mExpectedStrategy, mStrategy, id);
+        }
+    }
+};
+
+TEST_F(IncrementalLeastSquaresVelocityTrackerStrategyTest, MatchesFullFitForOnePointer) {
+    BitSet32 idBits;
+    idBits.markBit(DEFAULT_POINTER_ID);
+    // Samples every 8ms for longer than the horizon, on a parabola with some noise.
+    for (int32_t i = 0; i < 40; i++) {
+        const float t = i * 0.008f;
+        const float noise = (i % 3) * 0.5f;
+        addMovementAndCheck(ms2ns(8 * i), idBits,
+                            {{100 + 2000 * t - 3000 * t * t + noise, 500 - 800 * t + noise}});
+    }
+}
+
+TEST_F(IncrementalLeastSquaresVelocityTrackerStrategyTest, ReplacesMovementWithSameTime) {
+    BitSet32 idBits;
+    idBits.markBit(0);
+    addMovementAndCheck(ms2ns(0), idBits, {{10, 10}});
+    addMovementAndCheck(ms2ns(8), idBits, {{20, 15}});
+    addMovementAndCheck(ms2ns(16), idBits, {{35, 25}});
+    // A second pointer goes down at the same time as the last move.
+    idBits.markBit(1);
+    addMovementAndCheck(ms2ns(16), idBits, {{36, 26}, {200, 300}});
+    addMovementAndCheck(ms2ns(24), idBits, {{50, 30}, {210, 290}});
+    addMovementAndCheck(ms2ns(32), idBits, {{70, 40}, {230, 270}});
+}
+
+TEST_F(IncrementalLeastSquaresVelocityTrackerStrategyTest, MatchesFullFitForRandomGestures) {
+    std::mt19937 generator(/* seed */ 7);
+    std::uniform_real_distribution<float> positionDistribution(0, 2000);
+    std::uniform_real_distribution<float> velocityDistribution(-5000, 5000);
+    // Touchscreens report at 60Hz to 240Hz.
+    std::uniform_int_distribution<nsecs_t> intervalDistribution(ms2ns(4), ms2ns(16));
+    std::uniform_int_distribution<uint32_t> percentDistribution(0, 99);
+
+    nsecs_t eventTime = 0;
+    BitSet32 idBits;
+    idBits.markBit(0);
+    std::array<VelocityTracker::Position, MAX_POINTER_ID + 1> positions;
+    std::array<VelocityTracker::Position, MAX_POINTER_ID + 1> velocities;
+    for (uint32_t id = 0; id <= MAX_POINTER_ID; id++) {
+        positions[id] = {positionDistribution(generator), positionDistribution(generator)};
+        velocities[id] = {velocityDistribution(generator), velocityDistribution(generator)};
+    }
+
+    for (int32_t i = 0; i < 2000; i++) {
+        const uint32_t percent = percentDistribution(generator);
+        if (percent < 5) {
+            // Repeat the last movement time, with new positions.
+        } else if (percent < 7) {
+            // A pause longer than the horizon.
+            eventTime += ms2ns(150);
+        } else {
+            eventTime += intervalDistribution(generator);
+        }
+
+        if (percent >= 5 && percent < 15) {
+            // A pointer goes up or down. Like VelocityTracker, clear a new pointer first.
+            const uint32_t id = percentDistribution(generator) % 10;
+            if (idBits.hasBit(id)) {
+                if (idBits.count() > 1) {
+                    idBits.clearBit(id);
+                }
+            } else {
+                BitSet32 downIdBits;
+                downIdBits.markBit(id);
+                mExpectedStrategy.clearPointers(downIdBits);
+                mStrategy.clearPointers(downIdBits);
+                idBits.markBit(id);
+            }
+        }
+
+        std::vector<VelocityTracker::Position> movementPositions;
+        for (BitSet32 iterIdBits(idBits); !iterIdBits.isEmpty();) {
+            const uint32_t id = iterIdBits.clearFirstMarkedBit();
+            // Move at a constant velocity, with up to 1 unit of noise.
+            positions[id].x += velocities[id].x * 0.001f + (percent % 3) * 0.5f;
+            positions[id].y += velocities[id].y * 0.001f - (percent % 5) * 0.25f;
+            movementPositions.push_back(positions[id]);
+        }
+        addMovementAndCheck(eventTime, idBits, movementPositions);
+        if (HasFailure()) {
+            FAIL() << "Estimates differ after movement " << i;
+        }
+    }
+}
+
 } // namespace android
@@ -156,6 +156,35 @@ NotifyMotionArgs::NotifyMotionArgs(const NotifyMotionArgs& other)
     }
 }
 
+NotifyMotionArgs& NotifyMotionArgs::operator=(const NotifyMotionArgs& other) {
+    id = other.id;
+    eventTime = other.eventTime;
+    deviceId = other.deviceId;
+    source = other.source;
+    displayId = other.displayId;
+    policyFlags = other.policyFlags;
+    action = other.action;
+    actionButton = other.actionButton;
+    flags = other.flags;
+    metaState = other.metaState;
+    buttonState = other.buttonState;
+    classification = other.classification;
+    edgeFlags = other.edgeFlags;
+    pointerCount = other.pointerCount;
+    xPrecision = other.xPrecision;
+    yPrecision = other.yPrecision;
+    xCursorPosition = other.xCursorPosition;
+    yCursorPosition = other.yCursorPosition;
+    downTime = other.downTime;
+    readTime = other.readTime;
+    videoFrames = other.videoFrames;
+    for (uint32_t i = 0; i < pointerCount; i++) {
+        pointerProperties[i].copyFrom(other.pointerProperties[i]);
+        pointerCoords[i].copyFrom(other.pointerCoords[i]);
+    }
+    return *this;
+}
+
 static inline bool isCursorPositionEqual(float lhs, float rhs) {
     return (isnan(lhs) && isnan(rhs)) || lhs == rhs;
 }
@@ -316,62 +345,73 @@ QueuedInputListener::QueuedInputListener(const sp<InputListenerInterface>& inner
         mInnerListener(innerListener) {
 }
 
-QueuedInputListener::~QueuedInputListener() {
-    size_t count = mArgsQueue.size();
-    for (size_t i = 0; i < count; i++) {
-        delete mArgsQueue[i];
+QueuedInputListener::~QueuedInputListener() {}
+
+template <typename T>
+void QueuedInputListener::enqueue(const T& args) {
+    if (mArgsCount < mArgsQueue.size()) {
+        // Reuses the slot, which only allocates if the slot held args of another type or the new
+        // args have more video frames or sensor values than the slot has room for.
+        mArgsQueue[mArgsCount] = args;
+    } else {
+        mArgsQueue.emplace_back(args);
     }
+    mArgsCount++;
 }
 
 void QueuedInputListener::notifyConfigurationChanged(
         const NotifyConfigurationChangedArgs* args) {
     traceEvent(__func__, args->id);
-    mArgsQueue.push_back(new NotifyConfigurationChangedArgs(*args));
+    enqueue(*args);
 }
 
 void QueuedInputListener::notifyKey(const NotifyKeyArgs* args) {
     traceEvent(__func__, args->id);
-    mArgsQueue.push_back(new NotifyKeyArgs(*args));
+    enqueue(*args);
 }
 
 void QueuedInputListener::notifyMotion(const NotifyMotionArgs* args) {
     traceEvent(__func__, args->id);
-    mArgsQueue.push_back(new NotifyMotionArgs(*args));
+    enqueue(*args);
 }
 
 void QueuedInputListener::notifySwitch(const NotifySwitchArgs* args) {
     traceEvent(__func__, args->id);
-    mArgsQueue.push_back(new NotifySwitchArgs(*args));
+    enqueue(*args);
 }
 
 void QueuedInputListener::notifySensor(const NotifySensorArgs* args) {
     traceEvent(__func__, args->id);
-    mArgsQueue.push_back(new NotifySensorArgs(*args));
+    enqueue(*args);
 }
 
 void QueuedInputListener::notifyVibratorState(const NotifyVibratorStateArgs* args) {
     traceEvent(__func__, args->id);
-    mArgsQueue.push_back(new NotifyVibratorStateArgs(*args));
+    enqueue(*args);
 }
 
 void QueuedInputListener::notifyDeviceReset(const NotifyDeviceResetArgs* args) {
     traceEvent(__func__, args->id);
-    mArgsQueue.push_back(new NotifyDeviceResetArgs(*args));
+    enqueue(*args);
 }
 
 void QueuedInputListener::notifyPointerCaptureChanged(const NotifyPointerCaptureChangedArgs* args) {
     traceEvent(__func__, args->id);
-    mArgsQueue.push_back(new NotifyPointerCaptureChangedArgs(*args));
+    enqueue(*args);
 }
 
 void QueuedInputListener::flush() {
-    size_t count = mArgsQueue.size();
-    for (size_t i = 0; i < count; i++) {
-        NotifyArgs* args = mArgsQueue[i];
-        args->notify(mInnerListener);
-        delete args;
+    for (size_t i = 0; i < mArgsCount; i++) {
+        std::visit([this](const NotifyArgs& args) { args.notify(mInnerListener); }, mArgsQueue[i]);
+        // Release the video frames and sensor values rather than hold on to them until the slot is
+        // reused, which may not be for a while. The vectors keep their capacity.
+        if (auto* motionArgs = std::get_if<NotifyMotionArgs>(&mArgsQueue[i])) {
+            motionArgs->videoFrames.clear();
+        } else if (auto* sensorArgs = std::get_if<NotifySensorArgs>(&mArgsQueue[i])) {
+            sensorArgs->values.clear();
+        }
     }
-    mArgsQueue.clear();
+    mArgsCount = 0;
 }
 
 } // namespace android
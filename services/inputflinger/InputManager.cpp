@@ -25,6 +25,7 @@
 #include <binder/IPCThreadState.h>
 
 #include <log/log.h>
+#include <utils/String8.h>
 #include <unordered_map>
 
 #include <private/android_filesystem_config.h>
@@ -161,10 +162,47 @@ binder::Status InputManager::removeInputChannel(const sp<IBinder>& connectionTok
     return binder::Status::ok();
 }
 
+// Handles "dumpsys inputflinger --start-event-recording <path>" and
+// "dumpsys inputflinger --stop-event-recording", which record the raw touch events for replaying
+// them into the reader later.  Returns false if 'args' is not one of these commands.
+bool InputManager::handleEventRecordingCommand(const Vector<String16>& args, std::string& dump) {
+    const bool start = args.size() == 2 && args[0] == String16("--start-event-recording");
+    const bool stop = args.size() == 1 && args[0] == String16("--stop-event-recording");
+    if (!start && !stop) {
+        return false;
+    }
+
+    IPCThreadState* ipc = IPCThreadState::self();
+    const int uid = ipc->getCallingUid();
+    if (uid != AID_SHELL && uid != AID_ROOT) {
+        ALOGE("Invalid attempt to record the input events over IPC "
+              "from non shell/root entity (PID: %d)", ipc->getCallingPid());
+        dump += " Permission denied\n";
+        return true;
+    }
+
+    if (stop) {
+        mReader->stopEventRecording();
+        dump += " Stopped recording the input events\n";
+        return true;
+    }
+    const std::string path = String8(args[1]).string();
+    const status_t status = mReader->startEventRecording(path);
+    if (status == OK) {
+        dump += " Recording the input events to " + path + "\n";
+    } else {
+        dump += " Could not record the input events to " + path + ": " + statusToString(status) +
+                "\n";
+    }
+    return true;
+}
+
 status_t InputManager::dump(int fd, const Vector<String16>& args) {
     std::string dump;
 
-    dump += " InputFlinger dump\n";
+    if (!handleEventRecordingCommand(args, dump)) {
+        dump += " InputFlinger dump\n";
+    }
 
     ::write(fd, dump.c_str(), dump.size());
     return NO_ERROR;
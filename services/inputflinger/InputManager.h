@@ -113,6 +113,8 @@ public:
     binder::Status setFocusedWindow(const FocusRequest&) override;
 
 private:
+    bool handleEventRecordingCommand(const Vector<String16>& args, std::string& dump);
+
     sp<InputReaderInterface> mReader;
 
     sp<InputClassifierInterface> mClassifier;
@@ -0,0 +1,369 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <android-base/unique_fd.h>
+#include <fcntl.h>
+#include <linux/uinput.h>
+#include <log/log.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+#include "EventHub.h"
+#include "InputReader.h"
+
+// Replays a multi-touch event log onto several uinput touchscreens at once, and measures how long
+// an InputReader takes to read all the events from EventHub and notify the motions.
+// Creating uinput devices and blocking suspend need root.
+
+namespace android {
+
+using namespace std::chrono_literals;
+
+// The number of fingers on each touchscreen.
+static constexpr int32_t POINTER_COUNT = 10;
+
+// The number of frames each touchscreen reports per reader loop, as a touchscreen sampled at a
+// high rate would when the reader is a few milliseconds late.
+static constexpr size_t FRAMES_PER_LOOP = 4;
+
+// The number of frames in the log, which is replayed from the start once it has all been sent.
+static constexpr size_t LOG_FRAME_COUNT = 240;
+
+// How long a reader loop may wait for events before the benchmark gives up.
+static constexpr std::chrono::milliseconds LOOP_TIMEOUT = 1000ms;
+
+static constexpr int32_t DISPLAY_WIDTH = 1080;
+static constexpr int32_t DISPLAY_HEIGHT = 2340;
+
+static constexpr char DEVICE_NAME_PREFIX[] = "EventHub benchmark touchscreen ";
+
+static void append(std::vector<struct input_event>& log, uint16_t type, uint16_t code,
+                   int32_t value) {
+    struct input_event event = {};
+    event.type = type;
+    event.code = code;
+    event.value = value;
+    log.push_back(event);
+}
+
+// Builds the frame that puts all the fingers down.
+static std::vector<struct input_event> recordTouchDown() {
+    std::vector<struct input_event> log;
+    for (int32_t slot = 0; slot < POINTER_COUNT; slot++) {
+        append(log, EV_ABS, ABS_MT_SLOT, slot);
+        append(log, EV_ABS, ABS_MT_TRACKING_ID, slot);
+        append(log, EV_ABS, ABS_MT_POSITION_X, 50 + slot * 100);
+        append(log, EV_ABS, ABS_MT_POSITION_Y, 100);
+    }
+    append(log, EV_KEY, BTN_TOUCH, 1);
+    append(log, EV_SYN, SYN_REPORT, 0);
+    return log;
+}
+
+// Builds the log of a swipe of all the fingers, as uinput would record it: a slot, the new
+// position of the finger in that slot, and so on for all the fingers, then a sync per frame.
+// The positions of every frame differ from those of the previous one, since evdev drops the
+// values that do not change, so that each frame is notified as a move.
+static std::vector<struct input_event> recordSwipeLog() {
+    std::vector<struct input_event> log;
+    for (size_t frame = 0; frame < LOG_FRAME_COUNT; frame++) {
+        for (int32_t slot = 0; slot < POINTER_COUNT; slot++) {
+            append(log, EV_ABS, ABS_MT_SLOT, slot);
+            append(log, EV_ABS, ABS_MT_POSITION_X, 50 + slot * 100 + frame % 2);
+            append(log, EV_ABS, ABS_MT_POSITION_Y, 200 + frame * 8);
+        }
+        append(log, EV_SYN, SYN_REPORT, 0);
+    }
+    return log;
+}
+
+// --- ReplayTouchScreen ---
+
+// A uinput touchscreen that the log is replayed onto.
+class ReplayTouchScreen {
+public:
+    explicit ReplayTouchScreen(const std::string& name) : mName(name) {}
+
+    ~ReplayTouchScreen() {
+        if (mFd >= 0 && ioctl(mFd, UI_DEV_DESTROY)) {
+            ALOGE("Error while destroying uinput device: %s", strerror(errno));
+        }
+    }
+
+    bool init() {
+        mFd.reset(open("/dev/uinput", O_WRONLY | O_NONBLOCK | O_CLOEXEC));
+        if (mFd < 0) {
+            ALOGE("Can't open /dev/uinput: %s", strerror(errno));
+            return false;
+        }
+
+        struct uinput_user_dev device = {};
+        strlcpy(device.name, mName.c_str(), UINPUT_MAX_NAME_SIZE);
+        device.id.bustype = BUS_VIRTUAL;
+        device.id.vendor = 0x01;
+        device.id.product = 0x02;
+        device.id.version = 1;
+        setAbs(&device, ABS_MT_SLOT, 0, POINTER_COUNT - 1);
+        setAbs(&device, ABS_MT_TRACKING_ID, 0, UINT16_MAX);
+        setAbs(&device, ABS_MT_POSITION_X, 0, DISPLAY_WIDTH - 1);
+        setAbs(&device, ABS_MT_POSITION_Y, 0, DISPLAY_HEIGHT - 1);
+        ioctl(mFd, UI_SET_EVBIT, EV_KEY);
+        ioctl(mFd, UI_SET_KEYBIT, BTN_TOUCH);
+        ioctl(mFd, UI_SET_PROPBIT, INPUT_PROP_DIRECT);
+
+        if (write(mFd, &device, sizeof(device)) < 0 || ioctl(mFd, UI_DEV_CREATE)) {
+            ALOGE("Can't create uinput device %s: %s", mName.c_str(), strerror(errno));
+            return false;
+        }
+        return true;
+    }
+
+    const std::string& getName() const { return mName; }
+
+    bool replay(const struct input_event* events, size_t count) {
+        return write(mFd, events, sizeof(struct input_event) * count) >= 0;
+    }
+
+private:
+    const std::string mName;
+    base::unique_fd mFd;
+
+    void setAbs(struct uinput_user_dev* device, int32_t axis, int32_t min, int32_t max) {
+        ioctl(mFd, UI_SET_EVBIT, EV_ABS);
+        ioctl(mFd, UI_SET_ABSBIT, axis);
+        device->absmin[axis] = min;
+        device->absmax[axis] = max;
+    }
+};
+
+namespace {
+
+// --- FakeInputReaderPolicy ---
+
+class FakeInputReaderPolicy : public InputReaderPolicyInterface {
+public:
+    FakeInputReaderPolicy() {
+        DisplayViewport viewport;
+        viewport.displayId = ADISPLAY_ID_DEFAULT;
+        viewport.orientation = DISPLAY_ORIENTATION_0;
+        viewport.logicalRight = viewport.physicalRight = viewport.deviceWidth = DISPLAY_WIDTH;
+        viewport.logicalBottom = viewport.physicalBottom = viewport.deviceHeight = DISPLAY_HEIGHT;
+        viewport.isActive = true;
+        viewport.uniqueId = "local:0";
+        viewport.type = ViewportType::INTERNAL;
+        mConfig.setDisplayViewports({viewport});
+    }
+
+private:
+    void getReaderConfiguration(InputReaderConfiguration* outConfig) override {
+        *outConfig = mConfig;
+    }
+
+    std::shared_ptr<PointerControllerInterface> obtainPointerController(int32_t) override {
+        return nullptr;
+    }
+
+    void notifyInputDevicesChanged(const std::vector<InputDeviceInfo>&) override {}
+
+    std::shared_ptr<KeyCharacterMap> getKeyboardLayoutOverlay(
+            const InputDeviceIdentifier&) override {
+        return nullptr;
+    }
+
+    std::string getDeviceAlias(const InputDeviceIdentifier&) override { return ""; }
+
+    TouchAffineTransformation getTouchAffineTransformation(const std::string&, int32_t) override {
+        return TouchAffineTransformation();
+    }
+
+    InputReaderConfiguration mConfig;
+};
+
+// --- CountingInputListener ---
+
+// Counts the motions that the reader notifies.
+class CountingInputListener : public InputListenerInterface {
+public:
+    size_t notifiedMotionCount = 0;
+
+    void notifyConfigurationChanged(const NotifyConfigurationChangedArgs*) override {}
+    void notifyKey(const NotifyKeyArgs*) override {}
+    void notifyMotion(const NotifyMotionArgs*) override { notifiedMotionCount += 1; }
+    void notifySwitch(const NotifySwitchArgs*) override {}
+    void notifySensor(const NotifySensorArgs*) override {}
+    void notifyVibratorState(const NotifyVibratorStateArgs*) override {}
+    void notifyDeviceReset(const NotifyDeviceResetArgs*) override {}
+    void notifyPointerCaptureChanged(const NotifyPointerCaptureChangedArgs*) override {}
+};
+
+// --- ReplayInputReader ---
+
+// Lets the benchmark run the reader loop itself, rather than on the reader thread.
+class ReplayInputReader : public InputReader {
+public:
+    using InputReader::InputReader;
+    using InputReader::loopOnce;
+};
+
+// --- ReaderWatchdog ---
+
+// Runs the loops of a reader, and wakes it up if it waits for events for longer than
+// LOOP_TIMEOUT, so that a benchmark whose events are lost fails rather than hangs.
+class ReaderWatchdog {
+public:
+    ReaderWatchdog(ReplayInputReader& reader, EventHubInterface& eventHub)
+          : mReader(reader), mEventHub(eventHub), mThread([this] { run(); }) {}
+
+    ~ReaderWatchdog() {
+        {
+            std::scoped_lock lock(mLock);
+            mStopped = true;
+        }
+        mCondition.notify_all();
+        mThread.join();
+    }
+
+    // Runs one loop of the reader, and returns false if it had to be woken up.
+    bool loopOnce() {
+        {
+            std::scoped_lock lock(mLock);
+            mLoopDeadline = std::chrono::steady_clock::now() + LOOP_TIMEOUT;
+            mTimedOut = false;
+        }
+        mCondition.notify_all();
+        mReader.loopOnce();
+        std::scoped_lock lock(mLock);
+        mLoopDeadline.reset();
+        return !mTimedOut;
+    }
+
+private:
+    ReplayInputReader& mReader;
+    EventHubInterface& mEventHub;
+
+    std::mutex mLock;
+    std::condition_variable mCondition;
+    std::optional<std::chrono::steady_clock::time_point> mLoopDeadline GUARDED_BY(mLock);
+    bool mTimedOut GUARDED_BY(mLock) = false;
+    bool mStopped GUARDED_BY(mLock) = false;
+    std::thread mThread;
+
+    void run() {
+        std::unique_lock lock(mLock);
+        while (!mStopped) {
+            if (!mLoopDeadline) {
+                mCondition.wait(lock);
+            } else if (mCondition.wait_until(lock, *mLoopDeadline) == std::cv_status::timeout &&
+                       mLoopDeadline && std::chrono::steady_clock::now() >= *mLoopDeadline) {
+                mTimedOut = true;
+                mLoopDeadline.reset();
+                mEventHub.wake();
+            }
+        }
+    }
+};
+
+} // namespace
+
+// Returns how many of the touchscreens the reader has added.
+static size_t countAddedTouchScreens(const InputReader& reader) {
+    size_t count = 0;
+    for (const InputDeviceInfo& device : reader.getInputDevices()) {
+        if (device.getIdentifier().name.rfind(DEVICE_NAME_PREFIX, 0) == 0) {
+            count += 1;
+        }
+    }
+    return count;
+}
+
+// Each iteration is one reader loop's worth of frames from all the touchscreens at once.
+static void benchmarkReadTouchScreens(benchmark::State& state) {
+    const size_t deviceCount = state.range(0);
+    std::vector<std::unique_ptr<ReplayTouchScreen>> touchScreens;
+    for (size_t i = 0; i < deviceCount; i++) {
+        touchScreens.push_back(std::make_unique<ReplayTouchScreen>(
+                DEVICE_NAME_PREFIX + std::to_string(i)));
+        if (!touchScreens.back()->init()) {
+            state.SkipWithError("Could not create the uinput touchscreens");
+            return;
+        }
+    }
+
+    auto eventHub = std::make_shared<EventHub>();
+    sp<CountingInputListener> listener = new CountingInputListener();
+    ReplayInputReader reader(eventHub, new FakeInputReaderPolicy(), listener);
+    ReaderWatchdog watchdog(reader, *eventHub);
+
+    // Add the touchscreens, and put all their fingers down.
+    while (countAddedTouchScreens(reader) < deviceCount) {
+        if (!watchdog.loopOnce()) {
+            state.SkipWithError("The reader did not add all the uinput touchscreens");
+            return;
+        }
+    }
+    const std::vector<struct input_event> touchDown = recordTouchDown();
+    for (const std::unique_ptr<ReplayTouchScreen>& touchScreen : touchScreens) {
+        touchScreen->replay(touchDown.data(), touchDown.size());
+    }
+    // Each finger goes down with a motion of its own.
+    while (listener->notifiedMotionCount < deviceCount * POINTER_COUNT) {
+        if (!watchdog.loopOnce()) {
+            state.SkipWithError("Timed out waiting for the fingers to go down");
+            return;
+        }
+    }
+
+    const std::vector<struct input_event> log = recordSwipeLog();
+    const size_t eventsPerFrame = log.size() / LOG_FRAME_COUNT;
+    size_t frame = 0;
+    size_t loopCount = 0;
+    size_t expectedMotionCount = listener->notifiedMotionCount;
+    for (auto _ : state) {
+        state.PauseTiming();
+        if (frame + FRAMES_PER_LOOP > LOG_FRAME_COUNT) {
+            frame = 0;
+        }
+        for (const std::unique_ptr<ReplayTouchScreen>& touchScreen : touchScreens) {
+            touchScreen->replay(&log[frame * eventsPerFrame], FRAMES_PER_LOOP * eventsPerFrame);
+        }
+        frame += FRAMES_PER_LOOP;
+        expectedMotionCount += deviceCount * FRAMES_PER_LOOP;
+        state.ResumeTiming();
+
+        // Run the reader until every frame of every touchscreen has been notified as a move.
+        while (listener->notifiedMotionCount < expectedMotionCount) {
+            if (!watchdog.loopOnce()) {
+                state.SkipWithError("Timed out waiting for the replayed events");
+                return;
+            }
+            loopCount += 1;
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations() * deviceCount * FRAMES_PER_LOOP);
+    state.counters["reader_loops_per_iteration"] =
+            benchmark::Counter(loopCount, benchmark::Counter::kAvgIterations);
+}
+
+BENCHMARK(benchmarkReadTouchScreens)->Arg(1)->Arg(5)->Arg(8)->UseRealTime();
+
+} // namespace android
@@ -16,6 +16,10 @@
 
 #include <benchmark/benchmark.h>
 
+#include <algorithm>
+#include <thread>
+#include <vector>
+
 #include <android/os/IInputConstants.h>
 #include <binder/Binder.h>
 #include "../dispatcher/InputDispatcher.h"
@@ -46,6 +50,8 @@ class FakeInputDispatcherPolicy : public InputDispatcherPolicyInterface {
 public:
     FakeInputDispatcherPolicy() {}
 
+    void setCoalesceOutboundMotion(bool enabled) { mConfig.coalesceOutboundMotion = enabled; }
+
 protected:
     virtual ~FakeInputDispatcherPolicy() {}
 
@@ -158,6 +164,28 @@ public:
         }
     }
 
+    // Waits for the next motion event and finishes it. Returns null if no motion event arrives
+    // within the timeout.
+    MotionEvent* consumeMotion(std::chrono::milliseconds timeout) {
+        uint32_t consumeSeq = 0;
+        InputEvent* event = nullptr;
+
+        std::chrono::time_point start = std::chrono::steady_clock::now();
+        status_t result = WOULD_BLOCK;
+        while (result == WOULD_BLOCK && std::chrono::steady_clock::now() - start < timeout) {
+            result = mConsumer->consume(&mEventFactory, true /*consumeBatches*/, -1, &consumeSeq,
+                                        &event);
+        }
+        if (result != OK) {
+            return nullptr;
+        }
+        mConsumer->sendFinishedSignal(consumeSeq, true);
+        if (event->getType() != AINPUT_EVENT_TYPE_MOTION) {
+            return nullptr;
+        }
+        return static_cast<MotionEvent*>(event);
+    }
+
 protected:
     explicit FakeInputReceiver(const sp<InputDispatcher>& dispatcher, const std::string name)
           : mDispatcher(dispatcher) {
@@ -212,6 +240,42 @@ protected:
     Rect mFrame;
 };
 
+// A small window that is not touch modal and has no input channel, for the touch to be looked
+// past on its way to the window that receives it.
+class TileWindowHandle : public InputWindowHandle {
+public:
+    TileWindowHandle(const std::shared_ptr<InputApplicationHandle>& inputApplicationHandle,
+                     const Rect& frame)
+          : mFrame(frame) {
+        inputApplicationHandle->updateInfo();
+        mInfo.applicationInfo = *inputApplicationHandle->getInfo();
+    }
+
+    virtual bool updateInfo() override {
+        mInfo.name = "TileWindowHandle";
+        mInfo.type = InputWindowInfo::Type::APPLICATION;
+        mInfo.flags = InputWindowInfo::Flag::NOT_TOUCH_MODAL;
+        mInfo.inputFeatures = InputWindowInfo::Feature::NO_INPUT_CHANNEL;
+        mInfo.dispatchingTimeout = DISPATCHING_TIMEOUT;
+        mInfo.frameLeft = mFrame.left;
+        mInfo.frameTop = mFrame.top;
+        mInfo.frameRight = mFrame.right;
+        mInfo.frameBottom = mFrame.bottom;
+        mInfo.globalScaleFactor = 1.0;
+        mInfo.touchableRegion.clear();
+        mInfo.addTouchableRegion(mFrame);
+        mInfo.visible = true;
+        mInfo.ownerPid = INJECTOR_PID;
+        mInfo.ownerUid = INJECTOR_UID;
+        mInfo.displayId = ADISPLAY_ID_DEFAULT;
+
+        return true;
+    }
+
+private:
+    const Rect mFrame;
+};
+
 static MotionEvent generateMotionEvent() {
     PointerProperties pointerProperties[1];
     PointerCoords pointerCoords[1];
@@ -281,6 +345,9 @@ static void benchmarkNotifyMotion(benchmark::State& state) {
     dispatcher->setInputWindows({{ADISPLAY_ID_DEFAULT, {window}}});
 
     NotifyMotionArgs motionArgs = generateMotionArgs();
+    // How long each notifyMotion call takes on the calling (reader) thread, while the dispatcher
+    // thread is dispatching the events sent before it.
+    std::vector<nsecs_t> notifyLatencies;
 
     for (auto _ : state) {
         // Send ACTION_DOWN
@@ -288,17 +355,30 @@ static void benchmarkNotifyMotion(benchmark::State& state) {
         motionArgs.downTime = now();
         motionArgs.eventTime = motionArgs.downTime;
         dispatcher->notifyMotion(&motionArgs);
+        notifyLatencies.push_back(now() - motionArgs.eventTime);
 
         // Send ACTION_UP
         motionArgs.action = AMOTION_EVENT_ACTION_UP;
         motionArgs.eventTime = now();
         dispatcher->notifyMotion(&motionArgs);
+        notifyLatencies.push_back(now() - motionArgs.eventTime);
 
         window->consumeEvent();
         window->consumeEvent();
     }
 
     dispatcher->stop();
+
+    if (notifyLatencies.empty()) {
+        return;
+    }
+    std::sort(notifyLatencies.begin(), notifyLatencies.end());
+    auto percentile = [&notifyLatencies](size_t p) {
+        return notifyLatencies[(notifyLatencies.size() - 1) * p / 100];
+    };
+    state.counters["notify_p50_ns"] = percentile(50);
+    state.counters["notify_p90_ns"] = percentile(90);
+    state.counters["notify_p99_ns"] = percentile(99);
 }
 
 static void benchmarkInjectMotion(benchmark::State& state) {
@@ -334,8 +414,142 @@ static void benchmarkInjectMotion(benchmark::State& state) {
     dispatcher->stop();
 }
 
+static void benchmarkNotifyMotionManyWindows(benchmark::State& state) {
+    const int32_t windowCount = state.range(0);
+
+    // Create dispatcher
+    sp<FakeInputDispatcherPolicy> fakePolicy = new FakeInputDispatcherPolicy();
+    sp<InputDispatcher> dispatcher = new InputDispatcher(fakePolicy);
+    dispatcher->setInputDispatchMode(/*enabled*/ true, /*frozen*/ false);
+    dispatcher->start();
+
+    // Tile small windows away from the touch, in front of the window which receives it, so
+    // that all of them have to be looked past when finding the touched window.
+    std::shared_ptr<FakeApplicationHandle> application = std::make_shared<FakeApplicationHandle>();
+    std::vector<sp<InputWindowHandle>> windows;
+    for (int32_t i = 0; i < windowCount - 1; i++) {
+        const int32_t left = WIDTH + (i % 20) * 40;
+        const int32_t top = (i / 20) * 40;
+        windows.push_back(new TileWindowHandle(application, Rect(left, top, left + 40, top + 40)));
+    }
+    sp<FakeWindowHandle> window = new FakeWindowHandle(application, dispatcher, "Fake Window");
+    windows.push_back(window);
+
+    dispatcher->setInputWindows({{ADISPLAY_ID_DEFAULT, windows}});
+
+    NotifyMotionArgs motionArgs = generateMotionArgs();
+
+    for (auto _ : state) {
+        // Send ACTION_DOWN
+        motionArgs.action = AMOTION_EVENT_ACTION_DOWN;
+        motionArgs.downTime = now();
+        motionArgs.eventTime = motionArgs.downTime;
+        dispatcher->notifyMotion(&motionArgs);
+
+        // Send ACTION_UP
+        motionArgs.action = AMOTION_EVENT_ACTION_UP;
+        motionArgs.eventTime = now();
+        dispatcher->notifyMotion(&motionArgs);
+
+        window->consumeEvent();
+        window->consumeEvent();
+    }
+
+    dispatcher->stop();
+}
+
+// The number of MOVE samples in each gesture sent to the slow application. They are sent as fast as
+// the dispatcher takes them, so that the application can't keep up.
+static constexpr int32_t SLOW_CONSUMER_MOVE_COUNT = 2000;
+
+// How long the slow application spends on each event it reads, as when it keeps missing frames.
+static constexpr std::chrono::milliseconds SLOW_CONSUMER_EVENT_TIME = 4ms;
+
+// The number of events that the dispatcher holds for its connections, read from its dump.
+static size_t getPendingEventCount(InputDispatcher& dispatcher) {
+    std::string dump;
+    dispatcher.dump(dump);
+    size_t count = 0;
+    for (const std::string& label : {"OutboundQueue: length=", "WaitQueue: length="}) {
+        for (size_t pos = dump.find(label); pos != std::string::npos;
+             pos = dump.find(label, pos + 1)) {
+            count += std::stoul(dump.substr(pos + label.size()));
+        }
+    }
+    return count;
+}
+
+// Each iteration is one gesture sent to a window whose application reads its events too slowly.
+// The argument enables outbound motion coalescing. The latency is measured from the time of the
+// newest sample in each event that the application reads to when it reads it.
+static void benchmarkNotifyMotionSlowConsumer(benchmark::State& state) {
+    sp<FakeInputDispatcherPolicy> fakePolicy = new FakeInputDispatcherPolicy();
+    fakePolicy->setCoalesceOutboundMotion(state.range(0));
+    sp<InputDispatcher> dispatcher = new InputDispatcher(fakePolicy);
+    dispatcher->setInputDispatchMode(/*enabled*/ true, /*frozen*/ false);
+    dispatcher->start();
+
+    std::shared_ptr<FakeApplicationHandle> application = std::make_shared<FakeApplicationHandle>();
+    sp<FakeWindowHandle> window = new FakeWindowHandle(application, dispatcher, "Fake Window");
+
+    dispatcher->setInputWindows({{ADISPLAY_ID_DEFAULT, {window}}});
+
+    NotifyMotionArgs motionArgs = generateMotionArgs();
+    std::vector<nsecs_t> latencies;
+    size_t deliveredSampleCount = 0;
+    size_t peakPendingEventCount = 0;
+
+    for (auto _ : state) {
+        std::thread applicationThread([&]() {
+            while (MotionEvent* event = window->consumeMotion(1000ms)) {
+                latencies.push_back(now() - event->getEventTime());
+                deliveredSampleCount += event->getHistorySize() + 1;
+                if (event->getAction() == AMOTION_EVENT_ACTION_UP) {
+                    break;
+                }
+                std::this_thread::sleep_for(SLOW_CONSUMER_EVENT_TIME);
+            }
+        });
+
+        motionArgs.action = AMOTION_EVENT_ACTION_DOWN;
+        motionArgs.downTime = now();
+        motionArgs.eventTime = motionArgs.downTime;
+        dispatcher->notifyMotion(&motionArgs);
+
+        motionArgs.action = AMOTION_EVENT_ACTION_MOVE;
+        for (int32_t i = 0; i < SLOW_CONSUMER_MOVE_COUNT; i++) {
+            motionArgs.eventTime = now();
+            dispatcher->notifyMotion(&motionArgs);
+        }
+        dispatcher->waitForIdle();
+        peakPendingEventCount = std::max(peakPendingEventCount, getPendingEventCount(*dispatcher));
+
+        motionArgs.action = AMOTION_EVENT_ACTION_UP;
+        motionArgs.eventTime = now();
+        dispatcher->notifyMotion(&motionArgs);
+        applicationThread.join();
+    }
+
+    dispatcher->stop();
+
+    state.counters["delivered_samples"] =
+            benchmark::Counter(deliveredSampleCount, benchmark::Counter::kAvgIterations);
+    state.counters["peak_pending_events"] = peakPendingEventCount;
+    if (latencies.empty()) {
+        return;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&latencies](size_t p) {
+        return latencies[(latencies.size() - 1) * p / 100];
+    };
+    state.counters["latency_p50_us"] = ns2us(percentile(50));
+    state.counters["latency_p99_us"] = ns2us(percentile(99));
+}
+
 BENCHMARK(benchmarkNotifyMotion);
 BENCHMARK(benchmarkInjectMotion);
+BENCHMARK(benchmarkNotifyMotionManyWindows)->Arg(10)->Arg(100)->Arg(500);
+BENCHMARK(benchmarkNotifyMotionSlowConsumer)->Arg(0)->Arg(1)->UseRealTime();
 
 } // namespace android::inputdispatcher
 
@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include "InputListener.h"
+
+// Counts the allocations made through operator new, so that the benchmarks can report how many
+// allocations each reader loop makes. This binary only holds these benchmarks, so that the
+// counting does not slow down the allocations of any other.
+static std::atomic<size_t> sAllocationCount{0};
+
+void* operator new(size_t size) {
+    sAllocationCount.fetch_add(1, std::memory_order_relaxed);
+    void* ptr = malloc(size == 0 ? 1 : size);
+    if (ptr == nullptr) {
+        abort();
+    }
+    return ptr;
+}
+
+void operator delete(void* ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    free(ptr);
+}
+
+namespace android {
+
+// An arbitrary device id.
+static const int32_t DEVICE_ID = 1;
+
+// The number of motion events the reader generates per loop, as a touchscreen sampled at a high
+// rate would when the reader falls behind by a frame.
+static const size_t MOTIONS_PER_LOOP = 4;
+
+// --- NullInputListener ---
+
+class NullInputListener : public InputListenerInterface {
+protected:
+    ~NullInputListener() override {}
+
+public:
+    void notifyConfigurationChanged(const NotifyConfigurationChangedArgs*) override {}
+    void notifyKey(const NotifyKeyArgs*) override {}
+    void notifyMotion(const NotifyMotionArgs* args) override {
+        benchmark::DoNotOptimize(args->pointerCoords[0].getX());
+    }
+    void notifySwitch(const NotifySwitchArgs*) override {}
+    void notifySensor(const NotifySensorArgs*) override {}
+    void notifyVibratorState(const NotifyVibratorStateArgs*) override {}
+    void notifyDeviceReset(const NotifyDeviceResetArgs*) override {}
+    void notifyPointerCaptureChanged(const NotifyPointerCaptureChangedArgs*) override {}
+};
+
+static NotifyMotionArgs generateMotionArgs(uint32_t pointerCount) {
+    PointerProperties pointerProperties[MAX_POINTERS];
+    PointerCoords pointerCoords[MAX_POINTERS];
+
+    for (uint32_t i = 0; i < pointerCount; i++) {
+        pointerProperties[i].clear();
+        pointerProperties[i].id = i;
+        pointerProperties[i].toolType = AMOTION_EVENT_TOOL_TYPE_FINGER;
+
+        pointerCoords[i].clear();
+        pointerCoords[i].setAxisValue(AMOTION_EVENT_AXIS_X, 100 + i * 10);
+        pointerCoords[i].setAxisValue(AMOTION_EVENT_AXIS_Y, 100 + i * 10);
+    }
+
+    const nsecs_t currentTime = systemTime(SYSTEM_TIME_MONOTONIC);
+    return NotifyMotionArgs(/* id */ 0, currentTime, currentTime, DEVICE_ID,
+                            AINPUT_SOURCE_TOUCHSCREEN, ADISPLAY_ID_DEFAULT, POLICY_FLAG_PASS_TO_USER,
+                            AMOTION_EVENT_ACTION_MOVE, /* actionButton */ 0, /* flags */ 0,
+                            AMETA_NONE, /* buttonState */ 0, MotionClassification::NONE,
+                            AMOTION_EVENT_EDGE_FLAG_NONE, pointerCount, pointerProperties,
+                            pointerCoords,
+                            /* xPrecision */ 0, /* yPrecision */ 0,
+                            AMOTION_EVENT_INVALID_CURSOR_POSITION,
+                            AMOTION_EVENT_INVALID_CURSOR_POSITION, currentTime,
+                            /* videoFrames */ {});
+}
+
+// Queues and flushes the events of one reader loop per iteration, the way InputReader::loopOnce
+// does.
+static void benchmarkQueueAndFlushMotions(benchmark::State& state) {
+    sp<QueuedInputListener> queuedListener = new QueuedInputListener(new NullInputListener());
+    NotifyMotionArgs motionArgs = generateMotionArgs(state.range(0));
+
+    size_t allocationCount = 0;
+    for (auto _ : state) {
+        const size_t allocationCountBefore = sAllocationCount.load(std::memory_order_relaxed);
+        for (size_t i = 0; i < MOTIONS_PER_LOOP; i++) {
+            motionArgs.id++;
+            queuedListener->notifyMotion(&motionArgs);
+        }
+        NotifyDeviceResetArgs resetArgs(motionArgs.id++, motionArgs.eventTime, DEVICE_ID);
+        queuedListener->notifyDeviceReset(&resetArgs);
+        queuedListener->flush();
+        allocationCount += sAllocationCount.load(std::memory_order_relaxed) - allocationCountBefore;
+    }
+
+    state.counters["allocations_per_loop"] =
+            benchmark::Counter(allocationCount, benchmark::Counter::kAvgIterations);
+}
+
+BENCHMARK(benchmarkQueueAndFlushMotions)->Arg(1)->Arg(10)->Arg(MAX_POINTERS);
+
+} // namespace android
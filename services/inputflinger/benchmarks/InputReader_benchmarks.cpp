@@ -0,0 +1,458 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <map>
+#include <vector>
+
+#include <binder/Binder.h>
+#include "../dispatcher/InputDispatcher.h"
+#include "EventRecording.h"
+#include "InputReader.h"
+
+// Replays a recording of raw events through a real InputReader and InputDispatcher, to a window
+// that covers the display, and measures how long each stage holds the events.  Each iteration is
+// one reader loop, so one batch of events from the recording.
+//
+// The recording is a multi-touch swipe on a touchscreen, unless INPUT_EVENT_RECORDING names a
+// file recorded with "dumpsys inputflinger --start-event-recording <path>".  Only the touches of
+// such a recording are dispatched, since no window has focus.
+
+namespace android {
+
+using inputdispatcher::InputDispatcher;
+using namespace std::chrono_literals;
+
+static constexpr int32_t DISPLAY_WIDTH = 1080;
+static constexpr int32_t DISPLAY_HEIGHT = 2340;
+
+static constexpr int32_t DEVICE_ID = 1;
+
+// The number of fingers of the swipe, and of the frames the touchscreen reports during it.
+static constexpr int32_t POINTER_COUNT = 10;
+static constexpr size_t SWIPE_FRAME_COUNT = 240;
+
+// The time between two frames of a touchscreen sampled at 120Hz.
+static constexpr nsecs_t FRAME_INTERVAL = 8333333;
+
+static constexpr std::chrono::nanoseconds DISPATCHING_TIMEOUT = 5s;
+
+// How long to wait for the window to receive the events of a batch.
+static constexpr std::chrono::milliseconds CONSUME_TIMEOUT = 100ms;
+
+static constexpr char RECORDING_PATH_VARIABLE[] = "INPUT_EVENT_RECORDING";
+
+static nsecs_t now() {
+    return systemTime(SYSTEM_TIME_MONOTONIC);
+}
+
+static EventRecording recordSwipe() {
+    EventRecording recording;
+    RecordedDevice& device = recording.devices[DEVICE_ID];
+    device.id = DEVICE_ID;
+    device.identifier.name = "InputReader benchmark touchscreen";
+    device.identifier.descriptor = "benchmark";
+    device.identifier.bus = BUS_VIRTUAL;
+    device.classes = Flags<InputDeviceClass>(InputDeviceClass::TOUCH) | InputDeviceClass::TOUCH_MT;
+    device.controllerNumber = 0;
+    device.configuration["touch.deviceType"] = "touchScreen";
+    device.absoluteAxes[ABS_MT_SLOT] = {true, 0, POINTER_COUNT - 1, 0, 0, 0};
+    device.absoluteAxes[ABS_MT_TRACKING_ID] = {true, 0, UINT16_MAX, 0, 0, 0};
+    device.absoluteAxes[ABS_MT_POSITION_X] = {true, 0, DISPLAY_WIDTH - 1, 0, 0, 0};
+    device.absoluteAxes[ABS_MT_POSITION_Y] = {true, 0, DISPLAY_HEIGHT - 1, 0, 0, 0};
+    device.inputProperties.insert(INPUT_PROP_DIRECT);
+    device.keys[BTN_TOUCH] = {AKEYCODE_UNKNOWN, 0};
+
+    recording.batches.push_back(
+            {{0, 0, DEVICE_ID, EventHubInterface::DEVICE_ADDED, 0, 0},
+             {0, 0, 0, EventHubInterface::FINISHED_DEVICE_SCAN, 0, 0}});
+    for (size_t frame = 0; frame <= SWIPE_FRAME_COUNT; frame++) {
+        const nsecs_t when = (frame + 1) * FRAME_INTERVAL;
+        std::vector<RawEvent> batch;
+        auto append = [&batch, when](int32_t type, int32_t code, int32_t value) {
+            batch.push_back({when, when, DEVICE_ID, type, code, value});
+        };
+        for (int32_t slot = 0; slot < POINTER_COUNT; slot++) {
+            append(EV_ABS, ABS_MT_SLOT, slot);
+            if (frame == 0) {
+                append(EV_ABS, ABS_MT_TRACKING_ID, slot);
+            } else if (frame == SWIPE_FRAME_COUNT) {
+                append(EV_ABS, ABS_MT_TRACKING_ID, -1);
+                continue;
+            }
+            append(EV_ABS, ABS_MT_POSITION_X, 50 + slot * 100);
+            append(EV_ABS, ABS_MT_POSITION_Y, 200 + frame * 8);
+        }
+        if (frame == 0) {
+            append(EV_KEY, BTN_TOUCH, 1);
+        } else if (frame == SWIPE_FRAME_COUNT) {
+            append(EV_KEY, BTN_TOUCH, 0);
+        }
+        append(EV_SYN, SYN_REPORT, 0);
+        recording.batches.push_back(std::move(batch));
+    }
+    return recording;
+}
+
+static base::Result<EventRecording> loadRecording() {
+    const char* path = getenv(RECORDING_PATH_VARIABLE);
+    if (path == nullptr) {
+        return recordSwipe();
+    }
+    return EventRecording::load(path);
+}
+
+namespace {
+
+// --- FakeInputReaderPolicy ---
+
+class FakeInputReaderPolicy : public InputReaderPolicyInterface {
+public:
+    FakeInputReaderPolicy() {
+        DisplayViewport viewport;
+        viewport.displayId = ADISPLAY_ID_DEFAULT;
+        viewport.orientation = DISPLAY_ORIENTATION_0;
+        viewport.logicalRight = viewport.physicalRight = viewport.deviceWidth = DISPLAY_WIDTH;
+        viewport.logicalBottom = viewport.physicalBottom = viewport.deviceHeight = DISPLAY_HEIGHT;
+        viewport.isActive = true;
+        viewport.uniqueId = "local:0";
+        viewport.type = ViewportType::INTERNAL;
+        mConfig.setDisplayViewports({viewport});
+    }
+
+private:
+    void getReaderConfiguration(InputReaderConfiguration* outConfig) override {
+        *outConfig = mConfig;
+    }
+
+    std::shared_ptr<PointerControllerInterface> obtainPointerController(int32_t) override {
+        return nullptr;
+    }
+
+    void notifyInputDevicesChanged(const std::vector<InputDeviceInfo>&) override {}
+
+    std::shared_ptr<KeyCharacterMap> getKeyboardLayoutOverlay(
+            const InputDeviceIdentifier&) override {
+        return nullptr;
+    }
+
+    std::string getDeviceAlias(const InputDeviceIdentifier&) override { return ""; }
+
+    TouchAffineTransformation getTouchAffineTransformation(const std::string&, int32_t) override {
+        return TouchAffineTransformation();
+    }
+
+    InputReaderConfiguration mConfig;
+};
+
+// --- FakeInputDispatcherPolicy ---
+
+class FakeInputDispatcherPolicy : public InputDispatcherPolicyInterface {
+private:
+    void notifyConfigurationChanged(nsecs_t) override {}
+
+    void notifyNoFocusedWindowAnr(const std::shared_ptr<InputApplicationHandle>&) override {}
+
+    void notifyWindowUnresponsive(const sp<IBinder>&, const std::string& reason) override {
+        ALOGE("Window is not responding: %s", reason.c_str());
+    }
+
+    void notifyWindowResponsive(const sp<IBinder>&) override {}
+
+    void notifyMonitorUnresponsive(int32_t, const std::string&) override {}
+
+    void notifyMonitorResponsive(int32_t) override {}
+
+    void notifyInputChannelBroken(const sp<IBinder>&) override {}
+
+    void notifyFocusChanged(const sp<IBinder>&, const sp<IBinder>&) override {}
+
+    void notifySensorEvent(int32_t, InputDeviceSensorType, InputDeviceSensorAccuracy, nsecs_t,
+                           const std::vector<float>&) override {}
+
+    void notifySensorAccuracy(int32_t, InputDeviceSensorType, InputDeviceSensorAccuracy) override {}
+
+    void notifyVibratorState(int32_t, bool) override {}
+
+    void notifyUntrustedTouch(const std::string&) override {}
+
+    void getDispatcherConfiguration(InputDispatcherConfiguration* outConfig) override {
+        *outConfig = mConfig;
+    }
+
+    bool filterInputEvent(const InputEvent*, uint32_t) override { return true; }
+
+    void interceptKeyBeforeQueueing(const KeyEvent*, uint32_t&) override {}
+
+    // Like the window manager policy with the screen on.
+    void interceptMotionBeforeQueueing(int32_t, nsecs_t, uint32_t& policyFlags) override {
+        policyFlags |= POLICY_FLAG_PASS_TO_USER;
+    }
+
+    nsecs_t interceptKeyBeforeDispatching(const sp<IBinder>&, const KeyEvent*, uint32_t) override {
+        return 0;
+    }
+
+    bool dispatchUnhandledKey(const sp<IBinder>&, const KeyEvent*, uint32_t, KeyEvent*) override {
+        return false;
+    }
+
+    void notifySwitch(nsecs_t, uint32_t, uint32_t, uint32_t) override {}
+
+    void pokeUserActivity(nsecs_t, int32_t, int32_t) override {}
+
+    bool checkInjectEventsPermissionNonReentrant(int32_t, int32_t) override { return false; }
+
+    void onPointerDownOutsideFocus(const sp<IBinder>&) override {}
+
+    void setPointerCapture(const PointerCaptureRequest&) override {}
+
+    void notifyDropWindow(const sp<IBinder>&, float, float) override {}
+
+    InputDispatcherConfiguration mConfig;
+};
+
+// --- FakeApplicationHandle ---
+
+class FakeApplicationHandle : public InputApplicationHandle {
+public:
+    bool updateInfo() override {
+        mInfo.dispatchingTimeoutMillis =
+                std::chrono::duration_cast<std::chrono::milliseconds>(DISPATCHING_TIMEOUT).count();
+        return true;
+    }
+};
+
+// --- FullScreenWindowHandle ---
+
+// A window that covers the display, and receives the touches.
+class FullScreenWindowHandle : public InputWindowHandle {
+public:
+    FullScreenWindowHandle(const std::shared_ptr<InputApplicationHandle>& application,
+                           const sp<InputDispatcher>& dispatcher) {
+        mClientChannel = *dispatcher->createInputChannel("Full Screen Window");
+        mConsumer = std::make_unique<InputConsumer>(mClientChannel);
+        application->updateInfo();
+        mInfo.applicationInfo = *application->getInfo();
+    }
+
+    bool updateInfo() override {
+        mInfo.token = mClientChannel->getConnectionToken();
+        mInfo.name = "FullScreenWindowHandle";
+        mInfo.type = InputWindowInfo::Type::APPLICATION;
+        mInfo.flags = InputWindowInfo::Flag::NOT_TOUCH_MODAL;
+        mInfo.dispatchingTimeout = DISPATCHING_TIMEOUT;
+        mInfo.frameLeft = 0;
+        mInfo.frameTop = 0;
+        mInfo.frameRight = DISPLAY_WIDTH;
+        mInfo.frameBottom = DISPLAY_HEIGHT;
+        mInfo.globalScaleFactor = 1.0;
+        mInfo.touchableRegion.clear();
+        mInfo.addTouchableRegion(Rect(0, 0, DISPLAY_WIDTH, DISPLAY_HEIGHT));
+        mInfo.visible = true;
+        mInfo.focusable = false;
+        mInfo.hasWallpaper = false;
+        mInfo.paused = false;
+        mInfo.displayId = ADISPLAY_ID_DEFAULT;
+        return true;
+    }
+
+    // Consumes the motions that have been dispatched to the window, calls 'onEvent' with each one
+    // and the time it was received at, and returns the number of samples they had.
+    template <typename Callback>
+    size_t consumeMotionSamples(Callback onEvent) {
+        size_t count = 0;
+        for (;;) {
+            uint32_t seq;
+            InputEvent* event;
+            if (mConsumer->consume(&mEventFactory, true /*consumeBatches*/, -1, &seq, &event) !=
+                OK) {
+                return count;
+            }
+            if (event->getType() == AINPUT_EVENT_TYPE_MOTION) {
+                onEvent(*event, now());
+                count += static_cast<MotionEvent*>(event)->getHistorySize() + 1;
+            }
+            mConsumer->sendFinishedSignal(seq, true);
+        }
+    }
+
+private:
+    std::shared_ptr<InputChannel> mClientChannel;
+    std::unique_ptr<InputConsumer> mConsumer;
+    PreallocatedInputEventFactory mEventFactory;
+};
+
+// --- TimingInputListener ---
+
+// Passes the reader's notifications to the dispatcher, noting when each motion was notified.
+class TimingInputListener : public InputListenerInterface {
+public:
+    explicit TimingInputListener(const sp<InputListenerInterface>& dispatcher)
+          : mDispatcher(dispatcher) {}
+
+    size_t notifiedMotionCount = 0;
+    // The time the reader read the first event of each motion from the EventHub, and the time
+    // the motion was notified to the dispatcher, by event time.
+    std::map<nsecs_t, std::pair<nsecs_t, nsecs_t>> motionTimes;
+
+    void notifyConfigurationChanged(const NotifyConfigurationChangedArgs* args) override {
+        mDispatcher->notifyConfigurationChanged(args);
+    }
+
+    void notifyKey(const NotifyKeyArgs* args) override { mDispatcher->notifyKey(args); }
+
+    void notifyMotion(const NotifyMotionArgs* args) override {
+        motionTimes.emplace(args->eventTime, std::make_pair(args->readTime, now()));
+        notifiedMotionCount += 1;
+        mDispatcher->notifyMotion(args);
+    }
+
+    void notifySwitch(const NotifySwitchArgs* args) override { mDispatcher->notifySwitch(args); }
+
+    void notifySensor(const NotifySensorArgs* args) override { mDispatcher->notifySensor(args); }
+
+    void notifyVibratorState(const NotifyVibratorStateArgs* args) override {
+        mDispatcher->notifyVibratorState(args);
+    }
+
+    void notifyDeviceReset(const NotifyDeviceResetArgs* args) override {
+        mDispatcher->notifyDeviceReset(args);
+    }
+
+    void notifyPointerCaptureChanged(const NotifyPointerCaptureChangedArgs* args) override {
+        mDispatcher->notifyPointerCaptureChanged(args);
+    }
+
+private:
+    sp<InputListenerInterface> mDispatcher;
+};
+
+// --- ReplayInputReader ---
+
+// Lets the benchmark run the reader loop itself, rather than on the reader thread.
+class ReplayInputReader : public InputReader {
+public:
+    using InputReader::InputReader;
+    using InputReader::loopOnce;
+};
+
+} // namespace
+
+static void reportPercentiles(benchmark::State& state, const std::string& stage,
+                              std::vector<nsecs_t>& latencies) {
+    if (latencies.empty()) {
+        return;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    for (size_t p : {50, 90, 99}) {
+        state.counters[stage + "_p" + std::to_string(p) + "_us"] =
+                latencies[(latencies.size() - 1) * p / 100] / 1000.0;
+    }
+}
+
+static void benchmarkReplay(benchmark::State& state, ReplayEventHub::Speed speed) {
+    base::Result<EventRecording> recording = loadRecording();
+    if (!recording.ok()) {
+        state.SkipWithError(recording.error().message().c_str());
+        return;
+    }
+    size_t inputEventCount = 0;
+    size_t inputBatchCount = 0;
+    for (const std::vector<RawEvent>& batch : recording->batches) {
+        const size_t count =
+                std::count_if(batch.begin(), batch.end(), [](const RawEvent& event) {
+                    return event.type < EventHubInterface::FIRST_SYNTHETIC_EVENT;
+                });
+        inputEventCount += count;
+        inputBatchCount += count > 0 ? 1 : 0;
+    }
+    if (inputEventCount == 0) {
+        state.SkipWithError("The recording has no input events");
+        return;
+    }
+
+    sp<InputDispatcher> dispatcher = new InputDispatcher(new FakeInputDispatcherPolicy());
+    dispatcher->setInputDispatchMode(/*enabled*/ true, /*frozen*/ false);
+    dispatcher->start();
+    std::shared_ptr<FakeApplicationHandle> application = std::make_shared<FakeApplicationHandle>();
+    sp<FullScreenWindowHandle> window = new FullScreenWindowHandle(application, dispatcher);
+    dispatcher->setInputWindows({{ADISPLAY_ID_DEFAULT, {window}}});
+
+    auto eventHub = std::make_shared<ReplayEventHub>(std::move(*recording), speed);
+    sp<TimingInputListener> listener = new TimingInputListener(dispatcher);
+    ReplayInputReader reader(eventHub, new FakeInputReaderPolicy(), listener);
+
+    std::vector<nsecs_t> readerLatencies;
+    std::vector<nsecs_t> dispatchLatencies;
+    std::vector<nsecs_t> endToEndLatencies;
+    auto onEvent = [&](const InputEvent& event, nsecs_t receiveTime) {
+        const nsecs_t eventTime = static_cast<const MotionEvent&>(event).getEventTime();
+        auto it = listener->motionTimes.find(eventTime);
+        if (it == listener->motionTimes.end()) {
+            return;
+        }
+        const auto [readTime, notifyTime] = it->second;
+        readerLatencies.push_back(notifyTime - readTime);
+        dispatchLatencies.push_back(receiveTime - notifyTime);
+        endToEndLatencies.push_back(receiveTime - readTime);
+        listener->motionTimes.erase(listener->motionTimes.begin(), std::next(it));
+    };
+
+    // Reads a batch and waits for it to go through the whole pipeline.
+    size_t receivedMotionCount = 0;
+    auto replayBatch = [&]() {
+        reader.loopOnce();
+        const std::chrono::time_point start = std::chrono::steady_clock::now();
+        while (receivedMotionCount < listener->notifiedMotionCount &&
+               std::chrono::steady_clock::now() - start < CONSUME_TIMEOUT) {
+            receivedMotionCount += window->consumeMotionSamples(onEvent);
+        }
+        // Motions that the dispatcher dropped are not waited for again.
+        receivedMotionCount = listener->notifiedMotionCount;
+    };
+
+    // Replay the whole recording once before timing anything, which also adds the devices.
+    while (!eventHub->isFinished()) {
+        replayBatch();
+    }
+    readerLatencies.clear();
+    dispatchLatencies.clear();
+    endToEndLatencies.clear();
+
+    for (auto _ : state) {
+        if (eventHub->isFinished()) {
+            eventHub->rewindEvents();
+        }
+        replayBatch();
+    }
+
+    dispatcher->stop();
+
+    state.SetItemsProcessed(state.iterations() * inputEventCount / inputBatchCount);
+    reportPercentiles(state, "reader", readerLatencies);
+    reportPercentiles(state, "dispatch", dispatchLatencies);
+    reportPercentiles(state, "end_to_end", endToEndLatencies);
+}
+
+BENCHMARK_CAPTURE(benchmarkReplay, MaxSpeed, ReplayEventHub::Speed::MAX)->UseRealTime();
+BENCHMARK_CAPTURE(benchmarkReplay, RecordedSpeed, ReplayEventHub::Speed::RECORDED)
+        ->UseRealTime()
+        ->Iterations(SWIPE_FRAME_COUNT);
+
+} // namespace android
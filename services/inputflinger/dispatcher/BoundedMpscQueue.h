@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <optional>
+
+namespace android::inputdispatcher {
+
+/**
+ * A FIFO queue of up to <i>capacity</i> objects, which any number of threads can push to, and
+ * one thread at a time can pop from, without locking.
+ *
+ * Objects pushed by one thread are popped in the order they were pushed. A push which has not
+ * finished yet holds back the objects pushed after it, so pop can return nothing even though a
+ * later push has finished.
+ */
+template <class T>
+class BoundedMpscQueue {
+public:
+    // The capacity is rounded up to a power of two, of at least two.
+    explicit BoundedMpscQueue(size_t capacity)
+          : mMask(roundUpToPowerOfTwo(capacity) - 1), mSlots(new Slot[mMask + 1]) {
+        for (size_t i = 0; i <= mMask; i++) {
+            mSlots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * Add a new object to the queue. Does not block.
+     * Return true if it was added.
+     * Return false if the queue is full, in which case t is left as it was.
+     */
+    bool push(T&& t) {
+        size_t position = mTail.load(std::memory_order_relaxed);
+        for (;;) {
+            Slot& slot = mSlots[position & mMask];
+            const size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            const intptr_t difference = intptr_t(sequence) - intptr_t(position);
+            if (difference == 0) {
+                // The slot is free, claim it.
+                if (mTail.compare_exchange_weak(position, position + 1,
+                                                std::memory_order_relaxed)) {
+                    slot.value = std::move(t);
+                    slot.sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (difference < 0) {
+                // The slot still holds an object from a lap ago.
+                return false;
+            } else {
+                // Another thread claimed the slot first.
+                position = mTail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /**
+     * Remove and return the oldest object, if there is one. Does not block.
+     * Must not be called by more than one thread at a time.
+     */
+    std::optional<T> pop() {
+        Slot& slot = mSlots[mHead & mMask];
+        if (slot.sequence.load(std::memory_order_acquire) != mHead + 1) {
+            return std::nullopt;
+        }
+        std::optional<T> t = std::move(slot.value);
+        slot.value = T();
+        slot.sequence.store(mHead + mMask + 1, std::memory_order_release);
+        mHead++;
+        return t;
+    }
+
+private:
+    struct Slot {
+        // Equal to the position of the next push to use this slot while it is free, and one
+        // more than the position of its object while it is full.
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    static size_t roundUpToPowerOfTwo(size_t n) {
+        size_t powerOfTwo = 2;
+        while (powerOfTwo < n) {
+            powerOfTwo <<= 1;
+        }
+        return powerOfTwo;
+    }
+
+    const size_t mMask;
+    const std::unique_ptr<Slot[]> mSlots;
+    // Pushing and popping threads use different cache lines.
+    alignas(64) std::atomic<size_t> mTail{0};
+    alignas(64) size_t mHead = 0;
+};
+
+} // namespace android::inputdispatcher
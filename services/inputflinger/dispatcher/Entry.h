@@ -26,6 +26,7 @@
 #include <utils/Timers.h>
 #include <functional>
 #include <string>
+#include <vector>
 
 namespace android::inputdispatcher {
 
@@ -227,6 +228,11 @@ struct DispatchEntry {
     int32_t resolvedAction;
     int32_t resolvedFlags;
 
+    // Older MOVE samples of the same gesture that were coalesced into this entry while the
+    // connection was blocked, oldest first. They are published in the same message as eventEntry,
+    // as the history of this event, so there are at most as many as fit in one message.
+    std::vector<std::shared_ptr<EventEntry>> historicalEntries;
+
     DispatchEntry(std::shared_ptr<EventEntry> eventEntry, int32_t targetFlags,
                   ui::Transform transform, float globalScaleFactor, int2 displaySize);
 
@@ -126,6 +126,10 @@ constexpr std::chrono::nanoseconds KEY_WAITING_FOR_EVENTS_TIMEOUT = 500ms;
 // Number of recent events to keep for debugging purposes.
 constexpr size_t RECENT_QUEUE_MAX_SIZE = 10;
 
+// Maximum number of events from the outbound queue of a connection that are published together,
+// which is as many as InputChannel sends with one system call.
+constexpr size_t PUBLISH_BATCH_SIZE = 8;
+
 // Event log tags. See EventLogTags.logtags for reference
 constexpr int LOGTAG_INPUT_INTERACTION = 62000;
 constexpr int LOGTAG_INPUT_FOCUS = 62001;
@@ -506,9 +510,16 @@ static bool shouldReportFinishedEvent(const DispatchEntry& dispatchEntry,
 
 // --- InputDispatcher ---
 
+// Number of key and motion events which can be queued without taking the lock, before the
+// dispatcher moves them to the inbound queue.
+static constexpr size_t INBOUND_RING_CAPACITY = 1024;
+
 InputDispatcher::InputDispatcher(const sp<InputDispatcherPolicyInterface>& policy)
       : mPolicy(policy),
         mPendingEvent(nullptr),
+        mInboundRing(INBOUND_RING_CAPACITY),
+        mInboundRingWoken(false),
+        mInputFilterState(0),
         mLastDropReason(DropReason::NOT_DROPPED),
         mIdGenerator(IdGenerator::Source::INPUT_DISPATCHER),
         mAppSwitchSawKeyDown(false),
@@ -574,6 +585,11 @@ void InputDispatcher::dispatchOnce() {
         std::scoped_lock _l(mLock);
         mDispatcherIsAlive.notify_all();
 
+        // Take the events queued by notifyKey and notifyMotion. Events queued after this
+        // wake the looper again.
+        mInboundRingWoken.exchange(false);
+        moveInboundRingToQueueLocked();
+
         // Run a dispatch loop if there are no pending commands.
         // The dispatch loop might enqueue commands to run afterwards.
         if (!haveCommandsLocked()) {
@@ -927,6 +943,47 @@ bool InputDispatcher::shouldPruneInboundQueueLocked(const MotionEntry& motionEnt
 }
 
 bool InputDispatcher::enqueueInboundEventLocked(std::unique_ptr<EventEntry> newEntry) {
+    // Keep the events queued without the lock ahead of this one.
+    bool needWake = moveInboundRingToQueueLocked();
+    return addInboundEventLocked(std::move(newEntry)) || needWake;
+}
+
+void InputDispatcher::enqueueInboundEventFromNotifier(std::unique_ptr<EventEntry> newEntry,
+                                                      uint32_t inputFilterState) {
+    QueuedInboundEvent queued{std::move(newEntry), inputFilterState};
+    bool needWake;
+    if (mInboundRing.push(std::move(queued))) {
+        needWake = !mInboundRingWoken.exchange(true);
+    } else {
+        // The dispatcher is far behind. Queue the event with the lock held instead, after the
+        // ones in the ring.
+        std::scoped_lock _l(mLock);
+        if (queued.inputFilterState != mInputFilterState.load(std::memory_order_relaxed)) {
+            return; // dropped, as in moveInboundRingToQueueLocked
+        }
+        needWake = enqueueInboundEventLocked(std::move(queued.entry));
+    }
+
+    if (needWake) {
+        mLooper->wake();
+    }
+}
+
+bool InputDispatcher::moveInboundRingToQueueLocked() {
+    bool needWake = false;
+    const uint32_t inputFilterState = mInputFilterState.load(std::memory_order_relaxed);
+    while (std::optional<QueuedInboundEvent> queued = mInboundRing.pop()) {
+        if (queued->inputFilterState != inputFilterState) {
+            // The input filter was enabled or disabled after this event was checked against it,
+            // which drops all of the events queued before the change.
+            continue;
+        }
+        needWake |= addInboundEventLocked(std::move(queued->entry));
+    }
+    return needWake;
+}
+
+bool InputDispatcher::addInboundEventLocked(std::unique_ptr<EventEntry> newEntry) {
     bool needWake = mInboundQueue.empty();
     mInboundQueue.push_back(std::move(newEntry));
     EventEntry& entry = *(mInboundQueue.back());
@@ -998,9 +1055,17 @@ sp<InputWindowHandle> InputDispatcher::findTouchedWindowAtLocked(int32_t display
         LOG_ALWAYS_FATAL(
                 "Must provide a valid touch state if adding portal windows or outside targets");
     }
-    // Traverse windows from front to back to find touched window.
+    auto it = mTouchableWindowIndexByDisplay.find(displayId);
+    if (it == mTouchableWindowIndexByDisplay.end()) {
+        return nullptr;
+    }
+    // Traverse windows from front to back to find touched window. The index skips the windows
+    // which can't be touched at (x, y) and don't watch outside touches.
     const std::vector<sp<InputWindowHandle>>& windowHandles = getWindowHandlesLocked(displayId);
-    for (const sp<InputWindowHandle>& windowHandle : windowHandles) {
+    TouchableWindowIndex::Candidates candidates = it->second.candidatesAt(x, y);
+    size_t index;
+    while (candidates.next(&index)) {
+        const sp<InputWindowHandle>& windowHandle = windowHandles[index];
         if (ignoreDragWindow && haveSameToken(windowHandle, mDragState->dragWindow)) {
             continue;
         }
@@ -1178,6 +1243,7 @@ void InputDispatcher::postCommandLocked(std::unique_ptr<CommandEntry> commandEnt
 }
 
 void InputDispatcher::drainInboundQueueLocked() {
+    moveInboundRingToQueueLocked();
     while (!mInboundQueue.empty()) {
         std::shared_ptr<EventEntry> entry = mInboundQueue.front();
         mInboundQueue.pop_front();
@@ -2832,7 +2898,8 @@ void InputDispatcher::enqueueDispatchEntriesLocked(nsecs_t currentTime,
         ATRACE_NAME(message.c_str());
     }
 
-    bool wasEmpty = connection->outboundQueue.empty();
+    const size_t previousQueueLength = connection->outboundQueue.size();
+    bool wasEmpty = previousQueueLength == 0;
 
     // Enqueue dispatch entries for the requested modes.
     enqueueDispatchEntryLocked(connection, eventEntry, inputTarget,
@@ -2851,6 +2918,10 @@ void InputDispatcher::enqueueDispatchEntriesLocked(nsecs_t currentTime,
     // If the outbound queue was previously empty, start the dispatch cycle going.
     if (wasEmpty && !connection->outboundQueue.empty()) {
         startDispatchCycleLocked(currentTime, connection);
+    } else if (!wasEmpty && mConfig.coalesceOutboundMotion) {
+        // The connection is still waiting to publish the events queued before these ones, which
+        // were coalesced when it started waiting.
+        coalesceOutboundMotionLocked(*connection, previousQueueLength - 1);
     }
 }
 
@@ -3095,125 +3166,44 @@ void InputDispatcher::startDispatchCycleLocked(nsecs_t currentTime,
 #endif
 
     while (connection->status == Connection::STATUS_NORMAL && !connection->outboundQueue.empty()) {
-        DispatchEntry* dispatchEntry = connection->outboundQueue.front();
-        dispatchEntry->deliveryTime = currentTime;
-        const std::chrono::nanoseconds timeout =
-                getDispatchingTimeoutLocked(connection->inputChannel->getConnectionToken());
-        dispatchEntry->timeoutTime = currentTime + timeout.count();
-
-        // Publish the event.
-        status_t status;
-        const EventEntry& eventEntry = *(dispatchEntry->eventEntry);
-        switch (eventEntry.type) {
-            case EventEntry::Type::KEY: {
-                const KeyEntry& keyEntry = static_cast<const KeyEntry&>(eventEntry);
-                std::array<uint8_t, 32> hmac = getSignature(keyEntry, *dispatchEntry);
-
-                // Publish the key event.
-                status = connection->inputPublisher
-                                 .publishKeyEvent(dispatchEntry->seq,
-                                                  dispatchEntry->resolvedEventId, keyEntry.deviceId,
-                                                  keyEntry.source, keyEntry.displayId,
-                                                  std::move(hmac), dispatchEntry->resolvedAction,
-                                                  dispatchEntry->resolvedFlags, keyEntry.keyCode,
-                                                  keyEntry.scanCode, keyEntry.metaState,
-                                                  keyEntry.repeatCount, keyEntry.downTime,
-                                                  keyEntry.eventTime);
-                break;
-            }
-
-            case EventEntry::Type::MOTION: {
-                const MotionEntry& motionEntry = static_cast<const MotionEntry&>(eventEntry);
-
-                PointerCoords scaledCoords[MAX_POINTERS];
-                const PointerCoords* usingCoords = motionEntry.pointerCoords;
-
-                // Set the X and Y offset and X and Y scale depending on the input source.
-                if ((motionEntry.source & AINPUT_SOURCE_CLASS_POINTER) &&
-                    !(dispatchEntry->targetFlags & InputTarget::FLAG_ZERO_COORDS)) {
-                    float globalScaleFactor = dispatchEntry->globalScaleFactor;
-                    if (globalScaleFactor != 1.0f) {
-                        for (uint32_t i = 0; i < motionEntry.pointerCount; i++) {
-                            scaledCoords[i] = motionEntry.pointerCoords[i];
-                            // Don't apply window scale here since we don't want scale to affect raw
-                            // coordinates. The scale will be sent back to the client and applied
-                            // later when requesting relative coordinates.
-                            scaledCoords[i].scale(globalScaleFactor, 1 /* windowXScale */,
-                                                  1 /* windowYScale */);
-                        }
-                        usingCoords = scaledCoords;
-                    }
-                } else {
-                    // We don't want the dispatch target to know.
-                    if (dispatchEntry->targetFlags & InputTarget::FLAG_ZERO_COORDS) {
-                        for (uint32_t i = 0; i < motionEntry.pointerCount; i++) {
-                            scaledCoords[i].clear();
-                        }
-                        usingCoords = scaledCoords;
-                    }
-                }
-
-                std::array<uint8_t, 32> hmac = getSignature(motionEntry, *dispatchEntry);
-
-                // Publish the motion event.
-                status = connection->inputPublisher
-                                 .publishMotionEvent(dispatchEntry->seq,
-                                                     dispatchEntry->resolvedEventId,
-                                                     motionEntry.deviceId, motionEntry.source,
-                                                     motionEntry.displayId, std::move(hmac),
-                                                     dispatchEntry->resolvedAction,
-                                                     motionEntry.actionButton,
-                                                     dispatchEntry->resolvedFlags,
-                                                     motionEntry.edgeFlags, motionEntry.metaState,
-                                                     motionEntry.buttonState,
-                                                     motionEntry.classification,
-                                                     dispatchEntry->transform,
-                                                     motionEntry.xPrecision, motionEntry.yPrecision,
-                                                     motionEntry.xCursorPosition,
-                                                     motionEntry.yCursorPosition,
-                                                     dispatchEntry->displaySize.x,
-                                                     dispatchEntry->displaySize.y,
-                                                     motionEntry.downTime, motionEntry.eventTime,
-                                                     motionEntry.pointerCount,
-                                                     motionEntry.pointerProperties, usingCoords);
-                break;
-            }
-
-            case EventEntry::Type::FOCUS: {
-                const FocusEntry& focusEntry = static_cast<const FocusEntry&>(eventEntry);
-                status = connection->inputPublisher.publishFocusEvent(dispatchEntry->seq,
-                                                                      focusEntry.id,
-                                                                      focusEntry.hasFocus,
-                                                                      mInTouchMode);
-                break;
-            }
-
-            case EventEntry::Type::POINTER_CAPTURE_CHANGED: {
-                const auto& captureEntry =
-                        static_cast<const PointerCaptureChangedEntry&>(eventEntry);
-                status = connection->inputPublisher
-                                 .publishCaptureEvent(dispatchEntry->seq, captureEntry.id,
-                                                      captureEntry.pointerCaptureRequest.enable);
-                break;
-            }
-
-            case EventEntry::Type::DRAG: {
-                const DragEntry& dragEntry = static_cast<const DragEntry&>(eventEntry);
-                status = connection->inputPublisher.publishDragEvent(dispatchEntry->seq,
-                                                                     dragEntry.id, dragEntry.x,
-                                                                     dragEntry.y,
-                                                                     dragEntry.isExiting);
+        // Publish a batch of events, which are sent to the application together.
+        const size_t batchSize = std::min(connection->outboundQueue.size(), PUBLISH_BATCH_SIZE);
+        connection->inputPublisher.beginBatch();
+        size_t published = 0;
+        status_t status = OK;
+        while (published < batchSize) {
+            DispatchEntry* dispatchEntry = connection->outboundQueue[published];
+            dispatchEntry->deliveryTime = currentTime;
+            const std::chrono::nanoseconds timeout =
+                    getDispatchingTimeoutLocked(connection->inputChannel->getConnectionToken());
+            dispatchEntry->timeoutTime = currentTime + timeout.count();
+
+            status = publishDispatchEntryLocked(connection, dispatchEntry);
+            if (status) {
                 break;
             }
+            published++;
+        }
+        size_t sent;
+        status_t sendStatus = connection->inputPublisher.endBatch(&sent);
+        if (sent < published) {
+            status = sendStatus;
+        }
 
-            case EventEntry::Type::CONFIGURATION_CHANGED:
-            case EventEntry::Type::DEVICE_RESET:
-            case EventEntry::Type::SENSOR: {
-                LOG_ALWAYS_FATAL("Should never start dispatch cycles for %s events",
-                                 NamedEnum::string(eventEntry.type).c_str());
-                return;
+        // Re-enqueue the events that were sent on the wait queue.
+        for (size_t i = 0; i < sent; i++) {
+            DispatchEntry* dispatchEntry = connection->outboundQueue.front();
+            connection->outboundQueue.pop_front();
+            connection->waitQueue.push_back(dispatchEntry);
+            if (connection->responsive) {
+                mAnrTracker.insert(dispatchEntry->timeoutTime,
+                                   connection->inputChannel->getConnectionToken());
             }
         }
+        if (sent > 0) {
+            traceOutboundQueueLength(*connection);
+            traceWaitQueueLength(*connection);
+        }
 
         // Check the result.
         if (status) {
@@ -3234,6 +3224,9 @@ void InputDispatcher::startDispatchCycleLocked(nsecs_t currentTime,
                           "waiting for the application to catch up",
                           connection->getInputChannelName().c_str());
 #endif
+                    if (mConfig.coalesceOutboundMotion) {
+                        coalesceOutboundMotionLocked(*connection, 0 /*fromIndex*/);
+                    }
                 }
             } else {
                 ALOGE("channel '%s' ~ Could not publish event due to an unexpected error, "
@@ -3244,18 +3237,234 @@ void InputDispatcher::startDispatchCycleLocked(nsecs_t currentTime,
             }
             return;
         }
+    }
+}
+
+status_t InputDispatcher::publishDispatchEntryLocked(const sp<Connection>& connection,
+                                                     DispatchEntry* dispatchEntry) {
+    status_t status;
+    const EventEntry& eventEntry = *(dispatchEntry->eventEntry);
+    switch (eventEntry.type) {
+        case EventEntry::Type::KEY: {
+            const KeyEntry& keyEntry = static_cast<const KeyEntry&>(eventEntry);
+            std::array<uint8_t, 32> hmac = getSignature(keyEntry, *dispatchEntry);
+
+            // Publish the key event.
+            status = connection->inputPublisher
+                             .publishKeyEvent(dispatchEntry->seq,
+                                              dispatchEntry->resolvedEventId, keyEntry.deviceId,
+                                              keyEntry.source, keyEntry.displayId,
+                                              std::move(hmac), dispatchEntry->resolvedAction,
+                                              dispatchEntry->resolvedFlags, keyEntry.keyCode,
+                                              keyEntry.scanCode, keyEntry.metaState,
+                                              keyEntry.repeatCount, keyEntry.downTime,
+                                              keyEntry.eventTime);
+            break;
+        }
 
-        // Re-enqueue the event on the wait queue.
-        connection->outboundQueue.erase(std::remove(connection->outboundQueue.begin(),
-                                                    connection->outboundQueue.end(),
-                                                    dispatchEntry));
-        traceOutboundQueueLength(*connection);
-        connection->waitQueue.push_back(dispatchEntry);
-        if (connection->responsive) {
-            mAnrTracker.insert(dispatchEntry->timeoutTime,
-                               connection->inputChannel->getConnectionToken());
+        case EventEntry::Type::MOTION: {
+            // Publish the motion event, with any samples coalesced into it as its history.
+            status = publishMotionEntryLocked(*connection, *dispatchEntry);
+            break;
         }
-        traceWaitQueueLength(*connection);
+
+        case EventEntry::Type::FOCUS: {
+            const FocusEntry& focusEntry = static_cast<const FocusEntry&>(eventEntry);
+            status = connection->inputPublisher.publishFocusEvent(dispatchEntry->seq,
+                                                                  focusEntry.id,
+                                                                  focusEntry.hasFocus,
+                                                                  mInTouchMode);
+            break;
+        }
+
+        case EventEntry::Type::POINTER_CAPTURE_CHANGED: {
+            const auto& captureEntry =
+                    static_cast<const PointerCaptureChangedEntry&>(eventEntry);
+            status = connection->inputPublisher
+                             .publishCaptureEvent(dispatchEntry->seq, captureEntry.id,
+                                                  captureEntry.pointerCaptureRequest.enable);
+            break;
+        }
+
+        case EventEntry::Type::DRAG: {
+            const DragEntry& dragEntry = static_cast<const DragEntry&>(eventEntry);
+            status = connection->inputPublisher.publishDragEvent(dispatchEntry->seq,
+                                                                 dragEntry.id, dragEntry.x,
+                                                                 dragEntry.y,
+                                                                 dragEntry.isExiting);
+            break;
+        }
+
+        case EventEntry::Type::CONFIGURATION_CHANGED:
+        case EventEntry::Type::DEVICE_RESET:
+        case EventEntry::Type::SENSOR: {
+            LOG_ALWAYS_FATAL("Should never start dispatch cycles for %s events",
+                             NamedEnum::string(eventEntry.type).c_str());
+            return BAD_VALUE;
+        }
+    }
+    return status;
+}
+
+// Applies the scaling or clearing of coordinates that dispatchEntry asks for to 'count' coords,
+// and returns the ones to publish, which are either 'coords' or 'outCoords'.
+static const PointerCoords* resolveCoords(const DispatchEntry& dispatchEntry, int32_t source,
+                                          const PointerCoords* coords, size_t count,
+                                          PointerCoords* outCoords) {
+    // Set the X and Y offset and X and Y scale depending on the input source.
+    if ((source & AINPUT_SOURCE_CLASS_POINTER) &&
+        !(dispatchEntry.targetFlags & InputTarget::FLAG_ZERO_COORDS)) {
+        float globalScaleFactor = dispatchEntry.globalScaleFactor;
+        if (globalScaleFactor != 1.0f) {
+            for (size_t i = 0; i < count; i++) {
+                outCoords[i] = coords[i];
+                // Don't apply window scale here since we don't want scale to affect raw
+                // coordinates. The scale will be sent back to the client and applied
+                // later when requesting relative coordinates.
+                outCoords[i].scale(globalScaleFactor, 1 /* windowXScale */,
+                                   1 /* windowYScale */);
+            }
+            return outCoords;
+        }
+    } else {
+        // We don't want the dispatch target to know.
+        if (dispatchEntry.targetFlags & InputTarget::FLAG_ZERO_COORDS) {
+            for (size_t i = 0; i < count; i++) {
+                outCoords[i].clear();
+            }
+            return outCoords;
+        }
+    }
+    return coords;
+}
+
+status_t InputDispatcher::publishMotionEntryLocked(Connection& connection,
+                                                   const DispatchEntry& dispatchEntry) {
+    const MotionEntry& motionEntry = static_cast<const MotionEntry&>(*dispatchEntry.eventEntry);
+
+    PointerCoords scaledCoords[MAX_POINTERS];
+    const PointerCoords* usingCoords =
+            resolveCoords(dispatchEntry, motionEntry.source, motionEntry.pointerCoords,
+                          motionEntry.pointerCount, scaledCoords);
+
+    // Coalescing keeps the history small enough to fit in one message with the event.
+    const size_t historySize = dispatchEntry.historicalEntries.size();
+    nsecs_t historicalEventTimes[MAX_POINTERS];
+    PointerCoords historicalCoords[MAX_POINTERS];
+    for (size_t h = 0; h < historySize; h++) {
+        const MotionEntry& historicalEntry =
+                static_cast<const MotionEntry&>(*dispatchEntry.historicalEntries[h]);
+        historicalEventTimes[h] = historicalEntry.eventTime;
+        PointerCoords* sampleCoords = &historicalCoords[h * motionEntry.pointerCount];
+        const PointerCoords* resolvedCoords =
+                resolveCoords(dispatchEntry, motionEntry.source, historicalEntry.pointerCoords,
+                              motionEntry.pointerCount, sampleCoords);
+        if (resolvedCoords != sampleCoords) {
+            std::copy_n(resolvedCoords, motionEntry.pointerCount, sampleCoords);
+        }
+    }
+
+    std::array<uint8_t, 32> hmac = getSignature(motionEntry, dispatchEntry);
+
+    return connection.inputPublisher
+            .publishMotionEvent(dispatchEntry.seq, dispatchEntry.resolvedEventId,
+                                motionEntry.deviceId, motionEntry.source, motionEntry.displayId,
+                                std::move(hmac), dispatchEntry.resolvedAction,
+                                motionEntry.actionButton, dispatchEntry.resolvedFlags,
+                                motionEntry.edgeFlags, motionEntry.metaState,
+                                motionEntry.buttonState, motionEntry.classification,
+                                dispatchEntry.transform, motionEntry.xPrecision,
+                                motionEntry.yPrecision, motionEntry.xCursorPosition,
+                                motionEntry.yCursorPosition, dispatchEntry.displaySize.x,
+                                dispatchEntry.displaySize.y, motionEntry.downTime,
+                                motionEntry.eventTime, motionEntry.pointerCount,
+                                motionEntry.pointerProperties, usingCoords, historySize,
+                                historicalEventTimes, historicalCoords);
+}
+
+// Whether the pending dispatch entry 'previous' is superseded by 'next', which is queued right
+// after it: both are MOVE events of the same gesture, delivered to the window the same way, so
+// 'previous' can be sent as a historical sample of 'next'.
+static bool isSupersededMotion(const DispatchEntry& previous, const DispatchEntry& next) {
+    if (previous.eventEntry->type != EventEntry::Type::MOTION ||
+        next.eventEntry->type != EventEntry::Type::MOTION) {
+        return false;
+    }
+    if (previous.resolvedAction != AMOTION_EVENT_ACTION_MOVE ||
+        next.resolvedAction != AMOTION_EVENT_ACTION_MOVE) {
+        return false;
+    }
+    if (previous.targetFlags != next.targetFlags || previous.resolvedFlags != next.resolvedFlags ||
+        !(previous.transform == next.transform) ||
+        previous.globalScaleFactor != next.globalScaleFactor ||
+        previous.displaySize != next.displaySize) {
+        return false;
+    }
+
+    const MotionEntry& previousMotion = static_cast<const MotionEntry&>(*previous.eventEntry);
+    const MotionEntry& nextMotion = static_cast<const MotionEntry&>(*next.eventEntry);
+    // Injected events are left alone, since the injector may be waiting for each one of them.
+    if (previousMotion.injectionState != nullptr || nextMotion.injectionState != nullptr) {
+        return false;
+    }
+    if (previousMotion.deviceId != nextMotion.deviceId ||
+        previousMotion.source != nextMotion.source ||
+        previousMotion.displayId != nextMotion.displayId ||
+        previousMotion.downTime != nextMotion.downTime ||
+        previousMotion.metaState != nextMotion.metaState ||
+        previousMotion.buttonState != nextMotion.buttonState ||
+        previousMotion.classification != nextMotion.classification ||
+        previousMotion.pointerCount != nextMotion.pointerCount) {
+        return false;
+    }
+    for (uint32_t i = 0; i < previousMotion.pointerCount; i++) {
+        if (!(previousMotion.pointerProperties[i] == nextMotion.pointerProperties[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Merge the MOVE events in the outbound queue that are followed by a newer sample of the same
+ * gesture into that sample, starting with the entry at fromIndex. The older samples are kept as
+ * historical entries of the newer one and are published in the same message, as its history.
+ * This is only done while the connection's socket is full, so that a slow application gets one
+ * message for a run of samples rather than one for every sample. Once an entry carries as much
+ * history as fits in a message, it is not merged into the next one.
+ */
+void InputDispatcher::coalesceOutboundMotionLocked(Connection& connection, size_t fromIndex) {
+    std::deque<DispatchEntry*>& queue = connection.outboundQueue;
+    size_t coalescedCount = 0;
+    auto it = queue.begin() + std::min(fromIndex, queue.size());
+    while (it != queue.end() && std::next(it) != queue.end()) {
+        DispatchEntry* dispatchEntry = *it;
+        DispatchEntry* nextEntry = *std::next(it);
+        if (isSupersededMotion(*dispatchEntry, *nextEntry) &&
+            dispatchEntry->historicalEntries.size() + 1 + nextEntry->historicalEntries.size() <=
+                    InputPublisher::getMaxMotionHistorySize(
+                            static_cast<const MotionEntry&>(*nextEntry->eventEntry)
+                                    .pointerCount)) {
+            std::vector<std::shared_ptr<EventEntry>> history =
+                    std::move(dispatchEntry->historicalEntries);
+            history.push_back(dispatchEntry->eventEntry);
+            history.insert(history.end(), nextEntry->historicalEntries.begin(),
+                           nextEntry->historicalEntries.end());
+            nextEntry->historicalEntries = std::move(history);
+            it = queue.erase(it);
+            releaseDispatchEntry(dispatchEntry);
+            coalescedCount++;
+        } else {
+            ++it;
+        }
+    }
+
+    if (coalescedCount > 0) {
+#if DEBUG_DISPATCH_CYCLE
+        ALOGD("channel '%s' ~ Coalesced %zu pending motion events, outbound queue length %zu",
+              connection.getInputChannelName().c_str(), coalescedCount, queue.size());
+#endif
+        traceOutboundQueueLength(connection);
     }
 }
 
@@ -3374,34 +3583,26 @@ int InputDispatcher::handleReceiveCallback(int events, sp<IBinder> connectionTok
         }
 
         nsecs_t currentTime = now();
-        bool gotOne = false;
-        status_t status = OK;
-        for (;;) {
-            Result<InputPublisher::ConsumerResponse> result =
-                    connection->inputPublisher.receiveConsumerResponse();
-            if (!result.ok()) {
-                status = result.error().code();
-                break;
-            }
-
-            if (std::holds_alternative<InputPublisher::Finished>(*result)) {
+        std::vector<InputPublisher::ConsumerResponse> responses;
+        status_t status = connection->inputPublisher.receiveConsumerResponses(&responses);
+        for (const InputPublisher::ConsumerResponse& response : responses) {
+            if (std::holds_alternative<InputPublisher::Finished>(response)) {
                 const InputPublisher::Finished& finish =
-                        std::get<InputPublisher::Finished>(*result);
+                        std::get<InputPublisher::Finished>(response);
                 finishDispatchCycleLocked(currentTime, connection, finish.seq, finish.handled,
                                           finish.consumeTime);
-            } else if (std::holds_alternative<InputPublisher::Timeline>(*result)) {
+            } else if (std::holds_alternative<InputPublisher::Timeline>(response)) {
                 if (shouldReportMetricsForConnection(*connection)) {
                     const InputPublisher::Timeline& timeline =
-                            std::get<InputPublisher::Timeline>(*result);
+                            std::get<InputPublisher::Timeline>(response);
                     mLatencyTracker
                             .trackGraphicsLatency(timeline.inputEventId,
                                                   connection->inputChannel->getConnectionToken(),
-                                                  std::move(timeline.graphicsTimeline));
+                                                  timeline.graphicsTimeline);
                 }
             }
-            gotOne = true;
         }
-        if (gotOne) {
+        if (!responses.empty()) {
             runCommandsLockedInterruptible();
             if (status == WOULD_BLOCK) {
                 return 1;
@@ -3793,38 +3994,19 @@ void InputDispatcher::notifyKey(const NotifyKeyArgs* args) {
               std::to_string(t.duration().count()).c_str());
     }
 
-    bool needWake;
-    { // acquire lock
-        mLock.lock();
-
-        if (shouldSendKeyToInputFilterLocked(args)) {
-            mLock.unlock();
-
-            policyFlags |= POLICY_FLAG_FILTERED;
-            if (!mPolicy->filterInputEvent(&event, policyFlags)) {
-                return; // event was consumed by the filter
-            }
-
-            mLock.lock();
+    const uint32_t inputFilterState = mInputFilterState.load();
+    if (inputFilterState & INPUT_FILTER_ENABLED) {
+        policyFlags |= POLICY_FLAG_FILTERED;
+        if (!mPolicy->filterInputEvent(&event, policyFlags)) {
+            return; // event was consumed by the filter
         }
-
-        std::unique_ptr<KeyEntry> newEntry =
-                std::make_unique<KeyEntry>(args->id, args->eventTime, args->deviceId, args->source,
-                                           args->displayId, policyFlags, args->action, flags,
-                                           keyCode, args->scanCode, metaState, repeatCount,
-                                           args->downTime);
-
-        needWake = enqueueInboundEventLocked(std::move(newEntry));
-        mLock.unlock();
-    } // release lock
-
-    if (needWake) {
-        mLooper->wake();
     }
-}
 
-bool InputDispatcher::shouldSendKeyToInputFilterLocked(const NotifyKeyArgs* args) {
-    return mInputFilterEnabled;
+    std::unique_ptr<KeyEntry> newEntry =
+            std::make_unique<KeyEntry>(args->id, args->eventTime, args->deviceId, args->source,
+                                       args->displayId, policyFlags, args->action, flags, keyCode,
+                                       args->scanCode, metaState, repeatCount, args->downTime);
+    enqueueInboundEventFromNotifier(std::move(newEntry), inputFilterState);
 }
 
 void InputDispatcher::notifyMotion(const NotifyMotionArgs* args) {
@@ -3870,50 +4052,35 @@ void InputDispatcher::notifyMotion(const NotifyMotionArgs* args) {
               std::to_string(t.duration().count()).c_str());
     }
 
-    bool needWake;
-    { // acquire lock
-        mLock.lock();
-
-        if (shouldSendMotionToInputFilterLocked(args)) {
-            mLock.unlock();
-
-            MotionEvent event;
-            ui::Transform transform;
-            event.initialize(args->id, args->deviceId, args->source, args->displayId, INVALID_HMAC,
-                             args->action, args->actionButton, args->flags, args->edgeFlags,
-                             args->metaState, args->buttonState, args->classification, transform,
-                             args->xPrecision, args->yPrecision, args->xCursorPosition,
-                             args->yCursorPosition, AMOTION_EVENT_INVALID_DISPLAY_SIZE,
-                             AMOTION_EVENT_INVALID_DISPLAY_SIZE, args->downTime, args->eventTime,
-                             args->pointerCount, args->pointerProperties, args->pointerCoords);
-
-            policyFlags |= POLICY_FLAG_FILTERED;
-            if (!mPolicy->filterInputEvent(&event, policyFlags)) {
-                return; // event was consumed by the filter
-            }
+    const uint32_t inputFilterState = mInputFilterState.load();
+    if (inputFilterState & INPUT_FILTER_ENABLED) {
+        MotionEvent event;
+        ui::Transform transform;
+        event.initialize(args->id, args->deviceId, args->source, args->displayId, INVALID_HMAC,
+                         args->action, args->actionButton, args->flags, args->edgeFlags,
+                         args->metaState, args->buttonState, args->classification, transform,
+                         args->xPrecision, args->yPrecision, args->xCursorPosition,
+                         args->yCursorPosition, AMOTION_EVENT_INVALID_DISPLAY_SIZE,
+                         AMOTION_EVENT_INVALID_DISPLAY_SIZE, args->downTime, args->eventTime,
+                         args->pointerCount, args->pointerProperties, args->pointerCoords);
 
-            mLock.lock();
+        policyFlags |= POLICY_FLAG_FILTERED;
+        if (!mPolicy->filterInputEvent(&event, policyFlags)) {
+            return; // event was consumed by the filter
         }
-
-        // Just enqueue a new motion event.
-        std::unique_ptr<MotionEntry> newEntry =
-                std::make_unique<MotionEntry>(args->id, args->eventTime, args->deviceId,
-                                              args->source, args->displayId, policyFlags,
-                                              args->action, args->actionButton, args->flags,
-                                              args->metaState, args->buttonState,
-                                              args->classification, args->edgeFlags,
-                                              args->xPrecision, args->yPrecision,
-                                              args->xCursorPosition, args->yCursorPosition,
-                                              args->downTime, args->pointerCount,
-                                              args->pointerProperties, args->pointerCoords, 0, 0);
-
-        needWake = enqueueInboundEventLocked(std::move(newEntry));
-        mLock.unlock();
-    } // release lock
-
-    if (needWake) {
-        mLooper->wake();
     }
+
+    // Just enqueue a new motion event.
+    std::unique_ptr<MotionEntry> newEntry =
+            std::make_unique<MotionEntry>(args->id, args->eventTime, args->deviceId, args->source,
+                                          args->displayId, policyFlags, args->action,
+                                          args->actionButton, args->flags, args->metaState,
+                                          args->buttonState, args->classification,
+                                          args->edgeFlags, args->xPrecision, args->yPrecision,
+                                          args->xCursorPosition, args->yCursorPosition,
+                                          args->downTime, args->pointerCount,
+                                          args->pointerProperties, args->pointerCoords, 0, 0);
+    enqueueInboundEventFromNotifier(std::move(newEntry), inputFilterState);
 }
 
 void InputDispatcher::notifySensor(const NotifySensorArgs* args) {
@@ -3952,10 +4119,6 @@ void InputDispatcher::notifyVibratorState(const NotifyVibratorStateArgs* args) {
     mPolicy->notifyVibratorState(args->deviceId, args->isOn);
 }
 
-bool InputDispatcher::shouldSendMotionToInputFilterLocked(const NotifyMotionArgs* args) {
-    return mInputFilterEnabled;
-}
-
 void InputDispatcher::notifySwitch(const NotifySwitchArgs* args) {
 #if DEBUG_INBOUND_EVENT_DETAILS
     ALOGD("notifySwitch - eventTime=%" PRId64 ", policyFlags=0x%x, switchValues=0x%08x, "
@@ -4428,6 +4591,7 @@ void InputDispatcher::updateWindowHandlesForDisplayLocked(
     if (inputWindowHandles.empty()) {
         // Remove all handles on a display if there are no windows left.
         mWindowHandlesByDisplay.erase(displayId);
+        mTouchableWindowIndexByDisplay.erase(displayId);
         return;
     }
 
@@ -4478,6 +4642,7 @@ void InputDispatcher::updateWindowHandlesForDisplayLocked(
 
     // Insert or replace
     mWindowHandlesByDisplay[displayId] = newHandles;
+    mTouchableWindowIndexByDisplay[displayId].build(displayId, newHandles);
 }
 
 void InputDispatcher::setInputWindows(
@@ -4762,6 +4927,8 @@ void InputDispatcher::setInputFilterEnabled(bool enabled) {
         }
 
         mInputFilterEnabled = enabled;
+        const uint32_t changes = (mInputFilterState.load(std::memory_order_relaxed) >> 1) + 1;
+        mInputFilterState.store(changes << 1 | (enabled ? INPUT_FILTER_ENABLED : 0));
         resetAndDropEverythingLocked("input filter is being enabled or disabled");
     } // release lock
 
@@ -5176,6 +5343,8 @@ void InputDispatcher::dumpDispatchStateLocked(std::string& dump) {
     dump += StringPrintf(INDENT2 "KeyRepeatDelay: %" PRId64 "ms\n", ns2ms(mConfig.keyRepeatDelay));
     dump += StringPrintf(INDENT2 "KeyRepeatTimeout: %" PRId64 "ms\n",
                          ns2ms(mConfig.keyRepeatTimeout));
+    dump += StringPrintf(INDENT2 "CoalesceOutboundMotion: %s\n",
+                         toString(mConfig.coalesceOutboundMotion));
     dump += mLatencyTracker.dump(INDENT2);
     dump += mLatencyAggregator.dump(INDENT2);
 }
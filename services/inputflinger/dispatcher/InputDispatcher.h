@@ -18,6 +18,7 @@
 #define _UI_INPUT_DISPATCHER_H
 
 #include "AnrTracker.h"
+#include "BoundedMpscQueue.h"
 #include "CancelationOptions.h"
 #include "DragState.h"
 #include "Entry.h"
@@ -33,6 +34,7 @@
 #include "LatencyTracker.h"
 #include "Monitor.h"
 #include "TouchState.h"
+#include "TouchableWindowIndex.h"
 #include "TouchedWindow.h"
 
 #include <attestation/HmacKeyManager.h>
@@ -50,6 +52,7 @@
 #include <utils/RefBase.h>
 #include <utils/Timers.h>
 #include <utils/threads.h>
+#include <atomic>
 #include <condition_variable>
 #include <deque>
 #include <optional>
@@ -166,6 +169,22 @@ private:
 
     std::shared_ptr<EventEntry> mPendingEvent GUARDED_BY(mLock);
     std::deque<std::shared_ptr<EventEntry>> mInboundQueue GUARDED_BY(mLock);
+
+    // Events from notifyKey and notifyMotion, which are queued here without taking mLock so
+    // that the reader never waits for dispatch. They are moved to mInboundQueue, in order, at
+    // the start of each dispatch loop and before any other event is added to mInboundQueue.
+    struct QueuedInboundEvent {
+        std::unique_ptr<EventEntry> entry;
+        // mInputFilterState when the event was queued.
+        uint32_t inputFilterState;
+    };
+    BoundedMpscQueue<QueuedInboundEvent> mInboundRing;
+    // True once mLooper has been woken for events in mInboundRing, until they are moved.
+    std::atomic<bool> mInboundRingWoken;
+    // Whether the input filter is enabled, in INPUT_FILTER_ENABLED, and a count of the times
+    // that changed, in the other bits, for checking without mLock. Only written with mLock held.
+    static constexpr uint32_t INPUT_FILTER_ENABLED = 1;
+    std::atomic<uint32_t> mInputFilterState;
     std::deque<std::shared_ptr<EventEntry>> mRecentQueue GUARDED_BY(mLock);
     std::deque<std::unique_ptr<CommandEntry>> mCommandQueue GUARDED_BY(mLock);
 
@@ -182,6 +201,14 @@ private:
 
     // Enqueues an inbound event.  Returns true if mLooper->wake() should be called.
     bool enqueueInboundEventLocked(std::unique_ptr<EventEntry> entry) REQUIRES(mLock);
+    // Enqueues an inbound event from notifyKey or notifyMotion, without taking mLock unless
+    // mInboundRing is full, and wakes mLooper if needed.
+    void enqueueInboundEventFromNotifier(std::unique_ptr<EventEntry> entry,
+                                         uint32_t inputFilterState);
+    // Moves the events in mInboundRing to mInboundQueue.  Returns true if mLooper->wake()
+    // should be called.
+    bool moveInboundRingToQueueLocked() REQUIRES(mLock);
+    bool addInboundEventLocked(std::unique_ptr<EventEntry> entry) REQUIRES(mLock);
 
     // Cleans up input state when dropping an inbound event.
     void dropInboundEventLocked(const EventEntry& entry, DropReason dropReason) REQUIRES(mLock);
@@ -297,10 +324,6 @@ private:
     nsecs_t processAnrsLocked() REQUIRES(mLock);
     std::chrono::nanoseconds getDispatchingTimeoutLocked(const sp<IBinder>& token) REQUIRES(mLock);
 
-    // Input filter processing.
-    bool shouldSendKeyToInputFilterLocked(const NotifyKeyArgs* args) REQUIRES(mLock);
-    bool shouldSendMotionToInputFilterLocked(const NotifyMotionArgs* args) REQUIRES(mLock);
-
     // Inbound event processing.
     void drainInboundQueueLocked() REQUIRES(mLock);
     void releasePendingEventLocked() REQUIRES(mLock);
@@ -316,6 +339,9 @@ private:
 
     std::unordered_map<int32_t, std::vector<sp<InputWindowHandle>>> mWindowHandlesByDisplay
             GUARDED_BY(mLock);
+    // Rebuilt along with mWindowHandlesByDisplay, for findTouchedWindowAtLocked.
+    std::unordered_map<int32_t, TouchableWindowIndex> mTouchableWindowIndexByDisplay
+            GUARDED_BY(mLock);
     void setInputWindowsLocked(const std::vector<sp<InputWindowHandle>>& inputWindowHandles,
                                int32_t displayId) REQUIRES(mLock);
     // Get a reference to window handles by display, return an empty vector if not found.
@@ -545,6 +571,11 @@ private:
             REQUIRES(mLock);
     void startDispatchCycleLocked(nsecs_t currentTime, const sp<Connection>& connection)
             REQUIRES(mLock);
+    status_t publishDispatchEntryLocked(const sp<Connection>& connection,
+                                        DispatchEntry* dispatchEntry) REQUIRES(mLock);
+    status_t publishMotionEntryLocked(Connection& connection, const DispatchEntry& dispatchEntry)
+            REQUIRES(mLock);
+    void coalesceOutboundMotionLocked(Connection& connection, size_t fromIndex) REQUIRES(mLock);
     void finishDispatchCycleLocked(nsecs_t currentTime, const sp<Connection>& connection,
                                    uint32_t seq, bool handled, nsecs_t consumeTime) REQUIRES(mLock);
     void abortBrokenDispatchCycleLocked(nsecs_t currentTime, const sp<Connection>& connection,
@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "TouchableWindowIndex.h"
+
+#include <algorithm>
+
+namespace android::inputdispatcher {
+
+void TouchableWindowIndex::build(int32_t displayId,
+                                 const std::vector<sp<InputWindowHandle>>& windowHandles) {
+    mAlways.clear();
+    mCellStart.clear();
+    mCellWindows.clear();
+    mBounds = Rect::EMPTY_RECT;
+
+    // Windows in the grid, and their touchable bounds.
+    std::vector<std::pair<uint32_t, Rect>> gridWindows;
+    for (size_t i = 0; i < windowHandles.size(); i++) {
+        const InputWindowInfo* info = windowHandles[i]->getInfo();
+        if (info->displayId != displayId || !info->visible) {
+            continue;
+        }
+        const auto flags = info->flags;
+        const bool touchable = !flags.test(InputWindowInfo::Flag::NOT_TOUCHABLE);
+        const bool isTouchModal = !flags.test(InputWindowInfo::Flag::NOT_FOCUSABLE) &&
+                !flags.test(InputWindowInfo::Flag::NOT_TOUCH_MODAL);
+        if ((touchable && isTouchModal) ||
+            flags.test(InputWindowInfo::Flag::WATCH_OUTSIDE_TOUCH)) {
+            mAlways.push_back(i);
+        } else if (touchable) {
+            const Rect bounds = info->touchableRegion.getBounds();
+            if (bounds.isEmpty()) {
+                continue;
+            }
+            gridWindows.emplace_back(i, bounds);
+            if (mBounds.isEmpty()) {
+                mBounds = bounds;
+            } else {
+                mBounds.left = std::min(mBounds.left, bounds.left);
+                mBounds.top = std::min(mBounds.top, bounds.top);
+                mBounds.right = std::max(mBounds.right, bounds.right);
+                mBounds.bottom = std::max(mBounds.bottom, bounds.bottom);
+            }
+        }
+    }
+    if (gridWindows.empty()) {
+        return;
+    }
+
+    mCellWidth = (int64_t(mBounds.right) - mBounds.left + kGridSize - 1) / kGridSize;
+    mCellHeight = (int64_t(mBounds.bottom) - mBounds.top + kGridSize - 1) / kGridSize;
+
+    // The range of cells covered by each window, inclusive.
+    auto cellRange = [this](const Rect& bounds, int32_t* left, int32_t* top, int32_t* right,
+                            int32_t* bottom) {
+        *left = (int64_t(bounds.left) - mBounds.left) / mCellWidth;
+        *top = (int64_t(bounds.top) - mBounds.top) / mCellHeight;
+        *right = (int64_t(bounds.right) - 1 - mBounds.left) / mCellWidth;
+        *bottom = (int64_t(bounds.bottom) - 1 - mBounds.top) / mCellHeight;
+    };
+
+    // Count the windows in each cell, then fill them in, in order.
+    mCellStart.assign(kGridSize * kGridSize + 1, 0);
+    for (const auto& [i, bounds] : gridWindows) {
+        int32_t left, top, right, bottom;
+        cellRange(bounds, &left, &top, &right, &bottom);
+        for (int32_t y = top; y <= bottom; y++) {
+            for (int32_t x = left; x <= right; x++) {
+                mCellStart[cellIndex(x, y) + 1]++;
+            }
+        }
+    }
+    for (size_t cell = 1; cell < mCellStart.size(); cell++) {
+        mCellStart[cell] += mCellStart[cell - 1];
+    }
+    mCellWindows.resize(mCellStart.back());
+    std::vector<uint32_t> fill(mCellStart.begin(), mCellStart.end() - 1);
+    for (const auto& [i, bounds] : gridWindows) {
+        int32_t left, top, right, bottom;
+        cellRange(bounds, &left, &top, &right, &bottom);
+        for (int32_t y = top; y <= bottom; y++) {
+            for (int32_t x = left; x <= right; x++) {
+                mCellWindows[fill[cellIndex(x, y)]++] = i;
+            }
+        }
+    }
+}
+
+TouchableWindowIndex::Candidates TouchableWindowIndex::candidatesAt(int32_t x, int32_t y) const {
+    const uint32_t* always = mAlways.data();
+    const uint32_t* alwaysEnd = always + mAlways.size();
+    if (mCellStart.empty() || x < mBounds.left || x >= mBounds.right || y < mBounds.top ||
+        y >= mBounds.bottom) {
+        return Candidates(always, alwaysEnd, nullptr, nullptr);
+    }
+    const size_t cell = cellIndex((int64_t(x) - mBounds.left) / mCellWidth,
+                                  (int64_t(y) - mBounds.top) / mCellHeight);
+    const uint32_t* cellWindows = mCellWindows.data();
+    return Candidates(always, alwaysEnd, cellWindows + mCellStart[cell],
+                      cellWindows + mCellStart[cell + 1]);
+}
+
+TouchableWindowIndex::Candidates::Candidates(const uint32_t* always, const uint32_t* alwaysEnd,
+                                             const uint32_t* cell, const uint32_t* cellEnd)
+      : mAlways(always), mAlwaysEnd(alwaysEnd), mCell(cell), mCellEnd(cellEnd) {}
+
+bool TouchableWindowIndex::Candidates::next(size_t* outIndex) {
+    // Merge the two lists, which are both in order, and never have a window in common.
+    if (mAlways != mAlwaysEnd && (mCell == mCellEnd || *mAlways < *mCell)) {
+        *outIndex = *mAlways++;
+        return true;
+    }
+    if (mCell != mCellEnd) {
+        *outIndex = *mCell++;
+        return true;
+    }
+    return false;
+}
+
+} // namespace android::inputdispatcher
@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include <input/InputWindow.h>
+#include <ui/Rect.h>
+
+namespace android::inputdispatcher {
+
+// Speeds up finding the window touched at a point, among the windows of one display.
+//
+// Windows which could be touched at a point are bucketed in a uniform grid by the bounds of
+// their touchable region, so that a lookup only needs to look at the windows in one cell. Windows
+// which don't depend on the point are looked at on every lookup: touch modal windows, which take
+// touches anywhere, and windows which watch for touches outside of them.
+//
+// Windows which are neither visible nor touchable, and don't watch outside touches, can never
+// be touched, so they are left out.
+//
+// The index must be rebuilt whenever the windows or their info change, as it only keeps the
+// position of each window in the list it was built from.
+class TouchableWindowIndex {
+public:
+    // 'windowHandles' are the windows of 'displayId', front to back.
+    void build(int32_t displayId, const std::vector<sp<InputWindowHandle>>& windowHandles);
+
+    // Iterates over the positions of the windows which could be touched at a point, or which
+    // watch for touches outside of them, front to back.
+    class Candidates {
+    public:
+        // Returns false when there are none left.
+        bool next(size_t* outIndex);
+
+    private:
+        friend class TouchableWindowIndex;
+        Candidates(const uint32_t* always, const uint32_t* alwaysEnd, const uint32_t* cell,
+                   const uint32_t* cellEnd);
+
+        const uint32_t* mAlways;
+        const uint32_t* mAlwaysEnd;
+        const uint32_t* mCell;
+        const uint32_t* mCellEnd;
+    };
+    Candidates candidatesAt(int32_t x, int32_t y) const;
+
+private:
+    // per axis, so there are at most kGridSize * kGridSize cells
+    static constexpr int32_t kGridSize = 16;
+
+    // Windows to look at for any point, in order.
+    std::vector<uint32_t> mAlways;
+
+    // The area covered by the grid, the union of the touchable bounds of the windows in it.
+    Rect mBounds;
+    int64_t mCellWidth = 1;
+    int64_t mCellHeight = 1;
+    // The windows in cell i, in order, are mCellWindows[mCellStart[i]..mCellStart[i + 1]).
+    std::vector<uint32_t> mCellStart;
+    std::vector<uint32_t> mCellWindows;
+
+    size_t cellIndex(int32_t cellX, int32_t cellY) const { return cellY * kGridSize + cellX; }
+};
+
+} // namespace android::inputdispatcher
@@ -35,8 +35,14 @@ struct InputDispatcherConfiguration {
     // The key repeat inter-key delay.
     nsecs_t keyRepeatDelay;
 
+    // Whether consecutive MOVE events waiting for a connection whose socket is full may be
+    // merged into the latest one, which then carries the older samples as its history.
+    bool coalesceOutboundMotion;
+
     InputDispatcherConfiguration()
-          : keyRepeatTimeout(500 * 1000000LL), keyRepeatDelay(50 * 1000000LL) {}
+          : keyRepeatTimeout(500 * 1000000LL),
+            keyRepeatDelay(50 * 1000000LL),
+            coalesceOutboundMotion(false) {}
 };
 
 } // namespace android
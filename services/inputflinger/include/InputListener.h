@@ -17,6 +17,7 @@
 #ifndef _UI_INPUT_LISTENER_H
 #define _UI_INPUT_LISTENER_H
 
+#include <variant>
 #include <vector>
 
 #include <input/Input.h>
@@ -55,6 +56,8 @@ struct NotifyConfigurationChangedArgs : public NotifyArgs {
 
     NotifyConfigurationChangedArgs(const NotifyConfigurationChangedArgs& other);
 
+    NotifyConfigurationChangedArgs& operator=(const NotifyConfigurationChangedArgs& other) = default;
+
     virtual ~NotifyConfigurationChangedArgs() { }
 
     virtual void notify(const sp<InputListenerInterface>& listener) const;
@@ -86,6 +89,8 @@ struct NotifyKeyArgs : public NotifyArgs {
 
     NotifyKeyArgs(const NotifyKeyArgs& other);
 
+    NotifyKeyArgs& operator=(const NotifyKeyArgs& other) = default;
+
     virtual ~NotifyKeyArgs() { }
 
     virtual void notify(const sp<InputListenerInterface>& listener) const;
@@ -138,6 +143,8 @@ struct NotifyMotionArgs : public NotifyArgs {
 
     NotifyMotionArgs(const NotifyMotionArgs& other);
 
+    NotifyMotionArgs& operator=(const NotifyMotionArgs& other);
+
     virtual ~NotifyMotionArgs() { }
 
     bool operator==(const NotifyMotionArgs& rhs) const;
@@ -163,6 +170,8 @@ struct NotifySensorArgs : public NotifyArgs {
 
     NotifySensorArgs(const NotifySensorArgs& other);
 
+    NotifySensorArgs& operator=(const NotifySensorArgs& other) = default;
+
     bool operator==(const NotifySensorArgs rhs) const;
 
     ~NotifySensorArgs() override {}
@@ -183,6 +192,8 @@ struct NotifySwitchArgs : public NotifyArgs {
 
     NotifySwitchArgs(const NotifySwitchArgs& other);
 
+    NotifySwitchArgs& operator=(const NotifySwitchArgs& other) = default;
+
     bool operator==(const NotifySwitchArgs rhs) const;
 
     virtual ~NotifySwitchArgs() { }
@@ -202,6 +213,8 @@ struct NotifyDeviceResetArgs : public NotifyArgs {
 
     NotifyDeviceResetArgs(const NotifyDeviceResetArgs& other);
 
+    NotifyDeviceResetArgs& operator=(const NotifyDeviceResetArgs& other) = default;
+
     bool operator==(const NotifyDeviceResetArgs& rhs) const;
 
     virtual ~NotifyDeviceResetArgs() { }
@@ -220,6 +233,8 @@ struct NotifyPointerCaptureChangedArgs : public NotifyArgs {
 
     NotifyPointerCaptureChangedArgs(const NotifyPointerCaptureChangedArgs& other);
 
+    NotifyPointerCaptureChangedArgs& operator=(const NotifyPointerCaptureChangedArgs& other) = default;
+
     bool operator==(const NotifyPointerCaptureChangedArgs& rhs) const;
 
     virtual ~NotifyPointerCaptureChangedArgs() {}
@@ -238,6 +253,8 @@ struct NotifyVibratorStateArgs : public NotifyArgs {
 
     NotifyVibratorStateArgs(const NotifyVibratorStateArgs& other);
 
+    NotifyVibratorStateArgs& operator=(const NotifyVibratorStateArgs& other) = default;
+
     bool operator==(const NotifyVibratorStateArgs rhs) const;
 
     virtual ~NotifyVibratorStateArgs() {}
@@ -288,8 +305,19 @@ public:
     void flush();
 
 private:
+    using QueuedArgs =
+            std::variant<NotifyConfigurationChangedArgs, NotifyKeyArgs, NotifyMotionArgs,
+                         NotifySwitchArgs, NotifySensorArgs, NotifyVibratorStateArgs,
+                         NotifyDeviceResetArgs, NotifyPointerCaptureChangedArgs>;
+
+    template <typename T>
+    void enqueue(const T& args);
+
     sp<InputListenerInterface> mInnerListener;
-    std::vector<NotifyArgs*> mArgsQueue;
+    // The args are stored by value. The slots are kept across flushes and assigned over, so once
+    // the queue has grown to its usual size, queueing an event does not allocate.
+    std::vector<QueuedArgs> mArgsQueue;
+    size_t mArgsCount = 0;
 };
 
 } // namespace android
@@ -139,6 +139,14 @@ public:
     virtual std::optional<int32_t> getLightColor(int32_t deviceId, int32_t lightId) = 0;
     /* Get light player ID */
     virtual std::optional<int32_t> getLightPlayerId(int32_t deviceId, int32_t lightId) = 0;
+
+    /* Starts recording the raw events of the touch devices to the file at 'path', for replaying
+     * them into a reader later.  Only supported on debuggable builds.
+     *
+     * This method may be called on any thread (usually by the input manager). */
+    virtual status_t startEventRecording(const std::string& path) = 0;
+    /* Stops recording the raw events. */
+    virtual void stopEventRecording() = 0;
 };
 
 // --- InputReaderConfiguration ---
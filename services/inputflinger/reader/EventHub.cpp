@@ -49,6 +49,7 @@
 #include <utils/Log.h>
 #include <utils/Timers.h>
 
+#include <algorithm>
 #include <filesystem>
 #include <regex>
 
@@ -69,6 +70,10 @@ static const char* VIDEO_DEVICE_PATH = "/dev";
 
 static constexpr size_t OBFUSCATED_LENGTH = 8;
 
+// The number of events read from a device at a time.  Enough for a few frames of a multi-touch
+// screen, so that a busy device is drained in one read per wakeup.
+static constexpr size_t DEVICE_EVENT_BUFFER_SIZE = 256;
+
 static constexpr int32_t FF_STRONG_MAGNITUDE_CHANNEL_IDX = 0;
 static constexpr int32_t FF_WEAK_MAGNITUDE_CHANNEL_IDX = 1;
 
@@ -367,6 +372,11 @@ EventHub::Device::Device(int fd, int32_t id, const std::string& path,
         ffEffectId(-1),
         associatedDevice(nullptr),
         controllerNumber(0),
+        pendingEvents(DEVICE_EVENT_BUFFER_SIZE),
+        pendingEventIndex(0),
+        pendingEventCount(0),
+        pendingEventDeviceId(id),
+        pendingEventReadTime(0),
         enabled(true),
         isVirtual(fd < 0) {}
 
@@ -1463,8 +1473,6 @@ size_t EventHub::getEvents(int timeoutMillis, RawEvent* buffer, size_t bufferSiz
 
     std::scoped_lock _l(mLock);
 
-    struct input_event readBuffer[bufferSize];
-
     RawEvent* event = buffer;
     size_t capacity = bufferSize;
     bool awoken = false;
@@ -1482,8 +1490,16 @@ size_t EventHub::getEvents(int timeoutMillis, RawEvent* buffer, size_t bufferSiz
             break; // return to the caller before we actually rescan
         }
 
-        // Report any devices that had last been added/removed.
+        // Report any devices that had last been added/removed, after the events that were read
+        // from them before they were closed.
         for (auto it = mClosingDevices.begin(); it != mClosingDevices.end();) {
+            size_t count = takePendingEventsLocked(**it, event, capacity);
+            event += count;
+            capacity -= count;
+            if (capacity == 0) {
+                break;
+            }
+
             std::unique_ptr<Device> device = std::move(*it);
             ALOGV("Reporting device closed: id=%d, name=%s\n", device->id, device->path.c_str());
             event->when = now;
@@ -1498,6 +1514,9 @@ size_t EventHub::getEvents(int timeoutMillis, RawEvent* buffer, size_t bufferSiz
                 break;
             }
         }
+        if (capacity == 0) {
+            break; // the devices that are left are reported on the next call
+        }
 
         if (mNeedToScanDevices) {
             mNeedToScanDevices = false;
@@ -1603,42 +1622,9 @@ size_t EventHub::getEvents(int timeoutMillis, RawEvent* buffer, size_t bufferSiz
             }
             // This must be an input event
             if (eventItem.events & EPOLLIN) {
-                int32_t readSize =
-                        read(device->fd, readBuffer, sizeof(struct input_event) * capacity);
-                if (readSize == 0 || (readSize < 0 && errno == ENODEV)) {
-                    // Device was removed before INotify noticed.
-                    ALOGW("could not get event, removed? (fd: %d size: %" PRId32
-                          " bufferSize: %zu capacity: %zu errno: %d)\n",
-                          device->fd, readSize, bufferSize, capacity, errno);
+                if (!readDeviceEventsLocked(*device)) {
                     deviceChanged = true;
                     closeDeviceLocked(*device);
-                } else if (readSize < 0) {
-                    if (errno != EAGAIN && errno != EINTR) {
-                        ALOGW("could not get event (errno=%d)", errno);
-                    }
-                } else if ((readSize % sizeof(struct input_event)) != 0) {
-                    ALOGE("could not get event (wrong size: %d)", readSize);
-                } else {
-                    int32_t deviceId = device->id == mBuiltInKeyboardId ? 0 : device->id;
-
-                    size_t count = size_t(readSize) / sizeof(struct input_event);
-                    for (size_t i = 0; i < count; i++) {
-                        struct input_event& iev = readBuffer[i];
-                        event->when = processEventTimestamp(iev);
-                        event->readTime = systemTime(SYSTEM_TIME_MONOTONIC);
-                        event->deviceId = deviceId;
-                        event->type = iev.type;
-                        event->code = iev.code;
-                        event->value = iev.value;
-                        event += 1;
-                        capacity -= 1;
-                    }
-                    if (capacity == 0) {
-                        // The result buffer is full.  Reset the pending event index
-                        // so we will try to read the device again on the next iteration.
-                        mPendingEventIndex -= 1;
-                        break;
-                    }
                 }
             } else if (eventItem.events & EPOLLHUP) {
                 ALOGI("Removing device %s due to epoll hang-up event.",
@@ -1665,6 +1651,26 @@ size_t EventHub::getEvents(int timeoutMillis, RawEvent* buffer, size_t bufferSiz
             continue;
         }
 
+        // Return the events read from all the devices that were ready, the events of each device
+        // as a contiguous run.  If they do not all fit, the rest are returned on the next calls,
+        // before polling again.
+        size_t drainedDeviceCount = 0;
+        for (int32_t deviceId : mDevicesWithPendingEvents) {
+            // The events of a device that was closed are returned when it is reported removed.
+            auto it = mDevices.find(deviceId);
+            if (it != mDevices.end()) {
+                size_t count = takePendingEventsLocked(*it->second, event, capacity);
+                event += count;
+                capacity -= count;
+                if (it->second->pendingEventIndex < it->second->pendingEventCount) {
+                    break; // the result buffer is full
+                }
+            }
+            drainedDeviceCount += 1;
+        }
+        mDevicesWithPendingEvents.erase(mDevicesWithPendingEvents.begin(),
+                                        mDevicesWithPendingEvents.begin() + drainedDeviceCount);
+
         // Return now if we have collected any events or if we were explicitly awoken.
         if (event != buffer || awoken) {
             break;
@@ -1715,6 +1721,55 @@ size_t EventHub::getEvents(int timeoutMillis, RawEvent* buffer, size_t bufferSiz
     return event - buffer;
 }
 
+bool EventHub::readDeviceEventsLocked(Device& device) {
+    // The device is only read again once the events of its previous read have all been returned,
+    // so that they keep the time they were read at.  It stays ready until then.
+    if (device.pendingEventIndex < device.pendingEventCount) {
+        return true;
+    }
+    device.pendingEventIndex = 0;
+    device.pendingEventCount = 0;
+    size_t capacity = device.pendingEvents.size();
+
+    int32_t readSize = read(device.fd, device.pendingEvents.data(),
+                            sizeof(struct input_event) * capacity);
+    if (readSize == 0 || (readSize < 0 && errno == ENODEV)) {
+        // Device was removed before INotify noticed.
+        ALOGW("could not get event, removed? (fd: %d size: %" PRId32
+              " capacity: %zu errno: %d)\n",
+              device.fd, readSize, capacity, errno);
+        return false;
+    } else if (readSize < 0) {
+        if (errno != EAGAIN && errno != EINTR) {
+            ALOGW("could not get event (errno=%d)", errno);
+        }
+    } else if ((readSize % sizeof(struct input_event)) != 0) {
+        ALOGE("could not get event (wrong size: %d)", readSize);
+    } else {
+        mDevicesWithPendingEvents.push_back(device.id);
+        device.pendingEventCount = size_t(readSize) / sizeof(struct input_event);
+        device.pendingEventDeviceId = device.id == mBuiltInKeyboardId ? 0 : device.id;
+        device.pendingEventReadTime = systemTime(SYSTEM_TIME_MONOTONIC);
+    }
+    return true;
+}
+
+size_t EventHub::takePendingEventsLocked(Device& device, RawEvent* buffer, size_t capacity) {
+    size_t count = std::min(capacity, device.pendingEventCount - device.pendingEventIndex);
+    const struct input_event* iev = device.pendingEvents.data() + device.pendingEventIndex;
+    for (size_t i = 0; i < count; i++) {
+        RawEvent& event = buffer[i];
+        event.when = processEventTimestamp(iev[i]);
+        event.readTime = device.pendingEventReadTime;
+        event.deviceId = device.pendingEventDeviceId;
+        event.type = iev[i].type;
+        event.code = iev[i].code;
+        event.value = iev[i].value;
+    }
+    device.pendingEventIndex += count;
+    return count;
+}
+
 std::vector<TouchVideoFrame> EventHub::getVideoFrames(int32_t deviceId) {
     std::scoped_lock _l(mLock);
 
@@ -2238,6 +2293,13 @@ status_t EventHub::disableDevice(int32_t deviceId) {
     return device->disable();
 }
 
+status_t EventHub::startRecording(const std::string& path) {
+    // Recording is done by RecordingEventHub, which wraps this one on debuggable builds.
+    return INVALID_OPERATION;
+}
+
+void EventHub::stopRecording() {}
+
 void EventHub::createVirtualKeyboardLocked() {
     InputDeviceIdentifier identifier;
     identifier.name = "Virtual";
@@ -0,0 +1,1138 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "EventRecording"
+
+#include "EventRecording.h"
+
+#include <android-base/file.h>
+#include <android-base/stringprintf.h>
+#include <fcntl.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#define INDENT "  "
+
+namespace android {
+
+using android::base::ErrnoError;
+using android::base::Error;
+using android::base::Errorf;
+using android::base::Result;
+using android::base::StringPrintf;
+using namespace std::chrono_literals;
+
+/*
+ * The file starts with a magic number and a version, followed by records.  Each record is a type,
+ * the size of its payload and the payload.  All the values are little-endian, with strings and
+ * lists prefixed by their size.  Each event of a batch takes BATCH_EVENT_SIZE bytes.
+ *
+ * The version changes whenever the payload of an existing record type does.  New record types can
+ * be added without changing it, since the records that a reader does not know of are skipped.
+ */
+static constexpr uint32_t RECORDING_MAGIC = 0x43455249; // "IREC"
+static constexpr uint32_t RECORDING_VERSION = 2;
+
+enum class RecordType : uint8_t {
+    DEVICE = 1,
+    BATCH = 2,
+};
+
+// The size of the type and payload size of a record.
+static constexpr size_t RECORD_HEADER_SIZE = 5;
+
+// The size of an event in a batch: the event and read times, then four 32-bit fields.
+static constexpr size_t BATCH_EVENT_SIZE = 32;
+
+// A recording stops by itself once its file reaches this size, or once it has lasted this long, so
+// that one that is left running does not fill up the storage.
+static constexpr size_t MAX_RECORDING_SIZE = 64 * 1024 * 1024;
+static constexpr std::chrono::nanoseconds MAX_RECORDING_DURATION = 10min;
+
+static bool isInputEvent(const RawEvent& event) {
+    return event.type < EventHubInterface::FIRST_SYNTHETIC_EVENT;
+}
+
+// --- Serialization ---
+
+namespace {
+
+class Serializer {
+public:
+    explicit Serializer(std::vector<uint8_t>& buffer) : mBuffer(buffer) {}
+
+    template <typename T>
+    void write(T value) {
+        static_assert(std::is_integral_v<T>);
+        for (size_t i = 0; i < sizeof(T); i++) {
+            mBuffer.push_back(uint8_t(uint64_t(value) >> (i * 8)));
+        }
+    }
+
+    void write(const std::string& value) {
+        write<uint32_t>(value.size());
+        mBuffer.insert(mBuffer.end(), value.begin(), value.end());
+    }
+
+    void write(const std::set<int32_t>& values) {
+        write<uint32_t>(values.size());
+        for (int32_t value : values) {
+            write(value);
+        }
+    }
+
+    void writeRecordHeader(RecordType type) {
+        mRecordStart = mBuffer.size();
+        write(uint8_t(type));
+        write<uint32_t>(0);
+    }
+
+    // Fills in the payload size of the record started by the last writeRecordHeader.
+    void finishRecord() {
+        const uint32_t size = mBuffer.size() - mRecordStart - RECORD_HEADER_SIZE;
+        for (size_t i = 0; i < sizeof(size); i++) {
+            mBuffer[mRecordStart + 1 + i] = uint8_t(size >> (i * 8));
+        }
+    }
+
+private:
+    std::vector<uint8_t>& mBuffer;
+    size_t mRecordStart = 0;
+};
+
+class Deserializer {
+public:
+    Deserializer(const uint8_t* data, size_t size) : mData(data), mSize(size) {}
+
+    bool hasError() const { return mError; }
+    size_t remaining() const { return mSize - mOffset; }
+
+    // Returns whether 'size' more bytes can be read, and sets the error if not.
+    bool ensure(size_t size) {
+        if (mError || size > remaining()) {
+            mError = true;
+            return false;
+        }
+        return true;
+    }
+
+    template <typename T>
+    T read() {
+        static_assert(std::is_integral_v<T>);
+        if (!ensure(sizeof(T))) {
+            return 0;
+        }
+        uint64_t value = 0;
+        for (size_t i = 0; i < sizeof(T); i++) {
+            value |= uint64_t(mData[mOffset++]) << (i * 8);
+        }
+        return T(value);
+    }
+
+    std::string readString() {
+        const uint32_t size = read<uint32_t>();
+        if (!ensure(size)) {
+            return "";
+        }
+        std::string value(reinterpret_cast<const char*>(mData + mOffset), size);
+        mOffset += size;
+        return value;
+    }
+
+    std::set<int32_t> readSet() {
+        std::set<int32_t> values;
+        const uint32_t count = read<uint32_t>();
+        for (uint32_t i = 0; i < count && !mError; i++) {
+            values.insert(read<int32_t>());
+        }
+        return values;
+    }
+
+    // Returns a deserializer for the next 'size' bytes, and skips them.
+    Deserializer sub(size_t size) {
+        if (!ensure(size)) {
+            return Deserializer(nullptr, 0);
+        }
+        Deserializer sub(mData + mOffset, size);
+        mOffset += size;
+        return sub;
+    }
+
+private:
+    const uint8_t* mData;
+    size_t mSize;
+    size_t mOffset = 0;
+    bool mError = false;
+};
+
+} // namespace
+
+static void serializeDevice(Serializer& s, const RecordedDevice& device) {
+    s.write(device.id);
+    s.write(device.identifier.name);
+    s.write(device.identifier.location);
+    s.write(device.identifier.uniqueId);
+    s.write(device.identifier.bus);
+    s.write(device.identifier.vendor);
+    s.write(device.identifier.product);
+    s.write(device.identifier.version);
+    s.write(device.identifier.descriptor);
+    s.write(device.identifier.nonce);
+    s.write(device.classes.get());
+    s.write(device.controllerNumber);
+
+    s.write<uint32_t>(device.configuration.size());
+    for (const auto& [key, value] : device.configuration) {
+        s.write(key);
+        s.write(value);
+    }
+
+    s.write<uint32_t>(device.absoluteAxes.size());
+    for (const auto& [axis, info] : device.absoluteAxes) {
+        s.write(axis);
+        s.write(info.minValue);
+        s.write(info.maxValue);
+        s.write(info.flat);
+        s.write(info.fuzz);
+        s.write(info.resolution);
+    }
+
+    s.write(device.relativeAxes);
+    s.write(device.inputProperties);
+    s.write(device.mscEvents);
+
+    s.write<uint32_t>(device.keys.size());
+    for (const auto& [scanCode, mapping] : device.keys) {
+        s.write(scanCode);
+        s.write(mapping.keyCode);
+        s.write(mapping.flags);
+    }
+
+    s.write<uint32_t>(device.virtualKeys.size());
+    for (const VirtualKeyDefinition& virtualKey : device.virtualKeys) {
+        s.write(virtualKey.scanCode);
+        s.write(virtualKey.centerX);
+        s.write(virtualKey.centerY);
+        s.write(virtualKey.width);
+        s.write(virtualKey.height);
+    }
+}
+
+static RecordedDevice deserializeDevice(Deserializer& d) {
+    RecordedDevice device;
+    device.id = d.read<int32_t>();
+    device.identifier.name = d.readString();
+    device.identifier.location = d.readString();
+    device.identifier.uniqueId = d.readString();
+    device.identifier.bus = d.read<uint16_t>();
+    device.identifier.vendor = d.read<uint16_t>();
+    device.identifier.product = d.read<uint16_t>();
+    device.identifier.version = d.read<uint16_t>();
+    device.identifier.descriptor = d.readString();
+    device.identifier.nonce = d.read<uint16_t>();
+    device.classes = Flags<InputDeviceClass>(d.read<uint32_t>());
+    device.controllerNumber = d.read<int32_t>();
+
+    const uint32_t configurationCount = d.read<uint32_t>();
+    for (uint32_t i = 0; i < configurationCount && !d.hasError(); i++) {
+        std::string key = d.readString();
+        device.configuration[key] = d.readString();
+    }
+
+    const uint32_t axisCount = d.read<uint32_t>();
+    for (uint32_t i = 0; i < axisCount && !d.hasError(); i++) {
+        const int32_t axis = d.read<int32_t>();
+        RawAbsoluteAxisInfo& info = device.absoluteAxes[axis];
+        info.valid = true;
+        info.minValue = d.read<int32_t>();
+        info.maxValue = d.read<int32_t>();
+        info.flat = d.read<int32_t>();
+        info.fuzz = d.read<int32_t>();
+        info.resolution = d.read<int32_t>();
+    }
+
+    device.relativeAxes = d.readSet();
+    device.inputProperties = d.readSet();
+    device.mscEvents = d.readSet();
+
+    const uint32_t keyCount = d.read<uint32_t>();
+    for (uint32_t i = 0; i < keyCount && !d.hasError(); i++) {
+        const int32_t scanCode = d.read<int32_t>();
+        RecordedDevice::KeyMapping& mapping = device.keys[scanCode];
+        mapping.keyCode = d.read<int32_t>();
+        mapping.flags = d.read<uint32_t>();
+    }
+
+    const uint32_t virtualKeyCount = d.read<uint32_t>();
+    for (uint32_t i = 0; i < virtualKeyCount && !d.hasError(); i++) {
+        VirtualKeyDefinition virtualKey;
+        virtualKey.scanCode = d.read<int32_t>();
+        virtualKey.centerX = d.read<int32_t>();
+        virtualKey.centerY = d.read<int32_t>();
+        virtualKey.width = d.read<int32_t>();
+        virtualKey.height = d.read<int32_t>();
+        device.virtualKeys.push_back(virtualKey);
+    }
+    return device;
+}
+
+static void serializeBatch(Serializer& s, const RawEvent* events, size_t count) {
+    s.write<uint32_t>(count);
+    for (size_t i = 0; i < count; i++) {
+        const RawEvent& event = events[i];
+        s.write(event.when);
+        // The read time is only meaningful for input events, and is usually close to the event
+        // time, but the reader may fall far behind.
+        s.write<int64_t>(isInputEvent(event) ? event.readTime - event.when : 0);
+        s.write(event.deviceId);
+        s.write(event.type);
+        s.write(event.code);
+        s.write(event.value);
+    }
+}
+
+static std::vector<RawEvent> deserializeBatch(Deserializer& d) {
+    const uint32_t count = d.read<uint32_t>();
+    // Checked before allocating, so that a corrupt count fails the load rather than the allocation.
+    if (!d.ensure(size_t(count) * BATCH_EVENT_SIZE)) {
+        return {};
+    }
+    std::vector<RawEvent> events(count);
+    for (RawEvent& event : events) {
+        event.when = d.read<int64_t>();
+        event.readTime = event.when + d.read<int64_t>();
+        event.deviceId = d.read<int32_t>();
+        event.type = d.read<int32_t>();
+        event.code = d.read<int32_t>();
+        event.value = d.read<int32_t>();
+        if (d.hasError()) {
+            events.clear();
+            break;
+        }
+    }
+    return events;
+}
+
+// --- RecordedDevice ---
+
+RecordedDevice RecordedDevice::fromEventHub(const EventHubInterface& eventHub, int32_t deviceId) {
+    RecordedDevice device;
+    device.id = deviceId;
+    device.identifier = eventHub.getDeviceIdentifier(deviceId);
+    device.classes = eventHub.getDeviceClasses(deviceId);
+    device.controllerNumber = eventHub.getDeviceControllerNumber(deviceId);
+
+    PropertyMap configuration;
+    eventHub.getConfiguration(deviceId, &configuration);
+    const KeyedVector<String8, String8>& properties = configuration.getProperties();
+    for (size_t i = 0; i < properties.size(); i++) {
+        device.configuration[properties.keyAt(i).string()] = properties.valueAt(i).string();
+    }
+
+    for (int32_t axis = 0; axis <= ABS_MAX; axis++) {
+        RawAbsoluteAxisInfo info;
+        if (eventHub.getAbsoluteAxisInfo(deviceId, axis, &info) == OK && info.valid) {
+            device.absoluteAxes[axis] = info;
+        }
+    }
+    for (int32_t axis = 0; axis <= REL_MAX; axis++) {
+        if (eventHub.hasRelativeAxis(deviceId, axis)) {
+            device.relativeAxes.insert(axis);
+        }
+    }
+    for (int32_t property = 0; property <= INPUT_PROP_MAX; property++) {
+        if (eventHub.hasInputProperty(deviceId, property)) {
+            device.inputProperties.insert(property);
+        }
+    }
+    for (int32_t mscEvent = 0; mscEvent <= MSC_MAX; mscEvent++) {
+        if (eventHub.hasMscEvent(deviceId, mscEvent)) {
+            device.mscEvents.insert(mscEvent);
+        }
+    }
+    for (int32_t scanCode = 0; scanCode <= KEY_MAX; scanCode++) {
+        if (!eventHub.hasScanCode(deviceId, scanCode)) {
+            continue;
+        }
+        KeyMapping& mapping = device.keys[scanCode];
+        int32_t metaState;
+        if (eventHub.mapKey(deviceId, scanCode, 0 /*usageCode*/, AMETA_NONE, &mapping.keyCode,
+                            &metaState, &mapping.flags) != OK) {
+            mapping.keyCode = AKEYCODE_UNKNOWN;
+            mapping.flags = 0;
+        }
+    }
+    eventHub.getVirtualKeyDefinitions(deviceId, device.virtualKeys);
+    return device;
+}
+
+// --- EventRecording ---
+
+Result<EventRecording> EventRecording::load(const std::string& path) {
+    std::string contents;
+    if (!base::ReadFileToString(path, &contents)) {
+        return ErrnoError() << "Could not read " << path;
+    }
+
+    Deserializer d(reinterpret_cast<const uint8_t*>(contents.data()), contents.size());
+    if (d.read<uint32_t>() != RECORDING_MAGIC || d.read<uint32_t>() != RECORDING_VERSION) {
+        return Error() << path << " is not an event recording of version " << RECORDING_VERSION;
+    }
+
+    EventRecording recording;
+    while (d.remaining() > 0) {
+        const RecordType type = RecordType(d.read<uint8_t>());
+        Deserializer record = d.sub(d.read<uint32_t>());
+        switch (type) {
+            case RecordType::DEVICE: {
+                RecordedDevice device = deserializeDevice(record);
+                if (!record.hasError()) {
+                    recording.devices[device.id] = std::move(device);
+                }
+                break;
+            }
+            case RecordType::BATCH:
+                recording.batches.push_back(deserializeBatch(record));
+                break;
+            default:
+                // Record types added since this reader was written are skipped.
+                break;
+        }
+        if (d.hasError() || record.hasError()) {
+            return Error() << path << " is truncated or corrupt";
+        }
+    }
+    return recording;
+}
+
+Result<void> EventRecording::save(const std::string& path) const {
+    Result<std::unique_ptr<EventRecordingWriter>> writer = EventRecordingWriter::open(path);
+    if (!writer.ok()) {
+        return writer.error();
+    }
+    for (const auto& [_, device] : devices) {
+        if (!(*writer)->writeDevice(device)) {
+            return ErrnoError() << "Could not write " << path;
+        }
+    }
+    for (const std::vector<RawEvent>& batch : batches) {
+        if (!(*writer)->writeBatch(batch.data(), batch.size())) {
+            return ErrnoError() << "Could not write " << path;
+        }
+    }
+    return {};
+}
+
+// --- EventRecordingWriter ---
+
+EventRecordingWriter::EventRecordingWriter(base::unique_fd fd) : mFd(std::move(fd)) {}
+
+Result<std::unique_ptr<EventRecordingWriter>> EventRecordingWriter::open(const std::string& path) {
+    base::unique_fd fd(::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600));
+    if (fd < 0) {
+        return ErrnoError() << "Could not create " << path;
+    }
+    std::unique_ptr<EventRecordingWriter> writer(new EventRecordingWriter(std::move(fd)));
+    Serializer s(writer->mBuffer);
+    s.write(RECORDING_MAGIC);
+    s.write(RECORDING_VERSION);
+    if (!writer->flush()) {
+        return ErrnoError() << "Could not write " << path;
+    }
+    return writer;
+}
+
+bool EventRecordingWriter::writeDevice(const RecordedDevice& device) {
+    Serializer s(mBuffer);
+    s.writeRecordHeader(RecordType::DEVICE);
+    serializeDevice(s, device);
+    s.finishRecord();
+    return flush();
+}
+
+bool EventRecordingWriter::writeBatch(const RawEvent* events, size_t count) {
+    Serializer s(mBuffer);
+    s.writeRecordHeader(RecordType::BATCH);
+    serializeBatch(s, events, count);
+    s.finishRecord();
+    return flush();
+}
+
+bool EventRecordingWriter::flush() {
+    const bool written = base::WriteFully(mFd, mBuffer.data(), mBuffer.size());
+    mSize += mBuffer.size();
+    mBuffer.clear();
+    return written;
+}
+
+// --- RecordingEventHub ---
+
+RecordingEventHub::RecordingEventHub(std::unique_ptr<EventHubInterface> eventHub)
+      : mEventHub(std::move(eventHub)), mRecordingDeadline(0) {}
+
+RecordingEventHub::~RecordingEventHub() {}
+
+size_t RecordingEventHub::getEvents(int timeoutMillis, RawEvent* buffer, size_t bufferSize) {
+    const size_t count = mEventHub->getEvents(timeoutMillis, buffer, bufferSize);
+    std::scoped_lock _l(mLock);
+    const bool recording = mWriter != nullptr;
+
+    // The touch devices are tracked even when not recording, so that a recording can start with
+    // the ones that are present.  They are described before the batch that adds them, so that a
+    // replay knows them by the time the reader asks about them.
+    bool written = true;
+    mRecordedEvents.clear();
+    for (size_t i = 0; i < count; i++) {
+        const RawEvent& event = buffer[i];
+        bool recorded;
+        switch (event.type) {
+            case DEVICE_ADDED:
+                recorded =
+                        mEventHub->getDeviceClasses(event.deviceId).test(InputDeviceClass::TOUCH);
+                if (recorded) {
+                    mTouchDevices.insert(event.deviceId);
+                    if (recording && written) {
+                        written = mWriter->writeDevice(
+                                RecordedDevice::fromEventHub(*mEventHub, event.deviceId));
+                    }
+                }
+                break;
+            case DEVICE_REMOVED:
+                recorded = mTouchDevices.erase(event.deviceId) > 0;
+                break;
+            case FINISHED_DEVICE_SCAN:
+                recorded = true;
+                break;
+            default:
+                recorded = recording && mTouchDevices.count(event.deviceId) > 0;
+                break;
+        }
+        if (recording && recorded) {
+            mRecordedEvents.push_back(event);
+        }
+    }
+    if (!recording) {
+        return count;
+    }
+
+    if (written && !mRecordedEvents.empty()) {
+        written = mWriter->writeBatch(mRecordedEvents.data(), mRecordedEvents.size());
+    }
+    if (!written) {
+        ALOGE("Could not write the event recording, recording stopped: %s", strerror(errno));
+        mWriter.reset();
+    } else if (mWriter->getSize() >= MAX_RECORDING_SIZE ||
+               systemTime(SYSTEM_TIME_MONOTONIC) >= mRecordingDeadline) {
+        ALOGI("The event recording reached its maximum size or duration, recording stopped");
+        mWriter.reset();
+    }
+    return count;
+}
+
+status_t RecordingEventHub::startRecording(const std::string& path) {
+    Result<std::unique_ptr<EventRecordingWriter>> writer = EventRecordingWriter::open(path);
+    if (!writer.ok()) {
+        ALOGE("Could not record the input events: %s", writer.error().message().c_str());
+        return -writer.error().code();
+    }
+
+    // The recording starts by adding the touch devices that are present, the way a device scan
+    // adds them.
+    std::scoped_lock _l(mLock);
+    const nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+    std::vector<RawEvent> addedDevices;
+    for (int32_t deviceId : mTouchDevices) {
+        if (!(*writer)->writeDevice(RecordedDevice::fromEventHub(*mEventHub, deviceId))) {
+            const int error = errno;
+            ALOGE("Could not write the event recording: %s", strerror(error));
+            return -error;
+        }
+        addedDevices.push_back({now, 0, deviceId, DEVICE_ADDED, 0, 0});
+    }
+    addedDevices.push_back({now, 0, 0, FINISHED_DEVICE_SCAN, 0, 0});
+    if (!(*writer)->writeBatch(addedDevices.data(), addedDevices.size())) {
+        const int error = errno;
+        ALOGE("Could not write the event recording: %s", strerror(error));
+        return -error;
+    }
+
+    mWriter = std::move(*writer);
+    mRecordingDeadline = now + MAX_RECORDING_DURATION.count();
+    ALOGI("Recording the input events to %s", path.c_str());
+    return OK;
+}
+
+void RecordingEventHub::stopRecording() {
+    std::scoped_lock _l(mLock);
+    if (mWriter != nullptr) {
+        ALOGI("Stopped recording the input events");
+        mWriter.reset();
+    }
+}
+
+Flags<InputDeviceClass> RecordingEventHub::getDeviceClasses(int32_t deviceId) const {
+    return mEventHub->getDeviceClasses(deviceId);
+}
+
+InputDeviceIdentifier RecordingEventHub::getDeviceIdentifier(int32_t deviceId) const {
+    return mEventHub->getDeviceIdentifier(deviceId);
+}
+
+int32_t RecordingEventHub::getDeviceControllerNumber(int32_t deviceId) const {
+    return mEventHub->getDeviceControllerNumber(deviceId);
+}
+
+void RecordingEventHub::getConfiguration(int32_t deviceId, PropertyMap* outConfiguration) const {
+    mEventHub->getConfiguration(deviceId, outConfiguration);
+}
+
+status_t RecordingEventHub::getAbsoluteAxisInfo(int32_t deviceId, int axis,
+                                                RawAbsoluteAxisInfo* outAxisInfo) const {
+    return mEventHub->getAbsoluteAxisInfo(deviceId, axis, outAxisInfo);
+}
+
+bool RecordingEventHub::hasRelativeAxis(int32_t deviceId, int axis) const {
+    return mEventHub->hasRelativeAxis(deviceId, axis);
+}
+
+bool RecordingEventHub::hasInputProperty(int32_t deviceId, int property) const {
+    return mEventHub->hasInputProperty(deviceId, property);
+}
+
+bool RecordingEventHub::hasMscEvent(int32_t deviceId, int mscEvent) const {
+    return mEventHub->hasMscEvent(deviceId, mscEvent);
+}
+
+status_t RecordingEventHub::mapKey(int32_t deviceId, int32_t scanCode, int32_t usageCode,
+                                   int32_t metaState, int32_t* outKeycode, int32_t* outMetaState,
+                                   uint32_t* outFlags) const {
+    return mEventHub->mapKey(deviceId, scanCode, usageCode, metaState, outKeycode, outMetaState,
+                             outFlags);
+}
+
+status_t RecordingEventHub::mapAxis(int32_t deviceId, int32_t scanCode,
+                                    AxisInfo* outAxisInfo) const {
+    return mEventHub->mapAxis(deviceId, scanCode, outAxisInfo);
+}
+
+void RecordingEventHub::setExcludedDevices(const std::vector<std::string>& devices) {
+    mEventHub->setExcludedDevices(devices);
+}
+
+std::vector<TouchVideoFrame> RecordingEventHub::getVideoFrames(int32_t deviceId) {
+    return mEventHub->getVideoFrames(deviceId);
+}
+
+Result<std::pair<InputDeviceSensorType, int32_t>> RecordingEventHub::mapSensor(int32_t deviceId,
+                                                                              int32_t absCode) {
+    return mEventHub->mapSensor(deviceId, absCode);
+}
+
+const std::vector<int32_t> RecordingEventHub::getRawBatteryIds(int32_t deviceId) {
+    return mEventHub->getRawBatteryIds(deviceId);
+}
+
+std::optional<RawBatteryInfo> RecordingEventHub::getRawBatteryInfo(int32_t deviceId,
+                                                                   int32_t batteryId) {
+    return mEventHub->getRawBatteryInfo(deviceId, batteryId);
+}
+
+const std::vector<int32_t> RecordingEventHub::getRawLightIds(int32_t deviceId) {
+    return mEventHub->getRawLightIds(deviceId);
+}
+
+std::optional<RawLightInfo> RecordingEventHub::getRawLightInfo(int32_t deviceId, int32_t lightId) {
+    return mEventHub->getRawLightInfo(deviceId, lightId);
+}
+
+std::optional<int32_t> RecordingEventHub::getLightBrightness(int32_t deviceId, int32_t lightId) {
+    return mEventHub->getLightBrightness(deviceId, lightId);
+}
+
+void RecordingEventHub::setLightBrightness(int32_t deviceId, int32_t lightId,
+                                           int32_t brightness) {
+    mEventHub->setLightBrightness(deviceId, lightId, brightness);
+}
+
+std::optional<std::unordered_map<LightColor, int32_t>> RecordingEventHub::getLightIntensities(
+        int32_t deviceId, int32_t lightId) {
+    return mEventHub->getLightIntensities(deviceId, lightId);
+}
+
+void RecordingEventHub::setLightIntensities(int32_t deviceId, int32_t lightId,
+                                            std::unordered_map<LightColor, int32_t> intensities) {
+    mEventHub->setLightIntensities(deviceId, lightId, std::move(intensities));
+}
+
+int32_t RecordingEventHub::getScanCodeState(int32_t deviceId, int32_t scanCode) const {
+    return mEventHub->getScanCodeState(deviceId, scanCode);
+}
+
+int32_t RecordingEventHub::getKeyCodeState(int32_t deviceId, int32_t keyCode) const {
+    return mEventHub->getKeyCodeState(deviceId, keyCode);
+}
+
+int32_t RecordingEventHub::getSwitchState(int32_t deviceId, int32_t sw) const {
+    return mEventHub->getSwitchState(deviceId, sw);
+}
+
+status_t RecordingEventHub::getAbsoluteAxisValue(int32_t deviceId, int32_t axis,
+                                                 int32_t* outValue) const {
+    return mEventHub->getAbsoluteAxisValue(deviceId, axis, outValue);
+}
+
+bool RecordingEventHub::markSupportedKeyCodes(int32_t deviceId, size_t numCodes,
+                                              const int32_t* keyCodes, uint8_t* outFlags) const {
+    return mEventHub->markSupportedKeyCodes(deviceId, numCodes, keyCodes, outFlags);
+}
+
+bool RecordingEventHub::hasScanCode(int32_t deviceId, int32_t scanCode) const {
+    return mEventHub->hasScanCode(deviceId, scanCode);
+}
+
+bool RecordingEventHub::hasLed(int32_t deviceId, int32_t led) const {
+    return mEventHub->hasLed(deviceId, led);
+}
+
+void RecordingEventHub::setLedState(int32_t deviceId, int32_t led, bool on) {
+    mEventHub->setLedState(deviceId, led, on);
+}
+
+void RecordingEventHub::getVirtualKeyDefinitions(
+        int32_t deviceId, std::vector<VirtualKeyDefinition>& outVirtualKeys) const {
+    mEventHub->getVirtualKeyDefinitions(deviceId, outVirtualKeys);
+}
+
+const std::shared_ptr<KeyCharacterMap> RecordingEventHub::getKeyCharacterMap(
+        int32_t deviceId) const {
+    return mEventHub->getKeyCharacterMap(deviceId);
+}
+
+bool RecordingEventHub::setKeyboardLayoutOverlay(int32_t deviceId,
+                                                 std::shared_ptr<KeyCharacterMap> map) {
+    return mEventHub->setKeyboardLayoutOverlay(deviceId, std::move(map));
+}
+
+void RecordingEventHub::vibrate(int32_t deviceId, const VibrationElement& effect) {
+    mEventHub->vibrate(deviceId, effect);
+}
+
+void RecordingEventHub::cancelVibrate(int32_t deviceId) {
+    mEventHub->cancelVibrate(deviceId);
+}
+
+std::vector<int32_t> RecordingEventHub::getVibratorIds(int32_t deviceId) {
+    return mEventHub->getVibratorIds(deviceId);
+}
+
+std::optional<int32_t> RecordingEventHub::getBatteryCapacity(int32_t deviceId,
+                                                             int32_t batteryId) const {
+    return mEventHub->getBatteryCapacity(deviceId, batteryId);
+}
+
+std::optional<int32_t> RecordingEventHub::getBatteryStatus(int32_t deviceId,
+                                                           int32_t batteryId) const {
+    return mEventHub->getBatteryStatus(deviceId, batteryId);
+}
+
+void RecordingEventHub::requestReopenDevices() {
+    mEventHub->requestReopenDevices();
+}
+
+void RecordingEventHub::wake() {
+    mEventHub->wake();
+}
+
+void RecordingEventHub::dump(std::string& dump) {
+    mEventHub->dump(dump);
+    std::scoped_lock _l(mLock);
+    if (mWriter != nullptr) {
+        dump += StringPrintf("Event Recording: active, %zu bytes\n", mWriter->getSize());
+    } else {
+        dump += "Event Recording: stopped\n";
+    }
+}
+
+void RecordingEventHub::monitor() {
+    mEventHub->monitor();
+}
+
+bool RecordingEventHub::isDeviceEnabled(int32_t deviceId) {
+    return mEventHub->isDeviceEnabled(deviceId);
+}
+
+status_t RecordingEventHub::enableDevice(int32_t deviceId) {
+    return mEventHub->enableDevice(deviceId);
+}
+
+status_t RecordingEventHub::disableDevice(int32_t deviceId) {
+    return mEventHub->disableDevice(deviceId);
+}
+
+// --- ReplayEventHub ---
+
+static size_t findFirstEventBatch(const EventRecording& recording) {
+    for (size_t i = 0; i < recording.batches.size(); i++) {
+        const std::vector<RawEvent>& batch = recording.batches[i];
+        if (std::any_of(batch.begin(), batch.end(), isInputEvent)) {
+            return i;
+        }
+    }
+    return recording.batches.size();
+}
+
+ReplayEventHub::ReplayEventHub(EventRecording recording, Speed speed)
+      : mRecording(std::move(recording)),
+        mSpeed(speed),
+        mFirstEventBatch(findFirstEventBatch(mRecording)),
+        mAwoken(false),
+        mNextBatch(0),
+        mNextEvent(0),
+        mReplayStartTime(-1),
+        mRecordingStartTime(0) {}
+
+ReplayEventHub::~ReplayEventHub() {}
+
+bool ReplayEventHub::isFinished() const {
+    return mNextBatch >= mRecording.batches.size();
+}
+
+void ReplayEventHub::rewindEvents() {
+    mNextBatch = mFirstEventBatch;
+    mNextEvent = 0;
+    mReplayStartTime = -1;
+}
+
+size_t ReplayEventHub::getEvents(int timeoutMillis, RawEvent* buffer, size_t bufferSize) {
+    std::unique_lock<std::mutex> lock(mLock);
+    auto isAwoken = [this]() REQUIRES(mLock) { return mAwoken; };
+    const nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+    if (isFinished()) {
+        // Like EventHub with no more events, block until woken or timed out.
+        if (timeoutMillis < 0) {
+            mWakeCondition.wait(lock, isAwoken);
+        } else {
+            mWakeCondition.wait_for(lock, std::chrono::milliseconds(timeoutMillis), isAwoken);
+        }
+        mAwoken = false;
+        return 0;
+    }
+
+    const std::vector<RawEvent>& batch = mRecording.batches[mNextBatch];
+    if (mReplayStartTime < 0) {
+        mReplayStartTime = now;
+        mRecordingStartTime = batch.empty() ? 0 : batch.front().when;
+    }
+
+    if (mSpeed == Speed::RECORDED && mNextEvent == 0 && !batch.empty()) {
+        const nsecs_t replayTime = mReplayStartTime + batch.front().when - mRecordingStartTime;
+        if (replayTime > now) {
+            nsecs_t waitTime = replayTime - now;
+            if (timeoutMillis >= 0) {
+                waitTime = std::min(waitTime, milliseconds_to_nanoseconds(timeoutMillis));
+            }
+            mWakeCondition.wait_for(lock, std::chrono::nanoseconds(waitTime), isAwoken);
+            if (mAwoken || systemTime(SYSTEM_TIME_MONOTONIC) < replayTime) {
+                mAwoken = false;
+                return 0;
+            }
+        }
+    }
+    mAwoken = false;
+
+    const nsecs_t readTime = systemTime(SYSTEM_TIME_MONOTONIC);
+    size_t count = 0;
+    while (mNextEvent < batch.size() && count < bufferSize) {
+        const RawEvent& event = batch[mNextEvent++];
+        if (isInputEvent(event) && mDisabledDevices.count(event.deviceId)) {
+            continue;
+        }
+        RawEvent& replayed = buffer[count++];
+        replayed = event;
+        if (mSpeed == Speed::MAX) {
+            replayed.when = readTime;
+            replayed.readTime = readTime;
+        } else {
+            replayed.when += mReplayStartTime - mRecordingStartTime;
+            replayed.readTime = isInputEvent(event) ? readTime : 0;
+        }
+    }
+    if (mNextEvent >= batch.size()) {
+        mNextBatch += 1;
+        mNextEvent = 0;
+    }
+    return count;
+}
+
+const RecordedDevice* ReplayEventHub::getDevice(int32_t deviceId) const {
+    auto it = mRecording.devices.find(deviceId);
+    return it != mRecording.devices.end() ? &it->second : nullptr;
+}
+
+Flags<InputDeviceClass> ReplayEventHub::getDeviceClasses(int32_t deviceId) const {
+    const RecordedDevice* device = getDevice(deviceId);
+    return device != nullptr ? device->classes : Flags<InputDeviceClass>(0);
+}
+
+InputDeviceIdentifier ReplayEventHub::getDeviceIdentifier(int32_t deviceId) const {
+    const RecordedDevice* device = getDevice(deviceId);
+    return device != nullptr ? device->identifier : InputDeviceIdentifier();
+}
+
+int32_t ReplayEventHub::getDeviceControllerNumber(int32_t deviceId) const {
+    const RecordedDevice* device = getDevice(deviceId);
+    return device != nullptr ? device->controllerNumber : 0;
+}
+
+void ReplayEventHub::getConfiguration(int32_t deviceId, PropertyMap* outConfiguration) const {
+    outConfiguration->clear();
+    const RecordedDevice* device = getDevice(deviceId);
+    if (device != nullptr) {
+        for (const auto& [key, value] : device->configuration) {
+            outConfiguration->addProperty(String8(key.c_str()), String8(value.c_str()));
+        }
+    }
+}
+
+status_t ReplayEventHub::getAbsoluteAxisInfo(int32_t deviceId, int axis,
+                                             RawAbsoluteAxisInfo* outAxisInfo) const {
+    outAxisInfo->clear();
+    const RecordedDevice* device = getDevice(deviceId);
+    if (device != nullptr) {
+        auto it = device->absoluteAxes.find(axis);
+        if (it != device->absoluteAxes.end()) {
+            *outAxisInfo = it->second;
+            return OK;
+        }
+    }
+    return -1;
+}
+
+bool ReplayEventHub::hasRelativeAxis(int32_t deviceId, int axis) const {
+    const RecordedDevice* device = getDevice(deviceId);
+    return device != nullptr && device->relativeAxes.count(axis);
+}
+
+bool ReplayEventHub::hasInputProperty(int32_t deviceId, int property) const {
+    const RecordedDevice* device = getDevice(deviceId);
+    return device != nullptr && device->inputProperties.count(property);
+}
+
+bool ReplayEventHub::hasMscEvent(int32_t deviceId, int mscEvent) const {
+    const RecordedDevice* device = getDevice(deviceId);
+    return device != nullptr && device->mscEvents.count(mscEvent);
+}
+
+status_t ReplayEventHub::mapKey(int32_t deviceId, int32_t scanCode, int32_t, int32_t metaState,
+                                int32_t* outKeycode, int32_t* outMetaState,
+                                uint32_t* outFlags) const {
+    // Only the mapping without a usage code was recorded, and the meta state is passed through.
+    *outMetaState = metaState;
+    const RecordedDevice* device = getDevice(deviceId);
+    if (device != nullptr) {
+        auto it = device->keys.find(scanCode);
+        if (it != device->keys.end() && it->second.keyCode != AKEYCODE_UNKNOWN) {
+            *outKeycode = it->second.keyCode;
+            *outFlags = it->second.flags;
+            return OK;
+        }
+    }
+    *outKeycode = AKEYCODE_UNKNOWN;
+    *outFlags = 0;
+    return NAME_NOT_FOUND;
+}
+
+status_t ReplayEventHub::mapAxis(int32_t, int32_t, AxisInfo*) const {
+    return NAME_NOT_FOUND;
+}
+
+void ReplayEventHub::setExcludedDevices(const std::vector<std::string>&) {}
+
+std::vector<TouchVideoFrame> ReplayEventHub::getVideoFrames(int32_t) {
+    return {};
+}
+
+Result<std::pair<InputDeviceSensorType, int32_t>> ReplayEventHub::mapSensor(int32_t, int32_t) {
+    return Errorf("Sensors are not replayed.");
+}
+
+const std::vector<int32_t> ReplayEventHub::getRawBatteryIds(int32_t) {
+    return {};
+}
+
+std::optional<RawBatteryInfo> ReplayEventHub::getRawBatteryInfo(int32_t, int32_t) {
+    return std::nullopt;
+}
+
+const std::vector<int32_t> ReplayEventHub::getRawLightIds(int32_t) {
+    return {};
+}
+
+std::optional<RawLightInfo> ReplayEventHub::getRawLightInfo(int32_t, int32_t) {
+    return std::nullopt;
+}
+
+std::optional<int32_t> ReplayEventHub::getLightBrightness(int32_t, int32_t) {
+    return std::nullopt;
+}
+
+void ReplayEventHub::setLightBrightness(int32_t, int32_t, int32_t) {}
+
+std::optional<std::unordered_map<LightColor, int32_t>> ReplayEventHub::getLightIntensities(
+        int32_t, int32_t) {
+    return std::nullopt;
+}
+
+void ReplayEventHub::setLightIntensities(int32_t, int32_t,
+                                         std::unordered_map<LightColor, int32_t>) {}
+
+int32_t ReplayEventHub::getScanCodeState(int32_t deviceId, int32_t scanCode) const {
+    const RecordedDevice* device = getDevice(deviceId);
+    return device != nullptr && device->keys.count(scanCode) ? AKEY_STATE_UP : AKEY_STATE_UNKNOWN;
+}
+
+int32_t ReplayEventHub::getKeyCodeState(int32_t deviceId, int32_t keyCode) const {
+    uint8_t supported = 0;
+    return markSupportedKeyCodes(deviceId, 1, &keyCode, &supported) && supported
+            ? AKEY_STATE_UP
+            : AKEY_STATE_UNKNOWN;
+}
+
+int32_t ReplayEventHub::getSwitchState(int32_t, int32_t) const {
+    return AKEY_STATE_UNKNOWN;
+}
+
+status_t ReplayEventHub::getAbsoluteAxisValue(int32_t deviceId, int32_t axis,
+                                              int32_t* outValue) const {
+    *outValue = 0;
+    const RecordedDevice* device = getDevice(deviceId);
+    return device != nullptr && device->absoluteAxes.count(axis) ? OK : -1;
+}
+
+bool ReplayEventHub::markSupportedKeyCodes(int32_t deviceId, size_t numCodes,
+                                           const int32_t* keyCodes, uint8_t* outFlags) const {
+    const RecordedDevice* device = getDevice(deviceId);
+    if (device == nullptr) {
+        return false;
+    }
+    for (size_t i = 0; i < numCodes; i++) {
+        for (const auto& [_, mapping] : device->keys) {
+            if (mapping.keyCode == keyCodes[i]) {
+                outFlags[i] = 1;
+                break;
+            }
+        }
+    }
+    return true;
+}
+
+bool ReplayEventHub::hasScanCode(int32_t deviceId, int32_t scanCode) const {
+    const RecordedDevice* device = getDevice(deviceId);
+    return device != nullptr && device->keys.count(scanCode);
+}
+
+bool ReplayEventHub::hasLed(int32_t, int32_t) const {
+    return false;
+}
+
+void ReplayEventHub::setLedState(int32_t, int32_t, bool) {}
+
+void ReplayEventHub::getVirtualKeyDefinitions(
+        int32_t deviceId, std::vector<VirtualKeyDefinition>& outVirtualKeys) const {
+    outVirtualKeys.clear();
+    const RecordedDevice* device = getDevice(deviceId);
+    if (device != nullptr) {
+        outVirtualKeys = device->virtualKeys;
+    }
+}
+
+const std::shared_ptr<KeyCharacterMap> ReplayEventHub::getKeyCharacterMap(int32_t) const {
+    return nullptr;
+}
+
+bool ReplayEventHub::setKeyboardLayoutOverlay(int32_t, std::shared_ptr<KeyCharacterMap>) {
+    return false;
+}
+
+void ReplayEventHub::vibrate(int32_t, const VibrationElement&) {}
+
+void ReplayEventHub::cancelVibrate(int32_t) {}
+
+std::vector<int32_t> ReplayEventHub::getVibratorIds(int32_t) {
+    return {};
+}
+
+std::optional<int32_t> ReplayEventHub::getBatteryCapacity(int32_t, int32_t) const {
+    return std::nullopt;
+}
+
+std::optional<int32_t> ReplayEventHub::getBatteryStatus(int32_t, int32_t) const {
+    return std::nullopt;
+}
+
+void ReplayEventHub::requestReopenDevices() {}
+
+void ReplayEventHub::wake() {
+    std::scoped_lock _l(mLock);
+    mAwoken = true;
+    mWakeCondition.notify_all();
+}
+
+void ReplayEventHub::dump(std::string& dump) {
+    std::scoped_lock _l(mLock);
+    dump += "Replay Event Hub State:\n";
+    dump += StringPrintf(INDENT "Speed: %s\n", mSpeed == Speed::MAX ? "max" : "recorded");
+    dump += StringPrintf(INDENT "Devices: %zu\n", mRecording.devices.size());
+    dump += StringPrintf(INDENT "Batches: %zu of %zu replayed\n", mNextBatch,
+                         mRecording.batches.size());
+}
+
+void ReplayEventHub::monitor() {
+    std::unique_lock<std::mutex> lock(mLock);
+}
+
+bool ReplayEventHub::isDeviceEnabled(int32_t deviceId) {
+    std::scoped_lock _l(mLock);
+    return getDevice(deviceId) != nullptr && !mDisabledDevices.count(deviceId);
+}
+
+status_t ReplayEventHub::enableDevice(int32_t deviceId) {
+    std::scoped_lock _l(mLock);
+    if (getDevice(deviceId) == nullptr) {
+        return BAD_VALUE;
+    }
+    mDisabledDevices.erase(deviceId);
+    return OK;
+}
+
+status_t ReplayEventHub::disableDevice(int32_t deviceId) {
+    std::scoped_lock _l(mLock);
+    if (getDevice(deviceId) == nullptr) {
+        return BAD_VALUE;
+    }
+    mDisabledDevices.insert(deviceId);
+    return OK;
+}
+
+status_t ReplayEventHub::startRecording(const std::string& path) {
+    return INVALID_OPERATION;
+}
+
+void ReplayEventHub::stopRecording() {}
+
+} // namespace android
@@ -759,6 +759,14 @@ std::optional<int32_t> InputReader::getLightPlayerId(int32_t deviceId, int32_t l
     return std::nullopt;
 }
 
+status_t InputReader::startEventRecording(const std::string& path) {
+    return mEventHub->startRecording(path);
+}
+
+void InputReader::stopEventRecording() {
+    mEventHub->stopRecording();
+}
+
 bool InputReader::isInputDeviceEnabled(int32_t deviceId) {
     std::scoped_lock _l(mLock);
 
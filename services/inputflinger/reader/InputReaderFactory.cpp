@@ -14,15 +14,30 @@
  * limitations under the License.
  */
 
+#define LOG_TAG "InputReader"
+
 #include "InputReaderFactory.h"
 
+#include <android-base/properties.h>
+
+#include "EventRecording.h"
 #include "InputReader.h"
 
 namespace android {
 
+static std::unique_ptr<EventHubInterface> createEventHub() {
+    std::unique_ptr<EventHubInterface> eventHub = std::make_unique<EventHub>();
+    // The input events can only be recorded on debuggable builds, when asked for with
+    // "dumpsys inputflinger --start-event-recording <path>".
+    if (!base::GetBoolProperty("ro.debuggable", false)) {
+        return eventHub;
+    }
+    return std::make_unique<RecordingEventHub>(std::move(eventHub));
+}
+
 sp<InputReaderInterface> createInputReader(const sp<InputReaderPolicyInterface>& policy,
                                            const sp<InputListenerInterface>& listener) {
-    return new InputReader(std::make_unique<EventHub>(), policy, listener);
+    return new InputReader(createEventHub(), policy, listener);
 }
 
 } // namespace android
\ No newline at end of file
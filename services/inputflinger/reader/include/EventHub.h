@@ -356,6 +356,14 @@ public:
 
     /* Disable an input device. Closes file descriptor to that device. */
     virtual status_t disableDevice(int32_t deviceId) = 0;
+
+    /* Starts recording the touch devices and their raw events to the file at 'path', so that
+     * they can be replayed into the reader later.  Returns INVALID_OPERATION if this EventHub
+     * can't record. */
+    virtual status_t startRecording(const std::string& path) = 0;
+
+    /* Stops the recording started by startRecording, if any. */
+    virtual void stopRecording() = 0;
 };
 
 template <std::size_t BITS>
@@ -525,6 +533,10 @@ public:
 
     status_t disableDevice(int32_t deviceId) override final;
 
+    status_t startRecording(const std::string& path) override final;
+
+    void stopRecording() override final;
+
     ~EventHub() override;
 
 private:
@@ -579,6 +591,17 @@ private:
 
         int32_t controllerNumber;
 
+        // Events read from the device that getEvents has not returned yet, from
+        // pendingEvents[pendingEventIndex] to pendingEvents[pendingEventCount].  They are all
+        // returned before the device is read again, so that the events of each read reach the
+        // reader as one contiguous run.
+        std::vector<struct input_event> pendingEvents;
+        size_t pendingEventIndex;
+        size_t pendingEventCount;
+        // The id the pending events are reported with, and when they were read.
+        int32_t pendingEventDeviceId;
+        nsecs_t pendingEventReadTime;
+
         Device(int fd, int32_t id, const std::string& path,
                const InputDeviceIdentifier& identifier);
         ~Device();
@@ -631,6 +654,18 @@ private:
     void closeDeviceLocked(Device& device) REQUIRES(mLock);
     void closeAllDevicesLocked() REQUIRES(mLock);
 
+    /**
+     * Read the available events of a device into its pending events.
+     * Return false if the device was removed, in which case it must be closed.
+     */
+    bool readDeviceEventsLocked(Device& device) REQUIRES(mLock);
+    /**
+     * Convert as many pending events of a device as fit into the buffer.
+     * Return the number of events written.
+     */
+    size_t takePendingEventsLocked(Device& device, RawEvent* buffer, size_t capacity)
+            REQUIRES(mLock);
+
     status_t registerFdForEpoll(int fd);
     status_t unregisterFdFromEpoll(int fd);
     status_t registerDeviceForEpollLocked(Device& device) REQUIRES(mLock);
@@ -713,6 +748,9 @@ private:
     size_t mPendingEventCount;
     size_t mPendingEventIndex;
     bool mPendingINotify;
+
+    // The ids of the devices that have pending events, in the order they were read.
+    std::vector<int32_t> mDevicesWithPendingEvents;
 };
 
 }; // namespace android
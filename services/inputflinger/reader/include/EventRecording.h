@@ -0,0 +1,292 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <android-base/result.h>
+#include <android-base/thread_annotations.h>
+#include <android-base/unique_fd.h>
+
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "EventHub.h"
+
+namespace android {
+
+/*
+ * What the reader queries about an EventHub device, as recorded when the device was added.
+ */
+struct RecordedDevice {
+    struct KeyMapping {
+        int32_t keyCode;
+        uint32_t flags;
+    };
+
+    int32_t id;
+    InputDeviceIdentifier identifier;
+    Flags<InputDeviceClass> classes;
+    int32_t controllerNumber;
+    std::map<std::string, std::string> configuration;
+    std::map<int32_t, RawAbsoluteAxisInfo> absoluteAxes;
+    std::set<int32_t> relativeAxes;
+    std::set<int32_t> inputProperties;
+    std::set<int32_t> mscEvents;
+    // The scan codes the device has, and the key each one maps to without meta state.
+    std::map<int32_t, KeyMapping> keys;
+    std::vector<VirtualKeyDefinition> virtualKeys;
+
+    // Queries the description of a device from an EventHub.
+    static RecordedDevice fromEventHub(const EventHubInterface& eventHub, int32_t deviceId);
+};
+
+/*
+ * The raw events returned by an EventHub and the devices they came from, which can be saved to a
+ * compact binary file and replayed into an InputReader with ReplayEventHub.
+ *
+ * The events are kept in the batches that getEvents returned them in, so that a replay goes
+ * through the same reader loops as the recording.
+ */
+struct EventRecording {
+    std::map<int32_t, RecordedDevice> devices;
+    std::vector<std::vector<RawEvent>> batches;
+
+    static base::Result<EventRecording> load(const std::string& path);
+    base::Result<void> save(const std::string& path) const;
+};
+
+/*
+ * Appends the devices and events of an EventHub to a recording file as they are reported, in the
+ * format that EventRecording::load reads.
+ */
+class EventRecordingWriter {
+public:
+    // Creates the file at 'path', or truncates it, and writes its header.
+    static base::Result<std::unique_ptr<EventRecordingWriter>> open(const std::string& path);
+
+    bool writeDevice(const RecordedDevice& device);
+    bool writeBatch(const RawEvent* events, size_t count);
+
+    // The number of bytes written to the file so far.
+    size_t getSize() const { return mSize; }
+
+private:
+    base::unique_fd mFd;
+    // Holds each record while it is serialized, to write it with a single call.
+    std::vector<uint8_t> mBuffer;
+    size_t mSize = 0;
+
+    explicit EventRecordingWriter(base::unique_fd fd);
+
+    bool flush();
+};
+
+/*
+ * An EventHub that passes the devices and events of another one through, and records those of the
+ * touch devices between startRecording and stopRecording.
+ *
+ * A recording starts with the touch devices that are present, and stops by itself once the file
+ * reaches 64MB or it has lasted 10 minutes.  Other devices, such as keyboards, are not recorded.
+ */
+class RecordingEventHub : public EventHubInterface {
+public:
+    explicit RecordingEventHub(std::unique_ptr<EventHubInterface> eventHub);
+    ~RecordingEventHub() override;
+
+    size_t getEvents(int timeoutMillis, RawEvent* buffer, size_t bufferSize) override;
+
+    Flags<InputDeviceClass> getDeviceClasses(int32_t deviceId) const override;
+    InputDeviceIdentifier getDeviceIdentifier(int32_t deviceId) const override;
+    int32_t getDeviceControllerNumber(int32_t deviceId) const override;
+    void getConfiguration(int32_t deviceId, PropertyMap* outConfiguration) const override;
+    status_t getAbsoluteAxisInfo(int32_t deviceId, int axis,
+                                 RawAbsoluteAxisInfo* outAxisInfo) const override;
+    bool hasRelativeAxis(int32_t deviceId, int axis) const override;
+    bool hasInputProperty(int32_t deviceId, int property) const override;
+    bool hasMscEvent(int32_t deviceId, int mscEvent) const override;
+    status_t mapKey(int32_t deviceId, int32_t scanCode, int32_t usageCode, int32_t metaState,
+                    int32_t* outKeycode, int32_t* outMetaState, uint32_t* outFlags) const override;
+    status_t mapAxis(int32_t deviceId, int32_t scanCode, AxisInfo* outAxisInfo) const override;
+    void setExcludedDevices(const std::vector<std::string>& devices) override;
+    std::vector<TouchVideoFrame> getVideoFrames(int32_t deviceId) override;
+    base::Result<std::pair<InputDeviceSensorType, int32_t>> mapSensor(int32_t deviceId,
+                                                                      int32_t absCode) override;
+    const std::vector<int32_t> getRawBatteryIds(int32_t deviceId) override;
+    std::optional<RawBatteryInfo> getRawBatteryInfo(int32_t deviceId, int32_t batteryId) override;
+    const std::vector<int32_t> getRawLightIds(int32_t deviceId) override;
+    std::optional<RawLightInfo> getRawLightInfo(int32_t deviceId, int32_t lightId) override;
+    std::optional<int32_t> getLightBrightness(int32_t deviceId, int32_t lightId) override;
+    void setLightBrightness(int32_t deviceId, int32_t lightId, int32_t brightness) override;
+    std::optional<std::unordered_map<LightColor, int32_t>> getLightIntensities(
+            int32_t deviceId, int32_t lightId) override;
+    void setLightIntensities(int32_t deviceId, int32_t lightId,
+                             std::unordered_map<LightColor, int32_t> intensities) override;
+    int32_t getScanCodeState(int32_t deviceId, int32_t scanCode) const override;
+    int32_t getKeyCodeState(int32_t deviceId, int32_t keyCode) const override;
+    int32_t getSwitchState(int32_t deviceId, int32_t sw) const override;
+    status_t getAbsoluteAxisValue(int32_t deviceId, int32_t axis,
+                                  int32_t* outValue) const override;
+    bool markSupportedKeyCodes(int32_t deviceId, size_t numCodes, const int32_t* keyCodes,
+                               uint8_t* outFlags) const override;
+    bool hasScanCode(int32_t deviceId, int32_t scanCode) const override;
+    bool hasLed(int32_t deviceId, int32_t led) const override;
+    void setLedState(int32_t deviceId, int32_t led, bool on) override;
+    void getVirtualKeyDefinitions(int32_t deviceId,
+                                  std::vector<VirtualKeyDefinition>& outVirtualKeys) const override;
+    const std::shared_ptr<KeyCharacterMap> getKeyCharacterMap(int32_t deviceId) const override;
+    bool setKeyboardLayoutOverlay(int32_t deviceId, std::shared_ptr<KeyCharacterMap> map) override;
+    void vibrate(int32_t deviceId, const VibrationElement& effect) override;
+    void cancelVibrate(int32_t deviceId) override;
+    std::vector<int32_t> getVibratorIds(int32_t deviceId) override;
+    std::optional<int32_t> getBatteryCapacity(int32_t deviceId, int32_t batteryId) const override;
+    std::optional<int32_t> getBatteryStatus(int32_t deviceId, int32_t batteryId) const override;
+    void requestReopenDevices() override;
+    void wake() override;
+    void dump(std::string& dump) override;
+    void monitor() override;
+    bool isDeviceEnabled(int32_t deviceId) override;
+    status_t enableDevice(int32_t deviceId) override;
+    status_t disableDevice(int32_t deviceId) override;
+    status_t startRecording(const std::string& path) override;
+    void stopRecording() override;
+
+private:
+    const std::unique_ptr<EventHubInterface> mEventHub;
+
+    std::mutex mLock;
+    // The touch devices that are present, which are the only ones that are recorded.
+    std::set<int32_t> mTouchDevices GUARDED_BY(mLock);
+    // Null unless recording.
+    std::unique_ptr<EventRecordingWriter> mWriter GUARDED_BY(mLock);
+    // When the recording stops by itself.
+    nsecs_t mRecordingDeadline GUARDED_BY(mLock);
+    // The events of the last batch that are recorded, kept to avoid reallocating them.
+    std::vector<RawEvent> mRecordedEvents GUARDED_BY(mLock);
+};
+
+/*
+ * An EventHub that replays a recording, with the times of the events moved to when they are
+ * replayed.
+ *
+ * At RECORDED speed, each batch is returned once as much time has passed since the start of the
+ * replay as had passed since the start of the recording.  At MAX speed, each call returns the
+ * next batch right away, timestamped with the time of the call.
+ *
+ * Only the queries the reader makes about the devices are answered from the recording.  Their
+ * state is not recorded, so they report no keys down, and lights, batteries, sensors and
+ * vibrators are not supported.
+ */
+class ReplayEventHub : public EventHubInterface {
+public:
+    enum class Speed {
+        RECORDED,
+        MAX,
+    };
+
+    ReplayEventHub(EventRecording recording, Speed speed);
+    ~ReplayEventHub() override;
+
+    // Returns true once all the batches have been returned.
+    bool isFinished() const;
+
+    // Replays the input events again from the first batch that is not about devices, without
+    // adding the devices again, so that a benchmark can replay them as many times as it needs.
+    void rewindEvents();
+
+    size_t getEvents(int timeoutMillis, RawEvent* buffer, size_t bufferSize) override;
+
+    Flags<InputDeviceClass> getDeviceClasses(int32_t deviceId) const override;
+    InputDeviceIdentifier getDeviceIdentifier(int32_t deviceId) const override;
+    int32_t getDeviceControllerNumber(int32_t deviceId) const override;
+    void getConfiguration(int32_t deviceId, PropertyMap* outConfiguration) const override;
+    status_t getAbsoluteAxisInfo(int32_t deviceId, int axis,
+                                 RawAbsoluteAxisInfo* outAxisInfo) const override;
+    bool hasRelativeAxis(int32_t deviceId, int axis) const override;
+    bool hasInputProperty(int32_t deviceId, int property) const override;
+    bool hasMscEvent(int32_t deviceId, int mscEvent) const override;
+    status_t mapKey(int32_t deviceId, int32_t scanCode, int32_t usageCode, int32_t metaState,
+                    int32_t* outKeycode, int32_t* outMetaState, uint32_t* outFlags) const override;
+    status_t mapAxis(int32_t deviceId, int32_t scanCode, AxisInfo* outAxisInfo) const override;
+    void setExcludedDevices(const std::vector<std::string>& devices) override;
+    std::vector<TouchVideoFrame> getVideoFrames(int32_t deviceId) override;
+    base::Result<std::pair<InputDeviceSensorType, int32_t>> mapSensor(int32_t deviceId,
+                                                                      int32_t absCode) override;
+    const std::vector<int32_t> getRawBatteryIds(int32_t deviceId) override;
+    std::optional<RawBatteryInfo> getRawBatteryInfo(int32_t deviceId, int32_t batteryId) override;
+    const std::vector<int32_t> getRawLightIds(int32_t deviceId) override;
+    std::optional<RawLightInfo> getRawLightInfo(int32_t deviceId, int32_t lightId) override;
+    std::optional<int32_t> getLightBrightness(int32_t deviceId, int32_t lightId) override;
+    void setLightBrightness(int32_t deviceId, int32_t lightId, int32_t brightness) override;
+    std::optional<std::unordered_map<LightColor, int32_t>> getLightIntensities(
+            int32_t deviceId, int32_t lightId) override;
+    void setLightIntensities(int32_t deviceId, int32_t lightId,
+                             std::unordered_map<LightColor, int32_t> intensities) override;
+    int32_t getScanCodeState(int32_t deviceId, int32_t scanCode) const override;
+    int32_t getKeyCodeState(int32_t deviceId, int32_t keyCode) const override;
+    int32_t getSwitchState(int32_t deviceId, int32_t sw) const override;
+    status_t getAbsoluteAxisValue(int32_t deviceId, int32_t axis,
+                                  int32_t* outValue) const override;
+    bool markSupportedKeyCodes(int32_t deviceId, size_t numCodes, const int32_t* keyCodes,
+                               uint8_t* outFlags) const override;
+    bool hasScanCode(int32_t deviceId, int32_t scanCode) const override;
+    bool hasLed(int32_t deviceId, int32_t led) const override;
+    void setLedState(int32_t deviceId, int32_t led, bool on) override;
+    void getVirtualKeyDefinitions(int32_t deviceId,
+                                  std::vector<VirtualKeyDefinition>& outVirtualKeys) const override;
+    const std::shared_ptr<KeyCharacterMap> getKeyCharacterMap(int32_t deviceId) const override;
+    bool setKeyboardLayoutOverlay(int32_t deviceId, std::shared_ptr<KeyCharacterMap> map) override;
+    void vibrate(int32_t deviceId, const VibrationElement& effect) override;
+    void cancelVibrate(int32_t deviceId) override;
+    std::vector<int32_t> getVibratorIds(int32_t deviceId) override;
+    std::optional<int32_t> getBatteryCapacity(int32_t deviceId, int32_t batteryId) const override;
+    std::optional<int32_t> getBatteryStatus(int32_t deviceId, int32_t batteryId) const override;
+    void requestReopenDevices() override;
+    void wake() override;
+    void dump(std::string& dump) override;
+    void monitor() override;
+    bool isDeviceEnabled(int32_t deviceId) override;
+    status_t enableDevice(int32_t deviceId) override;
+    status_t disableDevice(int32_t deviceId) override;
+    status_t startRecording(const std::string& path) override;
+    void stopRecording() override;
+
+private:
+    const EventRecording mRecording;
+    const Speed mSpeed;
+    // The index of the first batch that has input events.
+    const size_t mFirstEventBatch;
+
+    mutable std::mutex mLock;
+    std::condition_variable mWakeCondition;
+    bool mAwoken GUARDED_BY(mLock);
+    std::set<int32_t> mDisabledDevices GUARDED_BY(mLock);
+
+    // Only used from the reader thread, in getEvents.
+    size_t mNextBatch;
+    size_t mNextEvent;
+    // The time of the start of the replay, and of the recording.
+    nsecs_t mReplayStartTime;
+    nsecs_t mRecordingStartTime;
+
+    const RecordedDevice* getDevice(int32_t deviceId) const;
+};
+
+} // namespace android
@@ -111,6 +111,10 @@ public:
 
     std::optional<int32_t> getLightPlayerId(int32_t deviceId, int32_t lightId) override;
 
+    status_t startEventRecording(const std::string& path) override;
+
+    void stopEventRecording() override;
+
 protected:
     // These members are protected so they can be instrumented by test cases.
     virtual std::shared_ptr<InputDevice> createDeviceLocked(int32_t deviceId,
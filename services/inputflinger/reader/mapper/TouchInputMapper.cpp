@@ -177,7 +177,8 @@ TouchInputMapper::TouchInputMapper(InputDeviceContext& deviceContext)
         mPhysicalHeight(-1),
         mPhysicalLeft(0),
         mPhysicalTop(0),
-        mSurfaceOrientation(DISPLAY_ORIENTATION_0) {}
+        mSurfaceOrientation(DISPLAY_ORIENTATION_0),
+        mSizeSource(SizeSource::NONE) {}
 
 TouchInputMapper::~TouchInputMapper() {}
 
@@ -394,6 +395,11 @@ void TouchInputMapper::configure(nsecs_t when, const InputReaderConfiguration* c
         configureSurface(when, &resetNeeded);
     }
 
+    if (mDeviceMode != DeviceMode::DISABLED) {
+        // Either the affine calibration or the surface may have changed.
+        updateRawToSurfaceTransform();
+    }
+
     if (changes && resetNeeded) {
         // Send reset, unless this is the first time the device has been configured,
         // in which case the reader will call reset itself after all mappers are ready.
@@ -1228,6 +1234,15 @@ void TouchInputMapper::resolveCalibration() {
     } else {
         mCalibration.sizeCalibration = Calibration::SizeCalibration::NONE;
     }
+    if (mCalibration.sizeCalibration == Calibration::SizeCalibration::NONE) {
+        mSizeSource = SizeSource::NONE;
+    } else if (mRawPointerAxes.touchMajor.valid && mRawPointerAxes.toolMajor.valid) {
+        mSizeSource = SizeSource::TOUCH_AND_TOOL;
+    } else if (mRawPointerAxes.touchMajor.valid) {
+        mSizeSource = SizeSource::TOUCH;
+    } else {
+        mSizeSource = SizeSource::TOOL;
+    }
 
     // Pressure
     if (mRawPointerAxes.pressure.valid) {
@@ -2091,81 +2106,57 @@ void TouchInputMapper::cookPointerData() {
         mCurrentCookedState.buttonState = mCurrentRawState.buttonState;
     }
 
-    // Walk through the the active pointers and map device coordinates onto
-    // surface coordinates and adjust for display orientation.
+    // Map the device coordinates of all the pointers onto surface coordinates, adjusted for the
+    // display orientation, with the transformation combined when the device was configured.
+    const RawPointerData::Pointer* rawPointers = mCurrentRawState.rawPointerData.pointers;
+    const RawToSurfaceTransform& transform = mRawToSurfaceTransform;
+    float xTransformedValues[MAX_POINTERS];
+    float yTransformedValues[MAX_POINTERS];
     for (uint32_t i = 0; i < currentPointerCount; i++) {
-        const RawPointerData::Pointer& in = mCurrentRawState.rawPointerData.pointers[i];
-
-        // Size
-        float touchMajor, touchMinor, toolMajor, toolMinor, size;
-        switch (mCalibration.sizeCalibration) {
-            case Calibration::SizeCalibration::GEOMETRIC:
-            case Calibration::SizeCalibration::DIAMETER:
-            case Calibration::SizeCalibration::BOX:
-            case Calibration::SizeCalibration::AREA:
-                if (mRawPointerAxes.touchMajor.valid && mRawPointerAxes.toolMajor.valid) {
-                    touchMajor = in.touchMajor;
-                    touchMinor = mRawPointerAxes.touchMinor.valid ? in.touchMinor : in.touchMajor;
-                    toolMajor = in.toolMajor;
-                    toolMinor = mRawPointerAxes.toolMinor.valid ? in.toolMinor : in.toolMajor;
-                    size = mRawPointerAxes.touchMinor.valid ? avg(in.touchMajor, in.touchMinor)
-                                                            : in.touchMajor;
-                } else if (mRawPointerAxes.touchMajor.valid) {
-                    toolMajor = touchMajor = in.touchMajor;
-                    toolMinor = touchMinor =
-                            mRawPointerAxes.touchMinor.valid ? in.touchMinor : in.touchMajor;
-                    size = mRawPointerAxes.touchMinor.valid ? avg(in.touchMajor, in.touchMinor)
-                                                            : in.touchMajor;
-                } else if (mRawPointerAxes.toolMajor.valid) {
-                    touchMajor = toolMajor = in.toolMajor;
-                    touchMinor = toolMinor =
-                            mRawPointerAxes.toolMinor.valid ? in.toolMinor : in.toolMajor;
-                    size = mRawPointerAxes.toolMinor.valid ? avg(in.toolMajor, in.toolMinor)
-                                                           : in.toolMajor;
-                } else {
-                    ALOG_ASSERT(false,
-                                "No touch or tool axes.  "
-                                "Size calibration should have been resolved to NONE.");
-                    touchMajor = 0;
-                    touchMinor = 0;
-                    toolMajor = 0;
-                    toolMinor = 0;
-                    size = 0;
-                }
+        const double x = rawPointers[i].x;
+        const double y = rawPointers[i].y;
+        xTransformedValues[i] =
+                float(x * transform.x_scale + y * transform.x_ymix + transform.x_offset);
+        yTransformedValues[i] =
+                float(x * transform.y_xmix + y * transform.y_scale + transform.y_offset);
+    }
 
-                if (mCalibration.haveSizeIsSummed && mCalibration.sizeIsSummed) {
-                    uint32_t touchingCount = mCurrentRawState.rawPointerData.touchingIdBits.count();
-                    if (touchingCount > 1) {
-                        touchMajor /= touchingCount;
-                        touchMinor /= touchingCount;
-                        toolMajor /= touchingCount;
-                        toolMinor /= touchingCount;
-                        size /= touchingCount;
-                    }
-                }
+    // When the sizes are summed, each touching pointer gets its share.
+    uint32_t sizeDivisor = 1;
+    if (mCalibration.haveSizeIsSummed && mCalibration.sizeIsSummed) {
+        sizeDivisor = std::max(mCurrentRawState.rawPointerData.touchingIdBits.count(), 1U);
+    }
 
-                if (mCalibration.sizeCalibration == Calibration::SizeCalibration::GEOMETRIC) {
-                    touchMajor *= mGeometricScale;
-                    touchMinor *= mGeometricScale;
-                    toolMajor *= mGeometricScale;
-                    toolMinor *= mGeometricScale;
-                } else if (mCalibration.sizeCalibration == Calibration::SizeCalibration::AREA) {
-                    touchMajor = touchMajor > 0 ? sqrtf(touchMajor) : 0;
-                    touchMinor = touchMajor;
-                    toolMajor = toolMajor > 0 ? sqrtf(toolMajor) : 0;
-                    toolMinor = toolMajor;
-                } else if (mCalibration.sizeCalibration == Calibration::SizeCalibration::DIAMETER) {
-                    touchMinor = touchMajor;
-                    toolMinor = toolMajor;
-                }
+    // Walk through the the active pointers and cook the rest of their axes.
+    for (uint32_t i = 0; i < currentPointerCount; i++) {
+        const RawPointerData::Pointer& in = rawPointers[i];
 
-                mCalibration.applySizeScaleAndBias(&touchMajor);
-                mCalibration.applySizeScaleAndBias(&touchMinor);
-                mCalibration.applySizeScaleAndBias(&toolMajor);
-                mCalibration.applySizeScaleAndBias(&toolMinor);
-                size *= mSizeScale;
+        // Size
+        float touchMajor, touchMinor, toolMajor, toolMinor, size;
+        switch (mSizeSource) {
+            case SizeSource::TOUCH_AND_TOOL:
+                touchMajor = in.touchMajor;
+                touchMinor = mRawPointerAxes.touchMinor.valid ? in.touchMinor : in.touchMajor;
+                toolMajor = in.toolMajor;
+                toolMinor = mRawPointerAxes.toolMinor.valid ? in.toolMinor : in.toolMajor;
+                size = mRawPointerAxes.touchMinor.valid ? avg(in.touchMajor, in.touchMinor)
+                                                        : in.touchMajor;
                 break;
-            default:
+            case SizeSource::TOUCH:
+                toolMajor = touchMajor = in.touchMajor;
+                toolMinor = touchMinor =
+                        mRawPointerAxes.touchMinor.valid ? in.touchMinor : in.touchMajor;
+                size = mRawPointerAxes.touchMinor.valid ? avg(in.touchMajor, in.touchMinor)
+                                                        : in.touchMajor;
+                break;
+            case SizeSource::TOOL:
+                touchMajor = toolMajor = in.toolMajor;
+                touchMinor = toolMinor =
+                        mRawPointerAxes.toolMinor.valid ? in.toolMinor : in.toolMajor;
+                size = mRawPointerAxes.toolMinor.valid ? avg(in.toolMajor, in.toolMinor)
+                                                       : in.toolMajor;
+                break;
+            case SizeSource::NONE:
                 touchMajor = 0;
                 touchMinor = 0;
                 toolMajor = 0;
@@ -2174,6 +2165,37 @@ void TouchInputMapper::cookPointerData() {
                 break;
         }
 
+        if (mSizeSource != SizeSource::NONE) {
+            if (sizeDivisor > 1) {
+                touchMajor /= sizeDivisor;
+                touchMinor /= sizeDivisor;
+                toolMajor /= sizeDivisor;
+                toolMinor /= sizeDivisor;
+                size /= sizeDivisor;
+            }
+
+            if (mCalibration.sizeCalibration == Calibration::SizeCalibration::GEOMETRIC) {
+                touchMajor *= mGeometricScale;
+                touchMinor *= mGeometricScale;
+                toolMajor *= mGeometricScale;
+                toolMinor *= mGeometricScale;
+            } else if (mCalibration.sizeCalibration == Calibration::SizeCalibration::AREA) {
+                touchMajor = touchMajor > 0 ? sqrtf(touchMajor) : 0;
+                touchMinor = touchMajor;
+                toolMajor = toolMajor > 0 ? sqrtf(toolMajor) : 0;
+                toolMinor = toolMajor;
+            } else if (mCalibration.sizeCalibration == Calibration::SizeCalibration::DIAMETER) {
+                touchMinor = touchMajor;
+                toolMinor = toolMajor;
+            }
+
+            mCalibration.applySizeScaleAndBias(&touchMajor);
+            mCalibration.applySizeScaleAndBias(&touchMinor);
+            mCalibration.applySizeScaleAndBias(&toolMajor);
+            mCalibration.applySizeScaleAndBias(&toolMinor);
+            size *= mSizeScale;
+        }
+
         // Pressure
         float pressure;
         switch (mCalibration.pressureCalibration) {
@@ -2246,11 +2268,10 @@ void TouchInputMapper::cookPointerData() {
                 break;
         }
 
-        // Adjust X,Y coords for device calibration
+        // The X,Y coords, adjusted for device calibration above.
         // TODO: Adjust coverage coords?
-        float xTransformed = in.x, yTransformed = in.y;
-        mAffineTransform.applyTo(xTransformed, yTransformed);
-        rotateAndScale(xTransformed, yTransformed);
+        const float xTransformed = xTransformedValues[i];
+        const float yTransformed = yTransformedValues[i];
 
         // Adjust X, Y, and coverage coords for surface orientation.
         float left, top, right, bottom;
@@ -3696,40 +3717,62 @@ void TouchInputMapper::cancelTouch(nsecs_t when, nsecs_t readTime) {
     abortTouches(when, readTime, 0 /* policyFlags*/);
 }
 
-// Transform raw coordinate to surface coordinate
-void TouchInputMapper::rotateAndScale(float& x, float& y) {
-    // Scale to surface coordinate.
-    const float xScaled = float(x - mRawPointerAxes.x.minValue) * mXScale;
-    const float yScaled = float(y - mRawPointerAxes.y.minValue) * mYScale;
-
-    const float xScaledMax = float(mRawPointerAxes.x.maxValue - x) * mXScale;
-    const float yScaledMax = float(mRawPointerAxes.y.maxValue - y) * mYScale;
-
-    // Rotate to surface coordinate.
+// Combine the affine calibration with the transformation from calibrated raw coordinates to
+// surface coordinates, so that pointers are located in one step.
+void TouchInputMapper::updateRawToSurfaceTransform() {
+    // Scale to surface coordinates, then rotate, as x' = p * x + q * y + r and
+    // y' = s * x + t * y + u.
     // 0 - no swap and reverse.
     // 90 - swap x/y and reverse y.
     // 180 - reverse x, y.
     // 270 - swap x/y and reverse x.
+    const double xScale = mXScale;
+    const double yScale = mYScale;
+    const double xMin = mRawPointerAxes.x.minValue;
+    const double yMin = mRawPointerAxes.y.minValue;
+    const double xMax = mRawPointerAxes.x.maxValue;
+    const double yMax = mRawPointerAxes.y.maxValue;
+    double p = 0, q = 0, r = 0, s = 0, t = 0, u = 0;
     switch (mSurfaceOrientation) {
-        case DISPLAY_ORIENTATION_0:
-            x = xScaled + mXTranslate;
-            y = yScaled + mYTranslate;
-            break;
         case DISPLAY_ORIENTATION_90:
-            y = xScaledMax - (mRawSurfaceWidth - mSurfaceRight);
-            x = yScaled + mYTranslate;
+            q = yScale;
+            r = -yMin * yScale + mYTranslate;
+            s = -xScale;
+            u = xMax * xScale - (mRawSurfaceWidth - mSurfaceRight);
             break;
         case DISPLAY_ORIENTATION_180:
-            x = xScaledMax - (mRawSurfaceWidth - mSurfaceRight);
-            y = yScaledMax - (mRawSurfaceHeight - mSurfaceBottom);
+            p = -xScale;
+            r = xMax * xScale - (mRawSurfaceWidth - mSurfaceRight);
+            t = -yScale;
+            u = yMax * yScale - (mRawSurfaceHeight - mSurfaceBottom);
             break;
         case DISPLAY_ORIENTATION_270:
-            y = xScaled + mXTranslate;
-            x = yScaledMax - (mRawSurfaceHeight - mSurfaceBottom);
+            q = -yScale;
+            r = yMax * yScale - (mRawSurfaceHeight - mSurfaceBottom);
+            s = xScale;
+            u = -xMin * xScale + mXTranslate;
             break;
+        case DISPLAY_ORIENTATION_0:
         default:
-            assert(false);
+            p = xScale;
+            r = -xMin * xScale + mXTranslate;
+            t = yScale;
+            u = -yMin * yScale + mYTranslate;
+            break;
     }
+
+    const double ax = mAffineTransform.x_scale;
+    const double axy = mAffineTransform.x_ymix;
+    const double ax0 = mAffineTransform.x_offset;
+    const double ayx = mAffineTransform.y_xmix;
+    const double ay = mAffineTransform.y_scale;
+    const double ay0 = mAffineTransform.y_offset;
+    mRawToSurfaceTransform.x_scale = p * ax + q * ayx;
+    mRawToSurfaceTransform.x_ymix = p * axy + q * ay;
+    mRawToSurfaceTransform.x_offset = p * ax0 + q * ay0 + r;
+    mRawToSurfaceTransform.y_xmix = s * ax + t * ayx;
+    mRawToSurfaceTransform.y_scale = s * axy + t * ay;
+    mRawToSurfaceTransform.y_offset = s * ax0 + t * ay0 + u;
 }
 
 bool TouchInputMapper::isPointInsideSurface(int32_t x, int32_t y) {
@@ -446,8 +446,31 @@ private:
 
     float mGeometricScale;
 
+    // The transformation from raw coordinates to surface coordinates: the affine calibration
+    // followed by the scaling, orientation and translation to the surface, combined when the
+    // device is configured so that a pointer is located with a single affine transformation.
+    // It is combined and applied in double precision, and the result rounded to float once.
+    struct RawToSurfaceTransform {
+        double x_scale = 1;
+        double x_ymix = 0;
+        double x_offset = 0;
+        double y_xmix = 0;
+        double y_scale = 1;
+        double y_offset = 0;
+    };
+    RawToSurfaceTransform mRawToSurfaceTransform;
+
     float mPressureScale;
 
+    // The raw axes that the touch and tool sizes are cooked from, resolved with the calibration.
+    enum class SizeSource {
+        NONE,
+        TOUCH_AND_TOOL,
+        TOUCH,
+        TOOL,
+    };
+    SizeSource mSizeSource;
+
     float mSizeScale;
 
     float mOrientationScale;
@@ -796,7 +819,7 @@ private:
     static void assignPointerIds(const RawState& last, RawState& current);
 
     const char* modeToString(DeviceMode deviceMode);
-    void rotateAndScale(float& x, float& y);
+    void updateRawToSurfaceTransform();
 
     // Wrapper methods for interfacing with PointerController. These are used to convert points
     // between the coordinate spaces used by InputReader and PointerController, if they differ.
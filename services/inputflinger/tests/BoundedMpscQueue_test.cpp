@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "../BoundedMpscQueue.h"
+
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+
+namespace android::inputdispatcher {
+
+// --- BoundedMpscQueueTest ---
+
+TEST(BoundedMpscQueueTest, Queue_AddAndRemove) {
+    BoundedMpscQueue<int> queue(4);
+
+    ASSERT_FALSE(queue.pop());
+    ASSERT_TRUE(queue.push(1));
+    ASSERT_EQ(1, queue.pop());
+    ASSERT_FALSE(queue.pop());
+}
+
+/**
+ * The capacity is rounded up to a power of two, and never exceeded.
+ */
+TEST(BoundedMpscQueueTest, Queue_ReachesCapacity) {
+    BoundedMpscQueue<int> queue(3);
+
+    ASSERT_TRUE(queue.push(1));
+    ASSERT_TRUE(queue.push(2));
+    ASSERT_TRUE(queue.push(3));
+    ASSERT_TRUE(queue.push(4));
+    int rejected = 5;
+    ASSERT_FALSE(queue.push(std::move(rejected))) << "Queue should reach capacity at size 4";
+
+    // Space is reused once elements are removed.
+    ASSERT_EQ(1, queue.pop());
+    ASSERT_TRUE(queue.push(5));
+    ASSERT_FALSE(queue.push(6));
+}
+
+TEST(BoundedMpscQueueTest, Queue_isFIFO) {
+    constexpr size_t capacity = 8;
+    BoundedMpscQueue<int> queue(capacity);
+
+    // Go around the ring a few times.
+    for (int round = 0; round < 3; round++) {
+        for (size_t i = 0; i < capacity; i++) {
+            ASSERT_TRUE(queue.push(static_cast<int>(i)));
+        }
+        for (size_t i = 0; i < capacity; i++) {
+            ASSERT_EQ(static_cast<int>(i), queue.pop());
+        }
+    }
+}
+
+TEST(BoundedMpscQueueTest, Queue_KeepsElementWhenFull) {
+    BoundedMpscQueue<std::unique_ptr<int>> queue(2);
+
+    ASSERT_TRUE(queue.push(std::make_unique<int>(1)));
+    ASSERT_TRUE(queue.push(std::make_unique<int>(2)));
+    std::unique_ptr<int> element = std::make_unique<int>(3);
+    ASSERT_FALSE(queue.push(std::move(element)));
+    ASSERT_NE(nullptr, element) << "A rejected element should not be moved from";
+    ASSERT_EQ(3, *element);
+}
+
+// --- BoundedMpscQueueTest - Multiple threads ---
+
+/**
+ * Elements pushed by each thread are popped in the order that thread pushed them, and none
+ * are lost or duplicated.
+ */
+TEST(BoundedMpscQueueTest, Queue_AllowsMultipleProducers) {
+    constexpr int producerCount = 4;
+    constexpr int elementsPerProducer = 10000;
+    BoundedMpscQueue<int> queue(64); // small, so producers often find it full
+
+    std::vector<std::thread> producers;
+    for (int producer = 0; producer < producerCount; producer++) {
+        producers.emplace_back([&queue, producer]() {
+            for (int i = 0; i < elementsPerProducer; i++) {
+                int element = producer * elementsPerProducer + i;
+                while (!queue.push(std::move(element))) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    std::vector<int> nextByProducer(producerCount, 0);
+    for (int received = 0; received < producerCount * elementsPerProducer;) {
+        std::optional<int> element = queue.pop();
+        if (!element) {
+            std::this_thread::yield();
+            continue;
+        }
+        const int producer = *element / elementsPerProducer;
+        ASSERT_EQ(nextByProducer[producer], *element % elementsPerProducer);
+        nextByProducer[producer]++;
+        received++;
+    }
+    ASSERT_FALSE(queue.pop());
+
+    for (std::thread& producer : producers) {
+        producer.join();
+    }
+}
+
+} // namespace android::inputdispatcher
@@ -200,6 +200,42 @@ TEST_F(EventHubTest, InputEvent_TimestampIsMonotonic) {
     }
 }
 
+/**
+ * Events read from a device that do not fit into the caller's buffer must be returned by the
+ * following calls, in order, without waiting for the device to report more events.
+ */
+TEST_F(EventHubTest, GetEvents_WhenBufferIsSmall_ReturnsRemainingEventsInOrder) {
+    constexpr size_t keyPressCount = 5;
+    for (size_t i = 0; i < keyPressCount; i++) {
+        ASSERT_NO_FATAL_FAILURE(mKeyboard->pressAndReleaseHomeKey());
+    }
+    constexpr size_t bufferSize = 3;
+    std::array<RawEvent, bufferSize> eventBuffer;
+    std::vector<RawEvent> events;
+    while (events.size() < keyPressCount * 4) {
+        // The events are all queued by the time the uinput writes return, so only the first call
+        // waits for the device to be ready, and reads them all.
+        const std::chrono::milliseconds timeout = events.empty() ? 2s : 0s;
+        const size_t count =
+                mEventHub->getEvents(timeout.count(), eventBuffer.data(), eventBuffer.size());
+        ASSERT_NE(0U, count) << "Events were lost after " << events.size();
+        events.insert(events.end(), eventBuffer.begin(), eventBuffer.begin() + count);
+    }
+
+    ASSERT_EQ(keyPressCount * 4, events.size());
+    for (size_t i = 0; i < events.size(); i++) {
+        const RawEvent& event = events[i];
+        EXPECT_EQ(mDeviceId, event.deviceId);
+        // Each press and each release is a key event followed by a sync.
+        if (i % 2 == 0) {
+            EXPECT_EQ(EV_KEY, event.type);
+            EXPECT_EQ(i % 4 == 0 ? 1 : 0, event.value) << "Key events are out of order";
+        } else {
+            EXPECT_EQ(EV_SYN, event.type);
+        }
+    }
+}
+
 // --- BitArrayTest ---
 class BitArrayTest : public testing::Test {
 protected:
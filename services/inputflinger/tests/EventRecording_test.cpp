@@ -0,0 +1,326 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "EventRecording.h"
+
+#include <android-base/file.h>
+#include <gtest/gtest.h>
+
+namespace android {
+
+using namespace android::flag_operators;
+
+static constexpr int32_t DEVICE_ID = 3;
+static constexpr int32_t KEYBOARD_ID = 4;
+static constexpr nsecs_t ARBITRARY_TIME = 1234;
+
+// A touchscreen with a home virtual key, added and then touched once.
+static EventRecording createTouchRecording() {
+    EventRecording recording;
+    RecordedDevice& device = recording.devices[DEVICE_ID];
+    device.id = DEVICE_ID;
+    device.identifier.name = "touchscreen";
+    device.identifier.descriptor = "descriptor";
+    device.identifier.bus = BUS_VIRTUAL;
+    device.classes = InputDeviceClass::TOUCH | InputDeviceClass::TOUCH_MT;
+    device.controllerNumber = 0;
+    device.configuration["touch.deviceType"] = "touchScreen";
+    device.absoluteAxes[ABS_MT_POSITION_X] = {true, 0, 1079, 0, 0, 10};
+    device.absoluteAxes[ABS_MT_POSITION_Y] = {true, 0, 2339, 0, 0, 10};
+    device.inputProperties.insert(INPUT_PROP_DIRECT);
+    device.keys[BTN_TOUCH] = {AKEYCODE_UNKNOWN, 0};
+    device.keys[KEY_HOME] = {AKEYCODE_HOME, POLICY_FLAG_VIRTUAL};
+    device.virtualKeys.push_back({KEY_HOME, 540, 2400, 100, 60});
+
+    recording.batches.push_back({{ARBITRARY_TIME, 0, DEVICE_ID, EventHubInterface::DEVICE_ADDED, 0,
+                                  0},
+                                 {ARBITRARY_TIME, 0, 0, EventHubInterface::FINISHED_DEVICE_SCAN,
+                                  0, 0}});
+    recording.batches.push_back({{ARBITRARY_TIME + 1000, ARBITRARY_TIME + 1500, DEVICE_ID, EV_ABS,
+                                  ABS_MT_POSITION_X, 100},
+                                 {ARBITRARY_TIME + 1000, ARBITRARY_TIME + 1500, DEVICE_ID, EV_SYN,
+                                  SYN_REPORT, 0}});
+    recording.batches.push_back({{ARBITRARY_TIME + 2000, ARBITRARY_TIME + 2500, DEVICE_ID, EV_SYN,
+                                  SYN_REPORT, 0}});
+    return recording;
+}
+
+// A touch recording with a keyboard, which is typed on while the touchscreen is touched.
+static EventRecording createTouchAndKeyboardRecording() {
+    EventRecording recording = createTouchRecording();
+    RecordedDevice& device = recording.devices[KEYBOARD_ID];
+    device.id = KEYBOARD_ID;
+    device.identifier.name = "keyboard";
+    device.classes = InputDeviceClass::KEYBOARD | InputDeviceClass::ALPHAKEY;
+    device.controllerNumber = 0;
+    device.keys[KEY_A] = {AKEYCODE_A, 0};
+
+    recording.batches[0].insert(recording.batches[0].begin(),
+                                {ARBITRARY_TIME, 0, KEYBOARD_ID, EventHubInterface::DEVICE_ADDED,
+                                 0, 0});
+    recording.batches[1].push_back(
+            {ARBITRARY_TIME + 1000, ARBITRARY_TIME + 1500, KEYBOARD_ID, EV_KEY, KEY_A, 1});
+    return recording;
+}
+
+// --- EventRecordingTest ---
+
+TEST(EventRecordingTest, SaveAndLoad_PreservesDevicesAndBatches) {
+    const EventRecording recording = createTouchRecording();
+    TemporaryFile file;
+    ASSERT_TRUE(recording.save(file.path).ok());
+
+    base::Result<EventRecording> loaded = EventRecording::load(file.path);
+    ASSERT_TRUE(loaded.ok()) << loaded.error();
+
+    ASSERT_EQ(1U, loaded->devices.size());
+    const RecordedDevice& device = loaded->devices[DEVICE_ID];
+    EXPECT_EQ("touchscreen", device.identifier.name);
+    EXPECT_EQ("descriptor", device.identifier.descriptor);
+    EXPECT_EQ(BUS_VIRTUAL, device.identifier.bus);
+    EXPECT_EQ(InputDeviceClass::TOUCH | InputDeviceClass::TOUCH_MT, device.classes);
+    EXPECT_EQ("touchScreen", device.configuration.at("touch.deviceType"));
+    ASSERT_EQ(2U, device.absoluteAxes.size());
+    EXPECT_EQ(2339, device.absoluteAxes.at(ABS_MT_POSITION_Y).maxValue);
+    EXPECT_EQ(10, device.absoluteAxes.at(ABS_MT_POSITION_Y).resolution);
+    EXPECT_EQ(std::set<int32_t>{INPUT_PROP_DIRECT}, device.inputProperties);
+    EXPECT_EQ(AKEYCODE_HOME, device.keys.at(KEY_HOME).keyCode);
+    ASSERT_EQ(1U, device.virtualKeys.size());
+    EXPECT_EQ(2400, device.virtualKeys[0].centerY);
+
+    ASSERT_EQ(recording.batches.size(), loaded->batches.size());
+    for (size_t i = 0; i < recording.batches.size(); i++) {
+        ASSERT_EQ(recording.batches[i].size(), loaded->batches[i].size());
+        for (size_t j = 0; j < recording.batches[i].size(); j++) {
+            const RawEvent& expected = recording.batches[i][j];
+            const RawEvent& actual = loaded->batches[i][j];
+            EXPECT_EQ(expected.when, actual.when);
+            EXPECT_EQ(expected.deviceId, actual.deviceId);
+            EXPECT_EQ(expected.type, actual.type);
+            EXPECT_EQ(expected.code, actual.code);
+            EXPECT_EQ(expected.value, actual.value);
+            if (expected.type < EventHubInterface::FIRST_SYNTHETIC_EVENT) {
+                EXPECT_EQ(expected.readTime, actual.readTime);
+            }
+        }
+    }
+}
+
+TEST(EventRecordingTest, Load_RejectsTruncatedFile) {
+    TemporaryFile file;
+    ASSERT_TRUE(createTouchRecording().save(file.path).ok());
+
+    std::string contents;
+    ASSERT_TRUE(base::ReadFileToString(file.path, &contents));
+    ASSERT_TRUE(base::WriteStringToFile(contents.substr(0, contents.size() - 1), file.path));
+    EXPECT_FALSE(EventRecording::load(file.path).ok());
+}
+
+TEST(EventRecordingTest, SaveAndLoad_PreservesLongReadDelays) {
+    EventRecording recording;
+    const nsecs_t readTime = ARBITRARY_TIME + 5'000'000'000;
+    recording.batches.push_back({{ARBITRARY_TIME, readTime, DEVICE_ID, EV_SYN, SYN_REPORT, 0}});
+    TemporaryFile file;
+    ASSERT_TRUE(recording.save(file.path).ok());
+
+    base::Result<EventRecording> loaded = EventRecording::load(file.path);
+    ASSERT_TRUE(loaded.ok()) << loaded.error();
+    ASSERT_EQ(1U, loaded->batches.size());
+    ASSERT_EQ(1U, loaded->batches[0].size());
+    EXPECT_EQ(readTime, loaded->batches[0][0].readTime);
+}
+
+TEST(EventRecordingTest, Load_RejectsBatchWithMoreEventsThanTheFileHolds) {
+    TemporaryFile file;
+    ASSERT_TRUE(EventRecording().save(file.path).ok());
+
+    // A batch record, with a 4 byte payload holding the largest event count.
+    std::string contents;
+    ASSERT_TRUE(base::ReadFileToString(file.path, &contents));
+    contents += std::string("\x02\x04\x00\x00\x00\xff\xff\xff\xff", 9);
+    ASSERT_TRUE(base::WriteStringToFile(contents, file.path));
+    EXPECT_FALSE(EventRecording::load(file.path).ok());
+}
+
+// --- RecordingEventHubTest ---
+
+TEST(RecordingEventHubTest, StartRecording_RecordsOnlyTheTouchDevicesFromThenOn) {
+    RecordingEventHub eventHub(
+            std::make_unique<ReplayEventHub>(createTouchAndKeyboardRecording(),
+                                             ReplayEventHub::Speed::MAX));
+    RawEvent buffer[16];
+    ASSERT_EQ(3U, eventHub.getEvents(0, buffer, 16));
+
+    TemporaryFile file;
+    ASSERT_EQ(OK, eventHub.startRecording(file.path));
+    ASSERT_EQ(3U, eventHub.getEvents(0, buffer, 16));
+    ASSERT_EQ(1U, eventHub.getEvents(0, buffer, 16));
+    eventHub.stopRecording();
+
+    base::Result<EventRecording> loaded = EventRecording::load(file.path);
+    ASSERT_TRUE(loaded.ok()) << loaded.error();
+    ASSERT_EQ(1U, loaded->devices.size());
+    EXPECT_EQ("touchscreen", loaded->devices[DEVICE_ID].identifier.name);
+
+    // The touchscreen is added when the recording starts, since it was already present.
+    ASSERT_EQ(3U, loaded->batches.size());
+    ASSERT_EQ(2U, loaded->batches[0].size());
+    EXPECT_EQ(EventHubInterface::DEVICE_ADDED, loaded->batches[0][0].type);
+    EXPECT_EQ(DEVICE_ID, loaded->batches[0][0].deviceId);
+    EXPECT_EQ(EventHubInterface::FINISHED_DEVICE_SCAN, loaded->batches[0][1].type);
+
+    ASSERT_EQ(2U, loaded->batches[1].size()) << "The key should not be recorded";
+    EXPECT_EQ(EV_ABS, loaded->batches[1][0].type);
+    EXPECT_EQ(EV_SYN, loaded->batches[1][1].type);
+    ASSERT_EQ(1U, loaded->batches[2].size());
+}
+
+TEST(RecordingEventHubTest, StopRecording_StopsWritingEvents) {
+    RecordingEventHub eventHub(std::make_unique<ReplayEventHub>(createTouchRecording(),
+                                                                ReplayEventHub::Speed::MAX));
+    RawEvent buffer[16];
+    ASSERT_EQ(2U, eventHub.getEvents(0, buffer, 16));
+
+    TemporaryFile file;
+    ASSERT_EQ(OK, eventHub.startRecording(file.path));
+    ASSERT_EQ(2U, eventHub.getEvents(0, buffer, 16));
+    eventHub.stopRecording();
+    ASSERT_EQ(1U, eventHub.getEvents(0, buffer, 16));
+
+    base::Result<EventRecording> loaded = EventRecording::load(file.path);
+    ASSERT_TRUE(loaded.ok()) << loaded.error();
+    EXPECT_EQ(2U, loaded->batches.size());
+}
+
+TEST(RecordingEventHubTest, StartRecording_WhenFileCannotBeCreated_Fails) {
+    RecordingEventHub eventHub(std::make_unique<ReplayEventHub>(createTouchRecording(),
+                                                                ReplayEventHub::Speed::MAX));
+    EXPECT_NE(OK, eventHub.startRecording("/nonexistent/directory/recording"));
+}
+
+// --- ReplayEventHubTest ---
+
+TEST(ReplayEventHubTest, GetEvents_ReturnsOneBatchPerCallThenTimesOut) {
+    ReplayEventHub eventHub(createTouchRecording(), ReplayEventHub::Speed::MAX);
+    RawEvent buffer[16];
+
+    ASSERT_EQ(2U, eventHub.getEvents(0, buffer, 16));
+    EXPECT_EQ(EventHubInterface::DEVICE_ADDED, buffer[0].type);
+    EXPECT_EQ(DEVICE_ID, buffer[0].deviceId);
+    EXPECT_EQ(EventHubInterface::FINISHED_DEVICE_SCAN, buffer[1].type);
+
+    ASSERT_EQ(2U, eventHub.getEvents(0, buffer, 16));
+    EXPECT_EQ(EV_ABS, buffer[0].type);
+    EXPECT_EQ(100, buffer[0].value);
+    EXPECT_EQ(buffer[0].when, buffer[0].readTime);
+    EXPECT_GT(buffer[0].when, ARBITRARY_TIME + 1000) << "Events should be stamped when replayed";
+
+    ASSERT_EQ(1U, eventHub.getEvents(0, buffer, 16));
+    EXPECT_TRUE(eventHub.isFinished());
+    EXPECT_EQ(0U, eventHub.getEvents(0, buffer, 16));
+}
+
+TEST(ReplayEventHubTest, GetEvents_SplitsBatchesLargerThanTheBuffer) {
+    ReplayEventHub eventHub(createTouchRecording(), ReplayEventHub::Speed::MAX);
+    RawEvent buffer[16];
+    ASSERT_EQ(2U, eventHub.getEvents(0, buffer, 16));
+
+    ASSERT_EQ(1U, eventHub.getEvents(0, buffer, 1));
+    EXPECT_EQ(EV_ABS, buffer[0].type);
+    ASSERT_EQ(1U, eventHub.getEvents(0, buffer, 1));
+    EXPECT_EQ(EV_SYN, buffer[0].type);
+    EXPECT_FALSE(eventHub.isFinished());
+}
+
+TEST(ReplayEventHubTest, RewindEvents_ReplaysInputEventsWithoutAddingDevicesAgain) {
+    ReplayEventHub eventHub(createTouchRecording(), ReplayEventHub::Speed::MAX);
+    RawEvent buffer[16];
+    while (!eventHub.isFinished()) {
+        eventHub.getEvents(0, buffer, 16);
+    }
+
+    eventHub.rewindEvents();
+    ASSERT_EQ(2U, eventHub.getEvents(0, buffer, 16));
+    EXPECT_EQ(EV_ABS, buffer[0].type);
+}
+
+TEST(ReplayEventHubTest, Wake_InterruptsGetEvents) {
+    ReplayEventHub eventHub(createTouchRecording(), ReplayEventHub::Speed::MAX);
+    RawEvent buffer[16];
+    while (!eventHub.isFinished()) {
+        eventHub.getEvents(0, buffer, 16);
+    }
+
+    eventHub.wake();
+    // Would block for a very long time if wake had no effect.
+    EXPECT_EQ(0U, eventHub.getEvents(100000, buffer, 16));
+}
+
+TEST(ReplayEventHubTest, DisabledDevice_EventsAreDropped) {
+    ReplayEventHub eventHub(createTouchRecording(), ReplayEventHub::Speed::MAX);
+    RawEvent buffer[16];
+    ASSERT_EQ(2U, eventHub.getEvents(0, buffer, 16));
+
+    ASSERT_EQ(OK, eventHub.disableDevice(DEVICE_ID));
+    EXPECT_FALSE(eventHub.isDeviceEnabled(DEVICE_ID));
+    EXPECT_EQ(0U, eventHub.getEvents(0, buffer, 16));
+
+    ASSERT_EQ(OK, eventHub.enableDevice(DEVICE_ID));
+    EXPECT_EQ(1U, eventHub.getEvents(0, buffer, 16));
+}
+
+TEST(ReplayEventHubTest, AnswersDeviceQueriesFromTheRecording) {
+    ReplayEventHub eventHub(createTouchRecording(), ReplayEventHub::Speed::MAX);
+
+    EXPECT_EQ("touchscreen", eventHub.getDeviceIdentifier(DEVICE_ID).name);
+    EXPECT_EQ(InputDeviceClass::TOUCH | InputDeviceClass::TOUCH_MT,
+              eventHub.getDeviceClasses(DEVICE_ID));
+
+    PropertyMap configuration;
+    eventHub.getConfiguration(DEVICE_ID, &configuration);
+    String8 deviceType;
+    ASSERT_TRUE(configuration.tryGetProperty(String8("touch.deviceType"), deviceType));
+    EXPECT_STREQ("touchScreen", deviceType.string());
+
+    RawAbsoluteAxisInfo axisInfo;
+    ASSERT_EQ(OK, eventHub.getAbsoluteAxisInfo(DEVICE_ID, ABS_MT_POSITION_X, &axisInfo));
+    EXPECT_TRUE(axisInfo.valid);
+    EXPECT_EQ(1079, axisInfo.maxValue);
+    EXPECT_NE(OK, eventHub.getAbsoluteAxisInfo(DEVICE_ID, ABS_MT_PRESSURE, &axisInfo));
+    EXPECT_FALSE(axisInfo.valid);
+
+    EXPECT_TRUE(eventHub.hasInputProperty(DEVICE_ID, INPUT_PROP_DIRECT));
+    EXPECT_TRUE(eventHub.hasScanCode(DEVICE_ID, BTN_TOUCH));
+    EXPECT_FALSE(eventHub.hasScanCode(DEVICE_ID, KEY_BACK));
+
+    int32_t keyCode;
+    int32_t metaState;
+    uint32_t flags;
+    ASSERT_EQ(OK,
+              eventHub.mapKey(DEVICE_ID, KEY_HOME, 0 /*usageCode*/, AMETA_NONE, &keyCode,
+                              &metaState, &flags));
+    EXPECT_EQ(AKEYCODE_HOME, keyCode);
+    EXPECT_EQ(POLICY_FLAG_VIRTUAL, flags);
+
+    std::vector<VirtualKeyDefinition> virtualKeys;
+    eventHub.getVirtualKeyDefinitions(DEVICE_ID, virtualKeys);
+    ASSERT_EQ(1U, virtualKeys.size());
+    EXPECT_EQ(KEY_HOME, virtualKeys[0].scanCode);
+
+    EXPECT_EQ(Flags<InputDeviceClass>(0), eventHub.getDeviceClasses(DEVICE_ID + 1));
+}
+
+} // namespace android
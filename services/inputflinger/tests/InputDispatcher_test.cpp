@@ -23,6 +23,7 @@
 #include <input/Input.h>
 #include <linux/input.h>
 
+#include <algorithm>
 #include <cinttypes>
 #include <thread>
 #include <unordered_set>
@@ -239,6 +240,8 @@ public:
         mConfig.keyRepeatDelay = delay;
     }
 
+    void setCoalesceOutboundMotion(bool enabled) { mConfig.coalesceOutboundMotion = enabled; }
+
     PointerCaptureRequest assertSetPointerCaptureCalled(bool enabled) {
         std::unique_lock lock(mLock);
         base::ScopedLockAssertion assumeLocked(mLock);
@@ -2915,6 +2918,112 @@ TEST_F(InputDispatcherKeyRepeatTest, FocusedWindow_RepeatKeyEventsUseUniqueEvent
     }
 }
 
+class InputDispatcherOutboundCoalescingTest : public InputDispatcherTest {
+protected:
+    // Enough events to fill the socket of a window that does not read them.
+    static constexpr int32_t MOVE_COUNT = 1000;
+
+    void SetUp() override {}
+
+    void startDispatcher(bool coalesceOutboundMotion) {
+        mFakePolicy = new FakeInputDispatcherPolicy();
+        mFakePolicy->setCoalesceOutboundMotion(coalesceOutboundMotion);
+        mDispatcher = new InputDispatcher(mFakePolicy);
+        mDispatcher->setInputDispatchMode(/*enabled*/ true, /*frozen*/ false);
+        ASSERT_EQ(OK, mDispatcher->start());
+    }
+
+    /**
+     * Touch a window, then move the pointer MOVE_COUNT times while the window is not reading its
+     * events. Return the window, with all the events dispatched to it.
+     */
+    sp<FakeWindowHandle> touchAndMoveOnSlowWindow(NotifyMotionArgs* outMotionArgs) {
+        std::shared_ptr<FakeApplicationHandle> application =
+                std::make_shared<FakeApplicationHandle>();
+        sp<FakeWindowHandle> window =
+                new FakeWindowHandle(application, mDispatcher, "Slow Window", ADISPLAY_ID_DEFAULT);
+        mDispatcher->setInputWindows({{ADISPLAY_ID_DEFAULT, {window}}});
+
+        NotifyMotionArgs& motionArgs = *outMotionArgs;
+        motionArgs = generateMotionArgs(AMOTION_EVENT_ACTION_DOWN, AINPUT_SOURCE_TOUCHSCREEN,
+                                        ADISPLAY_ID_DEFAULT);
+        mDispatcher->notifyMotion(&motionArgs);
+        motionArgs.action = AMOTION_EVENT_ACTION_MOVE;
+        for (int32_t i = 1; i <= MOVE_COUNT; i++) {
+            motionArgs.id += 1;
+            motionArgs.eventTime = systemTime(SYSTEM_TIME_MONOTONIC);
+            motionArgs.pointerCoords[0].setAxisValue(AMOTION_EVENT_AXIS_X, i);
+            mDispatcher->notifyMotion(&motionArgs);
+        }
+        mDispatcher->waitForIdle();
+        return window;
+    }
+
+    // Read all the MOVE events of the window, and return the x coordinates of all their samples.
+    std::vector<float> consumeMoves(const sp<FakeWindowHandle>& window) {
+        std::vector<float> xs;
+        while (InputEvent* event = window->consume()) {
+            EXPECT_EQ(AINPUT_EVENT_TYPE_MOTION, event->getType());
+            if (event->getType() != AINPUT_EVENT_TYPE_MOTION) {
+                break;
+            }
+            const MotionEvent& motionEvent = static_cast<const MotionEvent&>(*event);
+            EXPECT_EQ(AMOTION_EVENT_ACTION_MOVE, motionEvent.getAction());
+            for (size_t h = 0; h < motionEvent.getHistorySize(); h++) {
+                xs.push_back(motionEvent.getHistoricalX(0, h));
+            }
+            xs.push_back(motionEvent.getX(0));
+        }
+        return xs;
+    }
+};
+
+TEST_F(InputDispatcherOutboundCoalescingTest, Disabled_SlowWindowReceivesEveryMove) {
+    startDispatcher(false /*coalesceOutboundMotion*/);
+    NotifyMotionArgs motionArgs;
+    sp<FakeWindowHandle> window = touchAndMoveOnSlowWindow(&motionArgs);
+
+    window->consumeMotionDown(ADISPLAY_ID_DEFAULT);
+    std::vector<float> xs = consumeMoves(window);
+    ASSERT_EQ(static_cast<size_t>(MOVE_COUNT), xs.size());
+    EXPECT_EQ(MOVE_COUNT, xs.back());
+}
+
+TEST_F(InputDispatcherOutboundCoalescingTest, Enabled_SlowWindowReceivesEveryMoveInOrder) {
+    startDispatcher(true /*coalesceOutboundMotion*/);
+    NotifyMotionArgs motionArgs;
+    sp<FakeWindowHandle> window = touchAndMoveOnSlowWindow(&motionArgs);
+
+    window->consumeMotionDown(ADISPLAY_ID_DEFAULT);
+    std::vector<float> xs = consumeMoves(window);
+    ASSERT_EQ(static_cast<size_t>(MOVE_COUNT), xs.size()) << "Coalesced moves were dropped";
+    for (size_t i = 0; i < xs.size(); i++) {
+        ASSERT_EQ(static_cast<float>(i + 1), xs[i]) << "Moves were reordered at index " << i;
+    }
+}
+
+TEST_F(InputDispatcherOutboundCoalescingTest, Enabled_UpIsDeliveredAfterLatestMove) {
+    startDispatcher(true /*coalesceOutboundMotion*/);
+    NotifyMotionArgs motionArgs;
+    sp<FakeWindowHandle> window = touchAndMoveOnSlowWindow(&motionArgs);
+    motionArgs.action = AMOTION_EVENT_ACTION_UP;
+    motionArgs.id += 1;
+    motionArgs.eventTime = systemTime(SYSTEM_TIME_MONOTONIC);
+    mDispatcher->notifyMotion(&motionArgs);
+
+    window->consumeMotionDown(ADISPLAY_ID_DEFAULT);
+    float lastMoveX = 0;
+    MotionEvent* motionEvent;
+    while ((motionEvent = window->consumeMotion()) != nullptr &&
+           motionEvent->getAction() == AMOTION_EVENT_ACTION_MOVE) {
+        lastMoveX = motionEvent->getX(0);
+    }
+    ASSERT_NE(nullptr, motionEvent);
+    EXPECT_EQ(AMOTION_EVENT_ACTION_UP, motionEvent->getAction());
+    EXPECT_EQ(MOVE_COUNT, lastMoveX);
+    window->assertNoEvents();
+}
+
 /* Test InputDispatcher for MultiDisplay */
 class InputDispatcherFocusOnTwoDisplaysTest : public InputDispatcherTest {
 public:
@@ -0,0 +1,139 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include "InputListener.h"
+#include "TestInputListener.h"
+
+namespace android {
+
+// An arbitrary device id.
+static const int32_t DEVICE_ID = 1;
+
+static NotifyKeyArgs generateKeyArgs(int32_t id) {
+    return NotifyKeyArgs(id, /* eventTime */ 0, /* readTime */ 0, DEVICE_ID, AINPUT_SOURCE_KEYBOARD,
+                         ADISPLAY_ID_NONE, /* policyFlags */ 0, AKEY_EVENT_ACTION_DOWN,
+                         /* flags */ 0, AKEYCODE_A, /* scanCode */ 0, AMETA_NONE,
+                         /* downTime */ 0);
+}
+
+static NotifyMotionArgs generateMotionArgs(int32_t id, uint32_t pointerCount, float x) {
+    PointerProperties pointerProperties[MAX_POINTERS];
+    PointerCoords pointerCoords[MAX_POINTERS];
+    for (uint32_t i = 0; i < pointerCount; i++) {
+        pointerProperties[i].clear();
+        pointerProperties[i].id = i;
+        pointerProperties[i].toolType = AMOTION_EVENT_TOOL_TYPE_FINGER;
+
+        pointerCoords[i].clear();
+        pointerCoords[i].setAxisValue(AMOTION_EVENT_AXIS_X, x + i);
+        pointerCoords[i].setAxisValue(AMOTION_EVENT_AXIS_Y, x - i);
+    }
+
+    return NotifyMotionArgs(id, /* eventTime */ 0, /* readTime */ 0, DEVICE_ID,
+                            AINPUT_SOURCE_TOUCHSCREEN, ADISPLAY_ID_DEFAULT, /* policyFlags */ 0,
+                            AMOTION_EVENT_ACTION_MOVE, /* actionButton */ 0, /* flags */ 0,
+                            AMETA_NONE, /* buttonState */ 0, MotionClassification::NONE,
+                            AMOTION_EVENT_EDGE_FLAG_NONE, pointerCount, pointerProperties,
+                            pointerCoords, /* xPrecision */ 0, /* yPrecision */ 0,
+                            AMOTION_EVENT_INVALID_CURSOR_POSITION,
+                            AMOTION_EVENT_INVALID_CURSOR_POSITION, /* downTime */ 0,
+                            /* videoFrames */ {});
+}
+
+class QueuedInputListenerTest : public testing::Test {
+protected:
+    sp<TestInputListener> mTestListener;
+    sp<QueuedInputListener> mQueuedListener;
+
+    void SetUp() override {
+        mTestListener = new TestInputListener();
+        mQueuedListener = new QueuedInputListener(mTestListener);
+    }
+};
+
+TEST_F(QueuedInputListenerTest, DefersEventsUntilFlushed) {
+    NotifyKeyArgs keyArgs = generateKeyArgs(1);
+    mQueuedListener->notifyKey(&keyArgs);
+    ASSERT_NO_FATAL_FAILURE(mTestListener->assertNotifyKeyWasNotCalled());
+
+    mQueuedListener->flush();
+    NotifyKeyArgs notifiedKeyArgs;
+    ASSERT_NO_FATAL_FAILURE(mTestListener->assertNotifyKeyWasCalled(&notifiedKeyArgs));
+    ASSERT_EQ(keyArgs, notifiedKeyArgs);
+
+    mQueuedListener->flush();
+    ASSERT_NO_FATAL_FAILURE(mTestListener->assertNotifyKeyWasNotCalled())
+            << "Flushed events should not be sent again";
+}
+
+TEST_F(QueuedInputListenerTest, SendsEventsOfEveryType) {
+    NotifyKeyArgs keyArgs = generateKeyArgs(1);
+    NotifyMotionArgs motionArgs = generateMotionArgs(2, 1, 10);
+    NotifyDeviceResetArgs resetArgs(3, /* eventTime */ 0, DEVICE_ID);
+    NotifyConfigurationChangedArgs configurationChangedArgs(4, /* eventTime */ 0);
+
+    mQueuedListener->notifyKey(&keyArgs);
+    mQueuedListener->notifyMotion(&motionArgs);
+    mQueuedListener->notifyDeviceReset(&resetArgs);
+    mQueuedListener->notifyConfigurationChanged(&configurationChangedArgs);
+    mQueuedListener->flush();
+
+    NotifyKeyArgs notifiedKeyArgs;
+    ASSERT_NO_FATAL_FAILURE(mTestListener->assertNotifyKeyWasCalled(&notifiedKeyArgs));
+    ASSERT_EQ(keyArgs, notifiedKeyArgs);
+    NotifyMotionArgs notifiedMotionArgs;
+    ASSERT_NO_FATAL_FAILURE(mTestListener->assertNotifyMotionWasCalled(&notifiedMotionArgs));
+    ASSERT_EQ(motionArgs, notifiedMotionArgs);
+    NotifyDeviceResetArgs notifiedResetArgs;
+    ASSERT_NO_FATAL_FAILURE(mTestListener->assertNotifyDeviceResetWasCalled(&notifiedResetArgs));
+    ASSERT_EQ(resetArgs, notifiedResetArgs);
+    NotifyConfigurationChangedArgs notifiedConfigurationChangedArgs;
+    ASSERT_NO_FATAL_FAILURE(mTestListener->assertNotifyConfigurationChangedWasCalled(
+            &notifiedConfigurationChangedArgs));
+    ASSERT_EQ(configurationChangedArgs, notifiedConfigurationChangedArgs);
+}
+
+TEST_F(QueuedInputListenerTest, ReusedSlotsHoldTheNewArgs) {
+    // Fill the queue with wide motions, then reuse their slots for args of another type and for a
+    // motion with fewer pointers.
+    NotifyMotionArgs wideMotionArgs = generateMotionArgs(1, MAX_POINTERS, 10);
+    NotifyMotionArgs otherMotionArgs = generateMotionArgs(2, MAX_POINTERS, 20);
+    mQueuedListener->notifyMotion(&wideMotionArgs);
+    mQueuedListener->notifyMotion(&otherMotionArgs);
+    mQueuedListener->flush();
+    NotifyMotionArgs notifiedMotionArgs;
+    ASSERT_NO_FATAL_FAILURE(mTestListener->assertNotifyMotionWasCalled(&notifiedMotionArgs));
+    ASSERT_EQ(wideMotionArgs, notifiedMotionArgs);
+    ASSERT_NO_FATAL_FAILURE(mTestListener->assertNotifyMotionWasCalled(&notifiedMotionArgs));
+    ASSERT_EQ(otherMotionArgs, notifiedMotionArgs);
+
+    NotifyKeyArgs keyArgs = generateKeyArgs(3);
+    NotifyMotionArgs narrowMotionArgs = generateMotionArgs(4, 2, 30);
+    mQueuedListener->notifyKey(&keyArgs);
+    mQueuedListener->notifyMotion(&narrowMotionArgs);
+    mQueuedListener->flush();
+
+    NotifyKeyArgs notifiedKeyArgs;
+    ASSERT_NO_FATAL_FAILURE(mTestListener->assertNotifyKeyWasCalled(&notifiedKeyArgs));
+    ASSERT_EQ(keyArgs, notifiedKeyArgs);
+    ASSERT_NO_FATAL_FAILURE(mTestListener->assertNotifyMotionWasCalled(&notifiedMotionArgs));
+    ASSERT_EQ(narrowMotionArgs, notifiedMotionArgs);
+    ASSERT_NO_FATAL_FAILURE(mTestListener->assertNotifyMotionWasNotCalled());
+}
+
+} // namespace android
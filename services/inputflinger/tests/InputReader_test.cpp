@@ -970,6 +970,10 @@ private:
     void requestReopenDevices() override {}
 
     void wake() override {}
+
+    status_t startRecording(const std::string&) override { return INVALID_OPERATION; }
+
+    void stopRecording() override {}
 };
 
 // --- FakeInputMapper ---
@@ -5525,6 +5529,30 @@ TEST_F(SingleTouchInputMapperTest, Process_XYAxes_AffineCalibration) {
             x, y, 1, 0, 0, 0, 0, 0, 0, 0));
 }
 
+TEST_F(SingleTouchInputMapperTest, Process_XYAxes_AffineCalibration_WhenOrientationAware) {
+    addConfigurationProperty("touch.deviceType", "touchScreen");
+    prepareDisplay(DISPLAY_ORIENTATION_90);
+    prepareLocationCalibration();
+    prepareButtons();
+    prepareAxes(POSITION);
+    SingleTouchInputMapper& mapper = addMapperAndConfigure<SingleTouchInputMapper>();
+
+    int32_t rawX = 100;
+    int32_t rawY = 200;
+
+    // The calibration applies to the raw coordinates, before they are rotated with the display.
+    float x = toDisplayY(toCookedY(rawX, rawY));
+    float y = toDisplayX(RAW_X_MAX - toCookedX(rawX, rawY) + RAW_X_MIN);
+
+    processDown(mapper, rawX, rawY);
+    processSync(mapper);
+
+    NotifyMotionArgs args;
+    ASSERT_NO_FATAL_FAILURE(mFakeListener->assertNotifyMotionWasCalled(&args));
+    ASSERT_NO_FATAL_FAILURE(assertPointerCoords(args.pointerCoords[0],
+            x, y, 1, 0, 0, 0, 0, 0, 0, 0));
+}
+
 TEST_F(SingleTouchInputMapperTest, Process_ShouldHandleAllButtons) {
     addConfigurationProperty("touch.deviceType", "touchScreen");
     prepareDisplay(DISPLAY_ORIENTATION_0);
@@ -0,0 +1,175 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <random>
+
+#include "../TouchableWindowIndex.h"
+
+// atest inputflinger_tests:TouchableWindowIndexTest
+
+namespace android::inputdispatcher {
+
+static constexpr int32_t DISPLAY_ID = 0;
+static constexpr int32_t OTHER_DISPLAY_ID = 1;
+
+class IndexedWindowHandle : public InputWindowHandle {
+public:
+    IndexedWindowHandle(int32_t displayId, const Rect& touchableArea,
+                        Flags<InputWindowInfo::Flag> flags, bool visible) {
+        mInfo.displayId = displayId;
+        mInfo.touchableRegion = Region(touchableArea);
+        mInfo.flags = flags;
+        mInfo.visible = visible;
+    }
+
+    bool updateInfo() { return true; }
+    void addTouchableArea(const Rect& area) { mInfo.touchableRegion.orSelf(area); }
+};
+
+// The windows which findTouchedWindowAtLocked would look at for a touch at (x, y), front to back.
+static std::vector<size_t> expectedCandidates(const std::vector<sp<InputWindowHandle>>& windows,
+                                              int32_t x, int32_t y) {
+    std::vector<size_t> candidates;
+    for (size_t i = 0; i < windows.size(); i++) {
+        const InputWindowInfo* info = windows[i]->getInfo();
+        if (info->displayId != DISPLAY_ID || !info->visible) {
+            continue;
+        }
+        const bool isTouchModal = !info->flags.test(InputWindowInfo::Flag::NOT_FOCUSABLE) &&
+                !info->flags.test(InputWindowInfo::Flag::NOT_TOUCH_MODAL);
+        const bool touched = !info->flags.test(InputWindowInfo::Flag::NOT_TOUCHABLE) &&
+                (isTouchModal || info->touchableRegionContainsPoint(x, y));
+        if (touched || info->flags.test(InputWindowInfo::Flag::WATCH_OUTSIDE_TOUCH)) {
+            candidates.push_back(i);
+        }
+    }
+    return candidates;
+}
+
+// The candidates from the index, leaving out the ones which aren't expected. The index may
+// return more windows than are needed, but never fewer, and always in order.
+static std::vector<size_t> indexedCandidates(const TouchableWindowIndex& index,
+                                             const std::vector<sp<InputWindowHandle>>& windows,
+                                             int32_t x, int32_t y) {
+    const std::vector<size_t> expected = expectedCandidates(windows, x, y);
+    std::vector<size_t> candidates;
+    TouchableWindowIndex::Candidates it = index.candidatesAt(x, y);
+    size_t i;
+    bool first = true;
+    size_t previous = 0;
+    while (it.next(&i)) {
+        EXPECT_LT(i, windows.size());
+        EXPECT_TRUE(first || previous < i) << "candidates out of order at " << x << ", " << y;
+        first = false;
+        previous = i;
+        if (std::find(expected.begin(), expected.end(), i) != expected.end()) {
+            candidates.push_back(i);
+        }
+    }
+    return candidates;
+}
+
+TEST(TouchableWindowIndexTest, Empty) {
+    TouchableWindowIndex index;
+    index.build(DISPLAY_ID, {});
+    size_t i;
+    EXPECT_FALSE(index.candidatesAt(0, 0).next(&i));
+}
+
+TEST(TouchableWindowIndexTest, SkipsWindowsWhichCantBeTouched) {
+    const Flags<InputWindowInfo::Flag> notModal = InputWindowInfo::Flag::NOT_TOUCH_MODAL;
+    std::vector<sp<InputWindowHandle>> windows;
+    windows.push_back(new IndexedWindowHandle(DISPLAY_ID, Rect(0, 0, 10, 10), notModal,
+                                              false /* visible */));
+    windows.push_back(new IndexedWindowHandle(DISPLAY_ID, Rect(0, 0, 10, 10),
+                                              notModal | InputWindowInfo::Flag::NOT_TOUCHABLE,
+                                              true /* visible */));
+    windows.push_back(new IndexedWindowHandle(OTHER_DISPLAY_ID, Rect(0, 0, 10, 10), notModal,
+                                              true /* visible */));
+    windows.push_back(new IndexedWindowHandle(DISPLAY_ID, Rect(20, 20, 30, 30), notModal,
+                                              true /* visible */));
+    TouchableWindowIndex index;
+    index.build(DISPLAY_ID, windows);
+
+    size_t i;
+    EXPECT_FALSE(index.candidatesAt(5, 5).next(&i));
+    TouchableWindowIndex::Candidates it = index.candidatesAt(25, 25);
+    ASSERT_TRUE(it.next(&i));
+    EXPECT_EQ(3u, i);
+    EXPECT_FALSE(it.next(&i));
+}
+
+TEST(TouchableWindowIndexTest, TouchModalAndWatchOutsideWindowsAreAlwaysCandidates) {
+    const Flags<InputWindowInfo::Flag> notModal = InputWindowInfo::Flag::NOT_TOUCH_MODAL;
+    std::vector<sp<InputWindowHandle>> windows;
+    windows.push_back(new IndexedWindowHandle(DISPLAY_ID, Rect(0, 0, 10, 10),
+                                              notModal | InputWindowInfo::Flag::WATCH_OUTSIDE_TOUCH,
+                                              true /* visible */));
+    windows.push_back(new IndexedWindowHandle(DISPLAY_ID, Rect(500, 500, 600, 600), notModal,
+                                              true /* visible */));
+    windows.push_back(new IndexedWindowHandle(DISPLAY_ID, Rect(0, 0, 10, 10), {},
+                                              true /* visible */));
+    TouchableWindowIndex index;
+    index.build(DISPLAY_ID, windows);
+
+    EXPECT_EQ(std::vector<size_t>({0, 2}), indexedCandidates(index, windows, 1000, 1000));
+    EXPECT_EQ(std::vector<size_t>({0, 1, 2}), indexedCandidates(index, windows, 550, 550));
+}
+
+TEST(TouchableWindowIndexTest, MatchesLinearSearch) {
+    std::mt19937 rng(1234);
+    std::uniform_int_distribution<int32_t> coordinate(-200, 1400);
+    std::uniform_int_distribution<int32_t> size(0, 600);
+    std::uniform_int_distribution<int> percent(0, 99);
+
+    for (int round = 0; round < 50; round++) {
+        const size_t windowCount = round * 4;
+        std::vector<sp<InputWindowHandle>> windows;
+        for (size_t w = 0; w < windowCount; w++) {
+            Flags<InputWindowInfo::Flag> flags;
+            if (percent(rng) >= 5) flags |= InputWindowInfo::Flag::NOT_TOUCH_MODAL;
+            if (percent(rng) < 10) flags |= InputWindowInfo::Flag::NOT_TOUCHABLE;
+            if (percent(rng) < 5) flags |= InputWindowInfo::Flag::WATCH_OUTSIDE_TOUCH;
+            if (percent(rng) < 5) flags |= InputWindowInfo::Flag::NOT_FOCUSABLE;
+            const int32_t left = coordinate(rng);
+            const int32_t top = coordinate(rng);
+            sp<IndexedWindowHandle> window =
+                    new IndexedWindowHandle(percent(rng) < 5 ? OTHER_DISPLAY_ID : DISPLAY_ID,
+                                            Rect(left, top, left + size(rng), top + size(rng)),
+                                            flags, percent(rng) >= 10 /* visible */);
+            if (percent(rng) < 20) {
+                // A touchable region which isn't a single rectangle
+                const int32_t left = coordinate(rng);
+                const int32_t top = coordinate(rng);
+                window->addTouchableArea(Rect(left, top, left + size(rng), top + size(rng)));
+            }
+            windows.push_back(window);
+        }
+
+        TouchableWindowIndex index;
+        index.build(DISPLAY_ID, windows);
+        for (int p = 0; p < 200; p++) {
+            const int32_t x = coordinate(rng);
+            const int32_t y = coordinate(rng);
+            ASSERT_EQ(expectedCandidates(windows, x, y), indexedCandidates(index, windows, x, y))
+                    << "at " << x << ", " << y << " with " << windowCount << " windows";
+        }
+    }
+}
+
+} // namespace android::inputdispatcher
@@ -262,6 +262,7 @@ bool BufferStateLayer::setTransform(uint32_t transform) {
     if (mDrawingState.bufferTransform == transform) return false;
     mDrawingState.bufferTransform = transform;
     mDrawingState.modified = true;
+    setGeometryDirty();
     setTransactionFlags(eTransactionNeeded);
     return true;
 }
@@ -271,6 +272,7 @@ bool BufferStateLayer::setTransformToDisplayInverse(bool transformToDisplayInver
     mDrawingState.sequence++;
     mDrawingState.transformToDisplayInverse = transformToDisplayInverse;
     mDrawingState.modified = true;
+    setGeometryDirty();
     setTransactionFlags(eTransactionNeeded);
     return true;
 }
@@ -281,6 +283,7 @@ bool BufferStateLayer::setCrop(const Rect& crop) {
     mDrawingState.crop = crop;
 
     mDrawingState.modified = true;
+    setGeometryDirty();
     setTransactionFlags(eTransactionNeeded);
     return true;
 }
@@ -303,6 +306,7 @@ bool BufferStateLayer::setDestinationFrame(const Rect& destinationFrame) {
     mDrawingState.destinationFrame = destinationFrame;
 
     mDrawingState.modified = true;
+    setGeometryDirty();
     setTransactionFlags(eTransactionNeeded);
     return true;
 }
@@ -383,6 +387,7 @@ bool BufferStateLayer::setMatrix(const layer_state_t::matrix22_t& matrix,
 
     mDrawingState.sequence++;
     mDrawingState.modified = true;
+    setGeometryDirty();
     setTransactionFlags(eTransactionNeeded);
 
     return true;
@@ -397,6 +402,7 @@ bool BufferStateLayer::setPosition(float x, float y) {
 
     mDrawingState.sequence++;
     mDrawingState.modified = true;
+    setGeometryDirty();
     setTransactionFlags(eTransactionNeeded);
 
     return true;
@@ -63,6 +63,9 @@ public:
     virtual bool needsAnotherUpdate() const = 0;
     virtual nsecs_t getLastFrameRefreshTimestamp() const = 0;
 
+    // Enables (or disables) preparing and presenting independent outputs concurrently
+    virtual void setParallelOutputCompositionEnabled(bool) = 0;
+
     // Presents the indicated outputs
     virtual void present(CompositionRefreshArgs&) = 0;
 
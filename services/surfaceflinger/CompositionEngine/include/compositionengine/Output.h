@@ -262,6 +262,13 @@ public:
     // Presents the output, finalizing all composition details
     virtual void present(const CompositionRefreshArgs&) = 0;
 
+    // The two halves of present. preparePresent computes the composition state of the output
+    // layers without writing to the hardware composer command stream, so it may run concurrently
+    // for different outputs. finishPresent writes that state to the hardware composer, then
+    // composes and presents the output, one output at a time.
+    virtual void preparePresent(const CompositionRefreshArgs&) = 0;
+    virtual void finishPresent(const CompositionRefreshArgs&) = 0;
+
     // Latches the front-end layer state for each output layer
     virtual void updateLayerStateFromFE(const CompositionRefreshArgs&) const = 0;
 
@@ -17,6 +17,7 @@
 #pragma once
 
 #include <compositionengine/CompositionEngine.h>
+#include <compositionengine/impl/OutputWorkerPool.h>
 
 namespace android::compositionengine::impl {
 
@@ -42,6 +43,8 @@ public:
     bool needsAnotherUpdate() const override;
     nsecs_t getLastFrameRefreshTimestamp() const override;
 
+    void setParallelOutputCompositionEnabled(bool) override;
+
     void present(CompositionRefreshArgs&) override;
 
     void updateCursorAsync(CompositionRefreshArgs&) override;
@@ -57,11 +60,15 @@ public:
     void setNeedsAnotherUpdateForTest(bool);
 
 private:
+    bool useParallelOutputComposition(const CompositionRefreshArgs&) const;
+    void prepareOutputsInParallel(CompositionRefreshArgs&);
+
     std::unique_ptr<HWComposer> mHwComposer;
     std::unique_ptr<renderengine::RenderEngine> mRenderEngine;
     std::shared_ptr<TimeStats> mTimeStats;
     bool mNeedsAnotherUpdate = false;
     nsecs_t mRefreshStartTime = 0;
+    std::unique_ptr<OutputWorkerPool> mOutputWorkerPool;
 };
 
 std::unique_ptr<compositionengine::CompositionEngine> createCompositionEngine();
@@ -73,6 +73,8 @@ public:
 
     void prepare(const CompositionRefreshArgs&, LayerFESet&) override;
     void present(const CompositionRefreshArgs&) override;
+    void preparePresent(const CompositionRefreshArgs&) override;
+    void finishPresent(const CompositionRefreshArgs&) override;
 
     void rebuildLayerStacks(const CompositionRefreshArgs&, LayerFESet&) override;
     void collectVisibleLayers(const CompositionRefreshArgs&,
@@ -0,0 +1,58 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <android-base/thread_annotations.h>
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace android::compositionengine::impl {
+
+// A fixed set of threads that the per-output steps of a frame are spread over, so that the cost
+// of composing secondary displays overlaps with that of the primary display.
+class OutputWorkerPool {
+public:
+    explicit OutputWorkerPool(size_t workerCount);
+    ~OutputWorkerPool();
+
+    OutputWorkerPool(const OutputWorkerPool&) = delete;
+    OutputWorkerPool& operator=(const OutputWorkerPool&) = delete;
+
+    // Calls task with each index in [0, count), on the workers as well as on the calling thread,
+    // and returns once all the calls have returned. Calls must not overlap.
+    void run(size_t count, const std::function<void(size_t)>& task);
+
+private:
+    void threadMain();
+
+    std::mutex mMutex;
+    std::condition_variable mWorkAvailableCondition;
+    std::condition_variable mWorkDoneCondition;
+    const std::function<void(size_t)>* mTask GUARDED_BY(mMutex) = nullptr;
+    size_t mTaskCount GUARDED_BY(mMutex) = 0;
+    size_t mNextIndex GUARDED_BY(mMutex) = 0;
+    size_t mPendingCount GUARDED_BY(mMutex) = 0;
+    bool mStopping GUARDED_BY(mMutex) = false;
+
+    std::vector<std::thread> mThreads;
+};
+
+} // namespace android::compositionengine::impl
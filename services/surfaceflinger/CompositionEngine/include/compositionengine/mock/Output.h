@@ -77,6 +77,8 @@ public:
 
     MOCK_METHOD2(prepare, void(const compositionengine::CompositionRefreshArgs&, LayerFESet&));
     MOCK_METHOD1(present, void(const compositionengine::CompositionRefreshArgs&));
+    MOCK_METHOD1(preparePresent, void(const compositionengine::CompositionRefreshArgs&));
+    MOCK_METHOD1(finishPresent, void(const compositionengine::CompositionRefreshArgs&));
 
     MOCK_METHOD2(rebuildLayerStacks,
                  void(const compositionengine::CompositionRefreshArgs&, LayerFESet&));
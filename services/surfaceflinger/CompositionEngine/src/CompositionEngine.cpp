@@ -20,10 +20,13 @@
 #include <compositionengine/OutputLayer.h>
 #include <compositionengine/impl/CompositionEngine.h>
 #include <compositionengine/impl/Display.h>
+#include <compositionengine/impl/OutputCompositionState.h>
 
 #include <renderengine/RenderEngine.h>
 #include <utils/Trace.h>
 
+#include <algorithm>
+
 // TODO(b/129481165): remove the #pragma below and fix conversion issues
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wconversion"
@@ -39,6 +42,13 @@ CompositionEngine::~CompositionEngine() = default;
 
 namespace impl {
 
+namespace {
+
+// Together with the main thread, the workers prepare up to four outputs at once.
+constexpr size_t kOutputWorkerCount = 3;
+
+} // namespace
+
 std::unique_ptr<compositionengine::CompositionEngine> createCompositionEngine() {
     return std::make_unique<CompositionEngine>();
 }
@@ -88,13 +98,24 @@ nsecs_t CompositionEngine::getLastFrameRefreshTimestamp() const {
     return mRefreshStartTime;
 }
 
+void CompositionEngine::setParallelOutputCompositionEnabled(bool enabled) {
+    if (!enabled) {
+        mOutputWorkerPool.reset();
+    } else if (!mOutputWorkerPool) {
+        mOutputWorkerPool = std::make_unique<OutputWorkerPool>(kOutputWorkerCount);
+    }
+}
+
 void CompositionEngine::present(CompositionRefreshArgs& args) {
     ATRACE_CALL();
     ALOGV(__FUNCTION__);
 
     preComposition(args);
 
-    {
+    const bool parallel = useParallelOutputComposition(args);
+    if (parallel) {
+        prepareOutputsInParallel(args);
+    } else {
         // latchedLayers is used to track the set of front-end layer state that
         // has been latched across all outputs for the prepare step, and is not
         // needed for anything else.
@@ -107,11 +128,49 @@ void CompositionEngine::present(CompositionRefreshArgs& args) {
 
     updateLayerStateFromFE(args);
 
+    if (!parallel) {
+        for (const auto& output : args.outputs) {
+            output->present(args);
+        }
+        return;
+    }
+
+    mOutputWorkerPool->run(args.outputs.size(),
+                           [&args](size_t i) { args.outputs[i]->preparePresent(args); });
+
+    // The outputs share the hardware composer command stream, so they write to it and present
+    // one at a time, in order.
     for (const auto& output : args.outputs) {
-        output->present(args);
+        output->finishPresent(args);
     }
 }
 
+bool CompositionEngine::useParallelOutputComposition(const CompositionRefreshArgs& args) const {
+    return mOutputWorkerPool != nullptr && args.outputs.size() > 1;
+}
+
+void CompositionEngine::prepareOutputsInParallel(CompositionRefreshArgs& args) {
+    ATRACE_CALL();
+
+    // The outputs latch the geometry of each layer once between them, so do it up front, as the
+    // first output to rebuild its layer stacks would, and have them only read the set after that.
+    LayerFESet latchedLayers;
+    const bool anyOutputEnabled =
+            std::any_of(args.outputs.begin(), args.outputs.end(),
+                        [](const auto& output) { return output->getState().isEnabled; });
+    if (args.updatingOutputGeometryThisFrame && anyOutputEnabled) {
+        for (const auto& layer : args.layers) {
+            if (latchedLayers.insert(layer).second) {
+                layer->prepareCompositionState(LayerFE::StateSubset::BasicGeometry);
+            }
+        }
+    }
+
+    mOutputWorkerPool->run(args.outputs.size(), [&args, &latchedLayers](size_t i) {
+        args.outputs[i]->prepare(args, latchedLayers);
+    });
+}
+
 void CompositionEngine::updateCursorAsync(CompositionRefreshArgs& args) {
     std::unordered_map<compositionengine::LayerFE*, compositionengine::LayerFECompositionState*>
             uniqueVisibleLayers;
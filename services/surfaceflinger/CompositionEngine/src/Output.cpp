@@ -424,9 +424,23 @@ void Output::present(const compositionengine::CompositionRefreshArgs& refreshArg
     ATRACE_CALL();
     ALOGV(__FUNCTION__);
 
+    preparePresent(refreshArgs);
+    finishPresent(refreshArgs);
+}
+
+void Output::preparePresent(const compositionengine::CompositionRefreshArgs& refreshArgs) {
+    ATRACE_CALL();
+    ALOGV(__FUNCTION__);
+
     updateColorProfile(refreshArgs);
     updateCompositionState(refreshArgs);
     planComposition();
+}
+
+void Output::finishPresent(const compositionengine::CompositionRefreshArgs& refreshArgs) {
+    ATRACE_CALL();
+    ALOGV(__FUNCTION__);
+
     writeCompositionState(refreshArgs);
     setColorTransform(refreshArgs);
     beginFrame();
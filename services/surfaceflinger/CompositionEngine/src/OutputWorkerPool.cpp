@@ -0,0 +1,102 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <compositionengine/impl/OutputWorkerPool.h>
+
+#include <log/log.h>
+#include <pthread.h>
+#include <sched.h>
+#include <utils/Trace.h>
+
+namespace android::compositionengine::impl {
+
+namespace {
+
+// The workers stand in for the main thread, so they run at its priority.
+constexpr int kWorkerFifoPriority = 2;
+
+} // namespace
+
+OutputWorkerPool::OutputWorkerPool(size_t workerCount) {
+    for (size_t i = 0; i < workerCount; i++) {
+        mThreads.emplace_back(&OutputWorkerPool::threadMain, this);
+    }
+}
+
+OutputWorkerPool::~OutputWorkerPool() {
+    {
+        std::lock_guard lock(mMutex);
+        mStopping = true;
+    }
+    mWorkAvailableCondition.notify_all();
+    for (std::thread& thread : mThreads) {
+        thread.join();
+    }
+}
+
+void OutputWorkerPool::run(size_t count, const std::function<void(size_t)>& task) {
+    std::unique_lock lock(mMutex);
+    mTask = &task;
+    mTaskCount = count;
+    mNextIndex = 0;
+    mPendingCount = count;
+    mWorkAvailableCondition.notify_all();
+
+    // Take a share of the work rather than wait idle.
+    while (mNextIndex < mTaskCount) {
+        const size_t index = mNextIndex++;
+        lock.unlock();
+        task(index);
+        lock.lock();
+        mPendingCount--;
+    }
+
+    mWorkDoneCondition.wait(lock, [this]() REQUIRES(mMutex) { return mPendingCount == 0; });
+    mTask = nullptr;
+    mTaskCount = 0;
+}
+
+// NO_THREAD_SAFETY_ANALYSIS is because std::unique_lock presently lacks thread safety annotations.
+void OutputWorkerPool::threadMain() NO_THREAD_SAFETY_ANALYSIS {
+    pthread_setname_np(pthread_self(), "OutputWorker");
+
+    struct sched_param param = {0};
+    param.sched_priority = kWorkerFifoPriority;
+    if (sched_setscheduler(0, SCHED_FIFO, &param) != 0) {
+        ALOGW("Couldn't set SCHED_FIFO for the output worker");
+    }
+
+    std::unique_lock lock(mMutex);
+    while (true) {
+        mWorkAvailableCondition.wait(lock, [this]() REQUIRES(mMutex) {
+            return mStopping || mNextIndex < mTaskCount;
+        });
+        if (mStopping) {
+            return;
+        }
+
+        const size_t index = mNextIndex++;
+        const std::function<void(size_t)>& task = *mTask;
+        lock.unlock();
+        task(index);
+        lock.lock();
+        if (--mPendingCount == 0) {
+            mWorkDoneCondition.notify_one();
+        }
+    }
+}
+
+} // namespace android::compositionengine::impl
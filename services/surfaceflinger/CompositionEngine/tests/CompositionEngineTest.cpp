@@ -17,6 +17,7 @@
 #include <compositionengine/CompositionRefreshArgs.h>
 #include <compositionengine/LayerFECompositionState.h>
 #include <compositionengine/impl/CompositionEngine.h>
+#include <compositionengine/impl/OutputCompositionState.h>
 #include <compositionengine/mock/LayerFE.h>
 #include <compositionengine/mock/Output.h>
 #include <compositionengine/mock/OutputLayer.h>
@@ -32,10 +33,12 @@ namespace {
 using ::testing::_;
 using ::testing::DoAll;
 using ::testing::InSequence;
+using ::testing::Invoke;
 using ::testing::Ref;
 using ::testing::Return;
 using ::testing::ReturnRef;
 using ::testing::SaveArg;
+using ::testing::Sequence;
 using ::testing::StrictMock;
 
 struct CompositionEngineTest : public testing::Test {
@@ -123,6 +126,52 @@ TEST_F(CompositionEnginePresentTest, worksAsExpected) {
     mEngine.present(mRefreshArgs);
 }
 
+TEST_F(CompositionEnginePresentTest, worksAsExpectedWithParallelOutputComposition) {
+    sp<StrictMock<mock::LayerFE>> layerFE = sp<StrictMock<mock::LayerFE>>::make();
+    impl::OutputCompositionState outputState;
+    outputState.isEnabled = true;
+
+    EXPECT_CALL(mEngine, preComposition(Ref(mRefreshArgs)));
+
+    // The geometry of each layer is latched once, before the outputs are prepared.
+    EXPECT_CALL(*mOutput1, getState()).WillRepeatedly(ReturnRef(outputState));
+    EXPECT_CALL(*layerFE, prepareCompositionState(LayerFE::StateSubset::BasicGeometry)).Times(1);
+
+    // Each output goes through the same steps as when presented serially, but may do the
+    // first ones at the same time as the others.
+    Sequence finishSeq;
+    for (const auto& output : {mOutput1, mOutput2, mOutput3}) {
+        Sequence outputSeq;
+        EXPECT_CALL(*output, prepare(Ref(mRefreshArgs), _))
+                .InSequence(outputSeq)
+                .WillOnce(Invoke([&](const CompositionRefreshArgs&, LayerFESet& latchedLayers) {
+                    EXPECT_EQ(1u, latchedLayers.count(layerFE));
+                }));
+        EXPECT_CALL(*output, updateLayerStateFromFE(Ref(mRefreshArgs))).InSequence(outputSeq);
+        EXPECT_CALL(*output, preparePresent(Ref(mRefreshArgs))).InSequence(outputSeq);
+        // Only the last step writes to the hardware composer, so the outputs do it in order.
+        EXPECT_CALL(*output, finishPresent(Ref(mRefreshArgs))).InSequence(outputSeq, finishSeq);
+    }
+
+    mRefreshArgs.outputs = {mOutput1, mOutput2, mOutput3};
+    mRefreshArgs.layers = {layerFE};
+    mRefreshArgs.updatingOutputGeometryThisFrame = true;
+    mEngine.setParallelOutputCompositionEnabled(true);
+    mEngine.present(mRefreshArgs);
+}
+
+TEST_F(CompositionEnginePresentTest, presentsASingleOutputSeriallyWithParallelOutputComposition) {
+    InSequence seq;
+    EXPECT_CALL(mEngine, preComposition(Ref(mRefreshArgs)));
+    EXPECT_CALL(*mOutput1, prepare(Ref(mRefreshArgs), _));
+    EXPECT_CALL(*mOutput1, updateLayerStateFromFE(Ref(mRefreshArgs)));
+    EXPECT_CALL(*mOutput1, present(Ref(mRefreshArgs)));
+
+    mRefreshArgs.outputs = {mOutput1};
+    mEngine.setParallelOutputCompositionEnabled(true);
+    mEngine.present(mRefreshArgs);
+}
+
 /*
  * CompositionEngine::updateCursorAsync
  */
@@ -329,16 +329,53 @@ FloatRect Layer::getBounds(const Region& activeTransparentRegion) const {
 
 void Layer::computeBounds(FloatRect parentBounds, ui::Transform parentTransform,
                           float parentShadowRadius) {
+    computeOwnBounds(parentBounds, parentTransform, parentShadowRadius);
+
+    const float childShadowRadius = getChildShadowRadius();
+    for (const sp<Layer>& child : mDrawingChildren) {
+        child->computeBounds(mBounds, mEffectiveTransform, childShadowRadius);
+    }
+}
+
+void Layer::updateBounds(const FloatRect& parentBounds, const ui::Transform& parentTransform,
+                         float parentShadowRadius) {
+    const bool boundsChanged = mGeometryDirty || !(parentBounds == mBoundsParentBounds) ||
+            !(parentTransform == mBoundsParentTransform) ||
+            parentShadowRadius != mBoundsParentShadowRadius;
+    if (!boundsChanged && !mChildGeometryDirty) {
+        return;
+    }
+
+    if (boundsChanged) {
+        computeOwnBounds(parentBounds, parentTransform, parentShadowRadius);
+    }
+    mChildGeometryDirty = false;
+
+    // The children whose parent values did not change are skipped, unless something below them
+    // changed.
+    const float childShadowRadius = getChildShadowRadius();
+    for (const sp<Layer>& child : mDrawingChildren) {
+        child->updateBounds(mBounds, mEffectiveTransform, childShadowRadius);
+    }
+}
+
+void Layer::computeOwnBounds(const FloatRect& parentBounds, const ui::Transform& parentTransform,
+                             float parentShadowRadius) {
     const State& s(getDrawingState());
 
+    mBoundsParentBounds = parentBounds;
+    mBoundsParentTransform = parentTransform;
+    mBoundsParentShadowRadius = parentShadowRadius;
+    mGeometryDirty = false;
+
     // Calculate effective layer transform
     mEffectiveTransform = parentTransform * getActiveTransform(s);
 
     // Transform parent bounds to layer space
-    parentBounds = getActiveTransform(s).inverse().transform(parentBounds);
+    const FloatRect layerParentBounds = getActiveTransform(s).inverse().transform(parentBounds);
 
     // Calculate source bounds
-    mSourceBounds = computeSourceBounds(parentBounds);
+    mSourceBounds = computeSourceBounds(layerParentBounds);
 
     // Calculate bounds by croping diplay frame with layer crop and parent bounds
     FloatRect bounds = mSourceBounds;
@@ -346,7 +383,7 @@ void Layer::computeBounds(FloatRect parentBounds, ui::Transform parentTransform,
     if (!layerCrop.isEmpty()) {
         bounds = mSourceBounds.intersect(layerCrop.toFloatRect());
     }
-    bounds = bounds.intersect(parentBounds);
+    bounds = bounds.intersect(layerParentBounds);
 
     mBounds = bounds;
     mScreenBounds = mEffectiveTransform.transform(mBounds);
@@ -358,16 +395,40 @@ void Layer::computeBounds(FloatRect parentBounds, ui::Transform parentTransform,
     } else {
         mEffectiveShadowRadius = parentShadowRadius;
     }
+}
 
+float Layer::getChildShadowRadius() const {
     // Shadow radius is passed down to only one layer so if the layer can draw shadows,
     // don't pass it to its children.
-    const float childShadowRadius = canDrawShadows() ? 0.f : mEffectiveShadowRadius;
+    return canDrawShadows() ? 0.f : mEffectiveShadowRadius;
+}
 
-    for (const sp<Layer>& child : mDrawingChildren) {
-        child->computeBounds(mBounds, mEffectiveTransform, childShadowRadius);
+void Layer::setGeometryDirty() {
+    mGeometryDirty = true;
+
+    // The layer may be in the middle of being moved, so mark the ancestors it is drawn under as
+    // well as those it will be drawn under once the hierarchy is committed.
+    for (sp<Layer> parent = mCurrentParent.promote(); parent != nullptr;
+         parent = parent->mCurrentParent.promote()) {
+        parent->mChildGeometryDirty = true;
+    }
+    for (sp<Layer> parent = mDrawingParent.promote(); parent != nullptr;
+         parent = parent->mDrawingParent.promote()) {
+        parent->mChildGeometryDirty = true;
     }
 }
 
+Layer::CachedBounds Layer::getCachedBounds() const {
+    return {mEffectiveTransform, mSourceBounds, mBounds, mScreenBounds, mEffectiveShadowRadius};
+}
+
+bool Layer::CachedBounds::operator==(const CachedBounds& other) const {
+    return effectiveTransform == other.effectiveTransform &&
+            sourceBounds == other.sourceBounds && bounds == other.bounds &&
+            screenBounds == other.screenBounds &&
+            effectiveShadowRadius == other.effectiveShadowRadius;
+}
+
 Rect Layer::getCroppedBufferSize(const State& s) const {
     Rect size = getBufferSize(s);
     Rect crop = getCrop(s);
@@ -697,6 +758,7 @@ uint32_t Layer::doTransaction(uint32_t flags) {
     if (updateGeometry()) {
         // invalidate and recompute the visible regions if needed
         flags |= Layer::eVisibleRegion;
+        setGeometryDirty();
     }
 
     if (s.sequence != mLastCommittedTxSequence) {
@@ -744,6 +806,7 @@ bool Layer::setPosition(float x, float y) {
     mDrawingState.transform.set(x, y);
 
     mDrawingState.modified = true;
+    setGeometryDirty();
     setTransactionFlags(eTransactionNeeded);
     return true;
 }
@@ -870,6 +933,7 @@ bool Layer::setSize(uint32_t w, uint32_t h) {
     mDrawingState.requested_legacy.w = w;
     mDrawingState.requested_legacy.h = h;
     mDrawingState.modified = true;
+    setGeometryDirty();
     setTransactionFlags(eTransactionNeeded);
 
     // record the new size, from this point on, when the client request
@@ -958,6 +1022,7 @@ bool Layer::setMatrix(const layer_state_t::matrix22_t& matrix,
     mDrawingState.sequence++;
     mDrawingState.transform.set(matrix.dsdx, matrix.dtdy, matrix.dtdx, matrix.dsdy);
     mDrawingState.modified = true;
+    setGeometryDirty();
 
     setTransactionFlags(eTransactionNeeded);
     return true;
@@ -994,6 +1059,7 @@ bool Layer::setCrop(const Rect& crop) {
     mDrawingState.crop = crop;
 
     mDrawingState.modified = true;
+    setGeometryDirty();
     setTransactionFlags(eTransactionNeeded);
     return true;
 }
@@ -1068,6 +1134,7 @@ bool Layer::setShadowRadius(float shadowRadius) {
     mDrawingState.sequence++;
     mDrawingState.shadowRadius = shadowRadius;
     mDrawingState.modified = true;
+    setGeometryDirty();
     setTransactionFlags(eTransactionNeeded);
     return true;
 }
@@ -1674,6 +1741,7 @@ bool Layer::isLegacyDataSpace() const {
 
 void Layer::setParent(const sp<Layer>& layer) {
     mCurrentParent = layer;
+    setGeometryDirty();
 }
 
 int32_t Layer::getZ(LayerVector::StateSet) const {
@@ -2406,6 +2474,7 @@ void Layer::updateClonedDrawingState(std::map<sp<Layer>, sp<Layer>>& clonedLayer
         sp<Layer> clonedFrom = getClonedFrom();
         mDrawingState = clonedFrom->mDrawingState;
         clonedLayersMap.emplace(clonedFrom, this);
+        setGeometryDirty();
     }
 
     // The clone layer may have children in drawingState since they may have been created and
@@ -2498,6 +2567,7 @@ void Layer::updateClonedRelatives(const std::map<sp<Layer>, sp<Layer>>& clonedLa
 void Layer::addChildToDrawing(const sp<Layer>& layer) {
     mDrawingChildren.add(layer);
     layer->mDrawingParent = this;
+    layer->setGeometryDirty();
 }
 
 Layer::FrameRateCompatibility Layer::FrameRate::convertCompatibility(int8_t compatibility) {
@@ -656,6 +656,26 @@ public:
     // Compute bounds for the layer and cache the results.
     void computeBounds(FloatRect parentBounds, ui::Transform parentTransform, float shadowRadius);
 
+    // Like computeBounds, but only recomputes the layers of the tree whose geometry, or whose
+    // parent values, changed since their bounds were last computed.
+    void updateBounds(const FloatRect& parentBounds, const ui::Transform& parentTransform,
+                      float shadowRadius);
+
+    // Marks the geometry of the layer as changed, so that updateBounds recomputes its bounds.
+    void setGeometryDirty();
+
+    // The results of computeBounds, for checking updateBounds against it.
+    struct CachedBounds {
+        ui::Transform effectiveTransform;
+        FloatRect sourceBounds;
+        FloatRect bounds;
+        FloatRect screenBounds;
+        float effectiveShadowRadius;
+
+        bool operator==(const CachedBounds& other) const;
+    };
+    CachedBounds getCachedBounds() const;
+
     int32_t getSequence() const override { return sequence; }
 
     // For tracing.
@@ -1035,6 +1055,11 @@ private:
     // Returns true if the layer can draw shadows on its border.
     virtual bool canDrawShadows() const { return true; }
 
+    // Computes the cached bounds of this layer, but not of its children.
+    void computeOwnBounds(const FloatRect& parentBounds, const ui::Transform& parentTransform,
+                          float parentShadowRadius);
+    float getChildShadowRadius() const;
+
     Hwc2::IComposerClient::Composition getCompositionType(const DisplayDevice&) const;
 
     /**
@@ -1088,6 +1113,16 @@ private:
     // Layer bounds in screen space.
     FloatRect mScreenBounds;
 
+    // The parent bounds, transform and shadow radius that the properties above were computed from.
+    FloatRect mBoundsParentBounds;
+    ui::Transform mBoundsParentTransform;
+    float mBoundsParentShadowRadius = 0.f;
+
+    // Whether the geometry of this layer changed since its bounds were computed, and whether that
+    // of any layer below it did.
+    bool mGeometryDirty = true;
+    bool mChildGeometryDirty = true;
+
     bool mGetHandleCalled = false;
 
     // Tracks the process and user id of the caller when creating this layer
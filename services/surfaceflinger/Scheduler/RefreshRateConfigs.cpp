@@ -23,6 +23,7 @@
 
 #include "RefreshRateConfigs.h"
 #include <android-base/stringprintf.h>
+#include <math/HashCombine.h>
 #include <utils/Trace.h>
 #include <chrono>
 #include <cmath>
@@ -107,6 +108,52 @@ std::pair<nsecs_t, nsecs_t> RefreshRateConfigs::getDisplayFrames(nsecs_t layerPe
     return {quotient, remainder};
 }
 
+float RefreshRateConfigs::calculateCadenceScore(nsecs_t layerPeriod, nsecs_t displayPeriod,
+                                                bool isSeamlessSwitch) const {
+    // Slightly prefer seamless switches.
+    constexpr float kSeamedSwitchPenalty = 0.95f;
+    const float seamlessness = isSeamlessSwitch ? 1.0f : kSeamedSwitchPenalty;
+
+    // Calculate how many display vsyncs we need to present a single frame for this
+    // layer
+    const auto [displayFramesQuotient, displayFramesRemainder] =
+            getDisplayFrames(layerPeriod, displayPeriod);
+    static constexpr size_t MAX_FRAMES_TO_FIT = 10; // Stop calculating when score < 0.1
+    if (displayFramesRemainder == 0) {
+        // Layer desired refresh rate matches the display rate.
+        return 1.0f * seamlessness;
+    }
+
+    if (displayFramesQuotient == 0) {
+        // Layer desired refresh rate is higher than the display rate.
+        return (static_cast<float>(layerPeriod) / static_cast<float>(displayPeriod)) *
+                (1.0f / (MAX_FRAMES_TO_FIT + 1));
+    }
+
+    // Layer desired refresh rate is lower than the display rate. Check how well it fits
+    // the cadence.
+    auto diff = std::abs(displayFramesRemainder - (displayPeriod - displayFramesRemainder));
+    int iter = 2;
+    while (diff > MARGIN_FOR_PERIOD_CALCULATION && iter < MAX_FRAMES_TO_FIT) {
+        diff = diff - (displayPeriod - diff);
+        iter++;
+    }
+
+    return (1.0f / iter) * seamlessness;
+}
+
+std::optional<size_t> RefreshRateConfigs::findKnownFrameRateIndex(nsecs_t period) const {
+    // mKnownFrameRates is sorted by increasing frame rate, so by decreasing period.
+    const auto it = std::lower_bound(mKnownFrameRates.begin(), mKnownFrameRates.end(), period,
+                                     [](const Fps& fps, nsecs_t period) {
+                                         return fps.getPeriodNsecs() > period;
+                                     });
+    if (it == mKnownFrameRates.end() || it->getPeriodNsecs() != period) {
+        return {};
+    }
+    return static_cast<size_t>(std::distance(mKnownFrameRates.begin(), it));
+}
+
 bool RefreshRateConfigs::isVoteAllowed(const LayerRequirement& layer,
                                        const RefreshRate& refreshRate) const {
     switch (layer.vote) {
@@ -140,10 +187,6 @@ float RefreshRateConfigs::calculateLayerScoreLocked(const LayerRequirement& laye
         return 0;
     }
 
-    // Slightly prefer seamless switches.
-    constexpr float kSeamedSwitchPenalty = 0.95f;
-    const float seamlessness = isSeamlessSwitch ? 1.0f : kSeamedSwitchPenalty;
-
     // If the layer wants Max, give higher score to the higher refresh rate
     if (layer.vote == LayerVoteType::Max) {
         const auto ratio =
@@ -169,32 +212,7 @@ float RefreshRateConfigs::calculateLayerScoreLocked(const LayerRequirement& laye
 
     if (layer.vote == LayerVoteType::ExplicitExactOrMultiple ||
         layer.vote == LayerVoteType::Heuristic) {
-        // Calculate how many display vsyncs we need to present a single frame for this
-        // layer
-        const auto [displayFramesQuotient, displayFramesRemainder] =
-                getDisplayFrames(layerPeriod, displayPeriod);
-        static constexpr size_t MAX_FRAMES_TO_FIT = 10; // Stop calculating when score < 0.1
-        if (displayFramesRemainder == 0) {
-            // Layer desired refresh rate matches the display rate.
-            return 1.0f * seamlessness;
-        }
-
-        if (displayFramesQuotient == 0) {
-            // Layer desired refresh rate is higher than the display rate.
-            return (static_cast<float>(layerPeriod) / static_cast<float>(displayPeriod)) *
-                    (1.0f / (MAX_FRAMES_TO_FIT + 1));
-        }
-
-        // Layer desired refresh rate is lower than the display rate. Check how well it fits
-        // the cadence.
-        auto diff = std::abs(displayFramesRemainder - (displayPeriod - displayFramesRemainder));
-        int iter = 2;
-        while (diff > MARGIN_FOR_PERIOD_CALCULATION && iter < MAX_FRAMES_TO_FIT) {
-            diff = diff - (displayPeriod - diff);
-            iter++;
-        }
-
-        return (1.0f / iter) * seamlessness;
+        return calculateCadenceScore(layerPeriod, displayPeriod, isSeamlessSwitch);
     }
 
     if (layer.vote == LayerVoteType::ExplicitExact) {
@@ -228,7 +246,7 @@ RefreshRate RefreshRateConfigs::getBestRefreshRate(const std::vector<LayerRequir
 
     GlobalSignals signalsConsidered;
     RefreshRate result = getBestRefreshRateLocked(layers, globalSignals, &signalsConsidered);
-    lastBestRefreshRateInvocation.emplace(
+    cacheBestRefreshRateInvocation(
             GetBestRefreshRateInvocation{.layerRequirements = layers,
                                          .globalSignals = globalSignals,
                                          .outSignalsConsidered = signalsConsidered,
@@ -239,21 +257,54 @@ RefreshRate RefreshRateConfigs::getBestRefreshRate(const std::vector<LayerRequir
     return result;
 }
 
+size_t RefreshRateConfigs::hashBestRefreshRateArgs(const std::vector<LayerRequirement>& layers,
+                                                   const GlobalSignals& globalSignals) {
+    size_t hash = hashCombine(globalSignals.touch, globalSignals.idle);
+    for (const LayerRequirement& layer : layers) {
+        hashCombineSingleHashed(hash,
+                                hashCombine(layer.vote, layer.desiredRefreshRate,
+                                            layer.seamlessness, layer.weight, layer.focused));
+    }
+    return hash;
+}
+
 std::optional<RefreshRate> RefreshRateConfigs::getCachedBestRefreshRate(
         const std::vector<LayerRequirement>& layers, const GlobalSignals& globalSignals,
         GlobalSignals* outSignalsConsidered) const {
-    const bool sameAsLastCall = lastBestRefreshRateInvocation &&
-            lastBestRefreshRateInvocation->layerRequirements == layers &&
-            lastBestRefreshRateInvocation->globalSignals == globalSignals;
+    const size_t hash = hashBestRefreshRateArgs(layers, globalSignals);
+    const auto it = std::find_if(mBestRefreshRateCache.begin(), mBestRefreshRateCache.end(),
+                                 [&](const auto& entry) {
+                                     const auto& [entryHash, invocation] = entry;
+                                     return entryHash == hash &&
+                                             invocation.globalSignals == globalSignals &&
+                                             invocation.layerRequirements == layers;
+                                 });
+    if (it == mBestRefreshRateCache.end()) {
+        return {};
+    }
 
-    if (sameAsLastCall) {
-        if (outSignalsConsidered) {
-            *outSignalsConsidered = lastBestRefreshRateInvocation->outSignalsConsidered;
-        }
-        return lastBestRefreshRateInvocation->resultingBestRefreshRate;
+    // Move the invocation to the front, so that the least recently used one is evicted first.
+    if (it != mBestRefreshRateCache.begin()) {
+        auto entry = std::move(*it);
+        mBestRefreshRateCache.erase(it);
+        mBestRefreshRateCache.push_front(std::move(entry));
     }
 
-    return {};
+    const GetBestRefreshRateInvocation& invocation = mBestRefreshRateCache.front().second;
+    if (outSignalsConsidered) {
+        *outSignalsConsidered = invocation.outSignalsConsidered;
+    }
+    return invocation.resultingBestRefreshRate;
+}
+
+void RefreshRateConfigs::cacheBestRefreshRateInvocation(
+        GetBestRefreshRateInvocation invocation) const {
+    const size_t hash =
+            hashBestRefreshRateArgs(invocation.layerRequirements, invocation.globalSignals);
+    mBestRefreshRateCache.emplace_front(hash, std::move(invocation));
+    if (mBestRefreshRateCache.size() > kBestRefreshRateCacheSize) {
+        mBestRefreshRateCache.pop_back();
+    }
 }
 
 RefreshRate RefreshRateConfigs::getBestRefreshRateLocked(
@@ -360,6 +411,36 @@ RefreshRate RefreshRateConfigs::getBestRefreshRateLocked(
 
     const auto& defaultMode = mRefreshRates.at(policy->defaultMode);
 
+    // What decides whether a layer may score a refresh rate, apart from the layer itself, is the
+    // same for every layer.
+    struct RefreshRateTraits {
+        bool isSeamlessSwitch;
+        bool isInPolicyForDefault;
+        bool inPrimaryRange;
+        const std::vector<CadenceScore>* cadenceScores;
+    };
+    std::vector<RefreshRateTraits> traits;
+    traits.reserve(scores.size());
+    for (const RefreshRateScore& score : scores) {
+        const RefreshRate* refreshRate = score.refreshRate;
+        const bool isSeamlessSwitch =
+                refreshRate->getModeGroup() == mCurrentRefreshRate->getModeGroup();
+        // Layers with default seamlessness vote for the current mode group if
+        // there are layers with seamlessness=SeamedAndSeamless and for the default
+        // mode group otherwise. In second case, if the current mode group is different
+        // from the default, this means a layer with seamlessness=SeamedAndSeamless has just
+        // disappeared.
+        const bool isInPolicyForDefault = seamedFocusedLayers > 0
+                ? isSeamlessSwitch
+                : refreshRate->getModeGroup() == defaultMode->getModeGroup();
+        traits.push_back(
+                {.isSeamlessSwitch = isSeamlessSwitch,
+                 .isInPolicyForDefault = isInPolicyForDefault,
+                 .inPrimaryRange =
+                         refreshRate->inPolicy(policy->primaryRange.min, policy->primaryRange.max),
+                 .cadenceScores = &mKnownFrameRateCadenceScores.at(refreshRate->getModeId())});
+    }
+
     for (const auto& layer : layers) {
         ALOGV("Calculating score for %s (%s, weight %.2f, desired %.2f) ", layer.name.c_str(),
               layerVoteTypeString(layer.vote).c_str(), layer.weight,
@@ -370,9 +451,16 @@ RefreshRate RefreshRateConfigs::getBestRefreshRateLocked(
 
         auto weight = layer.weight;
 
+        // Heuristic layers vote for known frame rates, as do most ExplicitExactOrMultiple ones,
+        // so their score can be looked up rather than calculated.
+        const std::optional<size_t> knownFrameRateIndex =
+                (layer.vote == LayerVoteType::ExplicitExactOrMultiple ||
+                 layer.vote == LayerVoteType::Heuristic)
+                ? findKnownFrameRateIndex(layer.desiredRefreshRate.getPeriodNsecs())
+                : std::nullopt;
+
         for (auto i = 0u; i < scores.size(); i++) {
-            const bool isSeamlessSwitch =
-                    scores[i].refreshRate->getModeGroup() == mCurrentRefreshRate->getModeGroup();
+            const bool isSeamlessSwitch = traits[i].isSeamlessSwitch;
 
             if (layer.seamlessness == Seamlessness::OnlySeamless && !isSeamlessSwitch) {
                 ALOGV("%s ignores %s to avoid non-seamless switch. Current mode = %s",
@@ -392,25 +480,14 @@ RefreshRate RefreshRateConfigs::getBestRefreshRateLocked(
                 continue;
             }
 
-            // Layers with default seamlessness vote for the current mode group if
-            // there are layers with seamlessness=SeamedAndSeamless and for the default
-            // mode group otherwise. In second case, if the current mode group is different
-            // from the default, this means a layer with seamlessness=SeamedAndSeamless has just
-            // disappeared.
-            const bool isInPolicyForDefault = seamedFocusedLayers > 0
-                    ? scores[i].refreshRate->getModeGroup() == mCurrentRefreshRate->getModeGroup()
-                    : scores[i].refreshRate->getModeGroup() == defaultMode->getModeGroup();
-
-            if (layer.seamlessness == Seamlessness::Default && !isInPolicyForDefault) {
+            if (layer.seamlessness == Seamlessness::Default && !traits[i].isInPolicyForDefault) {
                 ALOGV("%s ignores %s. Current mode = %s", formatLayerInfo(layer, weight).c_str(),
                       scores[i].refreshRate->toString().c_str(),
                       mCurrentRefreshRate->toString().c_str());
                 continue;
             }
 
-            bool inPrimaryRange = scores[i].refreshRate->inPolicy(policy->primaryRange.min,
-                                                                  policy->primaryRange.max);
-            if ((primaryRangeIsSingleRate || !inPrimaryRange) &&
+            if ((primaryRangeIsSingleRate || !traits[i].inPrimaryRange) &&
                 !(layer.focused &&
                   (layer.vote == LayerVoteType::ExplicitDefault ||
                    layer.vote == LayerVoteType::ExplicitExact))) {
@@ -419,8 +496,14 @@ RefreshRate RefreshRateConfigs::getBestRefreshRateLocked(
                 continue;
             }
 
-            const auto layerScore =
-                    calculateLayerScoreLocked(layer, *scores[i].refreshRate, isSeamlessSwitch);
+            float layerScore;
+            if (knownFrameRateIndex && isVoteAllowed(layer, *scores[i].refreshRate)) {
+                const CadenceScore& cadenceScore = (*traits[i].cadenceScores)[*knownFrameRateIndex];
+                layerScore = isSeamlessSwitch ? cadenceScore.seamless : cadenceScore.seamed;
+            } else {
+                layerScore =
+                        calculateLayerScoreLocked(layer, *scores[i].refreshRate, isSeamlessSwitch);
+            }
             ALOGV("%s gives %s score of %.2f", formatLayerInfo(layer, weight).c_str(),
                   scores[i].refreshRate->getName().c_str(), layerScore);
             scores[i].score += weight * layerScore;
@@ -669,9 +752,9 @@ const RefreshRate& RefreshRateConfigs::getCurrentRefreshRateByPolicyLocked() con
 void RefreshRateConfigs::setCurrentModeId(DisplayModeId modeId) {
     std::lock_guard lock(mLock);
 
-    // Invalidate the cached invocation to getBestRefreshRate. This forces
+    // Invalidate the cached invocations of getBestRefreshRate. This forces
     // the refresh rate to be recomputed on the next call to getBestRefreshRate.
-    lastBestRefreshRateInvocation.reset();
+    mBestRefreshRateCache.clear();
 
     mCurrentRefreshRate = mRefreshRates.at(modeId).get();
 }
@@ -691,11 +774,12 @@ void RefreshRateConfigs::updateDisplayModes(const DisplayModes& modes,
         return mode->getId() == currentModeId;
     }));
 
-    // Invalidate the cached invocation to getBestRefreshRate. This forces
+    // Invalidate the cached invocations of getBestRefreshRate. This forces
     // the refresh rate to be recomputed on the next call to getBestRefreshRate.
-    lastBestRefreshRateInvocation.reset();
+    mBestRefreshRateCache.clear();
 
     mRefreshRates.clear();
+    mKnownFrameRateCadenceScores.clear();
     for (const auto& mode : modes) {
         const auto modeId = mode->getId();
         mRefreshRates.emplace(modeId,
@@ -704,6 +788,17 @@ void RefreshRateConfigs::updateDisplayModes(const DisplayModes& modes,
         if (modeId == currentModeId) {
             mCurrentRefreshRate = mRefreshRates.at(modeId).get();
         }
+
+        std::vector<CadenceScore>& cadenceScores = mKnownFrameRateCadenceScores[modeId];
+        cadenceScores.reserve(mKnownFrameRates.size());
+        for (const Fps& frameRate : mKnownFrameRates) {
+            const nsecs_t layerPeriod = frameRate.getPeriodNsecs();
+            cadenceScores.push_back(
+                    {.seamless = calculateCadenceScore(layerPeriod, mode->getVsyncPeriod(),
+                                                       true /*isSeamlessSwitch*/),
+                     .seamed = calculateCadenceScore(layerPeriod, mode->getVsyncPeriod(),
+                                                     false /*isSeamlessSwitch*/)});
+        }
     }
 
     std::vector<const RefreshRate*> sortedModes;
@@ -751,7 +846,7 @@ status_t RefreshRateConfigs::setDisplayManagerPolicy(const Policy& policy) {
         ALOGE("Invalid refresh rate policy: %s", policy.toString().c_str());
         return BAD_VALUE;
     }
-    lastBestRefreshRateInvocation.reset();
+    mBestRefreshRateCache.clear();
     Policy previousPolicy = *getCurrentPolicyLocked();
     mDisplayManagerPolicy = policy;
     if (*getCurrentPolicyLocked() == previousPolicy) {
@@ -766,7 +861,7 @@ status_t RefreshRateConfigs::setOverridePolicy(const std::optional<Policy>& poli
     if (policy && !isPolicyValidLocked(*policy)) {
         return BAD_VALUE;
     }
-    lastBestRefreshRateInvocation.reset();
+    mBestRefreshRateCache.clear();
     Policy previousPolicy = *getCurrentPolicyLocked();
     mOverridePolicy = policy;
     if (*getCurrentPolicyLocked() == previousPolicy) {
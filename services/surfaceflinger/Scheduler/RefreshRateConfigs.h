@@ -20,6 +20,7 @@
 #include <gui/DisplayEventReceiver.h>
 
 #include <algorithm>
+#include <deque>
 #include <numeric>
 #include <optional>
 #include <type_traits>
@@ -368,6 +369,14 @@ private:
                                                         GlobalSignals* outSignalsConsidered) const
             REQUIRES(mLock);
 
+    struct GetBestRefreshRateInvocation;
+    void cacheBestRefreshRateInvocation(GetBestRefreshRateInvocation) const REQUIRES(mLock);
+
+    // Hashes what getBestRefreshRateLocked looks at in its arguments. Layer names and uids are left
+    // out, as they do not change the result.
+    static size_t hashBestRefreshRateArgs(const std::vector<LayerRequirement>& layers,
+                                          const GlobalSignals& globalSignals);
+
     RefreshRate getBestRefreshRateLocked(const std::vector<LayerRequirement>& layers,
                                          const GlobalSignals& globalSignals,
                                          GlobalSignals* outSignalsConsidered) const REQUIRES(mLock);
@@ -382,6 +391,14 @@ private:
     // display refresh period.
     std::pair<nsecs_t, nsecs_t> getDisplayFrames(nsecs_t layerPeriod, nsecs_t displayPeriod) const;
 
+    // Returns how well a layer voting ExplicitExactOrMultiple or Heuristic with the given period
+    // fits the cadence of the display period.
+    float calculateCadenceScore(nsecs_t layerPeriod, nsecs_t displayPeriod,
+                                bool isSeamlessSwitch) const;
+
+    // Returns the index in mKnownFrameRates of the frame rate with exactly the given period.
+    std::optional<size_t> findKnownFrameRateIndex(nsecs_t period) const;
+
     // Returns the lowest refresh rate according to the current policy. May change at runtime. Only
     // uses the primary range, not the app request range.
     const RefreshRate& getMinRefreshRateByPolicyLocked() const REQUIRES(mLock);
@@ -437,6 +454,15 @@ private:
     // from based on the closest value.
     const std::vector<Fps> mKnownFrameRates;
 
+    // The cadence scores of each of mKnownFrameRates against each display mode, so that scoring
+    // the layers that vote for them is a lookup.
+    struct CadenceScore {
+        float seamless;
+        float seamed;
+    };
+    std::unordered_map<DisplayModeId, std::vector<CadenceScore>> mKnownFrameRateCadenceScores
+            GUARDED_BY(mLock);
+
     const Config mConfig;
     bool mSupportsFrameRateOverride;
 
@@ -446,7 +472,12 @@ private:
         GlobalSignals outSignalsConsidered;
         RefreshRate resultingBestRefreshRate;
     };
-    mutable std::optional<GetBestRefreshRateInvocation> lastBestRefreshRateInvocation
+
+    // The most recent invocations of getBestRefreshRate, most recent first, along with the hash of
+    // their arguments. The layers tend to go back and forth between a few sets of votes, e.g. as
+    // a video is paused and resumed, so a few entries are enough.
+    static constexpr size_t kBestRefreshRateCacheSize = 8;
+    mutable std::deque<std::pair<size_t, GetBestRefreshRateInvocation>> mBestRefreshRateCache
             GUARDED_BY(mLock);
 };
 
@@ -40,6 +40,12 @@ using base::StringAppendF;
 
 static auto constexpr kMaxPercent = 100u;
 
+// TODO (b/144707443): its important that there's some precision in the mean of the ordinals
+//                     for the intercept calculation, so scale the ordinals by 1000 to continue
+//                     fixed point calculation. Explore expanding
+//                     scheduler::utils::calculate_mean to have a fixed point fractional part.
+static constexpr int64_t kScalingFactor = 1000;
+
 VSyncPredictor::~VSyncPredictor() = default;
 
 VSyncPredictor::VSyncPredictor(nsecs_t idealPeriod, size_t historySize,
@@ -74,11 +80,14 @@ bool VSyncPredictor::validate(nsecs_t timestamp) const {
         return false;
     }
 
-    const auto iter = std::min_element(mTimestamps.begin(), mTimestamps.end(),
-                                       [timestamp](nsecs_t a, nsecs_t b) {
-                                           return std::abs(timestamp - a) < std::abs(timestamp - b);
-                                       });
-    const auto distancePercent = std::abs(*iter - timestamp) * kMaxPercent / mIdealPeriod;
+    // While the timestamps are in order, the closest one to a later timestamp is the newest.
+    const auto closest = mOutOfOrderCount == 0 && timestamp > aValidTimestamp
+            ? aValidTimestamp
+            : *std::min_element(mTimestamps.begin(), mTimestamps.end(),
+                                [timestamp](nsecs_t a, nsecs_t b) {
+                                    return std::abs(timestamp - a) < std::abs(timestamp - b);
+                                });
+    const auto distancePercent = std::abs(closest - timestamp) * kMaxPercent / mIdealPeriod;
     if (distancePercent < kOutlierTolerancePercent) {
         // duplicate timestamp
         return false;
@@ -113,16 +122,35 @@ bool VSyncPredictor::addVsyncTimestamp(nsecs_t timestamp) {
         return false;
     }
 
+    const bool wasInOrder = mOutOfOrderCount == 0;
+    if (kHistorySize > 1 && !mTimestamps.empty() && timestamp < mTimestamps[mLastTimestampIndex]) {
+        mOutOfOrderCount++;
+    }
+
     if (mTimestamps.size() != kHistorySize) {
         mTimestamps.push_back(timestamp);
+        mOrdinals.push_back(0);
         mLastTimestampIndex = next(mLastTimestampIndex);
     } else {
+        evictOldestTimestamp(wasInOrder);
         mLastTimestampIndex = next(mLastTimestampIndex);
         mTimestamps[mLastTimestampIndex] = timestamp;
     }
+    traceInt64If("VSP-ts", timestamp);
 
     if (mTimestamps.size() < kMinimumSamplesForPrediction) {
         mRateMap[mIdealPeriod] = {mIdealPeriod, 0};
+    }
+
+    auto it = mRateMap.find(mIdealPeriod);
+    auto const currentPeriod = it->second.slope;
+    if (wasInOrder && mOutOfOrderCount == 0) {
+        addNewestTimestampToSums(currentPeriod);
+    } else {
+        recomputeSums(currentPeriod);
+    }
+
+    if (mTimestamps.size() < kMinimumSamplesForPrediction) {
         return true;
     }
 
@@ -141,39 +169,16 @@ bool VSyncPredictor::addVsyncTimestamp(nsecs_t timestamp) {
     //
     // intercept = mean(Y) - slope * mean(X)
     //
-    std::vector<nsecs_t> vsyncTS(mTimestamps.size());
-    std::vector<nsecs_t> ordinals(mTimestamps.size());
-
-    // normalizing to the oldest timestamp cuts down on error in calculating the intercept.
-    auto const oldest_ts = *std::min_element(mTimestamps.begin(), mTimestamps.end());
-    auto it = mRateMap.find(mIdealPeriod);
-    auto const currentPeriod = it->second.slope;
-    // TODO (b/144707443): its important that there's some precision in the mean of the ordinals
-    //                     for the intercept calculation, so scale the ordinals by 1000 to continue
-    //                     fixed point calculation. Explore expanding
-    //                     scheduler::utils::calculate_mean to have a fixed point fractional part.
-    static constexpr int64_t kScalingFactor = 1000;
+    // Both sums are expanded in terms of the running sums of X, Y, X^2 and XY, which gives the
+    // same result as summing over the centered values, means truncated as they are.
+    auto const count = static_cast<int64_t>(mTimestamps.size());
+    auto const meanTS = mSums.timestamps / count;
+    auto const meanOrdinal = mSums.ordinals / count;
 
-    for (auto i = 0u; i < mTimestamps.size(); i++) {
-        traceInt64If("VSP-ts", mTimestamps[i]);
-
-        vsyncTS[i] = mTimestamps[i] - oldest_ts;
-        ordinals[i] = ((vsyncTS[i] + (currentPeriod / 2)) / currentPeriod) * kScalingFactor;
-    }
-
-    auto meanTS = scheduler::calculate_mean(vsyncTS);
-    auto meanOrdinal = scheduler::calculate_mean(ordinals);
-    for (size_t i = 0; i < vsyncTS.size(); i++) {
-        vsyncTS[i] -= meanTS;
-        ordinals[i] -= meanOrdinal;
-    }
-
-    auto top = 0ll;
-    auto bottom = 0ll;
-    for (size_t i = 0; i < vsyncTS.size(); i++) {
-        top += vsyncTS[i] * ordinals[i];
-        bottom += ordinals[i] * ordinals[i];
-    }
+    auto const top = mSums.products - meanOrdinal * mSums.timestamps -
+            meanTS * mSums.ordinals + count * meanOrdinal * meanTS;
+    auto const bottom = mSums.squaredOrdinals - 2 * meanOrdinal * mSums.ordinals +
+            count * meanOrdinal * meanOrdinal;
 
     if (CC_UNLIKELY(bottom == 0)) {
         it->second = {mIdealPeriod, 0};
@@ -335,8 +340,74 @@ void VSyncPredictor::clearTimestamps() {
         }
 
         mTimestamps.clear();
+        mOrdinals.clear();
         mLastTimestampIndex = 0;
     }
+    mSums = {};
+    mOutOfOrderCount = 0;
+}
+
+// Drops the oldest timestamp, which is about to be overwritten, from the sums.
+void VSyncPredictor::evictOldestTimestamp(bool inOrder) {
+    if (mTimestamps.size() == 1) {
+        mSums = {};
+        return;
+    }
+
+    const size_t oldest = next(mLastTimestampIndex);
+    const size_t nextOldest = next(oldest);
+    if (mTimestamps[nextOldest] < mTimestamps[oldest]) {
+        mOutOfOrderCount--;
+    }
+    if (!inOrder) {
+        return;
+    }
+
+    // The oldest timestamp is what the sums are relative to, so it adds nothing to them. Make them
+    // relative to the next oldest instead.
+    auto const count = static_cast<int64_t>(mTimestamps.size()) - 1;
+    auto const dx = mOrdinals[nextOldest] - mOrdinals[oldest];
+    auto const dy = mTimestamps[nextOldest] - mTimestamps[oldest];
+    mSums.squaredOrdinals += count * dx * dx - 2 * dx * mSums.ordinals;
+    mSums.products += count * dx * dy - dx * mSums.timestamps - dy * mSums.ordinals;
+    mSums.ordinals -= count * dx;
+    mSums.timestamps -= count * dy;
+}
+
+// Snaps the newest timestamp to an ordinal relative to the oldest one, and adds it to the sums.
+void VSyncPredictor::addNewestTimestampToSums(nsecs_t currentPeriod) {
+    const size_t newest = mLastTimestampIndex;
+    const size_t oldest = next(newest);
+    if (newest == oldest) {
+        mOrdinals[newest] = 0;
+        mSums = {};
+        return;
+    }
+
+    auto const y = mTimestamps[newest] - mTimestamps[oldest];
+    auto const x = ((y + (currentPeriod / 2)) / currentPeriod) * kScalingFactor;
+    mOrdinals[newest] = mOrdinals[oldest] + x;
+    mSums.ordinals += x;
+    mSums.timestamps += y;
+    mSums.squaredOrdinals += x * x;
+    mSums.products += x * y;
+}
+
+// Snaps all the timestamps to ordinals relative to the earliest one, which is needed when they
+// are not in order.
+void VSyncPredictor::recomputeSums(nsecs_t currentPeriod) {
+    // normalizing to the oldest timestamp cuts down on error in calculating the intercept.
+    auto const oldest = *std::min_element(mTimestamps.begin(), mTimestamps.end());
+    mSums = {};
+    for (size_t i = 0; i < mTimestamps.size(); i++) {
+        auto const y = mTimestamps[i] - oldest;
+        auto const x = ((y + (currentPeriod / 2)) / currentPeriod) * kScalingFactor;
+        mOrdinals[i] = x;
+        mSums.ordinals += x;
+        mSums.timestamps += y;
+        mSums.squaredOrdinals += x * x;
+        mSums.products += x * y;
+    }
 }
 
 bool VSyncPredictor::needsMoreSamples() const {
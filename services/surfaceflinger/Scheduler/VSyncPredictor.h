@@ -72,6 +72,9 @@ private:
     VSyncPredictor(VSyncPredictor const&) = delete;
     VSyncPredictor& operator=(VSyncPredictor const&) = delete;
     void clearTimestamps() REQUIRES(mMutex);
+    void evictOldestTimestamp(bool inOrder) REQUIRES(mMutex);
+    void addNewestTimestampToSums(nsecs_t currentPeriod) REQUIRES(mMutex);
+    void recomputeSums(nsecs_t currentPeriod) REQUIRES(mMutex);
 
     inline void traceInt64If(const char* name, int64_t value) const;
     bool const mTraceOn;
@@ -99,6 +102,24 @@ private:
 
     size_t mLastTimestampIndex GUARDED_BY(mMutex) = 0;
     std::vector<nsecs_t> mTimestamps GUARDED_BY(mMutex);
+
+    // The snapped ordinal of each entry of mTimestamps, scaled by kScalingFactor.
+    std::vector<int64_t> mOrdinals GUARDED_BY(mMutex);
+
+    // Sums over mTimestamps that the linear regression is computed from, relative to the oldest
+    // timestamp and its ordinal. They are updated as timestamps enter and leave the ring buffer.
+    struct RegressionSums {
+        int64_t ordinals = 0;
+        int64_t timestamps = 0;
+        int64_t squaredOrdinals = 0;
+        int64_t products = 0;
+    };
+    RegressionSums mSums GUARDED_BY(mMutex);
+
+    // The number of entries of mTimestamps that are earlier than the one added before them. The
+    // sums are only updated incrementally while there are none, as the oldest timestamp is then
+    // also the earliest.
+    size_t mOutOfOrderCount GUARDED_BY(mMutex) = 0;
 };
 
 } // namespace android::scheduler
@@ -466,6 +466,9 @@ SurfaceFlinger::SurfaceFlinger(Factory& factory) : SurfaceFlinger(factory, SkipI
     property_get("debug.sf.disable_client_composition_cache", value, "0");
     mDisableClientCompositionCache = atoi(value);
 
+    mDebugVerifyLayerBounds = base::GetBoolProperty("debug.sf.verify_layer_bounds"s, false);
+    ALOGI_IF(mDebugVerifyLayerBounds, "Verifying incremental layer bounds");
+
     // We should be reading 'persist.sys.sf.color_saturation' here
     // but since /data may be encrypted, we need to wait until after vold
     // comes online to attempt to read the property. The property is
@@ -808,6 +811,10 @@ void SurfaceFlinger::init() {
         ALOGW("Failed to set main task profile");
     }
 
+    // Started here rather than by the first transaction with unsignaled fences, so that the thread
+    // does not inherit the priority and cgroup of whichever binder thread queued it.
+    mTransactionFenceWatcher.start();
+
     mCompositionEngine->setTimeStats(mTimeStats);
     mCompositionEngine->setHwComposer(getFactory().createHWComposer(mHwcServiceName));
     mCompositionEngine->getHwComposer().setCallback(this);
@@ -817,6 +824,10 @@ void SurfaceFlinger::init() {
         enableHalVirtualDisplays(true);
     }
 
+    // Outputs are prepared and composed serially unless enabled.
+    mCompositionEngine->setParallelOutputCompositionEnabled(
+            base::GetBoolProperty("debug.sf.enable_parallel_output_composition"s, false));
+
     // Process any initial hotplug and resulting display changes.
     processDisplayHotplugEventsLocked();
     const auto display = getDefaultDisplayDeviceLocked();
@@ -2454,6 +2465,37 @@ FloatRect SurfaceFlinger::getLayerClipBoundsForDisplay(const DisplayDevice& disp
 }
 
 void SurfaceFlinger::computeLayerBounds() {
+    ATRACE_CALL();
+
+    // The source bounds of layers that are transformed to the inverse of the display depend on
+    // the rotation of the primary display, which is not part of any layer's state.
+    const auto rotationFlags = DisplayDevice::getPrimaryDisplayRotationFlags();
+    if (rotationFlags != mLayerBoundsRotationFlags) {
+        mLayerBoundsRotationFlags = rotationFlags;
+        computeLayerBoundsForDisplays(true /* fullUpdate */);
+        return;
+    }
+
+    computeLayerBoundsForDisplays(false /* fullUpdate */);
+    if (!mDebugVerifyLayerBounds) {
+        return;
+    }
+
+    std::unordered_map<const Layer*, Layer::CachedBounds> updatedBounds;
+    mDrawingState.traverse(
+            [&](Layer* layer) { updatedBounds.emplace(layer, layer->getCachedBounds()); });
+    computeLayerBoundsForDisplays(true /* fullUpdate */);
+    for (const auto& [layer, bounds] : updatedBounds) {
+        const Layer::CachedBounds expectedBounds = layer->getCachedBounds();
+        ALOGE_IF(!(bounds == expectedBounds),
+                 "Incremental bounds of %s do not match a full recompute: "
+                 "screen bounds %s, expected %s",
+                 layer->getDebugName(), to_string(Rect{bounds.screenBounds}).c_str(),
+                 to_string(Rect{expectedBounds.screenBounds}).c_str());
+    }
+}
+
+void SurfaceFlinger::computeLayerBoundsForDisplays(bool fullUpdate) {
     for (const auto& pair : ON_MAIN_THREAD(mDisplays)) {
         const auto& displayDevice = pair.second;
         const auto display = displayDevice->getCompositionDisplay();
@@ -2463,8 +2505,13 @@ void SurfaceFlinger::computeLayerBounds() {
                 continue;
             }
 
-            layer->computeBounds(getLayerClipBoundsForDisplay(*displayDevice), ui::Transform(),
-                                 0.f /* shadowRadius */);
+            if (fullUpdate) {
+                layer->computeBounds(getLayerClipBoundsForDisplay(*displayDevice),
+                                     ui::Transform(), 0.f /* shadowRadius */);
+            } else {
+                layer->updateBounds(getLayerClipBoundsForDisplay(*displayDevice),
+                                    ui::Transform(), 0.f /* shadowRadius */);
+            }
         }
     }
 }
@@ -3385,9 +3432,15 @@ bool SurfaceFlinger::handlePageFlip() {
         Mutex::Autolock lock(mStateLock);
 
         for (const auto& layer : mLayersWithQueuedFrames) {
-            if (layer->latchBuffer(visibleRegions, latchTime, expectedPresentTime)) {
+            bool layerVisibleRegions = false;
+            if (layer->latchBuffer(layerVisibleRegions, latchTime, expectedPresentTime)) {
                 mLayersPendingRefresh.push_back(layer);
             }
+            if (layerVisibleRegions) {
+                // The size or transform of the buffer may have changed the layer's bounds.
+                layer->setGeometryDirty();
+                visibleRegions = true;
+            }
             layer->useSurfaceDamage();
             if (layer->isBufferLatched()) {
                 newDataLatched = true;
@@ -3503,6 +3556,7 @@ void SurfaceFlinger::flushTransactionQueues() {
         Mutex::Autolock _l(mStateLock);
         {
             Mutex::Autolock _l(mQueueLock);
+            mPendingQueuesWaitingOnFences = 0;
             // Collect transactions from pending transaction queue.
             auto it = mPendingTransactionQueues.begin();
             while (it != mPendingTransactionQueues.end()) {
@@ -3510,11 +3564,14 @@ void SurfaceFlinger::flushTransactionQueues() {
 
                 while (!transactionQueue.empty()) {
                     auto& transaction = transactionQueue.front();
-                    if (!transactionIsReadyToBeApplied(transaction.frameTimelineInfo,
-                                                       transaction.isAutoTimestamp,
-                                                       transaction.desiredPresentTime,
-                                                       transaction.originUid, transaction.states,
-                                                       bufferLayersReadyToPresent)) {
+                    const TransactionReadiness readiness =
+                            transactionIsReadyToBeApplied(transaction, bufferLayersReadyToPresent);
+                    if (readiness == TransactionReadiness::NotReadyUnsignaledFences) {
+                        // The fence watcher flushes again once the fences signal.
+                        mPendingQueuesWaitingOnFences++;
+                        break;
+                    }
+                    if (readiness == TransactionReadiness::NotReady) {
                         setTransactionFlags(eTransactionFlushNeeded);
                         break;
                     }
@@ -3541,12 +3598,13 @@ void SurfaceFlinger::flushTransactionQueues() {
                 auto& transaction = mTransactionQueue.front();
                 bool pendingTransactions = mPendingTransactionQueues.find(transaction.applyToken) !=
                         mPendingTransactionQueues.end();
-                if (pendingTransactions ||
-                    !transactionIsReadyToBeApplied(transaction.frameTimelineInfo,
-                                                   transaction.isAutoTimestamp,
-                                                   transaction.desiredPresentTime,
-                                                   transaction.originUid, transaction.states,
-                                                   bufferLayersReadyToPresent)) {
+                const TransactionReadiness readiness = pendingTransactions
+                        ? TransactionReadiness::NotReady
+                        : transactionIsReadyToBeApplied(transaction, bufferLayersReadyToPresent);
+                if (readiness != TransactionReadiness::Ready) {
+                    if (readiness == TransactionReadiness::NotReadyUnsignaledFences) {
+                        mPendingQueuesWaitingOnFences++;
+                    }
                     mPendingTransactionQueues[transaction.applyToken].push(std::move(transaction));
                 } else {
                     transaction.traverseStatesWithBuffers([&](const layer_state_t& state) {
@@ -3578,10 +3636,12 @@ void SurfaceFlinger::flushTransactionQueues() {
 
 bool SurfaceFlinger::transactionFlushNeeded() {
     Mutex::Autolock _l(mQueueLock);
-    return !mPendingTransactionQueues.empty() || !mTransactionQueue.empty();
+    return mPendingTransactionQueues.size() > mPendingQueuesWaitingOnFences ||
+            !mTransactionQueue.empty();
 }
 
-bool SurfaceFlinger::frameIsEarly(nsecs_t expectedPresentTime, int64_t vsyncId) const {
+bool SurfaceFlinger::frameIsEarly(nsecs_t expectedPresentTime,
+                                  std::optional<nsecs_t> predictedPresentTime) const {
     // The amount of time SF can delay a frame if it is considered early based
     // on the VsyncModulator::VsyncConfig::appWorkDuration
     constexpr static std::chrono::nanoseconds kEarlyLatchMaxThreshold = 100ms;
@@ -3589,81 +3649,105 @@ bool SurfaceFlinger::frameIsEarly(nsecs_t expectedPresentTime, int64_t vsyncId)
     const auto currentVsyncPeriod = mScheduler->getDisplayStatInfo(systemTime()).vsyncPeriod;
     const auto earlyLatchVsyncThreshold = currentVsyncPeriod / 2;
 
-    const auto prediction = mFrameTimeline->getTokenManager()->getPredictionsForToken(vsyncId);
-    if (!prediction.has_value()) {
+    if (!predictedPresentTime.has_value()) {
         return false;
     }
 
-    if (std::abs(prediction->presentTime - expectedPresentTime) >=
-        kEarlyLatchMaxThreshold.count()) {
+    if (std::abs(*predictedPresentTime - expectedPresentTime) >= kEarlyLatchMaxThreshold.count()) {
         return false;
     }
 
-    return prediction->presentTime >= expectedPresentTime &&
-            prediction->presentTime - expectedPresentTime >= earlyLatchVsyncThreshold;
+    return *predictedPresentTime >= expectedPresentTime &&
+            *predictedPresentTime - expectedPresentTime >= earlyLatchVsyncThreshold;
 }
 
-bool SurfaceFlinger::transactionIsReadyToBeApplied(
-        const FrameTimelineInfo& info, bool isAutoTimestamp, int64_t desiredPresentTime,
-        uid_t originUid, const Vector<ComposerState>& states,
+SurfaceFlinger::TransactionReadiness SurfaceFlinger::transactionIsReadyToBeApplied(
+        const TransactionState& transaction,
         const std::unordered_set<sp<IBinder>, ISurfaceComposer::SpHash<IBinder>>&
                 bufferLayersReadyToPresent) const {
     ATRACE_CALL();
     const nsecs_t expectedPresentTime = mExpectedPresentTime.load();
     // Do not present if the desiredPresentTime has not passed unless it is more than one second
     // in the future. We ignore timestamps more than 1 second in the future for stability reasons.
-    if (!isAutoTimestamp && desiredPresentTime >= expectedPresentTime &&
-        desiredPresentTime < expectedPresentTime + s2ns(1)) {
+    if (!transaction.isAutoTimestamp && transaction.desiredPresentTime >= expectedPresentTime &&
+        transaction.desiredPresentTime < expectedPresentTime + s2ns(1)) {
         ATRACE_NAME("not current");
-        return false;
+        return TransactionReadiness::NotReady;
     }
 
-    if (!mScheduler->isVsyncValid(expectedPresentTime, originUid)) {
+    if (!mScheduler->isVsyncValid(expectedPresentTime, transaction.originUid)) {
         ATRACE_NAME("!isVsyncValid");
-        return false;
+        return TransactionReadiness::NotReady;
     }
 
     // If the client didn't specify desiredPresentTime, use the vsyncId to determine the expected
     // present time of this transaction.
-    if (isAutoTimestamp && frameIsEarly(expectedPresentTime, info.vsyncId)) {
+    if (transaction.isAutoTimestamp &&
+        frameIsEarly(expectedPresentTime, transaction.predictedPresentTime)) {
         ATRACE_NAME("frameIsEarly");
-        return false;
+        return TransactionReadiness::NotReady;
     }
 
-    for (const ComposerState& state : states) {
+    for (const ComposerState& state : transaction.states) {
         const layer_state_t& s = state.state;
-        const bool acquireFenceChanged = (s.what & layer_state_t::eAcquireFenceChanged);
-        if (acquireFenceChanged && s.acquireFence && !enableLatchUnsignaled &&
-            s.acquireFence->getStatus() == Fence::Status::Unsignaled) {
-            ATRACE_NAME("fence unsignaled");
-            return false;
+        if (!s.hasBufferChanges()) {
+            continue;
         }
-
-        sp<Layer> layer = nullptr;
-        if (s.surface) {
-            layer = fromHandle(s.surface).promote();
-        } else if (s.hasBufferChanges()) {
+        if (!s.surface) {
             ALOGW("Transaction with buffer, but no Layer?");
             continue;
         }
-        if (!layer) {
+
+        // If backpressure is enabled and we already have a buffer to commit, keep the
+        // transaction in the queue.
+        const bool hasPendingBuffer =
+                bufferLayersReadyToPresent.find(s.surface) != bufferLayersReadyToPresent.end();
+        if (!hasPendingBuffer || !transaction.isAutoTimestamp) {
             continue;
         }
+        const sp<Layer> layer = fromHandle(s.surface).promote();
+        if (layer && layer->backpressureEnabled()) {
+            ATRACE_NAME(layer->getName().c_str());
+            ATRACE_NAME("hasPendingBuffer");
+            return TransactionReadiness::NotReady;
+        }
+    }
 
-        ATRACE_NAME(layer->getName().c_str());
+    if (transaction.acquireFenceBarrier && !transaction.acquireFenceBarrier->isOpen()) {
+        ATRACE_NAME("fence unsignaled");
+        return transaction.acquireFenceBarrier->isWatched()
+                ? TransactionReadiness::NotReadyUnsignaledFences
+                : TransactionReadiness::NotReady;
+    }
+    return TransactionReadiness::Ready;
+}
 
-        if (s.hasBufferChanges()) {
-            // If backpressure is enabled and we already have a buffer to commit, keep the
-            // transaction in the queue.
-            const bool hasPendingBuffer =
-                    bufferLayersReadyToPresent.find(s.surface) != bufferLayersReadyToPresent.end();
-            if (layer->backpressureEnabled() && hasPendingBuffer && isAutoTimestamp) {
-                ATRACE_NAME("hasPendingBuffer");
-                return false;
-            }
+void SurfaceFlinger::trackTransactionReadiness(TransactionState& transaction) {
+    ATRACE_CALL();
+    if (transaction.isAutoTimestamp) {
+        const auto prediction = mFrameTimeline->getTokenManager()->getPredictionsForToken(
+                transaction.frameTimelineInfo.vsyncId);
+        if (prediction.has_value()) {
+            transaction.predictedPresentTime = prediction->presentTime;
         }
     }
-    return true;
+
+    if (enableLatchUnsignaled) {
+        return;
+    }
+
+    std::vector<sp<Fence>> unsignaledFences;
+    for (const ComposerState& state : transaction.states) {
+        const layer_state_t& s = state.state;
+        if ((s.what & layer_state_t::eAcquireFenceChanged) && s.acquireFence &&
+            s.acquireFence->getStatus() == Fence::Status::Unsignaled) {
+            unsignaledFences.push_back(s.acquireFence);
+        }
+    }
+    if (!unsignaledFences.empty()) {
+        transaction.acquireFenceBarrier =
+                mTransactionFenceWatcher.watch(std::move(unsignaledFences));
+    }
 }
 
 void SurfaceFlinger::queueTransaction(TransactionState& state) {
@@ -3768,6 +3852,7 @@ status_t SurfaceFlinger::setTransactionState(
     state.traverseStatesWithBuffers([&](const layer_state_t& state) {
         mBufferCountTracker.increment(state.surface->localBinder());
     });
+    trackTransactionReadiness(state);
     queueTransaction(state);
 
     // Check the pending state to make sure the transaction is synchronous.
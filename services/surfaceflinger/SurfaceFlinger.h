@@ -65,6 +65,7 @@
 #include "SurfaceTracing.h"
 #include "TracedOrdinal.h"
 #include "TransactionCallbackInvoker.h"
+#include "TransactionFenceWatcher.h"
 
 #include <atomic>
 #include <cstdint>
@@ -563,6 +564,20 @@ private:
         int originUid;
         uint64_t id;
         std::shared_ptr<CountDownLatch> transactionCommittedSignal;
+
+        // Filled in by trackTransactionReadiness when the transaction is queued, so that checking
+        // whether it is ready does not look up its prediction or wait on its fences.
+        std::optional<nsecs_t> predictedPresentTime;
+        // Opens once the acquire fences that had not signaled when it was queued have. Null if
+        // there were none.
+        std::shared_ptr<const TransactionFenceWatcher::Barrier> acquireFenceBarrier;
+    };
+
+    enum class TransactionReadiness {
+        NotReady,
+        // Only waiting on acquire fences, which wake up SurfaceFlinger when they signal.
+        NotReadyUnsignaledFences,
+        Ready,
     };
 
     template <typename F, std::enable_if_t<!std::is_member_function_pointer_v<F>>* = nullptr>
@@ -853,15 +868,18 @@ private:
     uint32_t setTransactionFlags(uint32_t flags, TransactionSchedule, const sp<IBinder>& = {});
     void commitTransaction() REQUIRES(mStateLock);
     void commitOffscreenLayers();
-    bool transactionIsReadyToBeApplied(
-            const FrameTimelineInfo& info, bool isAutoTimestamp, int64_t desiredPresentTime,
-            uid_t originUid, const Vector<ComposerState>& states,
+    TransactionReadiness transactionIsReadyToBeApplied(
+            const TransactionState& transaction,
             const std::unordered_set<sp<IBinder>, ISurfaceComposer::SpHash<IBinder>>&
                     bufferLayersReadyToPresent) const REQUIRES(mStateLock);
+    // Called on the binder thread before a transaction is queued, to do the parts of the
+    // readiness check that do not depend on the state of the main thread.
+    void trackTransactionReadiness(TransactionState& transaction);
     uint32_t setDisplayStateLocked(const DisplayState& s) REQUIRES(mStateLock);
     uint32_t addInputWindowCommands(const InputWindowCommands& inputWindowCommands)
             REQUIRES(mStateLock);
-    bool frameIsEarly(nsecs_t expectedPresentTime, int64_t vsyncId) const;
+    bool frameIsEarly(nsecs_t expectedPresentTime,
+                      std::optional<nsecs_t> predictedPresentTime) const;
     /*
      * Layer management
      */
@@ -908,6 +926,8 @@ private:
 
     // Traverse through all the layers and compute and cache its bounds.
     void computeLayerBounds();
+    // Only the layers whose geometry changed are recomputed, unless fullUpdate is set.
+    void computeLayerBoundsForDisplays(bool fullUpdate);
 
     // Boot animation, on/off animations and screen capture
     void startBootAnim();
@@ -1300,6 +1320,10 @@ private:
     volatile nsecs_t mDebugInTransaction = 0;
     bool mForceFullDamage = false;
     bool mPropagateBackpressureClientComposition = false;
+    // Checks the layer bounds that computeLayerBounds updates against a full recompute.
+    bool mDebugVerifyLayerBounds = false;
+    // The primary display rotation that the layer bounds were last computed with.
+    ui::Transform::RotationFlags mLayerBoundsRotationFlags = ui::Transform::ROT_INVALID;
     sp<SurfaceInterceptor> mInterceptor;
 
     SurfaceTracing mTracing{*this};
@@ -1346,6 +1370,9 @@ private:
     std::unordered_map<sp<IBinder>, std::queue<TransactionState>, IListenerHash>
             mPendingTransactionQueues GUARDED_BY(mQueueLock);
     std::queue<TransactionState> mTransactionQueue GUARDED_BY(mQueueLock);
+    // The number of pending transaction queues whose front transaction is only waiting on acquire
+    // fences, as of the last flush. Those do not need another flush until their fences signal.
+    size_t mPendingQueuesWaitingOnFences GUARDED_BY(mQueueLock) = 0;
     /*
      * Feature prototyping
      */
@@ -1495,6 +1522,10 @@ private:
 
     void scheduleRegionSamplingThread();
     void notifyRegionSamplingThread();
+
+    // Declared last, so that its thread stops before anything its callback uses is destroyed.
+    TransactionFenceWatcher mTransactionFenceWatcher{
+            [this] { setTransactionFlags(eTransactionFlushNeeded); }};
 };
 
 } // namespace android
@@ -0,0 +1,181 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#undef LOG_TAG
+#define LOG_TAG "TransactionFenceWatcher"
+#define ATRACE_TAG ATRACE_TAG_GRAPHICS
+
+#include "TransactionFenceWatcher.h"
+
+#include <log/log.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <utils/Trace.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iterator>
+
+namespace android {
+
+using namespace std::chrono_literals;
+
+// The same as the main thread, see SurfaceFlinger::setSchedFifo.
+constexpr int kFifoPriority = 2;
+
+// How many times poll() is tried before the fences are handed back to the main thread, and how
+// long to wait in between, in case it failed for lack of memory.
+constexpr int kMaxPollAttempts = 3;
+constexpr std::chrono::milliseconds kPollRetryDelay = 1ms;
+
+bool TransactionFenceWatcher::Barrier::isOpen() const {
+    if (mUnsignaledCount.load(std::memory_order_acquire) == 0) {
+        return true;
+    }
+    if (isWatched()) {
+        return false;
+    }
+    return std::all_of(mFences.begin(), mFences.end(), [](const sp<Fence>& fence) {
+        return fence->getStatus() != Fence::Status::Unsignaled;
+    });
+}
+
+TransactionFenceWatcher::TransactionFenceWatcher(Callback onBarriersOpened)
+      : mOnBarriersOpened(std::move(onBarriersOpened)),
+        mWakeFd(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) {
+    LOG_ALWAYS_FATAL_IF(mWakeFd < 0, "Failed to create eventfd: %s", strerror(errno));
+}
+
+TransactionFenceWatcher::~TransactionFenceWatcher() {
+    std::thread thread;
+    {
+        std::lock_guard lock(mMutex);
+        mStopping = true;
+        thread = std::move(mThread);
+    }
+    if (thread.joinable()) {
+        wake();
+        thread.join();
+    }
+}
+
+void TransactionFenceWatcher::start() {
+    std::lock_guard lock(mMutex);
+    if (!mThread.joinable()) {
+        mThread = std::thread(&TransactionFenceWatcher::threadMain, this);
+    }
+}
+
+std::shared_ptr<const TransactionFenceWatcher::Barrier> TransactionFenceWatcher::watch(
+        std::vector<sp<Fence>> fences) {
+    std::shared_ptr<Barrier> barrier(new Barrier(fences));
+    {
+        std::lock_guard lock(mMutex);
+        for (sp<Fence>& fence : fences) {
+            mNewFences.push_back({std::move(fence), barrier});
+        }
+    }
+    wake();
+    return barrier;
+}
+
+void TransactionFenceWatcher::wake() {
+    const uint64_t one = 1;
+    if (write(mWakeFd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+        ALOGE("Failed to wake the watcher thread: %s", strerror(errno));
+    }
+}
+
+void TransactionFenceWatcher::threadMain() {
+    pthread_setname_np(pthread_self(), "TxnFenceWatcher");
+
+    // Signaled fences hold back the next frame, so wake up as promptly as the main thread does.
+    struct sched_param param = {0};
+    param.sched_priority = kFifoPriority;
+    if (sched_setscheduler(0, SCHED_FIFO, &param) != 0) {
+        ALOGW("Couldn't set SCHED_FIFO for the fence watcher");
+    }
+
+    std::vector<WatchedFence> watched;
+    std::vector<pollfd> pollFds;
+    int failedPollCount = 0;
+    while (true) {
+        {
+            std::lock_guard lock(mMutex);
+            if (mStopping) {
+                return;
+            }
+            watched.insert(watched.end(), std::make_move_iterator(mNewFences.begin()),
+                           std::make_move_iterator(mNewFences.end()));
+            mNewFences.clear();
+        }
+
+        // The first entry is the wake fd, followed by one entry per watched fence.
+        pollFds.clear();
+        pollFds.push_back({mWakeFd.get(), POLLIN, 0});
+        for (const WatchedFence& watchedFence : watched) {
+            pollFds.push_back({watchedFence.fence->get(), POLLIN, 0});
+        }
+
+        if (TEMP_FAILURE_RETRY(poll(pollFds.data(), pollFds.size(), -1)) < 0) {
+            ALOGE("Failed to poll %zu fences: %s", watched.size(), strerror(errno));
+            if (++failedPollCount < kMaxPollAttempts) {
+                std::this_thread::sleep_for(kPollRetryDelay);
+                continue;
+            }
+            // Hand the fences back to the main thread, which checks them every frame until they
+            // signal, as it would without the watcher. The barriers stay closed until then.
+            ATRACE_NAME("TransactionFenceWatcher unwatch");
+            for (const WatchedFence& watchedFence : watched) {
+                watchedFence.barrier->mUnwatched.store(true, std::memory_order_release);
+            }
+            watched.clear();
+            failedPollCount = 0;
+            mOnBarriersOpened();
+            continue;
+        }
+        failedPollCount = 0;
+        ATRACE_NAME("TransactionFenceWatcher");
+
+        if (pollFds[0].revents & POLLIN) {
+            uint64_t ignored;
+            read(mWakeFd, &ignored, sizeof(ignored));
+        }
+
+        // POLLERR and POLLNVAL are reported for fences that will never signal, which do not hold
+        // back a transaction when the main thread checks them either.
+        bool barriersOpened = false;
+        for (size_t i = watched.size(); i-- > 0;) {
+            if (pollFds[i + 1].revents == 0) {
+                continue;
+            }
+            if (watched[i].barrier->mUnsignaledCount.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                barriersOpened = true;
+            }
+            watched.erase(watched.begin() + i);
+        }
+
+        if (barriersOpened) {
+            mOnBarriersOpened();
+        }
+    }
+}
+
+} // namespace android
@@ -0,0 +1,88 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <android-base/thread_annotations.h>
+#include <android-base/unique_fd.h>
+#include <ui/Fence.h>
+
+namespace android {
+
+// Waits on the acquire fences of queued transactions on a thread of its own, so that the main
+// thread can tell whether a transaction is ready without checking each of its fences every frame.
+class TransactionFenceWatcher {
+public:
+    // Opens once all the fences it was created for have signaled.
+    class Barrier {
+    public:
+        bool isOpen() const;
+
+        // Whether the watcher still wakes up SurfaceFlinger when the barrier opens. If it could
+        // not wait on the fences, the caller has to check the barrier again every frame.
+        bool isWatched() const { return !mUnwatched.load(std::memory_order_acquire); }
+
+    private:
+        friend class TransactionFenceWatcher;
+        explicit Barrier(std::vector<sp<Fence>> fences)
+              : mFences(std::move(fences)), mUnsignaledCount(mFences.size()) {}
+
+        const std::vector<sp<Fence>> mFences;
+        std::atomic<size_t> mUnsignaledCount;
+        std::atomic<bool> mUnwatched = false;
+    };
+
+    // Called on the watcher thread whenever one or more barriers have opened, or have stopped
+    // being watched.
+    using Callback = std::function<void()>;
+
+    explicit TransactionFenceWatcher(Callback onBarriersOpened);
+    ~TransactionFenceWatcher();
+
+    // Starts the thread, which inherits the cgroup of the caller. SurfaceFlinger starts it from
+    // its main thread as it initializes, rather than from the first binder thread to call watch().
+    void start();
+
+    // Returns a barrier that opens once all the fences have signaled. Fences passed before the
+    // thread is started are watched once it is.
+    std::shared_ptr<const Barrier> watch(std::vector<sp<Fence>> fences);
+
+private:
+    struct WatchedFence {
+        sp<Fence> fence;
+        std::shared_ptr<Barrier> barrier;
+    };
+
+    void wake();
+    void threadMain();
+
+    const Callback mOnBarriersOpened;
+    const base::unique_fd mWakeFd;
+
+    std::mutex mMutex;
+    std::vector<WatchedFence> mNewFences GUARDED_BY(mMutex);
+    bool mStopping GUARDED_BY(mMutex) = false;
+    std::thread mThread GUARDED_BY(mMutex);
+};
+
+} // namespace android
@@ -20,14 +20,24 @@
 
 #include <gtest/gtest.h>
 
+#include <android-base/unique_fd.h>
+#include <binder/ProcessState.h>
 #include <gui/SurfaceComposerClient.h>
+#include <sys/eventfd.h>
+#include <ui/Fence.h>
+#include <ui/GraphicBuffer.h>
 
 #include <utils/String8.h>
 
+#include <algorithm>
 #include <thread>
 #include <functional>
 #include <layerproto/LayerProtoParser.h>
 
+using namespace std::chrono_literals;
+
+#include "utils/CallbackUtils.h"
+
 namespace android {
 
 TEST(SurfaceFlingerStress, create_and_destroy) {
@@ -51,6 +61,163 @@ TEST(SurfaceFlingerStress, create_and_destroy) {
     }
 }
 
+// Submits buffers from as many apply tokens as there are threads, each waiting for its previous
+// buffer to be latched before submitting the next, and reports how long buffers take from being
+// submitted to being latched. That latency grows with the time SurfaceFlinger takes to decide
+// which transactions are ready and to apply them.
+TEST(SurfaceFlingerStress, buffer_transactions_per_apply_token) {
+    ProcessState::self()->startThreadPool();
+
+    constexpr int kFrameCount = 120;
+    for (int tokenCount : {1, 8, 32, 64}) {
+        std::mutex mutex;
+        std::vector<nsecs_t> latencies;
+
+        auto do_stress = [&]() {
+            sp<SurfaceComposerClient> client = new SurfaceComposerClient;
+            ASSERT_EQ(NO_ERROR, client->initCheck());
+            sp<SurfaceControl> surf =
+                    client->createSurface(String8("t"), 32, 32, PIXEL_FORMAT_RGBA_8888,
+                                          ISurfaceComposerClient::eFXSurfaceBufferState);
+            ASSERT_TRUE(surf != nullptr);
+
+            std::array<sp<GraphicBuffer>, 2> buffers;
+            for (auto& buffer : buffers) {
+                buffer = new GraphicBuffer(32, 32, PIXEL_FORMAT_RGBA_8888, 1,
+                                           GRALLOC_USAGE_SW_WRITE_OFTEN |
+                                                   GRALLOC_USAGE_HW_COMPOSER |
+                                                   GRALLOC_USAGE_HW_TEXTURE,
+                                           "test");
+                ASSERT_EQ(NO_ERROR, buffer->initCheck());
+            }
+
+            const sp<IBinder> applyToken = new BBinder();
+            CallbackHelper callback;
+            std::vector<nsecs_t> threadLatencies;
+            for (int i = 0; i < kFrameCount; i++) {
+                SurfaceComposerClient::Transaction t;
+                t.setApplyToken(applyToken)
+                        .setBuffer(surf, buffers[i % buffers.size()])
+                        .setAcquireFence(surf, Fence::NO_FENCE)
+                        .show(surf)
+                        .setLayer(surf, INT32_MAX - 1)
+                        .addTransactionCompletedCallback(callback.function,
+                                                         callback.getContext());
+                const nsecs_t postTime = systemTime();
+                t.apply();
+
+                CallbackData data;
+                ASSERT_NO_FATAL_FAILURE(callback.getCallbackData(&data));
+                threadLatencies.push_back(data.latchTime - postTime);
+            }
+
+            std::lock_guard lock(mutex);
+            latencies.insert(latencies.end(), threadLatencies.begin(), threadLatencies.end());
+        };
+
+        std::vector<std::thread> threads;
+        const nsecs_t start = systemTime();
+        for (int i = 0; i < tokenCount; i++) {
+            threads.push_back(std::thread(do_stress));
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        const nsecs_t duration = systemTime() - start;
+
+        ASSERT_EQ(latencies.size(), static_cast<size_t>(tokenCount * kFrameCount));
+        std::sort(latencies.begin(), latencies.end());
+        printf("%2d apply tokens: %.1f buffers/s, submit to latch median %.2f ms, p99 %.2f ms\n",
+               tokenCount, latencies.size() * 1e9 / duration,
+               ns2us(latencies[latencies.size() / 2]) / 1000.0,
+               ns2us(latencies[latencies.size() * 99 / 100]) / 1000.0);
+    }
+}
+
+// Like buffer_transactions_per_apply_token, but each buffer comes with an acquire fence that is
+// still unsignaled when the transaction is applied, as when an app submits a buffer the GPU is
+// still rendering to. The fence signals a little later, and the test reports how long buffers
+// take from their fence signaling to being latched.
+TEST(SurfaceFlingerStress, unsignaled_buffer_transactions_per_apply_token) {
+    ProcessState::self()->startThreadPool();
+
+    constexpr int kFrameCount = 60;
+    constexpr auto kRenderTime = 2ms;
+    for (int tokenCount : {1, 8, 32}) {
+        std::mutex mutex;
+        std::vector<nsecs_t> latencies;
+
+        auto do_stress = [&]() {
+            sp<SurfaceComposerClient> client = new SurfaceComposerClient;
+            ASSERT_EQ(NO_ERROR, client->initCheck());
+            sp<SurfaceControl> surf =
+                    client->createSurface(String8("t"), 32, 32, PIXEL_FORMAT_RGBA_8888,
+                                          ISurfaceComposerClient::eFXSurfaceBufferState);
+            ASSERT_TRUE(surf != nullptr);
+
+            std::array<sp<GraphicBuffer>, 2> buffers;
+            for (auto& buffer : buffers) {
+                buffer = new GraphicBuffer(32, 32, PIXEL_FORMAT_RGBA_8888, 1,
+                                           GRALLOC_USAGE_SW_WRITE_OFTEN |
+                                                   GRALLOC_USAGE_HW_COMPOSER |
+                                                   GRALLOC_USAGE_HW_TEXTURE,
+                                           "test");
+                ASSERT_EQ(NO_ERROR, buffer->initCheck());
+            }
+
+            const sp<IBinder> applyToken = new BBinder();
+            CallbackHelper callback;
+            std::vector<nsecs_t> threadLatencies;
+            for (int i = 0; i < kFrameCount; i++) {
+                // An eventfd polls like a fence, and signals once it is written to.
+                base::unique_fd eventFd(eventfd(0, EFD_CLOEXEC));
+                ASSERT_TRUE(eventFd.ok());
+                sp<Fence> fence = new Fence(base::unique_fd(dup(eventFd.get())));
+                ASSERT_EQ(Fence::Status::Unsignaled, fence->getStatus());
+
+                SurfaceComposerClient::Transaction t;
+                t.setApplyToken(applyToken)
+                        .setBuffer(surf, buffers[i % buffers.size()])
+                        .setAcquireFence(surf, fence)
+                        .show(surf)
+                        .setLayer(surf, INT32_MAX - 1)
+                        .addTransactionCompletedCallback(callback.function,
+                                                         callback.getContext());
+                t.apply();
+
+                std::this_thread::sleep_for(kRenderTime);
+                const uint64_t one = 1;
+                const nsecs_t signalTime = systemTime();
+                ASSERT_EQ(static_cast<ssize_t>(sizeof(one)),
+                          write(eventFd.get(), &one, sizeof(one)));
+
+                CallbackData data;
+                ASSERT_NO_FATAL_FAILURE(callback.getCallbackData(&data));
+                // The buffer must not be latched before its fence has signaled.
+                ASSERT_GE(data.latchTime, signalTime);
+                threadLatencies.push_back(data.latchTime - signalTime);
+            }
+
+            std::lock_guard lock(mutex);
+            latencies.insert(latencies.end(), threadLatencies.begin(), threadLatencies.end());
+        };
+
+        std::vector<std::thread> threads;
+        for (int i = 0; i < tokenCount; i++) {
+            threads.push_back(std::thread(do_stress));
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        ASSERT_EQ(latencies.size(), static_cast<size_t>(tokenCount * kFrameCount));
+        std::sort(latencies.begin(), latencies.end());
+        printf("%2d apply tokens: signal to latch median %.2f ms, p99 %.2f ms\n", tokenCount,
+               ns2us(latencies[latencies.size() / 2]) / 1000.0,
+               ns2us(latencies[latencies.size() * 99 / 100]) / 1000.0);
+    }
+}
+
 surfaceflinger::LayersProto generateLayerProto() {
     surfaceflinger::LayersProto layersProto;
     std::array<surfaceflinger::LayerProto*, 10> layers = {};
@@ -0,0 +1,63 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <gmock/gmock.h>
+#include <gui/LayerMetadata.h>
+
+#include "EffectLayer.h"
+#include "TestableSurfaceFlinger.h"
+#include "mock/DisplayHardware/MockComposer.h"
+#include "mock/MockEventThread.h"
+#include "mock/MockVsyncController.h"
+
+namespace android::benchmark_helpers {
+
+// Gives the flinger a scheduler and a composer that answer every call, since the benchmarks do
+// not check how they are used.
+inline void setupFakeSchedulerAndComposer(TestableSurfaceFlinger& flinger) {
+    using testing::_;
+    using testing::NiceMock;
+    using testing::Return;
+
+    auto eventThread = std::make_unique<NiceMock<mock::EventThread>>();
+    auto sfEventThread = std::make_unique<NiceMock<mock::EventThread>>();
+    ON_CALL(*eventThread, createEventConnection(_, _))
+            .WillByDefault(Return(new EventThreadConnection(eventThread.get(), /*callingUid=*/0,
+                                                            ResyncCallback())));
+    ON_CALL(*sfEventThread, createEventConnection(_, _))
+            .WillByDefault(Return(new EventThreadConnection(sfEventThread.get(),
+                                                            /*callingUid=*/0, ResyncCallback())));
+
+    auto vsyncTracker = std::make_unique<NiceMock<mock::VSyncTracker>>();
+    ON_CALL(*vsyncTracker, nextAnticipatedVSyncTimeFrom(_)).WillByDefault(Return(0));
+    ON_CALL(*vsyncTracker, currentPeriod())
+            .WillByDefault(
+                    Return(TestableSurfaceFlinger::FakeHwcDisplayInjector::DEFAULT_VSYNC_PERIOD));
+    flinger.setupScheduler(std::make_unique<NiceMock<mock::VsyncController>>(),
+                           std::move(vsyncTracker), std::move(eventThread),
+                           std::move(sfEventThread));
+    flinger.setupComposer(std::make_unique<NiceMock<Hwc2::mock::Composer>>());
+}
+
+inline sp<Layer> createEffectLayer(TestableSurfaceFlinger& flinger, const char* name) {
+    sp<Client> client;
+    LayerCreationArgs args(flinger.flinger(), client, name, 0, 0, 0, LayerMetadata());
+    return new EffectLayer(args);
+}
+
+} // namespace android::benchmark_helpers
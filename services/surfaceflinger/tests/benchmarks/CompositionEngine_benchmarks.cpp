@@ -0,0 +1,124 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <compositionengine/CompositionRefreshArgs.h>
+#include <compositionengine/DisplayColorProfileCreationArgs.h>
+#include <compositionengine/DisplayCreationArgs.h>
+#include <compositionengine/impl/Display.h>
+#include <compositionengine/mock/RenderSurface.h>
+#include <renderengine/mock/RenderEngine.h>
+
+#include "BenchmarkHelpers.h"
+
+// Measures a frame of CompositionEngine::present when the same windows are mirrored to several
+// GPU virtual displays, as they are when the screen is recorded or cast, with the outputs
+// composed one after the other or concurrently.
+
+namespace android {
+
+using benchmark_helpers::createEffectLayer;
+using testing::NiceMock;
+
+static constexpr int32_t DISPLAY_WIDTH = 1080;
+static constexpr int32_t DISPLAY_HEIGHT = 2340;
+
+static constexpr size_t WINDOW_COUNT = 60;
+
+// --- MirroredDisplays ---
+
+class MirroredDisplays {
+public:
+    MirroredDisplays(size_t displayCount, bool parallel) {
+        benchmark_helpers::setupFakeSchedulerAndComposer(mFlinger);
+        mFlinger.setupRenderEngine(std::make_unique<NiceMock<renderengine::mock::RenderEngine>>());
+        mFlinger.getCompositionEngine().setParallelOutputCompositionEnabled(parallel);
+
+        sp<Layer> root = createEffectLayer(mFlinger, "root");
+        mRefreshArgs.layers.push_back(root);
+        for (size_t i = 0; i < WINDOW_COUNT; i++) {
+            sp<Layer> window = createEffectLayer(mFlinger, "window");
+            window->setPosition((i % 6) * 180, (i / 6) * 234);
+            window->setCrop(Rect(0, 0, 360, 468));
+            window->setColor(half3(i / float(WINDOW_COUNT), 0.5f, 0.5f));
+            root->addChild(window);
+            mRefreshArgs.layers.push_back(window);
+        }
+        root->commitChildList();
+        root->computeBounds(FloatRect(0, 0, DISPLAY_WIDTH, DISPLAY_HEIGHT), ui::Transform(), 0.f);
+
+        for (size_t i = 0; i < displayCount; i++) {
+            mRefreshArgs.outputs.push_back(createVirtualDisplay(i));
+        }
+
+        // Every frame recomputes the output layers, as a frame that follows a transaction does.
+        mRefreshArgs.updatingOutputGeometryThisFrame = true;
+        mRefreshArgs.updatingGeometryThisFrame = true;
+        mRefreshArgs.repaintEverything = true;
+    }
+
+    void present() { mFlinger.getCompositionEngine().present(mRefreshArgs); }
+
+private:
+    std::shared_ptr<compositionengine::Output> createVirtualDisplay(size_t index) {
+        auto display = compositionengine::impl::createDisplay(
+                mFlinger.getCompositionEngine(),
+                compositionengine::DisplayCreationArgsBuilder()
+                        .setId(GpuVirtualDisplayId(index))
+                        .setPixels({DISPLAY_WIDTH, DISPLAY_HEIGHT})
+                        .setIsSecure(false)
+                        .setLayerStackId(0)
+                        .setName("virtual display " + std::to_string(index))
+                        .build());
+        display->createDisplayColorProfile(
+                compositionengine::DisplayColorProfileCreationArgsBuilder()
+                        .setHasWideColorGamut(false)
+                        .setHdrCapabilities(HdrCapabilities())
+                        .setSupportedPerFrameMetadata(0)
+                        .Build());
+        display->setRenderSurfaceForTest(
+                std::make_unique<NiceMock<compositionengine::mock::RenderSurface>>());
+        display->setDisplaySize({DISPLAY_WIDTH, DISPLAY_HEIGHT});
+        const Rect bounds(DISPLAY_WIDTH, DISPLAY_HEIGHT);
+        display->setProjection(ui::ROTATION_0, bounds, bounds);
+        display->setLayerStackFilter(0, false /*isInternal*/);
+        display->setCompositionEnabled(true);
+        return display;
+    }
+
+    TestableSurfaceFlinger mFlinger;
+    compositionengine::CompositionRefreshArgs mRefreshArgs;
+};
+
+// Arguments are the number of virtual displays, and whether they are composed concurrently.
+static void benchmarkPresentMirroredDisplays(benchmark::State& state) {
+    MirroredDisplays displays(state.range(0), state.range(1) != 0);
+    for (auto _ : state) {
+        displays.present();
+    }
+}
+BENCHMARK(benchmarkPresentMirroredDisplays)
+        ->ArgNames({"displays", "parallel"})
+        ->Apply([](benchmark::internal::Benchmark* b) {
+            for (int64_t displayCount = 1; displayCount <= 4; displayCount++) {
+                b->Args({displayCount, 0});
+                b->Args({displayCount, 1});
+            }
+        })
+        ->UseRealTime();
+
+} // namespace android
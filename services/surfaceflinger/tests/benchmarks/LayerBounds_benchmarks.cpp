@@ -0,0 +1,104 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include "BenchmarkHelpers.h"
+
+// Measures the cost of computing the bounds of a layer tree of the size a busy device has on
+// screen, when a single layer moves between frames.
+
+namespace android {
+
+using benchmark_helpers::createEffectLayer;
+
+static const FloatRect DISPLAY_BOUNDS(0, 0, 1080, 2340);
+
+// The tree has a root, then TASK_COUNT tasks, each with WINDOWS_PER_TASK windows, each with
+// SURFACES_PER_WINDOW surfaces: 1000 layers in all.
+static constexpr size_t TASK_COUNT = 9;
+static constexpr size_t WINDOWS_PER_TASK = 10;
+static constexpr size_t SURFACES_PER_WINDOW = 10;
+
+// --- LayerTree ---
+
+class LayerTree {
+public:
+    LayerTree() {
+        benchmark_helpers::setupFakeSchedulerAndComposer(mFlinger);
+
+        mRoot = createEffectLayer(mFlinger, "root");
+        mRoot->setCrop(Rect(0, 0, 1080, 2340));
+        for (size_t i = 0; i < TASK_COUNT; i++) {
+            sp<Layer> task = createEffectLayer(mFlinger, "task");
+            task->setPosition(0, i * 100);
+            task->setCrop(Rect(0, 0, 1080, 1600));
+            mRoot->addChild(task);
+            for (size_t j = 0; j < WINDOWS_PER_TASK; j++) {
+                sp<Layer> window = createEffectLayer(mFlinger, "window");
+                window->setPosition(j * 10, j * 20);
+                task->addChild(window);
+                for (size_t k = 0; k < SURFACES_PER_WINDOW; k++) {
+                    sp<Layer> surface = createEffectLayer(mFlinger, "surface");
+                    surface->setPosition(k * 5, k * 50);
+                    surface->setCrop(Rect(0, 0, 500, 100));
+                    window->addChild(surface);
+                    mSurfaces.push_back(surface);
+                }
+            }
+        }
+        mRoot->commitChildList();
+        mRoot->computeBounds(DISPLAY_BOUNDS, ui::Transform(), 0.f);
+    }
+
+    // Moves one of the surfaces, a different one each time.
+    void moveSurface() {
+        const sp<Layer>& surface = mSurfaces[mMoveCount % mSurfaces.size()];
+        const ui::Transform& transform = surface->getDrawingState().transform;
+        surface->setPosition(transform.tx(), transform.ty() + (mMoveCount % 2 ? 1 : -1));
+        mMoveCount++;
+    }
+
+    const sp<Layer>& getRoot() const { return mRoot; }
+
+private:
+    TestableSurfaceFlinger mFlinger;
+    sp<Layer> mRoot;
+    std::vector<sp<Layer>> mSurfaces;
+    size_t mMoveCount = 0;
+};
+
+static void benchmarkComputeBounds(benchmark::State& state) {
+    LayerTree tree;
+    for (auto _ : state) {
+        tree.moveSurface();
+        tree.getRoot()->computeBounds(DISPLAY_BOUNDS, ui::Transform(), 0.f);
+    }
+}
+BENCHMARK(benchmarkComputeBounds);
+
+static void benchmarkUpdateBounds(benchmark::State& state) {
+    LayerTree tree;
+    for (auto _ : state) {
+        tree.moveSurface();
+        tree.getRoot()->updateBounds(DISPLAY_BOUNDS, ui::Transform(), 0.f);
+    }
+}
+BENCHMARK(benchmarkUpdateBounds);
+
+} // namespace android
+
+BENCHMARK_MAIN();
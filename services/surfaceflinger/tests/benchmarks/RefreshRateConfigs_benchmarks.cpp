@@ -0,0 +1,101 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include "Scheduler/RefreshRateConfigs.h"
+
+// Measures choosing the refresh rate of a display with 30, 48, 60, 90 and 120 Hz modes for
+// a frame, when the layers vote the same as in a recent frame and when they do not.
+
+namespace android::scheduler {
+
+using LayerRequirement = RefreshRateConfigs::LayerRequirement;
+using LayerVoteType = RefreshRateConfigs::LayerVoteType;
+
+static DisplayModes createDisplayModes() {
+    DisplayModes modes;
+    int32_t id = 0;
+    for (float fps : {30.0f, 48.0f, 60.0f, 90.0f, 120.0f}) {
+        modes.push_back(DisplayMode::Builder(hal::HWConfigId(id))
+                                .setId(DisplayModeId(id))
+                                .setVsyncPeriod(int32_t(Fps(fps).getPeriodNsecs()))
+                                .setGroup(0)
+                                .build());
+        id++;
+    }
+    return modes;
+}
+
+// Returns layers voting as a mix of UI, video and games do. The variant changes the votes of some
+// of the layers, as a video starting or stopping does.
+static std::vector<LayerRequirement> createLayers(size_t layerCount, size_t variant) {
+    static const LayerRequirement kVotes[] = {
+            {.vote = LayerVoteType::Heuristic, .desiredRefreshRate = Fps(60.0f)},
+            {.vote = LayerVoteType::ExplicitExactOrMultiple, .desiredRefreshRate = Fps(24.0f)},
+            {.vote = LayerVoteType::NoVote},
+            {.vote = LayerVoteType::Heuristic, .desiredRefreshRate = Fps(30.0f)},
+            {.vote = LayerVoteType::ExplicitDefault, .desiredRefreshRate = Fps(90.0f)},
+            {.vote = LayerVoteType::Max},
+            {.vote = LayerVoteType::Min},
+            {.vote = LayerVoteType::ExplicitExactOrMultiple, .desiredRefreshRate = Fps(48.0f)},
+    };
+    constexpr size_t kVoteCount = sizeof(kVotes) / sizeof(kVotes[0]);
+
+    std::vector<LayerRequirement> layers;
+    for (size_t i = 0; i < layerCount; i++) {
+        LayerRequirement layer = kVotes[(i + (i % 4 == 0 ? variant : 0)) % kVoteCount];
+        layer.name = "layer" + std::to_string(i);
+        layer.weight = 1.0f / (1 + i % 3);
+        layers.push_back(std::move(layer));
+    }
+    return layers;
+}
+
+// The number of different sets of votes the benchmarks go through, one per frame.
+static constexpr size_t VARIANT_COUNT = 4;
+
+// Arguments are the number of layers, and whether the votes were seen in a recent frame.
+static void benchmarkGetBestRefreshRate(benchmark::State& state) {
+    const DisplayModes modes = createDisplayModes();
+    RefreshRateConfigs configs(modes, modes[2]->getId());
+    const bool cached = state.range(1) != 0;
+
+    std::vector<std::vector<LayerRequirement>> layers;
+    for (size_t variant = 0; variant < VARIANT_COUNT; variant++) {
+        layers.push_back(createLayers(state.range(0), variant));
+    }
+
+    size_t frame = 0;
+    for (auto _ : state) {
+        if (!cached) {
+            // Setting the mode drops the cached results.
+            configs.setCurrentModeId(modes[2]->getId());
+        }
+        benchmark::DoNotOptimize(configs.getBestRefreshRate(layers[frame++ % VARIANT_COUNT],
+                                                            {.touch = false, .idle = false}));
+    }
+}
+BENCHMARK(benchmarkGetBestRefreshRate)
+        ->ArgNames({"layers", "cached"})
+        ->Apply([](benchmark::internal::Benchmark* b) {
+            for (int64_t layerCount : {4, 16, 64}) {
+                b->Args({layerCount, 0});
+                b->Args({layerCount, 1});
+            }
+        });
+
+} // namespace android::scheduler
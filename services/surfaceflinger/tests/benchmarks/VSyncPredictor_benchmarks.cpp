@@ -0,0 +1,51 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include "Scheduler/VSyncPredictor.h"
+
+// Measures updating the vsync model with a HW vsync timestamp, as is done for every HW vsync
+// while the model is being resynchronized.
+
+namespace android::scheduler {
+
+static constexpr nsecs_t VSYNC_PERIOD = 16'666'666;
+static constexpr size_t MINIMUM_SAMPLES_FOR_PREDICTION = 6;
+static constexpr uint32_t OUTLIER_TOLERANCE_PERCENT = 25;
+
+// Returns the timestamp of the vsync with the given ordinal, off by up to 50us as HW vsyncs are.
+static nsecs_t vsyncTimestamp(int64_t ordinal) {
+    return ordinal * VSYNC_PERIOD + (ordinal * 7919) % 100'001 - 50'000;
+}
+
+// The argument is the number of timestamps the model is computed from.
+static void benchmarkAddVsyncTimestamp(benchmark::State& state) {
+    VSyncPredictor predictor(VSYNC_PERIOD, state.range(0), MINIMUM_SAMPLES_FOR_PREDICTION,
+                             OUTLIER_TOLERANCE_PERCENT);
+
+    int64_t ordinal = 1;
+    while (predictor.needsMoreSamples()) {
+        predictor.addVsyncTimestamp(vsyncTimestamp(ordinal++));
+    }
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(predictor.addVsyncTimestamp(vsyncTimestamp(ordinal++)));
+    }
+}
+BENCHMARK(benchmarkAddVsyncTimestamp)->ArgName("history")->Arg(20)->Arg(60)->Arg(120);
+
+} // namespace android::scheduler
@@ -0,0 +1,208 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#undef LOG_TAG
+#define LOG_TAG "LibSurfaceFlingerUnittests"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <gui/LayerMetadata.h>
+#include <log/log.h>
+
+#include "EffectLayer.h"
+#include "TestableSurfaceFlinger.h"
+#include "mock/DisplayHardware/MockComposer.h"
+#include "mock/MockEventThread.h"
+#include "mock/MockVsyncController.h"
+
+namespace android {
+
+using testing::_;
+using testing::Return;
+using FakeHwcDisplayInjector = TestableSurfaceFlinger::FakeHwcDisplayInjector;
+
+static const FloatRect DISPLAY_BOUNDS(0, 0, 1000, 1000);
+
+class LayerBoundsTest : public testing::Test {
+public:
+    LayerBoundsTest() {
+        const ::testing::TestInfo* const test_info =
+                ::testing::UnitTest::GetInstance()->current_test_info();
+        ALOGD("**** Setting up for %s.%s\n", test_info->test_case_name(), test_info->name());
+        setupScheduler();
+        mFlinger.setupComposer(std::make_unique<Hwc2::mock::Composer>());
+
+        // root
+        // ├── a
+        // │   ├── a1
+        // │   └── a2
+        // └── b
+        mRoot = createEffectLayer("root");
+        mA = createEffectLayer("a");
+        mA1 = createEffectLayer("a1");
+        mA2 = createEffectLayer("a2");
+        mB = createEffectLayer("b");
+        mRoot->addChild(mA);
+        mRoot->addChild(mB);
+        mA->addChild(mA1);
+        mA->addChild(mA2);
+        mRoot->setCrop(Rect(0, 0, 800, 800));
+        mA->setPosition(100, 100);
+        mA->setCrop(Rect(0, 0, 400, 400));
+        mA1->setCrop(Rect(0, 0, 200, 200));
+        mA2->setPosition(50, 0);
+        mB->setPosition(0, 500);
+        mRoot->commitChildList();
+        mRoot->updateBounds(DISPLAY_BOUNDS, ui::Transform(), 0.f);
+    }
+
+    ~LayerBoundsTest() {
+        const ::testing::TestInfo* const test_info =
+                ::testing::UnitTest::GetInstance()->current_test_info();
+        ALOGD("**** Tearing down after %s.%s\n", test_info->test_case_name(), test_info->name());
+    }
+
+    sp<Layer> createEffectLayer(const char* name) {
+        sp<Client> client;
+        LayerCreationArgs args(mFlinger.flinger(), client, name, 0, 0, 0, LayerMetadata());
+        return new EffectLayer(args);
+    }
+
+    void setupScheduler() {
+        auto eventThread = std::make_unique<mock::EventThread>();
+        auto sfEventThread = std::make_unique<mock::EventThread>();
+
+        EXPECT_CALL(*eventThread, registerDisplayEventConnection(_));
+        EXPECT_CALL(*eventThread, createEventConnection(_, _))
+                .WillOnce(Return(new EventThreadConnection(eventThread.get(), /*callingUid=*/0,
+                                                           ResyncCallback())));
+
+        EXPECT_CALL(*sfEventThread, registerDisplayEventConnection(_));
+        EXPECT_CALL(*sfEventThread, createEventConnection(_, _))
+                .WillOnce(Return(new EventThreadConnection(sfEventThread.get(), /*callingUid=*/0,
+                                                           ResyncCallback())));
+
+        auto vsyncController = std::make_unique<mock::VsyncController>();
+        auto vsyncTracker = std::make_unique<mock::VSyncTracker>();
+
+        EXPECT_CALL(*vsyncTracker, nextAnticipatedVSyncTimeFrom(_)).WillRepeatedly(Return(0));
+        EXPECT_CALL(*vsyncTracker, currentPeriod())
+                .WillRepeatedly(Return(FakeHwcDisplayInjector::DEFAULT_VSYNC_PERIOD));
+        mFlinger.setupScheduler(std::move(vsyncController), std::move(vsyncTracker),
+                                std::move(eventThread), std::move(sfEventThread));
+    }
+
+    std::vector<sp<Layer>> getLayers() const { return {mRoot, mA, mA1, mA2, mB}; }
+
+    // Checks that the bounds left by updateBounds are those a full recompute finds.
+    void expectBoundsMatchFullRecompute() {
+        std::vector<Layer::CachedBounds> incremental;
+        for (const sp<Layer>& layer : getLayers()) {
+            incremental.push_back(layer->getCachedBounds());
+        }
+
+        mRoot->computeBounds(DISPLAY_BOUNDS, ui::Transform(), 0.f);
+        const std::vector<sp<Layer>> layers = getLayers();
+        for (size_t i = 0; i < layers.size(); i++) {
+            const Layer::CachedBounds full = layers[i]->getCachedBounds();
+            EXPECT_TRUE(incremental[i] == full)
+                    << layers[i]->getName() << " has stale bounds "
+                    << testing::PrintToString(incremental[i].screenBounds) << ", expected "
+                    << testing::PrintToString(full.screenBounds);
+        }
+    }
+
+    // Changes the crop of the layer without going through Layer::setCrop, so that its geometry is
+    // not marked as changed.
+    void setCropBehindTheLayersBack(const sp<Layer>& layer, const Rect& crop) {
+        layer->getDrawingState().crop = crop;
+    }
+
+    TestableSurfaceFlinger mFlinger;
+    sp<Layer> mRoot;
+    sp<Layer> mA;
+    sp<Layer> mA1;
+    sp<Layer> mA2;
+    sp<Layer> mB;
+};
+
+namespace {
+
+TEST_F(LayerBoundsTest, updateBounds_matchesComputeBounds) {
+    expectBoundsMatchFullRecompute();
+    EXPECT_EQ(FloatRect(100, 100, 300, 300), mA1->getCachedBounds().screenBounds);
+    EXPECT_EQ(FloatRect(100, 100, 500, 500), mA2->getCachedBounds().screenBounds);
+    EXPECT_EQ(FloatRect(0, 0, 800, 800), mB->getCachedBounds().screenBounds);
+}
+
+TEST_F(LayerBoundsTest, updateBounds_afterLeafMoves) {
+    mA1->setPosition(20, 30);
+    mRoot->updateBounds(DISPLAY_BOUNDS, ui::Transform(), 0.f);
+
+    EXPECT_EQ(FloatRect(120, 130, 320, 330), mA1->getCachedBounds().screenBounds);
+    expectBoundsMatchFullRecompute();
+}
+
+TEST_F(LayerBoundsTest, updateBounds_afterParentCropChanges) {
+    mA->setCrop(Rect(0, 0, 100, 100));
+    mRoot->updateBounds(DISPLAY_BOUNDS, ui::Transform(), 0.f);
+
+    EXPECT_EQ(FloatRect(100, 100, 200, 200), mA1->getCachedBounds().screenBounds);
+    EXPECT_EQ(FloatRect(100, 100, 200, 200), mA2->getCachedBounds().screenBounds);
+    expectBoundsMatchFullRecompute();
+}
+
+TEST_F(LayerBoundsTest, updateBounds_afterMatrixChanges) {
+    mA->setMatrix({2.f, 0.f, 0.f, 2.f}, true /*allowNonRectPreservingTransforms*/);
+    mRoot->updateBounds(DISPLAY_BOUNDS, ui::Transform(), 0.f);
+
+    EXPECT_EQ(FloatRect(100, 100, 500, 500), mA1->getCachedBounds().screenBounds);
+    expectBoundsMatchFullRecompute();
+}
+
+TEST_F(LayerBoundsTest, updateBounds_afterReparent) {
+    mA->removeChild(mA1);
+    mB->addChild(mA1);
+    mRoot->commitChildList();
+    mRoot->updateBounds(DISPLAY_BOUNDS, ui::Transform(), 0.f);
+
+    EXPECT_EQ(FloatRect(0, 500, 200, 700), mA1->getCachedBounds().screenBounds);
+    expectBoundsMatchFullRecompute();
+}
+
+TEST_F(LayerBoundsTest, updateBounds_afterParentInputsChange) {
+    mRoot->updateBounds(FloatRect(0, 0, 200, 200), ui::Transform(), 0.f);
+
+    EXPECT_EQ(FloatRect(100, 100, 200, 200), mA1->getCachedBounds().screenBounds);
+    EXPECT_EQ(FloatRect(0, 0, 200, 200), mB->getCachedBounds().screenBounds);
+}
+
+TEST_F(LayerBoundsTest, updateBounds_skipsUnchangedSubtrees) {
+    setCropBehindTheLayersBack(mB, Rect(0, 0, 10, 10));
+    mA1->setPosition(20, 30);
+    mRoot->updateBounds(DISPLAY_BOUNDS, ui::Transform(), 0.f);
+
+    // Only the path to a1 was recomputed, so the crop of b is not in its bounds yet.
+    EXPECT_EQ(FloatRect(120, 130, 320, 330), mA1->getCachedBounds().screenBounds);
+    EXPECT_EQ(FloatRect(0, 0, 800, 800), mB->getCachedBounds().screenBounds);
+
+    mB->setGeometryDirty();
+    mRoot->updateBounds(DISPLAY_BOUNDS, ui::Transform(), 0.f);
+    EXPECT_EQ(FloatRect(0, 500, 10, 510), mB->getCachedBounds().screenBounds);
+}
+
+} // namespace
+} // namespace android
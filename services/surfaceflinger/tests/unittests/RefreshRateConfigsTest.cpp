@@ -81,14 +81,46 @@ protected:
     void setLastBestRefreshRateInvocation(RefreshRateConfigs& refreshRateConfigs,
                                           const GetBestRefreshRateInvocation& invocation) {
         std::lock_guard lock(refreshRateConfigs.mLock);
-        refreshRateConfigs.lastBestRefreshRateInvocation.emplace(
-                GetBestRefreshRateInvocation(invocation));
+        refreshRateConfigs.cacheBestRefreshRateInvocation(invocation);
     }
 
     std::optional<GetBestRefreshRateInvocation> getLastBestRefreshRateInvocation(
             const RefreshRateConfigs& refreshRateConfigs) {
         std::lock_guard lock(refreshRateConfigs.mLock);
-        return refreshRateConfigs.lastBestRefreshRateInvocation;
+        if (refreshRateConfigs.mBestRefreshRateCache.empty()) {
+            return {};
+        }
+        return refreshRateConfigs.mBestRefreshRateCache.front().second;
+    }
+
+    size_t getBestRefreshRateCacheSize(const RefreshRateConfigs& refreshRateConfigs) {
+        std::lock_guard lock(refreshRateConfigs.mLock);
+        return refreshRateConfigs.mBestRefreshRateCache.size();
+    }
+
+    static constexpr size_t kBestRefreshRateCacheSize =
+            RefreshRateConfigs::kBestRefreshRateCacheSize;
+
+    float calculateLayerScore(const RefreshRateConfigs& refreshRateConfigs,
+                              const LayerRequirement& layer, const RefreshRate& refreshRate,
+                              bool isSeamlessSwitch) {
+        std::lock_guard lock(refreshRateConfigs.mLock);
+        return refreshRateConfigs.calculateLayerScoreLocked(layer, refreshRate, isSeamlessSwitch);
+    }
+
+    // Returns the score getBestRefreshRate looks up for the layer, if it does.
+    std::optional<float> lookUpLayerScore(const RefreshRateConfigs& refreshRateConfigs,
+                                          const LayerRequirement& layer,
+                                          const RefreshRate& refreshRate, bool isSeamlessSwitch) {
+        std::lock_guard lock(refreshRateConfigs.mLock);
+        const auto index = refreshRateConfigs.findKnownFrameRateIndex(
+                layer.desiredRefreshRate.getPeriodNsecs());
+        if (!index) {
+            return {};
+        }
+        const auto& cadenceScore =
+                refreshRateConfigs.mKnownFrameRateCadenceScores.at(refreshRate.getModeId())[*index];
+        return isSeamlessSwitch ? cadenceScore.seamless : cadenceScore.seamed;
     }
 
     // Test config IDs
@@ -2003,6 +2035,114 @@ TEST_F(RefreshRateConfigsTest, getBestRefreshRate_WritesCache) {
     ASSERT_FALSE(detaultSignals == lastInvocation->outSignalsConsidered);
 }
 
+TEST_F(RefreshRateConfigsTest, getBestRefreshRate_ReadsOlderCachedInvocations) {
+    auto refreshRateConfigs =
+            std::make_unique<RefreshRateConfigs>(m30_60_72_90_120Device,
+                                                 /*currentConfigId=*/HWC_CONFIG_ID_60);
+
+    auto videoLayers = std::vector<LayerRequirement>{
+            LayerRequirement{.vote = LayerVoteType::ExplicitExactOrMultiple,
+                             .desiredRefreshRate = Fps(24.0f),
+                             .weight = 1.0f}};
+    auto uiLayers = std::vector<LayerRequirement>{
+            LayerRequirement{.vote = LayerVoteType::Heuristic,
+                             .desiredRefreshRate = Fps(90.0f),
+                             .weight = 1.0f}};
+
+    // Cache a result that getBestRefreshRate would not find, to tell when it is read back.
+    setLastBestRefreshRateInvocation(*refreshRateConfigs,
+                                     GetBestRefreshRateInvocation{.layerRequirements = videoLayers,
+                                                                  .resultingBestRefreshRate =
+                                                                          createRefreshRate(
+                                                                                  mConfig30)});
+    EXPECT_EQ(mExpected90Config,
+              refreshRateConfigs->getBestRefreshRate(uiLayers, {.touch = false, .idle = false}));
+    EXPECT_EQ(2u, getBestRefreshRateCacheSize(*refreshRateConfigs));
+
+    EXPECT_EQ(mExpected30Config,
+              refreshRateConfigs->getBestRefreshRate(videoLayers, {.touch = false, .idle = false}));
+    const auto lastInvocation = getLastBestRefreshRateInvocation(*refreshRateConfigs);
+    ASSERT_TRUE(lastInvocation.has_value());
+    EXPECT_EQ(videoLayers, lastInvocation->layerRequirements);
+
+    // Any change in the signals or votes is a different invocation.
+    EXPECT_EQ(mExpected120Config,
+              refreshRateConfigs->getBestRefreshRate(videoLayers, {.touch = true, .idle = false}));
+    videoLayers[0].desiredRefreshRate = Fps(60.0f);
+    EXPECT_EQ(mExpected60Config,
+              refreshRateConfigs->getBestRefreshRate(videoLayers, {.touch = false, .idle = false}));
+    EXPECT_EQ(4u, getBestRefreshRateCacheSize(*refreshRateConfigs));
+
+    refreshRateConfigs->setCurrentModeId(HWC_CONFIG_ID_90);
+    EXPECT_EQ(0u, getBestRefreshRateCacheSize(*refreshRateConfigs));
+}
+
+TEST_F(RefreshRateConfigsTest, getBestRefreshRate_EvictsLeastRecentlyUsedInvocation) {
+    auto refreshRateConfigs =
+            std::make_unique<RefreshRateConfigs>(m30_60_72_90_120Device,
+                                                 /*currentConfigId=*/HWC_CONFIG_ID_60);
+
+    const auto layersWithWeight = [](float weight) {
+        return std::vector<LayerRequirement>{
+                LayerRequirement{.vote = LayerVoteType::Heuristic,
+                                 .desiredRefreshRate = Fps(60.0f),
+                                 .weight = weight}};
+    };
+
+    for (size_t i = 0; i <= kBestRefreshRateCacheSize; i++) {
+        setLastBestRefreshRateInvocation(*refreshRateConfigs,
+                                         GetBestRefreshRateInvocation{
+                                                 .layerRequirements = layersWithWeight(i / 10.0f),
+                                                 .resultingBestRefreshRate =
+                                                         createRefreshRate(mConfig30)});
+        if (i == 1) {
+            // Use the first invocation again, so that the second one is the least recently used.
+            EXPECT_EQ(mExpected30Config,
+                      refreshRateConfigs->getBestRefreshRate(layersWithWeight(0.0f),
+                                                             {.touch = false, .idle = false}));
+        }
+    }
+    EXPECT_EQ(kBestRefreshRateCacheSize, getBestRefreshRateCacheSize(*refreshRateConfigs));
+
+    EXPECT_EQ(mExpected30Config,
+              refreshRateConfigs->getBestRefreshRate(layersWithWeight(0.0f),
+                                                     {.touch = false, .idle = false}));
+    EXPECT_EQ(mExpected60Config,
+              refreshRateConfigs->getBestRefreshRate(layersWithWeight(0.1f),
+                                                     {.touch = false, .idle = false}));
+}
+
+TEST_F(RefreshRateConfigsTest, getBestRefreshRate_LooksUpScoresOfKnownFrameRates) {
+    auto refreshRateConfigs =
+            std::make_unique<RefreshRateConfigs>(m30_60_72_90_120Device,
+                                                 /*currentConfigId=*/HWC_CONFIG_ID_60);
+
+    for (const auto vote : {LayerVoteType::ExplicitExactOrMultiple, LayerVoteType::Heuristic}) {
+        for (const Fps& frameRate : getKnownFrameRate(*refreshRateConfigs)) {
+            const LayerRequirement layer{.vote = vote, .desiredRefreshRate = frameRate};
+            for (const auto& mode : m30_60_72_90_120Device) {
+                const RefreshRate refreshRate = createRefreshRate(mode);
+                for (const bool isSeamlessSwitch : {true, false}) {
+                    const auto score = lookUpLayerScore(*refreshRateConfigs, layer, refreshRate,
+                                                        isSeamlessSwitch);
+                    ASSERT_TRUE(score.has_value()) << frameRate;
+                    EXPECT_EQ(calculateLayerScore(*refreshRateConfigs, layer, refreshRate,
+                                                  isSeamlessSwitch),
+                              *score)
+                            << layer.desiredRefreshRate << " on " << refreshRate;
+                }
+            }
+        }
+    }
+
+    // Frame rates that are not known are scored as before.
+    const LayerRequirement layer{.vote = LayerVoteType::Heuristic,
+                                 .desiredRefreshRate = Fps(37.0f)};
+    EXPECT_FALSE(lookUpLayerScore(*refreshRateConfigs, layer, createRefreshRate(mConfig60),
+                                  true /*isSeamlessSwitch*/)
+                         .has_value());
+}
+
 TEST_F(RefreshRateConfigsTest, getBestRefreshRate_ExplicitExactTouchBoost) {
     RefreshRateConfigs::Config config = {.enableFrameRateOverride = true};
     auto refreshRateConfigs =
@@ -383,6 +383,8 @@ public:
     }
 
     auto flushTransactionQueues() { return mFlinger->flushTransactionQueues(); };
+    auto transactionFlushNeeded() { return mFlinger->transactionFlushNeeded(); }
+    void startTransactionFenceWatcher() { mFlinger->mTransactionFenceWatcher.start(); }
 
     auto onTransact(uint32_t code, const Parcel& data, Parcel* reply, uint32_t flags) {
         return mFlinger->onTransact(code, data, reply, flags);
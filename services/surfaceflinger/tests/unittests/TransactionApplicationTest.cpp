@@ -24,8 +24,13 @@
 #include <gtest/gtest.h>
 #include <gui/SurfaceComposerClient.h>
 #include <log/log.h>
+#include <sys/eventfd.h>
+#include <ui/Fence.h>
 #include <utils/String8.h>
 
+#include <chrono>
+#include <thread>
+
 #include "TestableScheduler.h"
 #include "TestableSurfaceFlinger.h"
 #include "mock/MockEventThread.h"
@@ -37,6 +42,8 @@ namespace android {
 using testing::_;
 using testing::Return;
 
+using namespace std::chrono_literals;
+
 using FakeHwcDisplayInjector = TestableSurfaceFlinger::FakeHwcDisplayInjector;
 
 class TransactionApplicationTest : public testing::Test {
@@ -325,6 +332,60 @@ TEST_F(TransactionApplicationTest, BlockWithPriorTransaction_SyncInputWindows) {
     BlockedByPriorTransaction(/*flags*/ 0, /*syncInputWindows*/ true);
 }
 
+TEST_F(TransactionApplicationTest, UnsignaledFence_AppliedOnceSignaled) {
+    mFlinger.startTransactionFenceWatcher();
+
+    // An eventfd polls like a fence, and signals once it is written to.
+    base::unique_fd eventFd(eventfd(0, EFD_CLOEXEC));
+    ASSERT_TRUE(eventFd.ok());
+    sp<Fence> fence = new Fence(base::unique_fd(dup(eventFd.get())));
+    ASSERT_EQ(Fence::Status::Unsignaled, fence->getStatus());
+
+    // called in SurfaceFlinger::signalTransaction, once when the transaction is queued, and once
+    // when the fence watcher sees the fence signal
+    EXPECT_CALL(*mMessageQueue, invalidate()).Times(2);
+
+    TransactionInfo transaction;
+    setupSingle(transaction, /*flags*/ 0, /*syncInputWindows*/ false,
+                /*desiredPresentTime*/ systemTime(), /*isAutoTimestamp*/ true,
+                FrameTimelineInfo{});
+    ComposerState composerState;
+    composerState.state.what = layer_state_t::eAcquireFenceChanged;
+    composerState.state.acquireFence = fence;
+    transaction.states.add(composerState);
+    mFlinger.setTransactionState(transaction.frameTimelineInfo, transaction.states,
+                                 transaction.displays, transaction.flags, transaction.applyToken,
+                                 transaction.inputWindowCommands, transaction.desiredPresentTime,
+                                 transaction.isAutoTimestamp, transaction.uncacheBuffer,
+                                 mHasListenerCallbacks, mCallbacks, transaction.id);
+
+    // The transaction waits on the pending queue for its fence, without asking for another flush.
+    mFlinger.mutableTransactionFlags() &= ~eTransactionFlushNeeded;
+    mFlinger.flushTransactionQueues();
+    EXPECT_EQ(0u, mFlinger.getTransactionQueue().size());
+    EXPECT_EQ(1u, mFlinger.getPendingTransactionQueue().size());
+    EXPECT_EQ(0, mFlinger.mutableTransactionFlags() & eTransactionFlushNeeded);
+    EXPECT_FALSE(mFlinger.transactionFlushNeeded());
+
+    mFlinger.flushTransactionQueues();
+    EXPECT_EQ(1u, mFlinger.getPendingTransactionQueue().size());
+    EXPECT_EQ(0, mFlinger.mutableTransactionFlags() & eTransactionFlushNeeded);
+
+    // Signaling the fence asks for a flush, which applies the transaction.
+    const uint64_t one = 1;
+    ASSERT_EQ(static_cast<ssize_t>(sizeof(one)), write(eventFd.get(), &one, sizeof(one)));
+    const auto deadline = std::chrono::steady_clock::now() + 5s;
+    while (!(mFlinger.mutableTransactionFlags() & eTransactionFlushNeeded) &&
+           std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(1ms);
+    }
+    ASSERT_NE(0, mFlinger.mutableTransactionFlags() & eTransactionFlushNeeded);
+
+    mFlinger.flushTransactionQueues();
+    EXPECT_EQ(0u, mFlinger.getPendingTransactionQueue().size());
+    EXPECT_FALSE(mFlinger.transactionFlushNeeded());
+}
+
 TEST_F(TransactionApplicationTest, FromHandle) {
     sp<IBinder> badHandle;
     auto ret = mFlinger.fromHandle(badHandle);
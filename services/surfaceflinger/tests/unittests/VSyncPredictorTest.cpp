@@ -29,6 +29,9 @@
 #include <gtest/gtest.h>
 #include <algorithm>
 #include <chrono>
+#include <deque>
+#include <optional>
+#include <random>
 #include <utility>
 
 using namespace testing;
@@ -47,6 +50,36 @@ std::vector<nsecs_t> generateVsyncTimestamps(size_t count, nsecs_t period, nsecs
     return vsyncs;
 }
 
+// The linear regression that VSyncPredictor used to compute over all of its timestamps for every
+// sample, which the regression it updates as samples come and go should match.
+std::optional<VSyncPredictor::Model> batchRegression(const std::deque<nsecs_t>& timestamps,
+                                                     nsecs_t currentPeriod) {
+    static constexpr int64_t kScalingFactor = 1000;
+
+    std::vector<nsecs_t> vsyncTS(timestamps.size());
+    std::vector<nsecs_t> ordinals(timestamps.size());
+    auto const oldest = *std::min_element(timestamps.begin(), timestamps.end());
+    for (size_t i = 0; i < timestamps.size(); i++) {
+        vsyncTS[i] = timestamps[i] - oldest;
+        ordinals[i] = ((vsyncTS[i] + (currentPeriod / 2)) / currentPeriod) * kScalingFactor;
+    }
+
+    auto const meanTS = scheduler::calculate_mean(vsyncTS);
+    auto const meanOrdinal = scheduler::calculate_mean(ordinals);
+    auto top = 0ll;
+    auto bottom = 0ll;
+    for (size_t i = 0; i < vsyncTS.size(); i++) {
+        top += (vsyncTS[i] - meanTS) * (ordinals[i] - meanOrdinal);
+        bottom += (ordinals[i] - meanOrdinal) * (ordinals[i] - meanOrdinal);
+    }
+    if (bottom == 0) {
+        return std::nullopt;
+    }
+
+    nsecs_t const slope = top * kScalingFactor / bottom;
+    return VSyncPredictor::Model{slope, meanTS - (slope * meanOrdinal / kScalingFactor)};
+}
+
 struct VSyncPredictorTest : testing::Test {
     nsecs_t mNow = 0;
     nsecs_t mPeriod = 1000;
@@ -57,6 +90,37 @@ struct VSyncPredictorTest : testing::Test {
 
     VSyncPredictor tracker{mPeriod, kHistorySize, kMinimumSamplesForPrediction,
                            kOutlierTolerancePercent};
+
+    // Adds the timestamps one by one, and expects the model after each of them to be the one
+    // computed by batchRegression from the timestamps the tracker kept.
+    void expectModelsMatchBatchRegression(const std::vector<nsecs_t>& timestamps) {
+        for (auto const timestamp : timestamps) {
+            auto const currentPeriod = tracker.currentPeriod();
+            if (!tracker.addVsyncTimestamp(timestamp)) {
+                // The timestamp was either ignored, or all timestamps were dropped.
+                if (tracker.needsMoreSamples()) {
+                    mKeptTimestamps.clear();
+                }
+                continue;
+            }
+
+            mKeptTimestamps.push_back(timestamp);
+            if (mKeptTimestamps.size() > kHistorySize) {
+                mKeptTimestamps.pop_front();
+            }
+            if (mKeptTimestamps.size() < kMinimumSamplesForPrediction) {
+                continue;
+            }
+
+            auto const expected = batchRegression(mKeptTimestamps, currentPeriod);
+            ASSERT_TRUE(expected.has_value());
+            auto const [slope, intercept] = tracker.getVSyncPredictionModel();
+            EXPECT_THAT(slope, Eq(expected->slope)) << "at timestamp " << timestamp;
+            EXPECT_THAT(intercept, Eq(expected->intercept)) << "at timestamp " << timestamp;
+        }
+    }
+
+    std::deque<nsecs_t> mKeptTimestamps;
 };
 
 TEST_F(VSyncPredictorTest, reportsAnticipatedPeriod) {
@@ -532,6 +596,56 @@ TEST_F(VSyncPredictorTest, robustToDuplicateTimestamps_60hzRealTraceData) {
     EXPECT_THAT(intercept, IsCloseTo(expectedIntercept, mMaxRoundingError));
 }
 
+TEST_F(VSyncPredictorTest, modelMatchesBatchRegressionWithJitter) {
+    std::mt19937 generator(42);
+    std::uniform_int_distribution<nsecs_t> jitter(-mPeriod / 50, mPeriod / 50);
+
+    std::vector<nsecs_t> vsyncs;
+    for (nsecs_t i = 1; i <= 100; i++) {
+        vsyncs.push_back(i * mPeriod + jitter(generator));
+    }
+    expectModelsMatchBatchRegression(vsyncs);
+}
+
+TEST_F(VSyncPredictorTest, modelMatchesBatchRegressionWithDriftAndMissedVsyncs) {
+    std::mt19937 generator(7);
+    std::uniform_int_distribution<nsecs_t> missed(0, 3);
+    auto const actualPeriod = mPeriod + mPeriod / 40;
+
+    std::vector<nsecs_t> vsyncs;
+    nsecs_t ordinal = 0;
+    for (auto i = 0; i < 100; i++) {
+        ordinal += 1 + (missed(generator) == 0 ? 2 : 0);
+        vsyncs.push_back(ordinal * actualPeriod + 123);
+    }
+    expectModelsMatchBatchRegression(vsyncs);
+}
+
+TEST_F(VSyncPredictorTest, modelMatchesBatchRegressionAcrossPeriodChange) {
+    expectModelsMatchBatchRegression(generateVsyncTimestamps(25, mPeriod, 300));
+
+    auto const changedPeriod = mPeriod * 2;
+    tracker.setPeriod(changedPeriod);
+    mKeptTimestamps.clear();
+    expectModelsMatchBatchRegression(
+            generateVsyncTimestamps(25, changedPeriod + 11, 100 * mPeriod + 500));
+}
+
+TEST_F(VSyncPredictorTest, modelMatchesBatchRegressionWithOutOfOrderTimestamp) {
+    auto vsyncs = generateVsyncTimestamps(30, mPeriod, 50);
+    // A timestamp from before the ones in the window, followed by more in order ones.
+    vsyncs.insert(vsyncs.begin() + 15, 2 * mPeriod + 55);
+    expectModelsMatchBatchRegression(vsyncs);
+}
+
+TEST_F(VSyncPredictorTest, modelMatchesBatchRegressionWithOutliersAndDuplicates) {
+    auto vsyncs = generateVsyncTimestamps(40, mPeriod, 0);
+    vsyncs.insert(vsyncs.begin() + 12, vsyncs[11] + mPeriod / 2);
+    vsyncs.insert(vsyncs.begin() + 20, vsyncs[19] + 5);
+    vsyncs.insert(vsyncs.begin() + 3, vsyncs[2] + mPeriod / 2);
+    expectModelsMatchBatchRegression(vsyncs);
+}
+
 } // namespace android::scheduler
 
 // TODO(b/129481165): remove the #pragma below and fix conversion issues